@@ -190,6 +190,30 @@ struct lsquic_stream_if {
 /** By default, packets are paced */
 #define LSQUIC_DF_PACE_PACKETS      1
 
+/** Default congestion control algorithm is Cubic */
+#define LSQUIC_DF_CC_ALGO           1
+
+/** By default, Cubic uses HyStart++ to exit slow start */
+#define LSQUIC_DF_HYSTART           1
+
+/** By default, Cubic uses Proportional Rate Reduction in loss recovery */
+#define LSQUIC_DF_PRR               1
+
+/** By default, packets are not given departure times */
+#define LSQUIC_DF_TXTIME            0
+
+/** By default, there is no receive memory budget */
+#define LSQUIC_DF_FC_MEM_BUDGET     0
+
+/** By default, ACK decimation is off */
+#define LSQUIC_DF_ACK_DECIM         0
+
+/** When turned on, ACK decimation begins at the hundredth packet */
+#define LSQUIC_DF_ACK_DECIM_START   100
+
+/** By default, incoming stream data is not buffered in a ring */
+#define LSQUIC_DF_USE_DI_RING       0
+
 struct lsquic_engine_settings {
     /**
      * This is a bit mask wherein each bit corresponds to a value in
@@ -204,8 +228,9 @@ struct lsquic_engine_settings {
     /**
      * Initial default CFCW.
      *
-     * In server mode, per-connection values may be set lower than
-     * this if resources are scarce.
+     * Per-connection values may be set lower than this if resources are
+     * scarce.  In client mode, this happens when @ref es_fc_mem_budget
+     * is set and there is not enough of it left.
      *
      * Do not set es_cfcw and es_sfcw lower than @ref LSQUIC_MIN_FCW.
      *
@@ -231,10 +256,25 @@ struct lsquic_engine_settings {
      * which means that CFCW is not allowed to increase from its initial
      * value.
      *
+     * Each time a window update is due, the window is resized to twice
+     * the product of the rate at which the data has been read since the
+     * previous update and the smoothed RTT.  The window changes by at most
+     * a factor of two each time and does not go below its initial value
+     * unless the engine is over @ref es_fc_mem_budget.
+     *
      * @see es_cfcw
      */
     unsigned        es_max_cfcw;
 
+    /**
+     * Maximum value SFCW is allowed to reach due to window auto-tuning.
+     * Stream windows are tuned the same way connection windows are; they
+     * never exceed the connection window.  By default, this value is zero,
+     * which means that SFCW is not allowed to increase from its initial
+     * value.
+     *
+     * @see es_sfcw, es_max_cfcw
+     */
     unsigned        es_max_sfcw;
 
     /** MIDS */
@@ -389,6 +429,110 @@ struct lsquic_engine_settings {
      */
     int             es_pace_packets;
 
+    /**
+     * Congestion control algorithm to use.
+     *
+     *  1:  Cubic
+     *  2:  BBR
+     *
+     * BBR paces packets regardless of @ref es_pace_packets.
+     *
+     * The default value is @ref LSQUIC_DF_CC_ALGO.
+     */
+    unsigned        es_cc_algo;
+
+    /**
+     * If set to true, Cubic uses HyStart++: when RTT grows during slow
+     * start, congestion window growth slows down and, if the increase
+     * persists, slow start ends before packets are lost.  This setting
+     * has no effect on BBR.
+     *
+     * The default value is @ref LSQUIC_DF_HYSTART.
+     */
+    int             es_hystart;
+
+    /**
+     * If set to true, Cubic uses Proportional Rate Reduction (RFC 6937)
+     * during loss recovery: the number of packets sent is proportional to
+     * the number of packets acknowledged, so that bytes in flight come
+     * down to the new congestion window gradually rather than sending
+     * stopping and then resuming in a burst.  This setting has no effect
+     * on BBR.
+     *
+     * The default value is @ref LSQUIC_DF_PRR.
+     */
+    int             es_prr;
+
+    /**
+     * If set to a non-zero value, the pacer is allowed to schedule packets
+     * up to this many microseconds ahead and each outgoing packet is given
+     * an intended departure time: see `tx_time' in struct lsquic_out_spec.
+     * The packets_out callback is then expected to hand the packets to
+     * the kernel with that time, for example using SO_TXTIME, so that the
+     * network stack does the fine-grained pacing.  The engine needs to be
+     * ticked less often as a result.
+     *
+     * This only has effect if packets are paced.  Do not turn it on if
+     * the packets_out callback does not honor `tx_time': the RTT would be
+     * underestimated.  A value of 2000 is a reasonable starting point.
+     *
+     * The default value is @ref LSQUIC_DF_TXTIME.
+     */
+    unsigned        es_txtime;
+
+    /**
+     * Once ACK decimation is in effect, an ACK is sent after this many
+     * retransmittable packets are received or a quarter of min_rtt after
+     * the first of them, whichever comes first.  Packets that arrive out
+     * of order are still acknowledged right away.  This cuts the number
+     * of ACK packets sent during bulk transfers.
+     *
+     * Zero turns ACK decimation off: an ACK is then sent after every
+     * second retransmittable packet.  Chromium uses 10.
+     *
+     * The default value is @ref LSQUIC_DF_ACK_DECIM.
+     */
+    unsigned        es_ack_decim;
+
+    /**
+     * ACK decimation begins once a packet with this number is received.
+     * Until then, every second packet is acknowledged, which lets the
+     * peer's congestion window grow quickly at the start of connection.
+     *
+     * The default value is @ref LSQUIC_DF_ACK_DECIM_START.
+     */
+    unsigned        es_ack_decim_start;
+
+    /**
+     * Receive memory budget in bytes shared by all connections of the
+     * engine.  It limits the sum of connection flow control windows.
+     * A new connection starts with what is left of the budget if that is
+     * less than @ref es_cfcw, but no less than @ref LSQUIC_MIN_FCW.
+     * When a connection wants to grow its window, it can use what is left
+     * of the budget or its fair share of it, whichever is larger.  When
+     * the engine is over budget, connections whose windows are larger
+     * than their fair share shrink them at the next window update; the
+     * window does not go below @ref LSQUIC_MIN_FCW.
+     *
+     * Zero means there is no budget.
+     *
+     * The default value is @ref LSQUIC_DF_FC_MEM_BUDGET.
+     */
+    unsigned long long  es_fc_mem_budget;
+
+    /**
+     * If set to true, incoming data on application streams is copied into
+     * a ring buffer, one per stream, that grows up to the stream flow
+     * control window.  This suits bulk downloads, where the data arrives
+     * in large amounts and mostly in order.
+     *
+     * When false, the stream starts by holding on to the incoming packets
+     * and switches to a hash of data blocks if that becomes too costly.
+     *
+     * The default value is @ref LSQUIC_DF_USE_DI_RING.
+     */
+    int             es_use_di_ring;
+
 };
 
 /* Initialize `settings' to default values */
@@ -424,6 +568,28 @@ struct lsquic_out_spec
     const struct sockaddr *local_sa;
     const struct sockaddr *dest_sa;
     void                  *peer_ctx;
+    /**
+     * Number of packets, starting with this one, that can be sent together
+     * as a single UDP GSO (UDP_SEGMENT) super-buffer with segment size
+     * `sz'.  These packets come from the same connection and have the same
+     * local and destination addresses.  All of them except the last one
+     * are `sz' bytes long; the last one may be shorter.  There are at most
+     * 64 packets in a run and they total under 64 KB.
+     *
+     * This value is always at least 1.  The packets_out callback is free to
+     * ignore it and send packets one at a time.
+     *
+     * If `tx_time' is set, all packets in the run have the same value.
+     */
+    unsigned               n_segs;
+    /**
+     * Intended departure time in microseconds, in the clock used by the
+     * library: CLOCK_MONOTONIC on Linux.  Zero means "send now".  This is
+     * only set if es_txtime setting is turned on.  On Linux, it can be
+     * passed to the kernel in an SCM_TXTIME control message (after
+     * converting it to nanoseconds) on a socket with SO_TXTIME enabled.
+     */
+    uint64_t               tx_time;
 };
 
 /**
@@ -464,6 +630,15 @@ typedef struct lsquic_engine_api
      */
     const struct lsquic_packout_mem_if  *ea_pmi;
     void                                *ea_pmi_ctx;
+    /**
+     * Optional callback to generate connection IDs for new client
+     * connections.  If not specified, connection IDs are random.  This can
+     * be used to encode routing information in the connection ID, for
+     * example when several engines share a socket.  The returned ID must
+     * not be used by any other connection in the engine.
+     */
+    lsquic_cid_t                       (*ea_generate_cid)(void *ctx);
+    void                                *ea_generate_cid_ctx;
 } lsquic_engine_api_t;
 
 /**
@@ -502,6 +677,48 @@ lsquic_engine_packet_in (lsquic_engine_t *,
         const struct sockaddr *sa_local, const struct sockaddr *sa_peer,
         void *peer_ctx);
 
+/**
+ * Incoming packet specification.  Used by lsquic_engine_packets_in().
+ */
+struct lsquic_in_spec
+{
+    const unsigned char   *buf;
+    size_t                 sz;
+    const struct sockaddr *local_sa;
+    const struct sockaddr *peer_sa;
+    void                  *peer_ctx;
+};
+
+/**
+ * Pass a batch of incoming packets to the QUIC engine.  This is equivalent
+ * to calling lsquic_engine_packet_in() for each packet in `in_spec', but
+ * the receive timestamp is taken once for the whole batch and consecutive
+ * packets that belong to the same connection are matched without another
+ * connection lookup.  Packets that cannot be processed (invalid size or
+ * header, or memory allocation failure) are skipped.
+ *
+ * As with lsquic_engine_packet_in(), the library does not keep references
+ * to packet data after this function returns.
+ *
+ * @return  Number of packets that were processed by real connections.
+ */
+unsigned
+lsquic_engine_packets_in (lsquic_engine_t *,
+        const struct lsquic_in_spec *in_spec, unsigned n_packets_in);
+
+/**
+ * Get connection ID from incoming packet.  This can be used to route
+ * packets to one of several engines before they are passed to
+ * lsquic_engine_packet_in().
+ *
+ * @retval  0   Connection ID was found and written to `cid'.
+ *
+ * @retval -1   Packet does not contain connection ID.
+ */
+int
+lsquic_cid_from_packet (const unsigned char *packet_in_data,
+                        size_t packet_in_size, lsquic_cid_t *cid);
+
 /**
  * Process all connections.  This function must be called often enough so
  * that packets and connections do not expire.
@@ -511,7 +728,8 @@ lsquic_engine_proc_all (lsquic_engine_t *engine);
 
 /**
  * Process connections that have incoming packets.  Call this after adding
- * one or more incoming packets using lsquic_engine_packet_in().
+ * one or more incoming packets using lsquic_engine_packet_in() or
+ * lsquic_engine_packets_in().
  */
 void
 lsquic_engine_process_conns_with_incoming (lsquic_engine_t *);
@@ -593,6 +811,26 @@ ssize_t lsquic_stream_read(lsquic_stream_t *s, void *buf, size_t len);
 ssize_t lsquic_stream_readv(lsquic_stream_t *s, const struct iovec *,
                                                             int iovcnt);
 
+/**
+ * Read from stream without copying: `readf' is called with pointers to
+ * in-order stream data as it sits in the received packets.  `len' may be
+ * zero if `fin' is set.  `fin' is true if the data ends at the end of the
+ * stream.
+ *
+ * The callback returns the number of bytes it consumed, which may be
+ * smaller than `len'.  Only consumed bytes are marked as read and count
+ * toward flow control credit.  When the callback consumes fewer bytes than
+ * it is given, reading stops.  The pointer is only valid during the call.
+ *
+ * @retval Number of bytes read, 0 on EOF, or -1 on error.  If no data
+ *         is available, -1 is returned and errno is set to EWOULDBLOCK.
+ */
+ssize_t
+lsquic_stream_readf (lsquic_stream_t *s,
+        size_t (*readf)(void *ctx, const unsigned char *buf, size_t len,
+                                                                int fin),
+        void *ctx);
+
 int lsquic_stream_wantwrite(lsquic_stream_t *s, int is_want);
 
 /**
@@ -603,6 +841,24 @@ ssize_t lsquic_stream_write(lsquic_stream_t *s, const void *buf, size_t len);
 
 ssize_t lsquic_stream_writev(lsquic_stream_t *s, const struct iovec *vec, int count);
 
+/**
+ * Write `len' bytes from `buf' without copying them to the stream's
+ * buffer.  Data that does not fill a packet is kept by reference until
+ * it is packetized instead of being copied.  The data is still copied
+ * once, into packets, as with @ref lsquic_stream_write().
+ *
+ * If the return value is positive, the stream has taken a reference to
+ * `buf' and will call `release' exactly once when it no longer needs it.
+ * This may happen before this function returns.  The buffer must not be
+ * modified until then.  `release' must not call stream functions.
+ *
+ * @retval Number of bytes written, which may be smaller than `len', or
+ *         -1 on error.
+ */
+ssize_t
+lsquic_stream_write_nobuf (lsquic_stream_t *s, const void *buf, size_t len,
+                           void (*release)(void *ctx), void *ctx);
+
 /**
  * Used as argument to @ref lsquic_stream_writef()
  */
@@ -632,6 +888,39 @@ struct lsquic_reader
 ssize_t
 lsquic_stream_writef (lsquic_stream_t *, struct lsquic_reader *);
 
+#ifndef WIN32
+/**
+ * Flags for @ref lsquic_file_reader_new()
+ */
+enum lsquic_file_reader_flags
+{
+    /** Read the file using pread(2) instead of mapping it into memory */
+    LSQUIC_FR_PREAD     = 1 << 0,
+};
+
+/**
+ * Create reader to be used with @ref lsquic_stream_writef() that reads
+ * `size' bytes from file descriptor `fd' starting at offset `off'.
+ *
+ * By default, the file is mapped into memory a few megabytes at a time
+ * and the data is copied into packets straight from the page cache.
+ *
+ * If the file ends before `off' + `size', the stream ends where the file
+ * does.  If the file may be truncated while it is being uploaded, use
+ * @ref LSQUIC_FR_PREAD, as accessing a mapping past the end of file
+ * raises SIGBUS.
+ *
+ * The reader does not close `fd'.
+ *
+ * @retval New reader or NULL on error.
+ */
+struct lsquic_reader *
+lsquic_file_reader_new (int fd, uint64_t off, uint64_t size, unsigned flags);
+
+void
+lsquic_file_reader_destroy (struct lsquic_reader *);
+#endif
+
 /**
  * Flush any buffered data.  This triggers packetizing even a single byte
  * into a separate frame.  Flushing a closed stream is an error.
@@ -746,6 +1035,11 @@ lsquic_conn_get_engine (lsquic_conn_t *c);
 int lsquic_conn_get_sockaddr(const lsquic_conn_t *c,
                 const struct sockaddr **local, const struct sockaddr **peer);
 
+/**
+ * The logger callback is called once for each complete message, newline
+ * included.  Calls are serialized across threads; the callback must not
+ * log through lsquic itself.
+ */
 struct lsquic_logger_if {
     int     (*vprintf)(void *logger_ctx, const char *fmt, va_list args);
 };
@@ -798,6 +1092,9 @@ enum lsquic_logger_timestamp_style {
 /**
  * Call this if you want to do something with LSQUIC log messages, as they
  * are thrown out by default.
+ *
+ * The logger is shared by all engines.  Calls to the logger interface are
+ * serialized, so `vprintf' does not need to be thread-safe.
  */
 void lsquic_logger_init(const struct lsquic_logger_if *, void *logger_ctx,
                         enum lsquic_logger_timestamp_style);
@@ -840,6 +1137,11 @@ unsigned lsquic_engine_quic_versions (const lsquic_engine_t *);
  * Initialize LSQUIC.  This must be called before any other LSQUIC function
  * is called.  Returns 0 on success and -1 on failure.
  *
+ * This function may be called more than once, for example by each thread
+ * that runs an engine.  Each successful call must be matched by a call to
+ * @ref lsquic_global_cleanup.  If a later call specifies a flag that was
+ * not passed before, the corresponding mode is initialized then.
+ *
  * @param flags     This a bitmask of @ref LSQUIC_GLOBAL_CLIENT and
  *                    @ref LSQUIC_GLOBAL_SERVER.  At least one of these
  *                    flags should be specified.
@@ -855,7 +1157,9 @@ lsquic_global_init (int flags);
 
 /**
  * Clean up global state created by @ref lsquic_global_init.  Should be
- * called after all LSQUIC engine instances are gone.
+ * called after all LSQUIC engine instances are gone.  Global state is
+ * freed by the last call, the one that balances the number of successful
+ * calls to @ref lsquic_global_init.
  */
 void
 lsquic_global_cleanup (void);
@@ -910,6 +1214,68 @@ lsquic_engine_earliest_adv_tick (lsquic_engine_t *engine, int *diff);
 unsigned
 lsquic_engine_count_attq (lsquic_engine_t *engine, int from_now);
 
+/**
+ * Engine counters.  See struct lsquic_engine_stats.
+ */
+struct lsquic_engine_counters
+{
+    /** Packets given to the engine that it could parse */
+    unsigned long long  packets_in;
+    unsigned long long  bytes_in;
+    /** Packets that the packets_out callback reported as sent */
+    unsigned long long  packets_out;
+    unsigned long long  bytes_out;
+    /** Calls to the packets_out callback */
+    unsigned long long  batches_sent;
+    /** Calls to the packets_out callback that did not send all packets */
+    unsigned long long  short_writes;
+    unsigned long long  encrypt_failures;
+    /**
+     * Incoming packets that could not be parsed or that do not belong to
+     * any connection.
+     */
+    unsigned long long  packets_dropped;
+    /**
+     * Incoming packets that connections dropped as duplicates.  Most of
+     * them are dropped before they are decrypted.
+     */
+    unsigned long long  packets_dup;
+    unsigned long long  conns_created;
+    unsigned long long  conns_destroyed;
+};
+
+struct lsquic_engine_stats
+{
+    /** Counters since the engine was created */
+    struct lsquic_engine_counters   total;
+    /**
+     * Counters since the previous call to lsquic_engine_get_stats() or,
+     * if this is the first call, since the engine was created.
+     */
+    struct lsquic_engine_counters   interval;
+    /** Length of the interval in microseconds */
+    unsigned long long              interval_usec;
+    /** Connections that have not been closed */
+    unsigned                        n_conns;
+    /** Connections on the Advisory Tick Time queue */
+    unsigned                        attq_size;
+    /** Connections on the Pending RW Events queue */
+    unsigned                        pend_rw_count;
+    /**
+     * Sum of connection flow control windows.  This is what
+     * es_fc_mem_budget limits.
+     */
+    unsigned long long              fc_windows;
+};
+
+/**
+ * Get engine statistics.  The counters are always kept: logging does not
+ * need to be enabled.  Each call starts a new interval.
+ */
+void
+lsquic_engine_get_stats (lsquic_engine_t *engine,
+                                        struct lsquic_engine_stats *stats);
+
 enum LSQUIC_CONN_STATUS
 {
     LSCONN_ST_HSK_IN_PROGRESS,
@@ -929,6 +1295,76 @@ enum LSQUIC_CONN_STATUS
 enum LSQUIC_CONN_STATUS
 lsquic_conn_status (lsquic_conn_t *, char *errbuf, size_t bufsz);
 
+/** Current version of struct lsquic_conn_info */
+#define LSQUIC_CONN_INFO_VERSION 2
+
+/**
+ * Snapshot of connection transport state returned by
+ * @ref lsquic_conn_get_info().  New members are only ever added at the end
+ * of the structure, and @ref LSQUIC_CONN_INFO_VERSION is incremented when
+ * that happens.
+ */
+struct lsquic_conn_info
+{
+    /** Set to @ref LSQUIC_CONN_INFO_VERSION by the library */
+    unsigned            lci_version;
+    /** Packets in flight */
+    unsigned            lci_packets_in_flight;
+    /** RTT estimates in microseconds.  Zero until the first sample. */
+    unsigned long long  lci_srtt;
+    unsigned long long  lci_rttvar;
+    /** Smallest RTT sample, not adjusted for the peer's ACK delay */
+    unsigned long long  lci_min_rtt;
+    /** Congestion window in bytes */
+    unsigned long long  lci_cwnd;
+    /** Slow start threshold in bytes */
+    unsigned long long  lci_ssthresh;
+    /** Bytes in flight */
+    unsigned long long  lci_bytes_in_flight;
+    /**
+     * Packet counters.  These are zero if the library was compiled with
+     * LSQUIC_SEND_STATS set to 0.
+     */
+    unsigned long long  lci_packets_sent;
+    /** Packets declared lost */
+    unsigned long long  lci_packets_lost;
+    /** Packets whose frames were rescheduled for retransmission */
+    unsigned long long  lci_packets_resent;
+    /** Connection-level flow control: bytes sent and the peer's limit */
+    unsigned long long  lci_send_off;
+    unsigned long long  lci_send_max;
+    /** Connection-level flow control: highest offset received, our limit
+     * advertised to the peer, and the size of our receive window.
+     */
+    unsigned long long  lci_recv_off;
+    unsigned long long  lci_recv_max;
+    unsigned long long  lci_recv_window;
+    /**
+     * Time from connection creation until the handshake completed, in
+     * microseconds.  Zero if the handshake is not done yet.
+     */
+    unsigned long long  lci_hsk_usec;
+    /**
+     * Packets declared lost that were acknowledged later.  Losses caused
+     * by reordering or by a premature retransmission timeout show up here.
+     * Added in version 2; zero if the library was compiled with
+     * LSQUIC_SEND_STATS set to 0.
+     */
+    unsigned long long  lci_packets_spurious;
+};
+
+/**
+ * Fill in connection transport information.  At most `info_sz' bytes are
+ * copied, so that code compiled against an older version of this header
+ * (and thus a smaller structure) keeps working.  Pass sizeof(*info) as
+ * `info_sz'.
+ *
+ * @retval Number of bytes filled in.
+ */
+size_t
+lsquic_conn_get_info (lsquic_conn_t *, struct lsquic_conn_info *info,
+                                                            size_t info_sz);
+
 #ifdef __cplusplus
 }
 #endif
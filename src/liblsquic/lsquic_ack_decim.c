@@ -0,0 +1,33 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_ack_decim.c -- ACK decimation.
+ */
+
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_ack_decim.h"
+
+
+enum ack_decim_verdict
+lsquic_ack_decim_check (const struct ack_decim *ad, lsquic_packno_t largest,
+                                        unsigned n_ackable, int out_of_order)
+{
+    if (0 == ad->ad_packets || largest < ad->ad_start)
+        return ADV_OFF;
+
+    if (n_ackable >= ad->ad_packets || (out_of_order && n_ackable > 0))
+        return ADV_ACK_NOW;
+    else
+        return ADV_WAIT;
+}
+
+
+lsquic_time_t
+lsquic_ack_decim_delay (lsquic_time_t min_rtt, lsquic_time_t max_delay)
+{
+    /* Without an RTT sample, fall back to the regular ACK timeout */
+    if (min_rtt && min_rtt / 4 < max_delay)
+        return min_rtt / 4;
+    else
+        return max_delay;
+}
@@ -0,0 +1,50 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_ack_decim.h -- ACK decimation.
+ *
+ * Once the peer has sent enough packets, we no longer acknowledge every
+ * second retransmittable packet.  Instead, an ACK is sent after every
+ * ad_packets retransmittable packets or a quarter of min_rtt after the
+ * first unacknowledged one arrives, whichever comes first.  This follows
+ * Chromium's ACK_DECIMATION mode.  A packet that arrives out of order or
+ * leaves a gap is acknowledged right away, so that the peer learns of
+ * losses as quickly as before.
+ */
+
+#ifndef LSQUIC_ACK_DECIM_H
+#define LSQUIC_ACK_DECIM_H 1
+
+struct ack_decim
+{
+    unsigned            ad_packets;     /* Zero means decimation is off */
+    lsquic_packno_t     ad_start;       /* Decimate starting with this packet */
+};
+
+enum ack_decim_verdict
+{
+    ADV_OFF,        /* Decimation is not in effect: use regular rules */
+    ADV_WAIT,       /* Wait for more packets, set ACK alarm */
+    ADV_ACK_NOW,
+};
+
+#define lsquic_ack_decim_init(ad, packets, start) do {                  \
+    (ad)->ad_packets = (packets);                                       \
+    (ad)->ad_start   = (start);                                         \
+} while (0)
+
+/* `largest' is the largest packet number received.  `n_ackable' is the
+ * number of retransmittable packets received since last ACK was sent.
+ * A packet out of order only hastens an ACK if there is something to
+ * acknowledge: out-of-order ACK-only packets do not cause ACKs.
+ */
+enum ack_decim_verdict
+lsquic_ack_decim_check (const struct ack_decim *, lsquic_packno_t largest,
+                                        unsigned n_ackable, int out_of_order);
+
+/* How long to wait for more packets before sending ACK.  It is never
+ * longer than `max_delay'.
+ */
+lsquic_time_t
+lsquic_ack_decim_delay (lsquic_time_t min_rtt, lsquic_time_t max_delay);
+
+#endif
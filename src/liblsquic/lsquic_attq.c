@@ -2,14 +2,31 @@
 /*
  * lsquic_attq.c -- Advisory Tick Time Queue
  *
- * This is a collection of connections kept in a binary heap, the top
- * element having the minimum advsory time.  To speed up removal, each
- * element has an index it has in the heap array.  The index is updated
- * as elements are moved around in the array when heap is updated.
+ * This is a collection of connections kept in a hierarchical timing wheel.
+ * The wheel has a clock, which is never larger than the smallest advisory
+ * time in the queue.  Each level has 256 slots; a slot at level L covers
+ * 256^L microseconds.  An element is placed on the level of the highest
+ * 8-bit digit in which its advisory time differs from the clock, in the
+ * slot given by the value of that digit.  This way, all elements on lower
+ * levels come before those on higher levels and, within a level, slots
+ * are in time order.  Each level has a bitmap of non-empty slots, so that
+ * the earliest slot is found without walking the wheel.
+ *
+ * Adding and removing an element is O(1).  When the clock advances to a
+ * slot on a higher level, the elements in it are redistributed to lower
+ * levels ("cascaded").  Each element is cascaded at most once per level.
+ * Level 0 slots contain elements with the same advisory time, which makes
+ * the queue exact.
+ *
+ * The clock is only advanced by attq_pop(), up to the cutoff time.  An
+ * element added with advisory time smaller than the clock is placed at
+ * the head of the current level 0 slot, as it is already due.
  */
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <sys/queue.h>
 #ifdef WIN32
 #include <vc_compat.h>
 #endif
@@ -22,21 +39,113 @@
 #include "lsquic_conn.h"
 
 
+#define AQ_SLOT_BITS    8
+#define AQ_N_SLOTS      (1U << AQ_SLOT_BITS)
+#define AQ_SLOT_MASK    (AQ_N_SLOTS - 1)
+#define AQ_N_LEVELS     ((64 + AQ_SLOT_BITS - 1) / AQ_SLOT_BITS)
+#define AQ_N_WORDS      ((AQ_N_SLOTS + 63) / 64)
+
+TAILQ_HEAD(attq_slot, attq_elem);
+
 struct attq
 {
     struct malo        *aq_elem_malo;
-    struct attq_elem  **aq_heap;
     lsquic_time_t       aq_min;
+    lsquic_time_t       aq_clock;
     unsigned            aq_nelem;
-    unsigned            aq_nalloc;
+    uint64_t            aq_bitmaps[AQ_N_LEVELS][AQ_N_WORDS];
+    struct attq_slot    aq_slots[AQ_N_LEVELS][AQ_N_SLOTS];
+    /* Earliest element in the slot.  NULL if the slot is empty or if the
+     * earliest element has been removed: in that case, it is found again
+     * when needed.
+     */
+    struct attq_elem   *aq_slot_mins[AQ_N_LEVELS][AQ_N_SLOTS];
 };
 
 
+#if __GNUC__
+#   define ctz __builtin_ctzll
+#   define clz __builtin_clzll
+#else
+static unsigned
+ctz (unsigned long long x)
+{
+    unsigned n = 0;
+    if (0 == (x & ((1ULL << 32) - 1))) { n += 32; x >>= 32; }
+    if (0 == (x & ((1ULL << 16) - 1))) { n += 16; x >>= 16; }
+    if (0 == (x & ((1ULL <<  8) - 1))) { n +=  8; x >>=  8; }
+    if (0 == (x & ((1ULL <<  4) - 1))) { n +=  4; x >>=  4; }
+    if (0 == (x & ((1ULL <<  2) - 1))) { n +=  2; x >>=  2; }
+    if (0 == (x & ((1ULL <<  1) - 1))) { n +=  1; x >>=  1; }
+    return n;
+}
+
+
+static unsigned
+clz (unsigned long long x)
+{
+    unsigned n = 0;
+    if (0 == (x >> 32)) { n += 32; x <<= 32; }
+    if (0 == (x >> 48)) { n += 16; x <<= 16; }
+    if (0 == (x >> 56)) { n +=  8; x <<=  8; }
+    if (0 == (x >> 60)) { n +=  4; x <<=  4; }
+    if (0 == (x >> 62)) { n +=  2; x <<=  2; }
+    if (0 == (x >> 63)) { n +=  1; }
+    return n;
+}
+#endif
+
+
+#define AQ_DIGIT(time, level) \
+    ((unsigned) ((time) >> ((level) * AQ_SLOT_BITS)) & AQ_SLOT_MASK)
+
+#define AQ_BIT(slot) (1ULL << ((slot) & 63))
+#define AQ_IS_SET(q, level, slot) \
+    (!!((q)->aq_bitmaps[level][(slot) >> 6] & AQ_BIT(slot)))
+#define AQ_SET(q, level, slot) \
+    ((q)->aq_bitmaps[level][(slot) >> 6] |= AQ_BIT(slot))
+#define AQ_CLEAR(q, level, slot) \
+    ((q)->aq_bitmaps[level][(slot) >> 6] &= ~AQ_BIT(slot))
+
+
+/* Return the first non-empty slot on level `level' or AQ_N_SLOTS if the
+ * level is empty.
+ */
+static unsigned
+attq_first_slot (const struct attq *q, unsigned level)
+{
+    unsigned word;
+
+    for (word = 0; word < AQ_N_WORDS; ++word)
+        if (q->aq_bitmaps[level][word])
+            return word * 64 + ctz(q->aq_bitmaps[level][word]);
+
+    return AQ_N_SLOTS;
+}
+
+
+/* Time at which slot `slot' on level `level' begins */
+static lsquic_time_t
+attq_slot_start (const struct attq *q, unsigned level, unsigned slot)
+{
+    lsquic_time_t high;
+
+    if (level + 1 < AQ_N_LEVELS)
+        high = q->aq_clock
+                & ~((1ULL << ((level + 1) * AQ_SLOT_BITS)) - 1);
+    else
+        high = 0;
+
+    return high | ((lsquic_time_t) slot << (level * AQ_SLOT_BITS));
+}
+
+
 struct attq *
 attq_create (void)
 {
     struct attq *q;
     struct malo *malo;
+    unsigned level, slot;
 
     malo = lsquic_malo_create(sizeof(struct attq_elem));
     if (!malo)
@@ -49,6 +158,9 @@ attq_create (void)
         return NULL;
     }
 
+    for (level = 0; level < AQ_N_LEVELS; ++level)
+        for (slot = 0; slot < AQ_N_SLOTS; ++slot)
+            TAILQ_INIT(&q->aq_slots[level][slot]);
     q->aq_elem_malo = malo;
     return q;
 }
@@ -58,33 +170,35 @@ void
 attq_destroy (struct attq *q)
 {
     lsquic_malo_destroy(q->aq_elem_malo);
-    free(q->aq_heap);
     free(q);
 }
 
 
-
-#define AE_PARENT(i) ((i - 1) / 2)
-#define AE_LCHILD(i) (2 * i + 1)
-#define AE_RCHILD(i) (2 * i + 2)
-
-
 #ifndef NDEBUG
 static void
 attq_verify (struct attq *q)
 {
-    unsigned i;
+    const struct attq_elem *el;
+    unsigned level, slot, count;
 
-    for (i = 0; i < q->aq_nelem; ++i)
-    {
-        assert(q->aq_heap[i]->ae_heap_idx == i);
-        if (AE_LCHILD(i) < q->aq_nelem)
-            assert(q->aq_heap[i]->ae_adv_time <=
-                        q->aq_heap[AE_LCHILD(i)]->ae_adv_time);
-        if (AE_RCHILD(i) < q->aq_nelem)
-            assert(q->aq_heap[i]->ae_adv_time <=
-                        q->aq_heap[AE_RCHILD(i)]->ae_adv_time);
-    }
+    count = 0;
+    for (level = 0; level < AQ_N_LEVELS; ++level)
+        for (slot = 0; slot < AQ_N_SLOTS; ++slot)
+        {
+            assert(AQ_IS_SET(q, level, slot)
+                            == !TAILQ_EMPTY(&q->aq_slots[level][slot]));
+            TAILQ_FOREACH(el, &q->aq_slots[level][slot], ae_next)
+            {
+                assert(el->ae_level == level);
+                assert(el->ae_slot == slot);
+                if (el->ae_adv_time >= q->aq_clock)
+                    assert(el->ae_adv_time >= attq_slot_start(q, level, slot));
+                else
+                    assert(level == 0 && slot == AQ_DIGIT(q->aq_clock, 0));
+                ++count;
+            }
+        }
+    assert(count == q->aq_nelem);
 }
 #else
 #define attq_verify(q)
@@ -103,15 +217,53 @@ attq_maybe_add (struct attq *q, struct lsquic_conn *conn,
 
 
 static void
-attq_swap (struct attq *q, unsigned a, unsigned b)
+attq_place (struct attq *q, struct attq_elem *el)
 {
-    struct attq_elem *el;
+    struct attq_elem **min;
+    lsquic_time_t diff;
+    unsigned level, slot;
 
-    el = q->aq_heap[ a ];
-    q->aq_heap[ a ] = q->aq_heap[ b ];
-    q->aq_heap[ b ] = el;
-    q->aq_heap[ a ]->ae_heap_idx = a;
-    q->aq_heap[ b ]->ae_heap_idx = b;
+    if (el->ae_adv_time >= q->aq_clock)
+    {
+        diff = el->ae_adv_time ^ q->aq_clock;
+        if (diff)
+            level = (63 - clz(diff)) / AQ_SLOT_BITS;
+        else
+            level = 0;
+        slot = AQ_DIGIT(el->ae_adv_time, level);
+        TAILQ_INSERT_TAIL(&q->aq_slots[level][slot], el, ae_next);
+    }
+    else
+    {
+        /* Already due: place it in front of elements whose time is equal
+         * to the clock.
+         */
+        level = 0;
+        slot = AQ_DIGIT(q->aq_clock, 0);
+        TAILQ_INSERT_HEAD(&q->aq_slots[level][slot], el, ae_next);
+    }
+
+    el->ae_level = level;
+    el->ae_slot = slot;
+    min = &q->aq_slot_mins[level][slot];
+    if (!AQ_IS_SET(q, level, slot))
+        *min = el;
+    else if (*min && el->ae_adv_time < (*min)->ae_adv_time)
+        *min = el;
+    AQ_SET(q, level, slot);
+}
+
+
+static void
+attq_unplace (struct attq *q, struct attq_elem *el)
+{
+    struct attq_slot *const head = &q->aq_slots[el->ae_level][el->ae_slot];
+
+    TAILQ_REMOVE(head, el, ae_next);
+    if (TAILQ_EMPTY(head))
+        AQ_CLEAR(q, el->ae_level, el->ae_slot);
+    if (q->aq_slot_mins[el->ae_level][el->ae_slot] == el)
+        q->aq_slot_mins[el->ae_level][el->ae_slot] = NULL;
 }
 
 
@@ -119,21 +271,7 @@ int
 attq_add (struct attq *q, struct lsquic_conn *conn,
                                             lsquic_time_t advisory_time)
 {
-    struct attq_elem *el, **heap;
-    unsigned n, i;
-
-    if (q->aq_nelem >= q->aq_nalloc)
-    {
-        if (q->aq_nalloc > 0)
-            n = q->aq_nalloc * 2;
-        else
-            n = 8;
-        heap = realloc(q->aq_heap, n * sizeof(q->aq_heap[0]));
-        if (!heap)
-            return -1;
-        q->aq_heap = heap;
-        q->aq_nalloc = n;
-    }
+    struct attq_elem *el;
 
     el = lsquic_malo_get(q->aq_elem_malo);
     if (!el)
@@ -144,16 +282,8 @@ attq_add (struct attq *q, struct lsquic_conn *conn,
     el->ae_conn = conn;
     conn->cn_attq_elem = el;
 
-    el->ae_heap_idx = q->aq_nelem;
-    q->aq_heap[ q->aq_nelem++ ] = el;
-
-    i = q->aq_nelem - 1;
-    while (i > 0 && q->aq_heap[ AE_PARENT(i) ]->ae_adv_time >=
-                                        q->aq_heap[ i ]->ae_adv_time)
-    {
-        attq_swap(q, i, AE_PARENT(i));
-        i = AE_PARENT(i);
-    }
+    attq_place(q, el);
+    ++q->aq_nelem;
 
     attq_verify(q);
 
@@ -161,117 +291,155 @@ attq_add (struct attq *q, struct lsquic_conn *conn,
 }
 
 
-struct lsquic_conn *
-attq_pop (struct attq *q, lsquic_time_t cutoff)
+void
+attq_remove (struct attq *q, struct lsquic_conn *conn)
 {
-    struct lsquic_conn *conn;
     struct attq_elem *el;
 
-    if (q->aq_nelem == 0)
-        return NULL;
+    el = conn->cn_attq_elem;
 
-    el = q->aq_heap[0];
-    if (el->ae_adv_time >= cutoff)
-        return NULL;
+    assert(q->aq_nelem > 0);
+    assert(el->ae_conn == conn);
+
+    attq_unplace(q, el);
+    --q->aq_nelem;
 
-    conn = el->ae_conn;
-    attq_remove(q, conn);
-    return conn;
+    conn->cn_attq_elem = NULL;
+    lsquic_malo_put(el);
+    attq_verify(q);
 }
 
 
-static void
-attq_heapify (struct attq *q, unsigned i)
+/* Find the earliest non-empty slot.  Return the lowest level that has
+ * elements or AQ_N_LEVELS if the queue is empty.
+ */
+static unsigned
+attq_first (const struct attq *q, unsigned *slot)
 {
-    unsigned smallest;
+    unsigned level;
 
-    assert(i < q->aq_nelem);
+    for (level = 0; level < AQ_N_LEVELS; ++level)
+        if ((*slot = attq_first_slot(q, level)) < AQ_N_SLOTS)
+            break;
 
-    if (AE_LCHILD(i) < q->aq_nelem)
-    {
-        if (q->aq_heap[ AE_LCHILD(i) ]->ae_adv_time <
-                                    q->aq_heap[ i ]->ae_adv_time)
-            smallest = AE_LCHILD(i);
-        else
-            smallest = i;
-        if (AE_RCHILD(i) < q->aq_nelem &&
-            q->aq_heap[ AE_RCHILD(i) ]->ae_adv_time <
-                                    q->aq_heap[ smallest ]->ae_adv_time)
-            smallest = AE_RCHILD(i);
-    }
-    else
-        smallest = i;
+    return level;
+}
 
-    if (smallest != i)
+
+/* Advance the clock to the beginning of the slot and move its elements to
+ * lower levels.  All lower levels must be empty.
+ */
+static void
+attq_cascade (struct attq *q, unsigned level, unsigned slot)
+{
+    struct attq_slot *const head = &q->aq_slots[level][slot];
+    struct attq_elem *el, *next;
+
+    assert(level > 0);
+    q->aq_clock = attq_slot_start(q, level, slot);
+    /* Elements always land on a lower level, never in the same slot, so
+     * they are relinked without being unlinked one by one first.
+     */
+    for (el = TAILQ_FIRST(head); el; el = next)
     {
-        attq_swap(q, smallest, i);
-        attq_heapify(q, smallest);
+        next = TAILQ_NEXT(el, ae_next);
+        attq_place(q, el);
     }
+    TAILQ_INIT(head);
+    AQ_CLEAR(q, level, slot);
+    q->aq_slot_mins[level][slot] = NULL;
+    attq_verify(q);
 }
 
 
-void
-attq_remove (struct attq *q, struct lsquic_conn *conn)
+struct lsquic_conn *
+attq_pop (struct attq *q, lsquic_time_t cutoff)
 {
+    struct lsquic_conn *conn;
     struct attq_elem *el;
-    unsigned idx;
-
-    el = conn->cn_attq_elem;
-    idx = el->ae_heap_idx;
-
-    assert(q->aq_nelem > 0);
-    assert(q->aq_heap[idx] == el);
-    assert(conn->cn_attq_elem == el);
+    unsigned level, slot;
 
-    conn->cn_attq_elem = NULL;
-    lsquic_malo_put(el);
-
-    q->aq_heap[ idx ] = q->aq_heap[ --q->aq_nelem ];
-    q->aq_heap[ idx ]->ae_heap_idx = idx;
-    if (idx > 0 && q->aq_heap[ idx ]->ae_adv_time <
-                                q->aq_heap[ AE_PARENT(idx) ]->ae_adv_time)
+    while ((level = attq_first(q, &slot)) < AQ_N_LEVELS)
     {
-        do
+        if (level == 0)
         {
-            attq_swap(q, idx, AE_PARENT(idx));
-            idx = AE_PARENT(idx);
+            el = TAILQ_FIRST(&q->aq_slots[0][slot]);
+            if (el->ae_adv_time >= cutoff)
+                return NULL;
+            if (el->ae_adv_time > q->aq_clock)
+                q->aq_clock = el->ae_adv_time;
+            conn = el->ae_conn;
+            attq_remove(q, conn);
+            return conn;
         }
-        while (idx > 0 && q->aq_heap[ idx ]->ae_adv_time <
-                                q->aq_heap[ AE_PARENT(idx) ]->ae_adv_time);
+        else if (attq_slot_start(q, level, slot) < cutoff)
+            attq_cascade(q, level, slot);
+        else
+            return NULL;
     }
-    else if (q->aq_nelem > 1 && idx < q->aq_nelem)
-        attq_heapify(q, idx);
-    attq_verify(q);
+
+    return NULL;
 }
 
 
 unsigned
 attq_count_before (struct attq *q, lsquic_time_t cutoff)
 {
-    unsigned level, total_count, level_count, i, level_max;
+    const struct attq_elem *el;
+    uint64_t bitmap;
+    unsigned level, word, slot, count;
 
-    total_count = 0;
-    for (i = 0, level = 0;; ++level)
-    {
-        level_count = 0;
-        level_max = i + (1U << level);
-        for ( ; i < level_max && i < q->aq_nelem; ++i)
-            level_count += q->aq_heap[i]->ae_adv_time < cutoff;
-        total_count += level_count;
-        if (level_count < (1U << level))
-            return total_count;
-    }
-    assert(0);
+    count = 0;
+    for (level = 0; level < AQ_N_LEVELS; ++level)
+        for (word = 0; word < AQ_N_WORDS; ++word)
+        {
+            bitmap = q->aq_bitmaps[level][word];
+            while (bitmap)
+            {
+                slot = word * 64 + ctz(bitmap);
+                bitmap &= bitmap - 1;
+                /* The current level 0 slot may contain elements that are
+                 * already due.
+                 */
+                if (!(level == 0 && slot == AQ_DIGIT(q->aq_clock, 0))
+                            && attq_slot_start(q, level, slot) >= cutoff)
+                    return count;
+                TAILQ_FOREACH(el, &q->aq_slots[level][slot], ae_next)
+                    count += el->ae_adv_time < cutoff;
+            }
+        }
+
+    return count;
+}
+
+
+unsigned
+attq_count (const struct attq *q)
+{
+    return q->aq_nelem;
 }
 
 
 const lsquic_time_t *
 attq_next_time (struct attq *q)
 {
-    if (q->aq_nelem > 0)
-        return &q->aq_heap[0]->ae_adv_time;
-    else
+    struct attq_elem *el, **min;
+    unsigned level, slot;
+
+    level = attq_first(q, &slot);
+    if (level >= AQ_N_LEVELS)
         return NULL;
+
+    min = &q->aq_slot_mins[level][slot];
+    if (!*min)
+    {
+        *min = TAILQ_FIRST(&q->aq_slots[level][slot]);
+        for (el = TAILQ_NEXT(*min, ae_next); el; el = TAILQ_NEXT(el, ae_next))
+            if (el->ae_adv_time < (*min)->ae_adv_time)
+                *min = el;
+    }
+
+    return &(*min)->ae_adv_time;
 }
 
 
@@ -10,14 +10,16 @@ struct attq;
 struct lsquic_conn;
 
 
-/* The extra level of indirection is done for speed: swapping heap elements
+/* The extra level of indirection is done for speed: linking wheel slots
  * does not need memory associated with lsquic_conn.
  */
 struct attq_elem
 {
-    struct lsquic_conn  *ae_conn;
-    lsquic_time_t        ae_adv_time;
-    unsigned             ae_heap_idx;
+    TAILQ_ENTRY(attq_elem)   ae_next;
+    struct lsquic_conn      *ae_conn;
+    lsquic_time_t            ae_adv_time;
+    unsigned char            ae_level;
+    unsigned char            ae_slot;
 };
 
 
@@ -45,6 +47,10 @@ attq_pop (struct attq *, lsquic_time_t cutoff);
 unsigned
 attq_count_before (struct attq *, lsquic_time_t cutoff);
 
+/* Return number of connections in the queue */
+unsigned
+attq_count (const struct attq *);
+
 const lsquic_time_t *
 attq_next_time (struct attq *);
 
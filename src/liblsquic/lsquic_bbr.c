@@ -0,0 +1,644 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_bbr.c -- BBR congestion control.
+ *
+ * The state machine follows draft-cardwell-iccrg-bbr-congestion-control-00:
+ *
+ *  Startup     Pace at 2/ln(2) times the bandwidth estimate until the
+ *              estimate stops growing by at least 25% for three rounds.
+ *  Drain       Pace slower than the estimate until the queue created in
+ *              Startup is gone.
+ *  ProbeBW     Cycle the pacing gain: 1.25 to probe for more bandwidth,
+ *              0.75 to drain the resulting queue, and 1 for six rounds.
+ *  ProbeRTT    If the minimum RTT has not been refreshed in ten seconds,
+ *              reduce cwnd to four packets for 200 ms and one round trip
+ *              in order to measure it.
+ *
+ * Gains are fixed-point numbers with BBR_UNIT being 1.0.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/queue.h>
+
+#include "lsquic_int_types.h"
+#include "lsquic_types.h"
+#include "lsquic_cong_ctl.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_rtt.h"
+
+#define LSQUIC_LOGGER_MODULE LSQLM_BBR
+#define LSQUIC_LOG_CONN_ID bbr->bbr_cid
+#include "lsquic_logger.h"
+
+#define BBR_UNIT            256
+#define HIGH_GAIN           739                 /* 2/ln(2) */
+#define DRAIN_GAIN          (BBR_UNIT * BBR_UNIT / HIGH_GAIN)
+#define CWND_GAIN           (BBR_UNIT * 2)
+#define FULL_BW_THRESH      (BBR_UNIT * 5 / 4)  /* Bandwidth grew by 25% */
+#define FULL_BW_COUNT       3                   /* Rounds without growth */
+#define BW_WINDOW           10                  /* In round trips */
+#define MIN_RTT_WINDOW      (10 * 1000 * 1000)  /* In microseconds */
+#define PROBE_RTT_TIME      (200 * 1000)        /* In microseconds */
+
+/* cwnd is in bytes.  Use the same segment size as lsquic_cubic.c does. */
+#define BBR_MSS             1460
+#define INIT_CWND           (32 * BBR_MSS)
+#define MIN_CWND            (4 * BBR_MSS)
+
+#define CYCLE_LEN           8
+
+static const unsigned pacing_gains[CYCLE_LEN] =
+{
+    BBR_UNIT * 5 / 4, BBR_UNIT * 3 / 4,
+    BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT,
+};
+
+static const char *const mode2str[] =
+{
+    [BBR_MODE_STARTUP]   = "Startup",
+    [BBR_MODE_DRAIN]     = "Drain",
+    [BBR_MODE_PROBE_BW]  = "ProbeBW",
+    [BBR_MODE_PROBE_RTT] = "ProbeRTT",
+};
+
+#ifndef MAX
+#   define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#ifndef MIN
+#   define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+
+static uint64_t
+bbr_bdp (const struct lsquic_bbr *bbr, unsigned gain)
+{
+    uint64_t bw;
+
+    bw = minmax_get(&bbr->bbr_max_bw);
+    if (bw == 0 || bbr->bbr_min_rtt == 0)
+        return (uint64_t) INIT_CWND * gain / BBR_UNIT;
+    return bw * bbr->bbr_min_rtt / 1000000 * gain / BBR_UNIT;
+}
+
+
+/* Allow for delayed and stretched ACKs */
+static uint64_t
+bbr_target_cwnd (const struct lsquic_bbr *bbr, unsigned gain)
+{
+    return bbr_bdp(bbr, gain) + 3 * BBR_MSS;
+}
+
+
+static void
+bbr_init_pacing_rate (struct lsquic_bbr *bbr)
+{
+    lsquic_time_t srtt;
+
+    srtt = bbr->bbr_rtt_stats ? lsquic_rtt_stats_get_srtt(bbr->bbr_rtt_stats)
+                              : 0;
+    if (srtt == 0)
+        srtt = 1000;
+    bbr->bbr_pacing_rate = (uint64_t) bbr->bbr_cwnd * HIGH_GAIN / BBR_UNIT
+                                                        * 1000000 / srtt;
+}
+
+
+/* Do not lower the pacing rate before the pipe is full: a low estimate in
+ * Startup is usually due to a lack of samples.
+ */
+static void
+bbr_set_pacing_rate (struct lsquic_bbr *bbr, unsigned gain)
+{
+    uint64_t rate;
+
+    rate = minmax_get(&bbr->bbr_max_bw) * gain / BBR_UNIT;
+    if (rate && ((bbr->bbr_flags & BBR_FILLED_PIPE)
+                                            || rate > bbr->bbr_pacing_rate))
+        bbr->bbr_pacing_rate = rate;
+}
+
+
+static void
+bbr_set_mode (struct lsquic_bbr *bbr, enum bbr_mode mode)
+{
+    if (bbr->bbr_mode != mode)
+    {
+        LSQ_INFO("mode %s -> %s; bw: %"PRIu64"; min_rtt: %"PRIu64"; "
+            "cwnd: %lu", mode2str[bbr->bbr_mode], mode2str[mode],
+            minmax_get(&bbr->bbr_max_bw), bbr->bbr_min_rtt, bbr->bbr_cwnd);
+        bbr->bbr_mode = mode;
+    }
+}
+
+
+static void
+bbr_enter_startup (struct lsquic_bbr *bbr)
+{
+    bbr_set_mode(bbr, BBR_MODE_STARTUP);
+    bbr->bbr_pacing_gain = HIGH_GAIN;
+    bbr->bbr_cwnd_gain   = HIGH_GAIN;
+}
+
+
+/* Start at a random phase other than the draining one so that flows
+ * sharing a bottleneck do not probe in lockstep.
+ */
+static void
+bbr_enter_probe_bw (struct lsquic_bbr *bbr, lsquic_time_t now)
+{
+    unsigned r;
+
+    bbr_set_mode(bbr, BBR_MODE_PROBE_BW);
+    r = (unsigned) ((now >> 10) % (CYCLE_LEN - 1));
+    bbr->bbr_cycle_idx   = r ? r + 1 : 0;
+    bbr->bbr_cycle_stamp = now;
+    bbr->bbr_pacing_gain = pacing_gains[bbr->bbr_cycle_idx];
+    bbr->bbr_cwnd_gain   = CWND_GAIN;
+}
+
+
+static unsigned long
+bbr_save_cwnd (const struct lsquic_bbr *bbr)
+{
+    if (!(bbr->bbr_flags & BBR_IN_RECOVERY)
+                                    && bbr->bbr_mode != BBR_MODE_PROBE_RTT)
+        return bbr->bbr_cwnd;
+    else
+        return MAX(bbr->bbr_prior_cwnd, bbr->bbr_cwnd);
+}
+
+
+static void
+bbr_update_round (struct lsquic_bbr *bbr, const struct bw_sample *sample)
+{
+    bbr->bbr_flags &= ~BBR_ROUND_START;
+    if (sample
+        && sample->bws_prior_delivered >= bbr->bbr_next_round_delivered)
+    {
+        bbr->bbr_next_round_delivered =
+                        lsquic_bw_sampler_delivered(&bbr->bbr_bw_sampler);
+        ++bbr->bbr_round_count;
+        bbr->bbr_flags |= BBR_ROUND_START;
+        if ((bbr->bbr_flags & BBR_CONSERVATION)
+                            && bbr->bbr_round_count > bbr->bbr_recovery_round)
+            bbr->bbr_flags &= ~BBR_CONSERVATION;
+    }
+}
+
+
+/* Samples taken over an interval shorter than the minimum RTT are
+ * artifacts of ACK compression.  Application-limited samples can only
+ * raise the estimate.
+ */
+static void
+bbr_update_bw (struct lsquic_bbr *bbr, const struct bw_sample *sample)
+{
+    if (!sample || sample->bws_bandwidth == 0
+                            || sample->bws_interval < bbr->bbr_min_rtt)
+        return;
+
+    if (!sample->bws_is_app_limited
+                || sample->bws_bandwidth >= minmax_get(&bbr->bbr_max_bw))
+        minmax_upmax(&bbr->bbr_max_bw, bbr->bbr_round_count,
+                                                    sample->bws_bandwidth);
+}
+
+
+static void
+bbr_update_cycle_phase (struct lsquic_bbr *bbr, lsquic_time_t now,
+                                                unsigned long prior_in_flight)
+{
+    int full_length, advance;
+
+    if (bbr->bbr_mode != BBR_MODE_PROBE_BW)
+        return;
+
+    full_length = now - bbr->bbr_cycle_stamp > bbr->bbr_min_rtt;
+    if (bbr->bbr_pacing_gain == BBR_UNIT)
+        advance = full_length;
+    else if (bbr->bbr_pacing_gain > BBR_UNIT)
+        advance = full_length && (bbr->bbr_bytes_lost
+                || prior_in_flight >= bbr_bdp(bbr, bbr->bbr_pacing_gain));
+    else
+        advance = full_length
+                || bbr->bbr_in_flight <= bbr_bdp(bbr, BBR_UNIT);
+
+    if (advance)
+    {
+        bbr->bbr_cycle_idx = (bbr->bbr_cycle_idx + 1) % CYCLE_LEN;
+        bbr->bbr_cycle_stamp = now;
+        bbr->bbr_pacing_gain = pacing_gains[bbr->bbr_cycle_idx];
+        LSQ_DEBUG("cycle phase %u, pacing gain %u", bbr->bbr_cycle_idx,
+                                                    bbr->bbr_pacing_gain);
+    }
+}
+
+
+static void
+bbr_check_full_pipe (struct lsquic_bbr *bbr, const struct bw_sample *sample)
+{
+    uint64_t bw;
+
+    if ((bbr->bbr_flags & BBR_FILLED_PIPE)
+            || !(bbr->bbr_flags & BBR_ROUND_START)
+            || !sample || sample->bws_is_app_limited)
+        return;
+
+    bw = minmax_get(&bbr->bbr_max_bw);
+    if (bw * BBR_UNIT >= bbr->bbr_full_bw * FULL_BW_THRESH)
+    {
+        bbr->bbr_full_bw = bw;
+        bbr->bbr_full_bw_count = 0;
+        return;
+    }
+
+    if (++bbr->bbr_full_bw_count >= FULL_BW_COUNT)
+    {
+        bbr->bbr_flags |= BBR_FILLED_PIPE;
+        LSQ_INFO("pipe is full at %"PRIu64" bytes per second", bw);
+    }
+}
+
+
+static void
+bbr_check_drain (struct lsquic_bbr *bbr, lsquic_time_t now)
+{
+    if (bbr->bbr_mode == BBR_MODE_STARTUP
+                                    && (bbr->bbr_flags & BBR_FILLED_PIPE))
+    {
+        bbr_set_mode(bbr, BBR_MODE_DRAIN);
+        bbr->bbr_pacing_gain = DRAIN_GAIN;
+        bbr->bbr_cwnd_gain   = HIGH_GAIN;
+    }
+    if (bbr->bbr_mode == BBR_MODE_DRAIN
+                        && bbr->bbr_in_flight <= bbr_bdp(bbr, BBR_UNIT))
+        bbr_enter_probe_bw(bbr, now);
+}
+
+
+static void
+bbr_update_probe_rtt (struct lsquic_bbr *bbr, lsquic_time_t now,
+                                                    int min_rtt_expired)
+{
+    if (min_rtt_expired && !(bbr->bbr_flags & BBR_IDLE_RESTART)
+                                    && bbr->bbr_mode != BBR_MODE_PROBE_RTT)
+    {
+        bbr->bbr_prior_cwnd = bbr_save_cwnd(bbr);
+        bbr_set_mode(bbr, BBR_MODE_PROBE_RTT);
+        bbr->bbr_pacing_gain = BBR_UNIT;
+        bbr->bbr_cwnd_gain   = BBR_UNIT;
+        bbr->bbr_probe_rtt_done = 0;
+    }
+
+    if (bbr->bbr_mode != BBR_MODE_PROBE_RTT)
+        return;
+
+    if (bbr->bbr_probe_rtt_done == 0)
+    {
+        if (bbr->bbr_in_flight <= MIN_CWND)
+        {
+            bbr->bbr_probe_rtt_done = now + PROBE_RTT_TIME;
+            bbr->bbr_flags &= ~BBR_PROBE_RTT_ROUND;
+            bbr->bbr_next_round_delivered =
+                        lsquic_bw_sampler_delivered(&bbr->bbr_bw_sampler);
+        }
+    }
+    else
+    {
+        if (bbr->bbr_flags & BBR_ROUND_START)
+            bbr->bbr_flags |= BBR_PROBE_RTT_ROUND;
+        if ((bbr->bbr_flags & BBR_PROBE_RTT_ROUND)
+                                        && now >= bbr->bbr_probe_rtt_done)
+        {
+            bbr->bbr_min_rtt_stamp = now;
+            bbr->bbr_cwnd = MAX(bbr->bbr_cwnd, bbr->bbr_prior_cwnd);
+            if (bbr->bbr_flags & BBR_FILLED_PIPE)
+                bbr_enter_probe_bw(bbr, now);
+            else
+                bbr_enter_startup(bbr);
+        }
+    }
+}
+
+
+static void
+bbr_set_cwnd (struct lsquic_bbr *bbr)
+{
+    const unsigned long acked = bbr->bbr_bytes_acked;
+    uint64_t target;
+
+    if ((bbr->bbr_flags & BBR_IN_RECOVERY) && bbr->bbr_bytes_lost)
+    {
+        if (bbr->bbr_cwnd > bbr->bbr_bytes_lost + BBR_MSS)
+            bbr->bbr_cwnd -= bbr->bbr_bytes_lost;
+        else
+            bbr->bbr_cwnd = BBR_MSS;
+    }
+
+    if (bbr->bbr_flags & BBR_EXIT_RECOVERY)
+    {
+        bbr->bbr_flags &= ~BBR_EXIT_RECOVERY;
+        bbr->bbr_cwnd = MAX(bbr->bbr_cwnd, bbr->bbr_prior_cwnd);
+    }
+
+    if (bbr->bbr_flags & BBR_CONSERVATION)
+        bbr->bbr_cwnd = MAX(bbr->bbr_cwnd, bbr->bbr_in_flight + acked);
+    else
+    {
+        target = bbr_target_cwnd(bbr, bbr->bbr_cwnd_gain);
+        if (bbr->bbr_flags & BBR_FILLED_PIPE)
+            bbr->bbr_cwnd = MIN(bbr->bbr_cwnd + acked, target);
+        else if (bbr->bbr_cwnd < target
+                || lsquic_bw_sampler_delivered(&bbr->bbr_bw_sampler)
+                                                                < INIT_CWND)
+            bbr->bbr_cwnd += acked;
+        bbr->bbr_cwnd = MAX(bbr->bbr_cwnd, MIN_CWND);
+    }
+
+    if (bbr->bbr_mode == BBR_MODE_PROBE_RTT)
+        bbr->bbr_cwnd = MIN(bbr->bbr_cwnd, MIN_CWND);
+}
+
+
+static void
+bbr_cci_init (void *cong_ctl, lsquic_cid_t cid,
+                                const struct lsquic_rtt_stats *rtt_stats)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+
+    memset(bbr, 0, sizeof(*bbr));
+    bbr->bbr_cid = cid;
+    bbr->bbr_rtt_stats = rtt_stats;
+    if (0 == lsquic_bw_sampler_init(&bbr->bbr_bw_sampler, cid))
+        bbr->bbr_flags |= BBR_SAMPLER_OK;
+    else
+        LSQ_WARN("cannot initialize bandwidth sampler: no bandwidth "
+                                                    "estimates will be made");
+    minmax_init(&bbr->bbr_max_bw, BW_WINDOW);
+    bbr->bbr_mode = BBR_MODE_STARTUP;
+    bbr_enter_startup(bbr);
+    bbr->bbr_cwnd = INIT_CWND;
+    bbr_init_pacing_rate(bbr);
+    LSQ_INFO("initialized");
+}
+
+
+static void
+bbr_cci_cleanup (void *cong_ctl)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+
+    if (bbr->bbr_flags & BBR_SAMPLER_OK)
+        lsquic_bw_sampler_cleanup(&bbr->bbr_bw_sampler);
+}
+
+
+static void
+bbr_cci_sent (void *cong_ctl, struct lsquic_packet_out *packet_out,
+                                    unsigned long in_flight, int app_limited)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+
+    if (bbr->bbr_flags & BBR_SAMPLER_OK)
+        lsquic_bw_sampler_packet_sent(&bbr->bbr_bw_sampler, packet_out,
+                                                    in_flight, app_limited);
+    bbr->bbr_in_flight = in_flight;
+    bbr->bbr_last_sent_packno = packet_out->po_packno;
+}
+
+
+static void
+bbr_cci_begin_ack (void *cong_ctl, lsquic_time_t ack_time,
+                                                    unsigned long in_flight)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+
+    bbr->bbr_ack_time = ack_time;
+    bbr->bbr_in_flight = in_flight;
+    bbr->bbr_bytes_acked = 0;
+    if (bbr->bbr_flags & BBR_SAMPLER_OK)
+        lsquic_bw_sampler_begin_ack(&bbr->bbr_bw_sampler);
+}
+
+
+static void
+bbr_cci_ack (void *cong_ctl, struct lsquic_packet_out *packet_out,
+                    unsigned packet_sz, lsquic_time_t now, int app_limited)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+
+    if (bbr->bbr_flags & BBR_SAMPLER_OK)
+        lsquic_bw_sampler_packet_acked(&bbr->bbr_bw_sampler, packet_out,
+                                                packet_sz, bbr->bbr_ack_time);
+    bbr->bbr_bytes_acked += packet_sz;
+    if (bbr->bbr_in_flight > packet_sz)
+        bbr->bbr_in_flight -= packet_sz;
+    else
+        bbr->bbr_in_flight = 0;
+
+    if ((bbr->bbr_flags & BBR_IN_RECOVERY)
+                    && packet_out->po_packno > bbr->bbr_end_recovery_at)
+    {
+        bbr->bbr_flags &= ~(BBR_IN_RECOVERY|BBR_CONSERVATION);
+        bbr->bbr_flags |= BBR_EXIT_RECOVERY;
+        LSQ_DEBUG("exit recovery");
+    }
+}
+
+
+static void
+bbr_cci_end_ack (void *cong_ctl, unsigned long in_flight)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+    const struct bw_sample *sample;
+    const lsquic_time_t now = bbr->bbr_ack_time;
+    unsigned long prior_in_flight;
+    int min_rtt_expired;
+
+    if (bbr->bbr_flags & BBR_SAMPLER_OK)
+        sample = lsquic_bw_sampler_end_ack(&bbr->bbr_bw_sampler);
+    else
+        sample = NULL;
+    prior_in_flight = bbr->bbr_in_flight + bbr->bbr_bytes_acked;
+    bbr->bbr_in_flight = in_flight;
+
+    min_rtt_expired = bbr->bbr_min_rtt_stamp
+                        && now > bbr->bbr_min_rtt_stamp + MIN_RTT_WINDOW;
+    if (sample && sample->bws_rtt && (bbr->bbr_min_rtt == 0
+                    || sample->bws_rtt < bbr->bbr_min_rtt || min_rtt_expired))
+    {
+        bbr->bbr_min_rtt = sample->bws_rtt;
+        bbr->bbr_min_rtt_stamp = now;
+    }
+
+    bbr_update_round(bbr, sample);
+    bbr_update_bw(bbr, sample);
+    bbr_update_cycle_phase(bbr, now, prior_in_flight);
+    bbr_check_full_pipe(bbr, sample);
+    bbr_check_drain(bbr, now);
+    bbr_update_probe_rtt(bbr, now, min_rtt_expired);
+    if (sample && sample->bws_delivered)
+        bbr->bbr_flags &= ~BBR_IDLE_RESTART;
+
+    if (minmax_get(&bbr->bbr_max_bw))
+        bbr_set_pacing_rate(bbr, bbr->bbr_pacing_gain);
+    else
+        bbr_init_pacing_rate(bbr);
+    bbr_set_cwnd(bbr);
+
+    LSQ_DEBUG("%s; acked: %lu; lost: %lu; in flight: %lu; bw: %"PRIu64"; "
+        "min_rtt: %"PRIu64"; pacing rate: %"PRIu64"; cwnd: %lu",
+        mode2str[bbr->bbr_mode], bbr->bbr_bytes_acked, bbr->bbr_bytes_lost,
+        in_flight, minmax_get(&bbr->bbr_max_bw), bbr->bbr_min_rtt,
+        bbr->bbr_pacing_rate, bbr->bbr_cwnd);
+    bbr->bbr_bytes_acked = 0;
+    bbr->bbr_bytes_lost = 0;
+}
+
+
+static void
+bbr_cci_lost (void *cong_ctl, struct lsquic_packet_out *packet_out,
+                                                        unsigned packet_sz)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+
+    if (bbr->bbr_flags & BBR_SAMPLER_OK)
+        lsquic_bw_sampler_packet_lost(&bbr->bbr_bw_sampler, packet_out);
+    bbr->bbr_bytes_lost += packet_sz;
+    if (bbr->bbr_in_flight > packet_sz)
+        bbr->bbr_in_flight -= packet_sz;
+    else
+        bbr->bbr_in_flight = 0;
+}
+
+
+/* On entering recovery, send no more than what was acknowledged for one
+ * round trip (packet conservation).  The cwnd in effect before recovery
+ * is restored when it ends.
+ */
+static void
+bbr_cci_loss (void *cong_ctl)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+
+    if (bbr->bbr_flags & BBR_IN_RECOVERY)
+    {
+        bbr->bbr_end_recovery_at = bbr->bbr_last_sent_packno;
+        return;
+    }
+
+    bbr->bbr_prior_cwnd = bbr_save_cwnd(bbr);
+    bbr->bbr_flags |= BBR_IN_RECOVERY|BBR_CONSERVATION;
+    bbr->bbr_flags &= ~BBR_EXIT_RECOVERY;
+    bbr->bbr_recovery_round = bbr->bbr_round_count;
+    bbr->bbr_end_recovery_at = bbr->bbr_last_sent_packno;
+    bbr->bbr_cwnd = MAX(bbr->bbr_in_flight + bbr->bbr_bytes_acked, BBR_MSS);
+    bbr->bbr_bytes_lost = 0;
+    LSQ_DEBUG("enter recovery; prior cwnd: %lu; cwnd: %lu",
+                                        bbr->bbr_prior_cwnd, bbr->bbr_cwnd);
+}
+
+
+static void
+bbr_cci_timeout (void *cong_ctl)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+
+    bbr->bbr_prior_cwnd = bbr_save_cwnd(bbr);
+    bbr->bbr_flags |= BBR_IN_RECOVERY|BBR_CONSERVATION;
+    bbr->bbr_flags &= ~BBR_EXIT_RECOVERY;
+    bbr->bbr_recovery_round = bbr->bbr_round_count;
+    bbr->bbr_end_recovery_at = bbr->bbr_last_sent_packno;
+    bbr->bbr_cwnd = BBR_MSS;
+    bbr->bbr_bytes_lost = 0;
+    /* Losses make bandwidth samples unreliable: restart full pipe check */
+    bbr->bbr_full_bw = 0;
+    bbr->bbr_full_bw_count = 0;
+    LSQ_INFO("timeout; prior cwnd: %lu", bbr->bbr_prior_cwnd);
+}
+
+
+/* The losses were spurious: leave recovery and restore cwnd.  Bandwidth
+ * and RTT estimates are not affected by losses and need no undoing.
+ */
+static void
+bbr_cci_undo (void *cong_ctl)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+
+    if (!(bbr->bbr_flags & (BBR_IN_RECOVERY|BBR_EXIT_RECOVERY)))
+        return;
+
+    bbr->bbr_flags &= ~(BBR_IN_RECOVERY|BBR_CONSERVATION|BBR_EXIT_RECOVERY);
+    bbr->bbr_cwnd = MAX(bbr->bbr_cwnd, bbr->bbr_prior_cwnd);
+    LSQ_INFO("undo; cwnd: %lu", bbr->bbr_cwnd);
+}
+
+
+static void
+bbr_cci_was_quiet (void *cong_ctl, lsquic_time_t now,
+                                                    unsigned long in_flight)
+{
+    struct lsquic_bbr *const bbr = cong_ctl;
+
+    LSQ_DEBUG("restart from idle");
+    bbr->bbr_flags |= BBR_IDLE_RESTART;
+    if (bbr->bbr_mode == BBR_MODE_PROBE_BW)
+        bbr_set_pacing_rate(bbr, BBR_UNIT);
+}
+
+
+static unsigned long
+bbr_cci_get_cwnd (void *cong_ctl)
+{
+    return lsquic_bbr_get_cwnd((struct lsquic_bbr *) cong_ctl);
+}
+
+
+static unsigned long
+bbr_cci_get_ssthresh (void *cong_ctl)
+{
+    return 0;
+}
+
+
+static int
+bbr_cci_in_slow_start (void *cong_ctl)
+{
+    return ((struct lsquic_bbr *) cong_ctl)->bbr_mode == BBR_MODE_STARTUP;
+}
+
+
+static uint64_t
+bbr_cci_pacing_rate (void *cong_ctl, int in_recovery)
+{
+    return ((struct lsquic_bbr *) cong_ctl)->bbr_pacing_rate;
+}
+
+
+const struct cong_ctl_if lsquic_cong_bbr_if =
+{
+    .cci_ack           = bbr_cci_ack,
+    .cci_begin_ack     = bbr_cci_begin_ack,
+    .cci_cleanup       = bbr_cci_cleanup,
+    .cci_end_ack       = bbr_cci_end_ack,
+    .cci_get_cwnd      = bbr_cci_get_cwnd,
+    .cci_get_ssthresh  = bbr_cci_get_ssthresh,
+    .cci_in_slow_start = bbr_cci_in_slow_start,
+    .cci_init          = bbr_cci_init,
+    .cci_loss          = bbr_cci_loss,
+    .cci_lost          = bbr_cci_lost,
+    .cci_pacing_rate   = bbr_cci_pacing_rate,
+    .cci_sent          = bbr_cci_sent,
+    .cci_timeout       = bbr_cci_timeout,
+    .cci_undo          = bbr_cci_undo,
+    .cci_was_quiet     = bbr_cci_was_quiet,
+};
@@ -0,0 +1,69 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_bbr.h -- BBR congestion control.
+ *
+ * This is BBR version 1 as described in draft-cardwell-iccrg-bbr-
+ * congestion-control-00.  The bottleneck bandwidth is the windowed
+ * maximum of delivery rate samples over ten round trips and the round
+ * trip propagation delay is the minimum RTT seen in the last ten seconds.
+ */
+
+#ifndef LSQUIC_BBR_H
+#define LSQUIC_BBR_H 1
+
+enum bbr_mode
+{
+    BBR_MODE_STARTUP,
+    BBR_MODE_DRAIN,
+    BBR_MODE_PROBE_BW,
+    BBR_MODE_PROBE_RTT,
+};
+
+struct lsquic_bbr
+{
+    lsquic_cid_t                    bbr_cid;        /* Used for logging */
+    const struct lsquic_rtt_stats  *bbr_rtt_stats;
+    struct bw_sampler               bbr_bw_sampler;
+    struct minmax                   bbr_max_bw;     /* Time is round count */
+    enum bbr_mode                   bbr_mode;
+    enum bbr_flags {
+        BBR_FILLED_PIPE     = 1 << 0,
+        BBR_ROUND_START     = 1 << 1,
+        BBR_IDLE_RESTART    = 1 << 2,
+        BBR_IN_RECOVERY     = 1 << 3,
+        BBR_CONSERVATION    = 1 << 4,   /* Packet conservation */
+        BBR_EXIT_RECOVERY   = 1 << 5,   /* Restore cwnd on next ACK */
+        BBR_PROBE_RTT_ROUND = 1 << 6,   /* Round trip passed in ProbeRTT */
+        BBR_SAMPLER_OK      = 1 << 7,
+    }                               bbr_flags;
+    unsigned long                   bbr_cwnd;
+    unsigned long                   bbr_prior_cwnd;
+    unsigned long                   bbr_in_flight;
+    uint64_t                        bbr_pacing_rate;    /* Bytes per second */
+    unsigned                        bbr_pacing_gain;    /* In BBR_UNIT */
+    unsigned                        bbr_cwnd_gain;      /* In BBR_UNIT */
+    lsquic_time_t                   bbr_min_rtt;
+    lsquic_time_t                   bbr_min_rtt_stamp;
+    lsquic_time_t                   bbr_probe_rtt_done;
+    lsquic_time_t                   bbr_cycle_stamp;
+    uint64_t                        bbr_round_count;
+    uint64_t                        bbr_next_round_delivered;
+    uint64_t                        bbr_recovery_round;
+    uint64_t                        bbr_full_bw;
+    unsigned                        bbr_full_bw_count;
+    unsigned                        bbr_cycle_idx;
+    lsquic_packno_t                 bbr_last_sent_packno;
+    lsquic_packno_t                 bbr_end_recovery_at;
+    /* Accumulated while an ACK is processed: */
+    lsquic_time_t                   bbr_ack_time;
+    unsigned long                   bbr_bytes_acked;
+    unsigned long                   bbr_bytes_lost;
+};
+
+extern const struct cong_ctl_if lsquic_cong_bbr_if;
+
+#define lsquic_bbr_get_cwnd(bbr) (+(bbr)->bbr_cwnd)
+
+#define lsquic_bbr_get_bw(bbr) minmax_get(&(bbr)->bbr_max_bw)
+
+#endif
@@ -0,0 +1,163 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_bw_sampler.c -- Delivery rate sampling.
+ */
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/queue.h>
+
+#include "lsquic_int_types.h"
+#include "lsquic_types.h"
+#include "lsquic_malo.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_bw_sampler.h"
+
+#define LSQUIC_LOGGER_MODULE LSQLM_BW_SAMPLER
+#define LSQUIC_LOG_CONN_ID sampler->bs_cid
+#include "lsquic_logger.h"
+
+
+int
+lsquic_bw_sampler_init (struct bw_sampler *sampler, lsquic_cid_t cid)
+{
+    memset(sampler, 0, sizeof(*sampler));
+    sampler->bs_malo = lsquic_malo_create(sizeof(struct bwp_state));
+    if (!sampler->bs_malo)
+        return -1;
+    sampler->bs_cid = cid;
+    return 0;
+}
+
+
+void
+lsquic_bw_sampler_cleanup (struct bw_sampler *sampler)
+{
+    if (sampler->bs_malo)
+        lsquic_malo_destroy(sampler->bs_malo);
+}
+
+
+void
+lsquic_bw_sampler_packet_sent (struct bw_sampler *sampler,
+                    struct lsquic_packet_out *packet_out,
+                    unsigned long in_flight, int app_limited)
+{
+    struct bwp_state *state;
+
+    if (packet_out->po_bwp_state)
+        lsquic_malo_put(packet_out->po_bwp_state);
+    state = lsquic_malo_get(sampler->bs_malo);
+    packet_out->po_bwp_state = state;
+    if (!state)
+    {
+        LSQ_WARN("cannot allocate state for packet %"PRIu64,
+                                                    packet_out->po_packno);
+        return;
+    }
+
+    /* Nothing else is in flight: start the send and ACK phases anew */
+    if (in_flight <= (unsigned) lsquic_packet_out_sent_sz(packet_out))
+    {
+        sampler->bs_first_sent_time = packet_out->po_sent;
+        sampler->bs_delivered_time  = packet_out->po_sent;
+    }
+
+    if (app_limited)
+    {
+        sampler->bs_app_limited = sampler->bs_delivered + in_flight;
+        LSQ_DEBUG("app-limited until %"PRIu64" bytes are delivered",
+                                                    sampler->bs_app_limited);
+    }
+
+    state->bwps_delivered       = sampler->bs_delivered;
+    state->bwps_delivered_time  = sampler->bs_delivered_time;
+    state->bwps_first_sent_time = sampler->bs_first_sent_time;
+    state->bwps_is_app_limited  = sampler->bs_app_limited != 0;
+}
+
+
+void
+lsquic_bw_sampler_begin_ack (struct bw_sampler *sampler)
+{
+    sampler->bs_have_sample = 0;
+}
+
+
+void
+lsquic_bw_sampler_packet_acked (struct bw_sampler *sampler,
+                                struct lsquic_packet_out *packet_out,
+                                unsigned packet_sz, lsquic_time_t ack_time)
+{
+    struct bwp_state *const state = packet_out->po_bwp_state;
+
+    sampler->bs_delivered += packet_sz;
+    sampler->bs_delivered_time = ack_time;
+    if (sampler->bs_app_limited
+                        && sampler->bs_delivered > sampler->bs_app_limited)
+        sampler->bs_app_limited = 0;
+
+    if (!state)
+        return;
+
+    /* The most recently sent packet determines the sample */
+    if (!sampler->bs_have_sample
+            || state->bwps_delivered >= sampler->bs_sample.bws_prior_delivered)
+    {
+        sampler->bs_have_sample = 1;
+        sampler->bs_sample.bws_prior_delivered = state->bwps_delivered;
+        sampler->bs_sample.bws_is_app_limited  = state->bwps_is_app_limited;
+        sampler->bs_sample.bws_rtt = ack_time - packet_out->po_sent;
+        sampler->bs_prior_time     = state->bwps_delivered_time;
+        sampler->bs_send_elapsed   = packet_out->po_sent
+                                            - state->bwps_first_sent_time;
+        sampler->bs_first_sent_time = packet_out->po_sent;
+    }
+
+    lsquic_malo_put(state);
+    packet_out->po_bwp_state = NULL;
+}
+
+
+const struct bw_sample *
+lsquic_bw_sampler_end_ack (struct bw_sampler *sampler)
+{
+    struct bw_sample *const sample = &sampler->bs_sample;
+    lsquic_time_t ack_elapsed;
+
+    if (!sampler->bs_have_sample)
+        return NULL;
+
+    sample->bws_delivered = sampler->bs_delivered - sample->bws_prior_delivered;
+    ack_elapsed = sampler->bs_delivered_time - sampler->bs_prior_time;
+    if (ack_elapsed > sampler->bs_send_elapsed)
+        sample->bws_interval = ack_elapsed;
+    else
+        sample->bws_interval = sampler->bs_send_elapsed;
+    if (sample->bws_interval)
+        sample->bws_bandwidth = sample->bws_delivered * 1000000
+                                                    / sample->bws_interval;
+    else
+        sample->bws_bandwidth = 0;
+
+    LSQ_DEBUG("delivered: %"PRIu64"; interval: %"PRIu64"; bandwidth: "
+        "%"PRIu64"; rtt: %"PRIu64"; app-limited: %d", sample->bws_delivered,
+        sample->bws_interval, sample->bws_bandwidth, sample->bws_rtt,
+        sample->bws_is_app_limited);
+    return sample;
+}
+
+
+void
+lsquic_bw_sampler_packet_lost (struct bw_sampler *sampler,
+                                        struct lsquic_packet_out *packet_out)
+{
+    if (packet_out->po_bwp_state)
+    {
+        lsquic_malo_put(packet_out->po_bwp_state);
+        packet_out->po_bwp_state = NULL;
+    }
+}
@@ -0,0 +1,93 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_bw_sampler.h -- Delivery rate sampling.
+ *
+ * When a packet is sent, the sampler records in it how many bytes had been
+ * delivered to the peer by then.  When the packet is acknowledged, the
+ * number of bytes delivered since divided by the time that took yields a
+ * delivery rate sample.  This follows draft-cheng-iccrg-delivery-rate-
+ * estimation: the interval is the longer of the send and the ACK phases,
+ * which keeps ACK compression from inflating the estimate.
+ */
+
+#ifndef LSQUIC_BW_SAMPLER_H
+#define LSQUIC_BW_SAMPLER_H 1
+
+struct lsquic_packet_out;
+struct malo;
+
+/* Per-packet state.  Allocated when the packet is sent and freed when the
+ * packet is acknowledged, lost, or destroyed.
+ */
+struct bwp_state
+{
+    uint64_t        bwps_delivered;
+    lsquic_time_t   bwps_delivered_time;
+    lsquic_time_t   bwps_first_sent_time;
+    int             bwps_is_app_limited;
+};
+
+struct bw_sample
+{
+    uint64_t        bws_delivered;      /* Bytes delivered during interval */
+    uint64_t        bws_prior_delivered;/* Delivered count when newest acked
+                                         * packet was sent.
+                                         */
+    uint64_t        bws_bandwidth;      /* Bytes per second */
+    lsquic_time_t   bws_interval;
+    lsquic_time_t   bws_rtt;            /* RTT of the newest acked packet */
+    int             bws_is_app_limited;
+};
+
+struct bw_sampler
+{
+    struct malo        *bs_malo;        /* For struct bwp_state */
+    lsquic_cid_t        bs_cid;         /* Used for logging */
+    uint64_t            bs_delivered;
+    lsquic_time_t       bs_delivered_time;
+    lsquic_time_t       bs_first_sent_time;
+    /* If non-zero, sender is application-limited until this many bytes
+     * are delivered.
+     */
+    uint64_t            bs_app_limited;
+    /* Sample being put together while an ACK is processed: */
+    struct bw_sample    bs_sample;
+    lsquic_time_t       bs_prior_time;
+    lsquic_time_t       bs_send_elapsed;
+    int                 bs_have_sample;
+};
+
+int
+lsquic_bw_sampler_init (struct bw_sampler *, lsquic_cid_t);
+
+void
+lsquic_bw_sampler_cleanup (struct bw_sampler *);
+
+/* `in_flight' includes the packet that has just been sent.  If
+ * `app_limited' is set, the application did not have enough data to
+ * fill the congestion window.
+ */
+void
+lsquic_bw_sampler_packet_sent (struct bw_sampler *, struct lsquic_packet_out *,
+                                    unsigned long in_flight, int app_limited);
+
+void
+lsquic_bw_sampler_begin_ack (struct bw_sampler *);
+
+void
+lsquic_bw_sampler_packet_acked (struct bw_sampler *,
+        struct lsquic_packet_out *, unsigned packet_sz, lsquic_time_t ack_time);
+
+/* Returns the sample produced by packets acknowledged since the call to
+ * lsquic_bw_sampler_begin_ack() or NULL if there is none.
+ */
+const struct bw_sample *
+lsquic_bw_sampler_end_ack (struct bw_sampler *);
+
+void
+lsquic_bw_sampler_packet_lost (struct bw_sampler *,
+                                                struct lsquic_packet_out *);
+
+#define lsquic_bw_sampler_delivered(bs) (+(bs)->bs_delivered)
+
+#endif
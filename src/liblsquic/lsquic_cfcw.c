@@ -1,5 +1,6 @@
 /* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
 #include <inttypes.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,54 +29,161 @@ void
 lsquic_cfcw_init (struct lsquic_cfcw *fc, struct lsquic_conn_public *cpub,
                                                 unsigned max_recv_window)
 {
+    struct lsquic_engine_public *const enpub = cpub->enpub;
+    uint64_t budget, left;
+
     memset(fc, 0, sizeof(*fc));
-    fc->cf_max_recv_win = max_recv_window;
+    fc->cf_init_recv_win = max_recv_window;
     fc->cf_conn_pub = cpub;
-    (void) lsquic_cfcw_fc_offsets_changed(fc);
+
+    /* New connection may only take what is left of the budget.  The
+     * window grows back when memory is freed by other connections.
+     */
+    budget = enpub->enp_settings.es_fc_mem_budget;
+    if (budget)
+    {
+        left = budget > enpub->enp_fcw_total
+             ? budget - enpub->enp_fcw_total : 0;
+        if (left < LSQUIC_MIN_FCW)
+            left = LSQUIC_MIN_FCW;
+        if (max_recv_window > left)
+        {
+            LSQ_DEBUG("initial window %u is over budget: use %"PRIu64,
+                                                    max_recv_window, left);
+            max_recv_window = left;
+        }
+    }
+
+    fc->cf_max_recv_win = max_recv_window;
+    fc->cf_recv_off = max_recv_window;
+    fc->cf_last_updated = lsquic_time_now();
+    enpub->enp_fcw_total += max_recv_window;
+    ++enpub->enp_n_cfcw;
+}
+
+
+void
+lsquic_cfcw_cleanup (struct lsquic_cfcw *fc)
+{
+    struct lsquic_engine_public *const enpub = fc->cf_conn_pub->enpub;
+
+    enpub->enp_fcw_total -= fc->cf_max_recv_win;
+    --enpub->enp_n_cfcw;
+}
+
+
+unsigned
+lsquic_fcw_bdp_window (unsigned window, uint64_t n_read,
+                                lsquic_time_t elapsed, lsquic_time_t srtt)
+{
+    uint64_t new_window;
+
+    /* The window update is sent when half of the window has been read.
+     * The other half must last until the update reaches the peer and the
+     * peer's data reaches us: that is, one RTT.
+     */
+    if (elapsed > 0)
+        new_window = 2 * n_read * srtt / elapsed;
+    else
+        new_window = (uint64_t) window * 2;
+
+    if (new_window > (uint64_t) window * 2)
+        new_window = (uint64_t) window * 2;
+    else if (new_window < window / 2)
+        new_window = window / 2;
+
+    if (new_window > UINT_MAX)
+        new_window = UINT_MAX;
+
+    return new_window;
+}
+
+
+/* A connection may use what is left of the budget or its fair share,
+ * whichever is larger.
+ */
+static uint64_t
+cfcw_budget_cap (const struct lsquic_cfcw *fc)
+{
+    const struct lsquic_engine_public *const enpub = fc->cf_conn_pub->enpub;
+    uint64_t budget, others, left, fair_share;
+
+    budget = enpub->enp_settings.es_fc_mem_budget;
+    if (0 == budget)
+        return UINT64_MAX;
+
+    others = enpub->enp_fcw_total - fc->cf_max_recv_win;
+    left = budget > others ? budget - others : 0;
+    fair_share = budget / enpub->enp_n_cfcw;
+    return left > fair_share ? left : fair_share;
 }
 
 
 static void
-cfcw_maybe_increase_max_window (struct lsquic_cfcw *fc)
+cfcw_tune_window (struct lsquic_cfcw *fc, lsquic_time_t now)
 {
-    unsigned new_max_window;
+    struct lsquic_engine_public *const enpub = fc->cf_conn_pub->enpub;
+    unsigned new_max_window, max_window;
+    lsquic_time_t srtt;
+    uint64_t cap;
+
+    new_max_window = fc->cf_max_recv_win;
 
-    new_max_window = fc->cf_max_recv_win * 2;
+    srtt = lsquic_rtt_stats_get_srtt(&fc->cf_conn_pub->rtt_stats);
+    if (srtt)
+    {
+        new_max_window = lsquic_fcw_bdp_window(fc->cf_max_recv_win,
+                                fc->cf_read_off - fc->cf_last_read_off,
+                                now - fc->cf_last_updated, srtt);
+
+        /* Do not increase past explicitly specified maximum */
+        max_window = enpub->enp_settings.es_max_cfcw;
+        if (max_window < fc->cf_init_recv_win)
+            max_window = fc->cf_init_recv_win;
+        if (new_max_window > max_window)
+            new_max_window = max_window;
+
+        /* Slow reader alone does not shrink window below initial value */
+        if (new_max_window < fc->cf_init_recv_win)
+            new_max_window = fc->cf_init_recv_win;
+    }
 
-    /* Do not increase past explicitly specified maximum */
-    if (new_max_window > fc->cf_conn_pub->enpub->enp_settings.es_max_cfcw)
-        new_max_window = fc->cf_conn_pub->enpub->enp_settings.es_max_cfcw;
+    cap = cfcw_budget_cap(fc);
+    if (new_max_window > cap)
+        new_max_window = cap;
+    if (new_max_window < LSQUIC_MIN_FCW)
+        new_max_window = LSQUIC_MIN_FCW;
 
-    if (new_max_window > fc->cf_max_recv_win)
+    if (new_max_window != fc->cf_max_recv_win)
     {
-        LSQ_DEBUG("max window increase %u -> %u", fc->cf_max_recv_win,
+        LSQ_DEBUG("max window change %u -> %u", fc->cf_max_recv_win,
                                                             new_max_window);
         EV_LOG_CONN_EVENT(LSQUIC_LOG_CONN_ID,
-            "max CFCW increase %u -> %u", fc->cf_max_recv_win,
+            "max CFCW change %u -> %u", fc->cf_max_recv_win,
                                                             new_max_window);
+        enpub->enp_fcw_total -= fc->cf_max_recv_win;
+        enpub->enp_fcw_total += new_max_window;
         fc->cf_max_recv_win = new_max_window;
     }
-    else
-        LSQ_DEBUG("max window could use an increase, but we're stuck "
-            "at %u", fc->cf_max_recv_win);
 }
 
 
 int
 lsquic_cfcw_fc_offsets_changed (struct lsquic_cfcw *fc)
 {
-    lsquic_time_t now, since_last_update, srtt;
+    lsquic_time_t now;
 
     if (fc->cf_recv_off - fc->cf_read_off >= fc->cf_max_recv_win / 2)
         return 0;
 
     now = lsquic_time_now();
-    since_last_update = now - fc->cf_last_updated;
+    cfcw_tune_window(fc, now);
     fc->cf_last_updated = now;
+    fc->cf_last_read_off = fc->cf_read_off;
 
-    srtt = lsquic_rtt_stats_get_srtt(&fc->cf_conn_pub->rtt_stats);
-    if (since_last_update < srtt * 2)
-        cfcw_maybe_increase_max_window(fc);
+    /* If the window shrank, the offset already advertised still stands */
+    if (fc->cf_read_off + fc->cf_max_recv_win <= fc->cf_recv_off)
+        return 0;
 
     fc->cf_recv_off = fc->cf_read_off + fc->cf_max_recv_win;
     LSQ_DEBUG("recv_off changed: read_off: %"PRIu64"; recv_off: %"
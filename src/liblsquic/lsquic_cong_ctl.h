@@ -0,0 +1,94 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_cong_ctl.h -- Congestion controller interface.
+ *
+ * The send controller calls these functions; it does not know which
+ * congestion controller is in use.  The first argument is a pointer to
+ * the controller's state, which is embedded into the send controller.
+ */
+
+#ifndef LSQUIC_CONG_CTL_H
+#define LSQUIC_CONG_CTL_H 1
+
+struct lsquic_packet_out;
+struct lsquic_rtt_stats;
+
+struct cong_ctl_if
+{
+    void
+    (*cci_init) (void *cong_ctl, lsquic_cid_t,
+                                        const struct lsquic_rtt_stats *);
+
+    /* Called when a packet is sent.  `in_flight' is the number of bytes in
+     * flight, including this packet.  Optional.
+     */
+    void
+    (*cci_sent) (void *cong_ctl, struct lsquic_packet_out *,
+                                        unsigned long in_flight, int app_limited);
+
+    /* Acknowledged packets are reported using cci_ack(), which is called
+     * once for each newly acknowledged packet.  If cci_begin_ack and
+     * cci_end_ack are set, cci_ack() calls are bracketed by them.  The
+     * two are optional.
+     */
+    void
+    (*cci_begin_ack) (void *cong_ctl, lsquic_time_t ack_time,
+                                                    unsigned long in_flight);
+
+    void
+    (*cci_ack) (void *cong_ctl, struct lsquic_packet_out *,
+                        unsigned packet_sz, lsquic_time_t now, int app_limited);
+
+    void
+    (*cci_end_ack) (void *cong_ctl, unsigned long in_flight);
+
+    /* RTT sample taken when an ACK newly acknowledges the largest packet.
+     * It is not adjusted for ACK delay.  Optional.
+     */
+    void
+    (*cci_rtt_sample) (void *cong_ctl, lsquic_time_t rtt);
+
+    /* A packet has been declared lost.  Optional. */
+    void
+    (*cci_lost) (void *cong_ctl, struct lsquic_packet_out *,
+                                                        unsigned packet_sz);
+
+    /* New loss event: called at most once per round trip. */
+    void
+    (*cci_loss) (void *cong_ctl);
+
+    /* Retransmission timeout */
+    void
+    (*cci_timeout) (void *cong_ctl);
+
+    /* The last loss event or retransmission timeout was spurious: restore
+     * the state that preceded it.  Optional.
+     */
+    void
+    (*cci_undo) (void *cong_ctl);
+
+    /* There were no retransmittable packets in flight */
+    void
+    (*cci_was_quiet) (void *cong_ctl, lsquic_time_t now,
+                                                    unsigned long in_flight);
+
+    unsigned long
+    (*cci_get_cwnd) (void *cong_ctl);
+
+    /* Returns pacing rate in bytes per second */
+    uint64_t
+    (*cci_pacing_rate) (void *cong_ctl, int in_recovery);
+
+    int
+    (*cci_in_slow_start) (void *cong_ctl);
+
+    /* Returns slow start threshold or zero if controller does not use one */
+    unsigned long
+    (*cci_get_ssthresh) (void *cong_ctl);
+
+    /* Optional */
+    void
+    (*cci_cleanup) (void *cong_ctl);
+};
+
+#endif
@@ -102,8 +102,7 @@ struct lsquic_conn
     TAILQ_ENTRY(lsquic_conn)     cn_next_all,
                                  cn_next_in,
                                  cn_next_pend_rw,
-                                 cn_next_out,
-                                 cn_next_hash;
+                                 cn_next_out;
     const struct conn_iface     *cn_if;
     const struct parse_funcs    *cn_pf;
     struct attq_elem            *cn_attq_elem;
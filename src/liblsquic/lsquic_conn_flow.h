@@ -15,7 +15,9 @@ typedef struct lsquic_cfcw {
     uint64_t      cf_recv_off;      /* Flow control receive offset */
     uint64_t      cf_read_off;      /* Number of bytes consumed (cumulative) */
     lsquic_time_t cf_last_updated;
+    uint64_t      cf_last_read_off; /* Read offset at last update */
     unsigned      cf_max_recv_win;  /* Maximum receive window */
+    unsigned      cf_init_recv_win; /* Configured initial window */
 } lsquic_cfcw_t;
 
 struct lsquic_conn_cap {
@@ -38,10 +40,18 @@ struct lsquic_conn_cap {
         (cap)->cc_max - (cap)->cc_sent)
 
 
+/* The window is charged against the engine's memory budget: call
+ * lsquic_cfcw_cleanup() when done.  If the budget is exhausted, the
+ * window starts out smaller than `initial_max_recv_window'; use
+ * lsquic_cfcw_get_max_recv_window() to find out what to advertise.
+ */
 void
 lsquic_cfcw_init (lsquic_cfcw_t *, struct lsquic_conn_public *,
                                         unsigned initial_max_recv_window);
 
+void
+lsquic_cfcw_cleanup (lsquic_cfcw_t *);
+
 /* If update is to be sent, updates max_recv_off and returns true.  Note
  * that if you call this function twice, the second call will return false.
  */
@@ -63,4 +73,13 @@ lsquic_cfcw_incr_max_recv_off (lsquic_cfcw_t *, uint64_t);
 void
 lsquic_cfcw_incr_read_off (lsquic_cfcw_t *, uint64_t);
 
+/* Returns window size that is twice the bandwidth-delay product, where
+ * bandwidth is `n_read' bytes read in `elapsed' microseconds.  The result
+ * is within a factor of two of `window'.  Used by both connection and
+ * stream flow controllers.
+ */
+unsigned
+lsquic_fcw_bdp_window (unsigned window, uint64_t n_read,
+                                lsquic_time_t elapsed, lsquic_time_t srtt);
+
 #endif
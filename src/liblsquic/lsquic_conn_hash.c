@@ -1,5 +1,6 @@
 /* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/queue.h>
@@ -14,29 +15,216 @@
 #include "lsquic_logger.h"
 
 
-#define n_buckets(nbits) (1U << (nbits))
-#define conn_hash_mask(conn_hash) ((1 << (conn_hash)->ch_nbits) - 1)
-#define conn_hash_bucket_no(conn_hash, hash) (hash & conn_hash_mask(conn_hash))
+#define n_slots(nbits) (1U << (nbits))
+#define table_mask(table) (n_slots((table)->cht_nbits) - 1)
+#define conn_hash_hash(conn_hash, cid) \
+                    XXH32(&(cid), sizeof(cid), (uintptr_t) (conn_hash))
+
+
+static int
+table_init (struct conn_hash_table *table, unsigned nbits)
+{
+    const unsigned n = n_slots(nbits);
+
+    /* Entries and distances share one allocation */
+    table->cht_entries = malloc((sizeof(table->cht_entries[0])
+                                    + sizeof(table->cht_dists[0])) * n);
+    if (!table->cht_entries)
+        return -1;
+    table->cht_dists = (unsigned char *) (table->cht_entries + n);
+    memset(table->cht_dists, 0, sizeof(table->cht_dists[0]) * n);
+    table->cht_nbits = nbits;
+    table->cht_count = 0;
+    return 0;
+}
+
+
+static void
+table_cleanup (struct conn_hash_table *table)
+{
+    free(table->cht_entries);
+    memset(table, 0, sizeof(*table));
+}
+
+
+/* Return one plus the distance of the entry in slot `idx' from its home
+ * slot.
+ */
+static unsigned
+table_dist (const struct conn_hash *conn_hash,
+            const struct conn_hash_table *table, unsigned idx)
+{
+    unsigned home;
+
+    if (table->cht_dists[idx] < UCHAR_MAX)
+        return table->cht_dists[idx];
+
+    home = conn_hash_hash(conn_hash, table->cht_entries[idx].che_cid)
+                                                        & table_mask(table);
+    return ((idx - home) & table_mask(table)) + 1;
+}
+
+
+static void
+table_set_dist (struct conn_hash_table *table, unsigned idx, unsigned dist)
+{
+    table->cht_dists[idx] = dist < UCHAR_MAX ? dist : UCHAR_MAX;
+}
+
+
+/* Return slot index or -1 if not found */
+static int
+table_find (const struct conn_hash_table *table, unsigned hash,
+                                                        lsquic_cid_t cid)
+{
+    const unsigned mask = table_mask(table);
+    unsigned idx, dist, stored;
+
+    for (idx = hash & mask, dist = 1; ; idx = (idx + 1) & mask, ++dist)
+    {
+        stored = table->cht_dists[idx];
+        /* Had the connection been here, it would have taken this slot,
+         * as it is farther from its home.  This also catches empty slots.
+         * A saturated distance could be anything, so keep going.
+         */
+        if (stored < dist && stored < UCHAR_MAX)
+            return -1;
+        if (table->cht_entries[idx].che_cid == cid)
+            return idx;
+    }
+}
+
+
+static void
+table_insert (const struct conn_hash *conn_hash,
+              struct conn_hash_table *table, unsigned hash,
+              struct conn_hash_entry entry)
+{
+    const unsigned mask = table_mask(table);
+    struct conn_hash_entry tmp;
+    unsigned idx, dist, other;
+
+    for (idx = hash & mask, dist = 1; table->cht_dists[idx];
+                                        idx = (idx + 1) & mask, ++dist)
+    {
+        other = table_dist(conn_hash, table, idx);
+        if (other < dist)
+        {
+            /* Take from the rich, give to the poor */
+            tmp = table->cht_entries[idx];
+            table->cht_entries[idx] = entry;
+            table_set_dist(table, idx, dist);
+            entry = tmp;
+            dist = other;
+        }
+    }
+
+    table->cht_entries[idx] = entry;
+    table_set_dist(table, idx, dist);
+    ++table->cht_count;
+}
+
+
+/* Shift following entries back, so that no tombstones are necessary */
+static void
+table_remove_at (const struct conn_hash *conn_hash,
+                 struct conn_hash_table *table, unsigned idx)
+{
+    const unsigned mask = table_mask(table);
+    unsigned next;
+
+    for (next = (idx + 1) & mask; table->cht_dists[next] > 1;
+                                        idx = next, next = (next + 1) & mask)
+    {
+        table->cht_entries[idx] = table->cht_entries[next];
+        table_set_dist(table, idx, table_dist(conn_hash, table, next) - 1);
+    }
+
+    table->cht_dists[idx] = 0;
+    --table->cht_count;
+}
+
+
+/* Move entries from the old table to the new one, examining at most
+ * `n_steps' slots.  Slots are processed in order: since the old table
+ * no longer receives new entries and removal only shifts entries back,
+ * all slots before ch_migrate_idx remain empty.
+ */
+static void
+migrate_entries (struct conn_hash *conn_hash, unsigned n_steps)
+{
+    struct conn_hash_table *const old = &conn_hash->ch_old_table;
+    unsigned idx, hash;
+
+    if (!old->cht_entries)
+        return;
+
+    while (old->cht_count > 0 && n_steps-- > 0)
+    {
+        idx = conn_hash->ch_migrate_idx;
+        if (old->cht_dists[idx])
+        {
+            hash = conn_hash_hash(conn_hash, old->cht_entries[idx].che_cid);
+            table_insert(conn_hash, &conn_hash->ch_table, hash,
+                                                    old->cht_entries[idx]);
+            /* The next entry may be shifted into this slot: do not advance
+             * the index.
+             */
+            table_remove_at(conn_hash, old, idx);
+        }
+        else
+            ++conn_hash->ch_migrate_idx;
+    }
+
+    if (old->cht_count == 0)
+    {
+        LSQ_DEBUG("done migrating to the new table");
+        table_cleanup(old);
+        conn_hash->ch_migrate_idx = 0;
+    }
+}
+
+
+static int
+grow_conn_hash (struct conn_hash *conn_hash)
+{
+    struct conn_hash_table new_table;
+
+    /* The old table is drained long before the new one fills up.  This is
+     * here for completeness.
+     */
+    if (conn_hash->ch_old_table.cht_entries)
+        migrate_entries(conn_hash, UINT_MAX);
+
+    if (conn_hash->ch_table.cht_nbits >= sizeof(unsigned) * 8 - 1)
+        return -1;
+
+    LSQ_INFO("growing table to %u slots",
+                                n_slots(conn_hash->ch_table.cht_nbits + 1));
+    if (0 != table_init(&new_table, conn_hash->ch_table.cht_nbits + 1))
+    {
+        LSQ_WARN("malloc failed: potential trouble ahead");
+        return -1;
+    }
+
+    conn_hash->ch_old_table = conn_hash->ch_table;
+    conn_hash->ch_table = new_table;
+    conn_hash->ch_migrate_idx = 0;
+    return 0;
+}
 
 
 int
 conn_hash_init (struct conn_hash *conn_hash, unsigned max_count)
 {
-    unsigned n;
-
     if (!max_count)
         max_count = 1000000;
 
     memset(conn_hash, 0, sizeof(*conn_hash));
     conn_hash->ch_max_count = max_count;
-    conn_hash->ch_nbits = 1;  /* Start small */
     TAILQ_INIT(&conn_hash->ch_all);
-    conn_hash->ch_buckets = malloc(sizeof(conn_hash->ch_buckets[0]) *
-                                                n_buckets(conn_hash->ch_nbits));
-    if (!conn_hash->ch_buckets)
+    if (0 != table_init(&conn_hash->ch_table, 4))   /* Start small */
         return -1;
-    for (n = 0; n < n_buckets(conn_hash->ch_nbits); ++n)
-        TAILQ_INIT(&conn_hash->ch_buckets[n]);
     LSQ_INFO("initialized: max_count: %u", conn_hash->ch_max_count);
     return 0;
 }
@@ -45,80 +233,53 @@ conn_hash_init (struct conn_hash *conn_hash, unsigned max_count)
 void
 conn_hash_cleanup (struct conn_hash *conn_hash)
 {
-    free(conn_hash->ch_buckets);
+    table_cleanup(&conn_hash->ch_table);
+    table_cleanup(&conn_hash->ch_old_table);
 }
 
 
 struct lsquic_conn *
 conn_hash_find (struct conn_hash *conn_hash, lsquic_cid_t cid)
 {
-    const unsigned hash = XXH32(&cid, sizeof(cid), (uintptr_t) conn_hash);
-    const unsigned buckno = conn_hash_bucket_no(conn_hash, hash);
-    struct lsquic_conn *lconn;
-    TAILQ_FOREACH(lconn, &conn_hash->ch_buckets[buckno], cn_next_hash)
-        if (lconn->cn_cid == cid)
-            return lconn;
-    return NULL;
-}
-
-
-static int
-double_conn_hash_buckets (struct conn_hash *conn_hash)
-{
-    struct lsquic_conn_head *new_buckets, *new[2];
-    struct lsquic_conn *lconn;
-    unsigned n, old_nbits;
+    const unsigned hash = conn_hash_hash(conn_hash, cid);
     int idx;
 
-    old_nbits = conn_hash->ch_nbits;
-    LSQ_INFO("doubling number of buckets to %u", n_buckets(old_nbits + 1));
-    new_buckets = malloc(sizeof(conn_hash->ch_buckets[0])
-                                                * n_buckets(old_nbits + 1));
-    if (!new_buckets)
-    {
-        LSQ_WARN("malloc failed: potential trouble ahead");
-        return -1;
-    }
+    idx = table_find(&conn_hash->ch_table, hash, cid);
+    if (idx >= 0)
+        return conn_hash->ch_table.cht_entries[idx].che_conn;
 
-    for (n = 0; n < n_buckets(old_nbits); ++n)
+    if (conn_hash->ch_old_table.cht_entries)
     {
-        new[0] = &new_buckets[n];
-        new[1] = &new_buckets[n + n_buckets(old_nbits)];
-        TAILQ_INIT(new[0]);
-        TAILQ_INIT(new[1]);
-        while ((lconn = TAILQ_FIRST(&conn_hash->ch_buckets[n])))
-        {
-            TAILQ_REMOVE(&conn_hash->ch_buckets[n], lconn, cn_next_hash);
-            idx = (lconn->cn_hash >> old_nbits) & 1;
-            TAILQ_INSERT_TAIL(new[idx], lconn, cn_next_hash);
-        }
+        idx = table_find(&conn_hash->ch_old_table, hash, cid);
+        if (idx >= 0)
+            return conn_hash->ch_old_table.cht_entries[idx].che_conn;
     }
-    free(conn_hash->ch_buckets);
-    conn_hash->ch_nbits   = old_nbits + 1;
-    conn_hash->ch_buckets = new_buckets;
-    return 0;
+
+    return NULL;
 }
 
 
 int
 conn_hash_add (struct conn_hash *conn_hash, struct lsquic_conn *lconn)
 {
-    const unsigned hash = XXH32(&lconn->cn_cid, sizeof(lconn->cn_cid),
-                                                        (uintptr_t) conn_hash);
+    const unsigned hash = conn_hash_hash(conn_hash, lconn->cn_cid);
+    struct conn_hash_entry entry;
+
     if (conn_hash->ch_count >= conn_hash->ch_max_count)
         return -1;
-    if (conn_hash->ch_count >=
-                n_buckets(conn_hash->ch_nbits) * CONN_HASH_MAX_PER_BUCKET &&
-        conn_hash->ch_nbits < sizeof(hash) * 8 - 1                        &&
-        0 != double_conn_hash_buckets(conn_hash))
+    if ((conn_hash->ch_table.cht_count + 1) * 256 >
+            n_slots(conn_hash->ch_table.cht_nbits) * CONN_HASH_MAX_LOAD &&
+        0 != grow_conn_hash(conn_hash))
     {
             return -1;
     }
-    const unsigned buckno = conn_hash_bucket_no(conn_hash, hash);
     lconn->cn_hash = hash;
+    entry.che_cid = lconn->cn_cid;
+    entry.che_conn = lconn;
+    table_insert(conn_hash, &conn_hash->ch_table, hash, entry);
     TAILQ_INSERT_TAIL(&conn_hash->ch_all, lconn, cn_next_all);
-    TAILQ_INSERT_TAIL(&conn_hash->ch_buckets[buckno], lconn, cn_next_hash);
     ++conn_hash->ch_count;
+    migrate_entries(conn_hash, CONN_HASH_MIGRATE_STEP);
     return 0;
 }
 
@@ -126,10 +287,23 @@ conn_hash_add (struct conn_hash *conn_hash, struct lsquic_conn *lconn)
 void
 conn_hash_remove (struct conn_hash *conn_hash, struct lsquic_conn *lconn)
 {
-    const unsigned buckno = conn_hash_bucket_no(conn_hash, lconn->cn_hash);
+    struct conn_hash_table *table;
+    int idx;
+
+    table = &conn_hash->ch_table;
+    idx = table_find(table, lconn->cn_hash, lconn->cn_cid);
+    if (idx < 0)
+    {
+        table = &conn_hash->ch_old_table;
+        assert(table->cht_entries);
+        idx = table_find(table, lconn->cn_hash, lconn->cn_cid);
+    }
+    assert(idx >= 0);
+    assert(table->cht_entries[idx].che_conn == lconn);
+    table_remove_at(conn_hash, table, idx);
     TAILQ_REMOVE(&conn_hash->ch_all, lconn, cn_next_all);
-    TAILQ_REMOVE(&conn_hash->ch_buckets[buckno], lconn, cn_next_hash);
     --conn_hash->ch_count;
+    migrate_entries(conn_hash, CONN_HASH_MIGRATE_STEP);
 }
 
 
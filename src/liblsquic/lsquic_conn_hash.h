@@ -8,24 +8,55 @@
 
 #include <sys/queue.h>
 
-/* Once we reach this many per bucket on average, double the number of
- * buckets and redistribute entries.
- *
- * This value should be a power of two for speed.
+/* The table is grown once it is this full.  Expressed as a fraction of
+ * 256 for speed.
+ */
+#define CONN_HASH_MAX_LOAD 192
+
+/* Number of slots of the old table examined each time a connection is
+ * added or removed while the table grows.  Must be large enough for the
+ * old table to be drained before the new one becomes full.
  */
-#define CONN_HASH_MAX_PER_BUCKET 2
+#define CONN_HASH_MIGRATE_STEP 4
 
 struct lsquic_conn;
 
 TAILQ_HEAD(lsquic_conn_head, lsquic_conn);
 
+/* Connection ID and pointer are stored inline, so that lookup does not
+ * need to touch connections that do not match.
+ */
+struct conn_hash_entry
+{
+    lsquic_cid_t             che_cid;
+    struct lsquic_conn      *che_conn;
+};
+
+/* Open-addressing table with Robin Hood linear probing.  cht_dists[n] is
+ * zero if entry n is empty; otherwise, it is one plus the distance of the
+ * entry from its home slot.  Distances that do not fit into a byte are
+ * stored as UCHAR_MAX and recalculated from the hash when needed.
+ */
+struct conn_hash_table
+{
+    struct conn_hash_entry  *cht_entries;
+    unsigned char           *cht_dists;
+    unsigned                 cht_nbits;
+    unsigned                 cht_count;
+};
+
 struct conn_hash
 {
     struct lsquic_conn_head  ch_all;
-    struct lsquic_conn_head *ch_buckets;
     struct lsquic_conn      *ch_next;
+    /* When the table grows, entries are moved from the old table to the
+     * new one a few at a time, as connections are added and removed.
+     * While that happens, lookups check both tables.
+     */
+    struct conn_hash_table   ch_table,
+                             ch_old_table;
+    unsigned                 ch_migrate_idx;
     unsigned                 ch_count;
-    unsigned                 ch_nbits;
     unsigned                 ch_max_count;
 };
 
@@ -162,17 +162,29 @@ const common_cert_t common_cert_set[common_certs_num] = {
 
 static lsquic_str_t *s_ccsbuf;
 
-lsquic_str_t * get_common_certs_hash()
+/* The buffer is built once, by lsquic_global_init(), so that engines
+ * running in different threads can read it without locking.
+ */
+int
+lsquic_crt_init (void)
 {
     int i;
     if (s_ccsbuf == NULL)
     {
         s_ccsbuf = lsquic_str_new(NULL, 0);
+        if (!s_ccsbuf)
+            return -1;
         for (i=0 ;i<common_certs_num; ++i)
         {
             lsquic_str_append(s_ccsbuf, (const char *)&common_cert_set[i].hash, 8);
         }
     }
+    return 0;
+}
+
+
+lsquic_str_t * get_common_certs_hash()
+{
     return s_ccsbuf;
 }
 
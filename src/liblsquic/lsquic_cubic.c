@@ -14,7 +14,11 @@
 
 #include "lsquic_int_types.h"
 #include "lsquic_types.h"
+#include "lsquic_cong_ctl.h"
 #include "lsquic_cubic.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_rtt.h"
 #include "lsquic_util.h"
 
 #define LSQUIC_LOGGER_MODULE LSQLM_CUBIC
@@ -28,6 +32,14 @@
 #define ONE_MINUS_BETA          819     /* 819/1024 */
 #define ONE_OVER_C              2560    /* 2560/1024 */
 
+/* HyStart++ parameters, see draft-ietf-tcpm-hystartplusplus */
+#define MIN_RTT_THRESH          4000    /* Microseconds */
+#define MAX_RTT_THRESH          16000   /* Microseconds */
+#define MIN_RTT_DIVISOR         8
+#define N_RTT_SAMPLE            8
+#define CSS_GROWTH_DIVISOR      4
+#define CSS_ROUNDS              5
+
 static void
 cubic_reset (struct lsquic_cubic *cubic)
 {
@@ -102,6 +114,7 @@ lsquic_cubic_init_ext (struct lsquic_cubic *cubic, lsquic_cid_t cid,
     cubic->cu_ssthresh = 10000 * TCP_MSS; /* Emulate "unbounded" slow start */
     cubic->cu_cid   = cid;
     cubic->cu_flags = flags;
+    cubic->cu_undo_cwnd = 0;
 #ifndef NDEBUG
     const char *s;
     s = getenv("LSQUIC_CUBIC_SAMPLING_RATE");
@@ -149,7 +162,10 @@ lsquic_cubic_ack (struct lsquic_cubic *cubic, lsquic_time_t now_time,
 
     if (cubic->cu_cwnd <= cubic->cu_ssthresh)
     {
-        cubic->cu_cwnd += TCP_MSS;
+        if (cubic->cu_css_baseline_min_rtt)
+            cubic->cu_cwnd += TCP_MSS / CSS_GROWTH_DIVISOR;
+        else
+            cubic->cu_cwnd += TCP_MSS;
         LSQ_DEBUG("ACK: slow threshold, cwnd: %lu", cubic->cu_cwnd);
     }
     else if (!app_limited)
@@ -162,10 +178,20 @@ lsquic_cubic_ack (struct lsquic_cubic *cubic, lsquic_time_t now_time,
 }
 
 
+static void
+cubic_save_undo_state (struct lsquic_cubic *cubic)
+{
+    cubic->cu_undo_cwnd          = cubic->cu_cwnd;
+    cubic->cu_undo_ssthresh      = cubic->cu_ssthresh;
+    cubic->cu_undo_last_max_cwnd = cubic->cu_last_max_cwnd;
+}
+
+
 void
 lsquic_cubic_loss (struct lsquic_cubic *cubic)
 {
     LSQ_DEBUG("%s(cubic)", __func__);
+    cubic_save_undo_state(cubic);
     cubic->cu_epoch_start = 0;
     if (FAST_CONVERGENCE && cubic->cu_cwnd < cubic->cu_last_max_cwnd)
         cubic->cu_last_max_cwnd = cubic->cu_cwnd * TWO_MINUS_BETA_OVER_TWO / 1024;
@@ -174,6 +200,7 @@ lsquic_cubic_loss (struct lsquic_cubic *cubic)
     cubic->cu_cwnd = cubic->cu_cwnd * ONE_MINUS_BETA / 1024;
     cubic->cu_tcp_cwnd = cubic->cu_cwnd;
     cubic->cu_ssthresh = cubic->cu_cwnd;
+    cubic->cu_css_baseline_min_rtt = 0;
     LSQ_INFO("loss detected, last_max_cwnd: %lu, cwnd: %lu",
         cubic->cu_last_max_cwnd, cubic->cu_cwnd);
     LOG_CWND(cubic);
@@ -184,9 +211,230 @@ void
 lsquic_cubic_timeout (struct lsquic_cubic *cubic)
 {
     LSQ_DEBUG("%s(cubic)", __func__);
+    cubic_save_undo_state(cubic);
     cubic_reset(cubic);
     cubic->cu_ssthresh = cubic->cu_cwnd;
     cubic->cu_tcp_cwnd = cubic->cu_cwnd;
     LSQ_INFO("timeout, cwnd: %lu", cubic->cu_cwnd);
     LOG_CWND(cubic);
 }
+
+
+void
+lsquic_cubic_undo (struct lsquic_cubic *cubic)
+{
+    LSQ_DEBUG("%s(cubic)", __func__);
+    if (0 == cubic->cu_undo_cwnd)
+        return;
+
+    if (cubic->cu_cwnd < cubic->cu_undo_cwnd)
+        cubic->cu_cwnd = cubic->cu_undo_cwnd;
+    if (cubic->cu_ssthresh < cubic->cu_undo_ssthresh)
+        cubic->cu_ssthresh = cubic->cu_undo_ssthresh;
+    cubic->cu_last_max_cwnd = cubic->cu_undo_last_max_cwnd;
+    cubic->cu_tcp_cwnd = cubic->cu_cwnd;
+    cubic->cu_epoch_start = 0;
+    cubic->cu_undo_cwnd = 0;
+    LSQ_INFO("undo, cwnd: %lu, ssthresh: %lu", cubic->cu_cwnd,
+                                                        cubic->cu_ssthresh);
+    LOG_CWND(cubic);
+}
+
+
+void
+lsquic_cubic_sent (struct lsquic_cubic *cubic, lsquic_packno_t packno)
+{
+    cubic->cu_last_sent_packno = packno;
+}
+
+
+void
+lsquic_cubic_acked (struct lsquic_cubic *cubic, lsquic_packno_t packno)
+{
+    if (!(cubic->cu_flags & CU_HYSTART)
+            || cubic->cu_cwnd > cubic->cu_ssthresh
+            || packno <= cubic->cu_round_end)
+        return;
+
+    cubic->cu_round_end = cubic->cu_last_sent_packno;
+    cubic->cu_last_round_min_rtt = cubic->cu_round_min_rtt;
+    cubic->cu_round_min_rtt = 0;
+    cubic->cu_n_rtt_samples = 0;
+    LSQ_DEBUG("HyStart++: new round ends at packet %"PRIu64"; last round "
+        "min RTT: %"PRIu64, cubic->cu_round_end, cubic->cu_last_round_min_rtt);
+
+    if (cubic->cu_css_baseline_min_rtt
+                                && ++cubic->cu_css_rounds >= CSS_ROUNDS)
+    {
+        cubic->cu_css_baseline_min_rtt = 0;
+        cubic->cu_ssthresh = cubic->cu_cwnd;
+        LSQ_INFO("HyStart++: exit slow start, cwnd: %lu", cubic->cu_cwnd);
+    }
+}
+
+
+void
+lsquic_cubic_rtt_sample (struct lsquic_cubic *cubic, lsquic_time_t rtt)
+{
+    lsquic_time_t thresh;
+
+    if (!(cubic->cu_flags & CU_HYSTART)
+                                || cubic->cu_cwnd > cubic->cu_ssthresh)
+        return;
+
+    if (0 == cubic->cu_round_min_rtt || rtt < cubic->cu_round_min_rtt)
+        cubic->cu_round_min_rtt = rtt;
+    ++cubic->cu_n_rtt_samples;
+    if (cubic->cu_n_rtt_samples < N_RTT_SAMPLE
+                                    || 0 == cubic->cu_last_round_min_rtt)
+        return;
+
+    if (0 == cubic->cu_css_baseline_min_rtt)
+    {
+        thresh = cubic->cu_last_round_min_rtt / MIN_RTT_DIVISOR;
+        if (thresh < MIN_RTT_THRESH)
+            thresh = MIN_RTT_THRESH;
+        else if (thresh > MAX_RTT_THRESH)
+            thresh = MAX_RTT_THRESH;
+        if (cubic->cu_round_min_rtt >= cubic->cu_last_round_min_rtt + thresh)
+        {
+            cubic->cu_css_baseline_min_rtt = cubic->cu_round_min_rtt;
+            cubic->cu_css_rounds = 0;
+            LSQ_INFO("HyStart++: enter conservative slow start; min RTT "
+                "went from %"PRIu64" to %"PRIu64", cwnd: %lu",
+                cubic->cu_last_round_min_rtt, cubic->cu_round_min_rtt,
+                cubic->cu_cwnd);
+        }
+    }
+    else if (cubic->cu_round_min_rtt < cubic->cu_css_baseline_min_rtt)
+    {
+        cubic->cu_css_baseline_min_rtt = 0;
+        LSQ_INFO("HyStart++: RTT increase was spurious, resume slow start");
+    }
+}
+
+
+static void
+cubic_cci_init (void *cong_ctl, lsquic_cid_t cid,
+                                const struct lsquic_rtt_stats *rtt_stats)
+{
+    struct lsquic_cubic *const cubic = cong_ctl;
+    lsquic_cubic_init(cubic, cid);
+    cubic->cu_rtt_stats = rtt_stats;
+}
+
+
+static void
+cubic_cci_sent (void *cong_ctl, struct lsquic_packet_out *packet_out,
+                                    unsigned long in_flight, int app_limited)
+{
+    lsquic_cubic_sent(cong_ctl, packet_out->po_packno);
+}
+
+
+static void
+cubic_cci_ack (void *cong_ctl, struct lsquic_packet_out *packet_out,
+                    unsigned packet_sz, lsquic_time_t now, int app_limited)
+{
+    lsquic_cubic_acked(cong_ctl, packet_out->po_packno);
+    lsquic_cubic_ack(cong_ctl, now, now - packet_out->po_sent, app_limited,
+                                                                packet_sz);
+}
+
+
+static void
+cubic_cci_rtt_sample (void *cong_ctl, lsquic_time_t rtt)
+{
+    lsquic_cubic_rtt_sample(cong_ctl, rtt);
+}
+
+
+static void
+cubic_cci_loss (void *cong_ctl)
+{
+    lsquic_cubic_loss(cong_ctl);
+}
+
+
+static void
+cubic_cci_timeout (void *cong_ctl)
+{
+    lsquic_cubic_timeout(cong_ctl);
+}
+
+
+static void
+cubic_cci_undo (void *cong_ctl)
+{
+    lsquic_cubic_undo(cong_ctl);
+}
+
+
+static void
+cubic_cci_was_quiet (void *cong_ctl, lsquic_time_t now,
+                                                    unsigned long in_flight)
+{
+    lsquic_cubic_was_quiet(cong_ctl, now);
+}
+
+
+static unsigned long
+cubic_cci_get_cwnd (void *cong_ctl)
+{
+    return lsquic_cubic_get_cwnd((struct lsquic_cubic *) cong_ctl);
+}
+
+
+static unsigned long
+cubic_cci_get_ssthresh (void *cong_ctl)
+{
+    return lsquic_cubic_get_ssthresh((struct lsquic_cubic *) cong_ctl);
+}
+
+
+static int
+cubic_cci_in_slow_start (void *cong_ctl)
+{
+    return lsquic_cubic_in_slow_start((struct lsquic_cubic *) cong_ctl);
+}
+
+
+/* Pace at twice the current bandwidth estimate in slow start, at the
+ * estimate itself in recovery, and at 1.25 times the estimate otherwise.
+ */
+static uint64_t
+cubic_cci_pacing_rate (void *cong_ctl, int in_recovery)
+{
+    struct lsquic_cubic *const cubic = cong_ctl;
+    uint64_t bandwidth;
+    lsquic_time_t srtt;
+
+    srtt = cubic->cu_rtt_stats ? lsquic_rtt_stats_get_srtt(cubic->cu_rtt_stats)
+                               : 0;
+    if (srtt == 0)
+        srtt = 50000;
+    bandwidth = (uint64_t) cubic->cu_cwnd * 1000000 / srtt;
+    if (lsquic_cubic_in_slow_start(cubic))
+        return bandwidth * 2;
+    else if (in_recovery)
+        return bandwidth;
+    else
+        return bandwidth + bandwidth / 4;
+}
+
+
+const struct cong_ctl_if lsquic_cong_cubic_if =
+{
+    .cci_ack           = cubic_cci_ack,
+    .cci_get_cwnd      = cubic_cci_get_cwnd,
+    .cci_get_ssthresh  = cubic_cci_get_ssthresh,
+    .cci_in_slow_start = cubic_cci_in_slow_start,
+    .cci_init          = cubic_cci_init,
+    .cci_loss          = cubic_cci_loss,
+    .cci_pacing_rate   = cubic_cci_pacing_rate,
+    .cci_rtt_sample    = cubic_cci_rtt_sample,
+    .cci_sent          = cubic_cci_sent,
+    .cci_timeout       = cubic_cci_timeout,
+    .cci_undo          = cubic_cci_undo,
+    .cci_was_quiet     = cubic_cci_was_quiet,
+};
@@ -15,12 +15,29 @@ struct lsquic_cubic {
     unsigned long   cu_cwnd;
     unsigned long   cu_tcp_cwnd;
     unsigned long   cu_ssthresh;
+    /* HyStart++ state.  Zero RTT means no sample. */
+    lsquic_time_t   cu_round_min_rtt;
+    lsquic_time_t   cu_last_round_min_rtt;
+    lsquic_time_t   cu_css_baseline_min_rtt;   /* Non-zero in CSS */
+    lsquic_packno_t cu_round_end;
+    lsquic_packno_t cu_last_sent_packno;
+    unsigned        cu_n_rtt_samples;
+    unsigned        cu_css_rounds;
     lsquic_cid_t    cu_cid;            /* Used for logging */
+    const struct lsquic_rtt_stats
+                   *cu_rtt_stats;      /* Used for pacing; may be NULL */
     enum cubic_flags {
         CU_TCP_FRIENDLY = (1 << 0),
+        CU_HYSTART      = (1 << 1),     /* Use HyStart++ to exit slow start */
     }               cu_flags;
     unsigned        cu_sampling_rate;
     lsquic_time_t   cu_last_logged;
+    /* State before the last loss or timeout; zero cwnd means nothing
+     * to undo.  These are not touched by reset.
+     */
+    unsigned long   cu_undo_cwnd;
+    unsigned long   cu_undo_ssthresh;
+    unsigned long   cu_undo_last_max_cwnd;
 };
 
 #define DEFAULT_CUBIC_FLAGS (CU_TCP_FRIENDLY)
@@ -43,12 +60,36 @@ lsquic_cubic_loss (struct lsquic_cubic *cubic);
 void
 lsquic_cubic_timeout (struct lsquic_cubic *cubic);
 
+/* The last loss or timeout turned out to be spurious: restore congestion
+ * window and slow start threshold to what they were before it.
+ */
+void
+lsquic_cubic_undo (struct lsquic_cubic *cubic);
+
 void
 lsquic_cubic_was_quiet (struct lsquic_cubic *, lsquic_time_t now);
 
+/* HyStart++: `packno' is the packet number of the newest packet sent. */
+void
+lsquic_cubic_sent (struct lsquic_cubic *, lsquic_packno_t packno);
+
+/* HyStart++: a round trip ends when a packet sent after the previous
+ * round started is acknowledged.
+ */
+void
+lsquic_cubic_acked (struct lsquic_cubic *, lsquic_packno_t packno);
+
+/* HyStart++: RTT sample, taken once per ACK. */
+void
+lsquic_cubic_rtt_sample (struct lsquic_cubic *, lsquic_time_t rtt);
+
 #define lsquic_cubic_get_cwnd(c) (+(c)->cu_cwnd)
 
+#define lsquic_cubic_get_ssthresh(c) (+(c)->cu_ssthresh)
+
 #define lsquic_cubic_in_slow_start(cubic) \
                         ((cubic)->cu_cwnd < (cubic)->cu_ssthresh)
 
+extern const struct cong_ctl_if lsquic_cong_cubic_if;
+
 #endif
@@ -78,6 +78,9 @@ enum ins_frame
 data_in_hash_insert_data_frame (struct data_in *data_in,
                 const struct data_frame *data_frame, uint64_t read_offset);
 
+struct data_in *
+data_in_ring_new (struct lsquic_conn_public *, uint32_t stream_id);
+
 struct data_in *
 data_in_error_new ();
 
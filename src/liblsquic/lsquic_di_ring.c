@@ -0,0 +1,454 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_di_ring.c -- Copy incoming data into a ring buffer
+ *
+ * Stream data is copied into a single buffer that covers stream offsets
+ * starting at the read offset.  Byte at offset `off' lives at position
+ * `off & (capacity - 1)'.  Which parts of the buffer hold data is tracked
+ * using a sorted array of disjoint [start, end) ranges: binary search finds
+ * the place for a new frame no matter how much out of order it arrives, and
+ * the number of ranges is the number of holes plus one, which is small.
+ *
+ * The buffer grows -- in powers of two -- to cover the offset furthest
+ * from the read offset.  Because stream flow control is checked before
+ * the frame is inserted, the buffer is never larger than the stream's
+ * flow control window rounded up to a power of two.  This is more memory
+ * than the hash implementation uses when there are only a few bytes at
+ * the edge of a large window; in return, there is no allocation per block
+ * and readable data is contiguous up to the wrap point.
+ *
+ * Like the hash implementation, this one does not check for frame overlap.
+ * It never asks to switch implementations.
+ */
+
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+
+#include "lsquic.h"
+#include "lsquic_int_types.h"
+#include "lsquic_types.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_rtt.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_stream.h"
+#include "lsquic_mm.h"
+#include "lsquic_malo.h"
+#include "lsquic_conn.h"
+#include "lsquic_conn_public.h"
+#include "lsquic_data_in_if.h"
+
+
+#define LSQUIC_LOGGER_MODULE LSQLM_DI
+#define LSQUIC_LOG_CONN_ID rdi->rdi_conn_pub->lconn->cn_cid
+#define LSQUIC_LOG_STREAM_ID rdi->rdi_stream_id
+#include "lsquic_logger.h"
+
+
+/* Buffer is allocated when first data arrives */
+#define RDI_MIN_CAP     (16 * 1024)
+
+/* This is a sanity check: flow control limits buffer size well below it */
+#define RDI_MAX_CAP     (1U << 30)
+
+/* data_frame's df_size is 16 bits wide */
+#define RDI_MAX_READ    UINT16_MAX
+
+
+static const struct data_in_iface *di_if_ring_ptr;
+
+
+struct rdi_range
+{
+    uint64_t    start,
+                end;    /* One past last byte */
+};
+
+
+struct ring_data_in
+{
+    struct data_in              rdi_data_in;
+    struct lsquic_conn_public  *rdi_conn_pub;
+    unsigned char              *rdi_buf;
+    size_t                      rdi_cap;        /* Zero or power of two */
+    struct rdi_range           *rdi_ranges;     /* Sorted, disjoint */
+    unsigned                    rdi_n_ranges;
+    unsigned                    rdi_n_alloc;
+    uint64_t                    rdi_fin_off;
+    struct data_frame           rdi_data_frame;
+    uint32_t                    rdi_stream_id;
+    enum {
+            RDI_FIN = (1 << 0),
+    }                           rdi_flags;
+};
+
+
+#define RDI_PTR(data_in) (struct ring_data_in *) \
+    ((unsigned char *) (data_in) - offsetof(struct ring_data_in, rdi_data_in))
+
+
+struct data_in *
+data_in_ring_new (struct lsquic_conn_public *conn_pub, uint32_t stream_id)
+{
+    struct ring_data_in *rdi;
+
+    rdi = calloc(1, sizeof(*rdi));
+    if (!rdi)
+        return NULL;
+
+    rdi->rdi_data_in.di_if    = di_if_ring_ptr;
+    rdi->rdi_data_in.di_flags = 0;
+    rdi->rdi_conn_pub         = conn_pub;
+    rdi->rdi_stream_id        = stream_id;
+
+    return &rdi->rdi_data_in;
+}
+
+
+static void
+ring_di_destroy (struct data_in *data_in)
+{
+    struct ring_data_in *const rdi = RDI_PTR(data_in);
+
+    free(rdi->rdi_buf);
+    free(rdi->rdi_ranges);
+    free(rdi);
+}
+
+
+/* Copy `size' bytes at stream offset `off' into the buffer */
+static void
+ring_write (unsigned char *buf, size_t cap, uint64_t off,
+                                const unsigned char *data, size_t size)
+{
+    size_t pos, n;
+
+    pos = off & (cap - 1);
+    n = cap - pos;
+    if (n > size)
+        n = size;
+    memcpy(buf + pos, data, n);
+    if (n < size)
+        memcpy(buf, data + n, size - n);
+}
+
+
+/* Drop ranges -- or parts of ranges -- that have already been read */
+static void
+ring_trim (struct ring_data_in *rdi, uint64_t read_offset)
+{
+    unsigned n;
+
+    for (n = 0; n < rdi->rdi_n_ranges
+                        && rdi->rdi_ranges[n].end <= read_offset; ++n)
+        ;
+    if (n > 0)
+    {
+        rdi->rdi_n_ranges -= n;
+        memmove(rdi->rdi_ranges, rdi->rdi_ranges + n,
+                            sizeof(rdi->rdi_ranges[0]) * rdi->rdi_n_ranges);
+    }
+    if (rdi->rdi_n_ranges > 0 && rdi->rdi_ranges[0].start < read_offset)
+        rdi->rdi_ranges[0].start = read_offset;
+}
+
+
+/* Make the buffer large enough to hold offsets up to `end'.  All ranges
+ * must be at or after `read_offset'.
+ */
+static int
+ring_grow (struct ring_data_in *rdi, uint64_t read_offset, uint64_t end)
+{
+    const struct rdi_range *range;
+    unsigned char *new_buf;
+    size_t new_cap, pos, n;
+    uint64_t off;
+
+    if (end - read_offset > RDI_MAX_CAP)
+    {
+        LSQ_INFO("cannot buffer %"PRIu64" bytes", end - read_offset);
+        return -1;
+    }
+
+    new_cap = rdi->rdi_cap ? rdi->rdi_cap : RDI_MIN_CAP;
+    while (new_cap < end - read_offset)
+        new_cap <<= 1;
+
+    new_buf = malloc(new_cap);
+    if (!new_buf)
+    {
+        LSQ_WARN("cannot allocate %zu bytes", new_cap);
+        return -1;
+    }
+
+    for (range = rdi->rdi_ranges; range < rdi->rdi_ranges
+                                            + rdi->rdi_n_ranges; ++range)
+        for (off = range->start; off < range->end; off += n)
+        {
+            pos = off & (rdi->rdi_cap - 1);
+            n = rdi->rdi_cap - pos;
+            if (n > range->end - off)
+                n = range->end - off;
+            ring_write(new_buf, new_cap, off, rdi->rdi_buf + pos, n);
+        }
+
+    LSQ_DEBUG("grew buffer from %zu to %zu bytes", rdi->rdi_cap, new_cap);
+    free(rdi->rdi_buf);
+    rdi->rdi_buf = new_buf;
+    rdi->rdi_cap = new_cap;
+    return 0;
+}
+
+
+/* Return index of the first range that ends at or after `off' */
+static unsigned
+ring_find (const struct ring_data_in *rdi, uint64_t off)
+{
+    unsigned low, high, mid;
+
+    low = 0;
+    high = rdi->rdi_n_ranges;
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (rdi->rdi_ranges[mid].end < off)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+
+/* Add [start, end) to the range set, merging it with ranges it overlaps
+ * or touches.
+ */
+static int
+ring_add_range (struct ring_data_in *rdi, uint64_t start, uint64_t end)
+{
+    struct rdi_range *new_ranges;
+    unsigned first, last, n_alloc;
+
+    first = ring_find(rdi, start);
+    for (last = first; last < rdi->rdi_n_ranges
+                                && rdi->rdi_ranges[last].start <= end; ++last)
+        ;
+
+    if (first < last)
+    {
+        /* Ranges [first, last) are merged into `first' */
+        if (rdi->rdi_ranges[first].start < start)
+            start = rdi->rdi_ranges[first].start;
+        if (rdi->rdi_ranges[last - 1].end > end)
+            end = rdi->rdi_ranges[last - 1].end;
+        if (last > first + 1)
+        {
+            memmove(rdi->rdi_ranges + first + 1, rdi->rdi_ranges + last,
+                sizeof(rdi->rdi_ranges[0]) * (rdi->rdi_n_ranges - last));
+            rdi->rdi_n_ranges -= last - first - 1;
+        }
+    }
+    else
+    {
+        if (rdi->rdi_n_ranges >= rdi->rdi_n_alloc)
+        {
+            n_alloc = rdi->rdi_n_alloc ? rdi->rdi_n_alloc * 2 : 4;
+            new_ranges = realloc(rdi->rdi_ranges,
+                                        sizeof(new_ranges[0]) * n_alloc);
+            if (!new_ranges)
+            {
+                LSQ_WARN("cannot allocate %u ranges", n_alloc);
+                return -1;
+            }
+            rdi->rdi_ranges  = new_ranges;
+            rdi->rdi_n_alloc = n_alloc;
+        }
+        memmove(rdi->rdi_ranges + first + 1, rdi->rdi_ranges + first,
+                sizeof(rdi->rdi_ranges[0]) * (rdi->rdi_n_ranges - first));
+        ++rdi->rdi_n_ranges;
+    }
+
+    rdi->rdi_ranges[first].start = start;
+    rdi->rdi_ranges[first].end   = end;
+    return 0;
+}
+
+
+static enum ins_frame
+ring_insert_data_frame (struct ring_data_in *rdi,
+                const struct data_frame *data_frame, uint64_t read_offset)
+{
+    const unsigned char *data;
+    uint64_t off, end;
+    unsigned idx;
+
+    end = data_frame->df_offset + data_frame->df_size;
+    if (end < read_offset)
+        return INS_FRAME_DUP;
+
+    if ((rdi->rdi_flags & RDI_FIN) &&
+         (
+          (data_frame->df_fin && end != rdi->rdi_fin_off)
+          ||
+          end > rdi->rdi_fin_off
+         )
+       )
+    {
+        return INS_FRAME_ERR;
+    }
+
+    ring_trim(rdi, read_offset);
+
+    if (data_frame->df_fin && rdi->rdi_n_ranges > 0
+                    && rdi->rdi_ranges[rdi->rdi_n_ranges - 1].end > end)
+        return INS_FRAME_ERR;
+
+    if (data_frame->df_offset < read_offset)
+    {
+        off  = read_offset;
+        data = data_frame->df_data + (read_offset - data_frame->df_offset);
+    }
+    else
+    {
+        off  = data_frame->df_offset;
+        data = data_frame->df_data;
+    }
+
+    if (off < end)
+    {
+        idx = ring_find(rdi, off);
+        if (idx < rdi->rdi_n_ranges && rdi->rdi_ranges[idx].start <= off
+                                    && rdi->rdi_ranges[idx].end >= end
+                                    && !(data_frame->df_fin
+                                            && !(rdi->rdi_flags & RDI_FIN)))
+            return INS_FRAME_DUP;
+
+        if (end - read_offset > rdi->rdi_cap
+                                && 0 != ring_grow(rdi, read_offset, end))
+            return INS_FRAME_ERR;
+
+        ring_write(rdi->rdi_buf, rdi->rdi_cap, off, data, end - off);
+        if (0 != ring_add_range(rdi, off, end))
+            return INS_FRAME_ERR;
+    }
+
+    if (data_frame->df_fin)
+    {
+        rdi->rdi_flags  |= RDI_FIN;
+        rdi->rdi_fin_off = end;
+    }
+
+    return INS_FRAME_OK;
+}
+
+
+static enum ins_frame
+ring_di_insert_frame (struct data_in *data_in,
+                        struct stream_frame *new_frame, uint64_t read_offset)
+{
+    struct ring_data_in *const rdi = RDI_PTR(data_in);
+    enum ins_frame ins;
+
+    ins = ring_insert_data_frame(rdi, &new_frame->data_frame, read_offset);
+    lsquic_packet_in_put(rdi->rdi_conn_pub->mm, new_frame->packet_in);
+    lsquic_malo_put(new_frame);
+    return ins;
+}
+
+
+/* Readable data starts at `read_offset' and continues to the end of the
+ * first range or to the end of the buffer, whichever comes first.
+ */
+static struct data_frame *
+ring_di_get_frame (struct data_in *data_in, uint64_t read_offset)
+{
+    struct ring_data_in *const rdi = RDI_PTR(data_in);
+    const struct rdi_range *range;
+    size_t pos, size;
+
+    range = rdi->rdi_ranges;
+    if (rdi->rdi_n_ranges > 0 && range->start <= read_offset
+                                                && read_offset < range->end)
+    {
+        pos = read_offset & (rdi->rdi_cap - 1);
+        size = rdi->rdi_cap - pos;
+        if (size > range->end - read_offset)
+            size = range->end - read_offset;
+        if (size > RDI_MAX_READ)
+            size = RDI_MAX_READ;
+        rdi->rdi_data_frame.df_data     = rdi->rdi_buf + pos;
+        rdi->rdi_data_frame.df_offset   = read_offset;
+        rdi->rdi_data_frame.df_read_off = 0;
+        rdi->rdi_data_frame.df_size     = size;
+        rdi->rdi_data_frame.df_fin      = (rdi->rdi_flags & RDI_FIN) &&
+                                    read_offset + size == rdi->rdi_fin_off;
+        return &rdi->rdi_data_frame;
+    }
+    else if ((rdi->rdi_flags & RDI_FIN) && read_offset == rdi->rdi_fin_off)
+    {
+        rdi->rdi_data_frame.df_data     = NULL;
+        rdi->rdi_data_frame.df_offset   = read_offset;
+        rdi->rdi_data_frame.df_read_off = 0;
+        rdi->rdi_data_frame.df_size     = 0;
+        rdi->rdi_data_frame.df_fin      = 1;
+        return &rdi->rdi_data_frame;
+    }
+    else
+        return NULL;
+}
+
+
+static void
+ring_di_frame_done (struct data_in *data_in, struct data_frame *data_frame)
+{
+    struct ring_data_in *const rdi = RDI_PTR(data_in);
+
+    ring_trim(rdi, data_frame->df_offset + data_frame->df_read_off);
+}
+
+
+static int
+ring_di_empty (struct data_in *data_in)
+{
+    struct ring_data_in *const rdi = RDI_PTR(data_in);
+    return rdi->rdi_n_ranges == 0;
+}
+
+
+static struct data_in *
+ring_di_switch_impl (struct data_in *data_in, uint64_t read_offset)
+{
+    assert(0);  /* DI_SWITCH_IMPL is never set */
+    return data_in;
+}
+
+
+static size_t
+ring_di_mem_used (struct data_in *data_in)
+{
+    struct ring_data_in *const rdi = RDI_PTR(data_in);
+
+    return sizeof(*rdi) + rdi->rdi_cap
+                        + rdi->rdi_n_alloc * sizeof(rdi->rdi_ranges[0]);
+}
+
+
+static const struct data_in_iface di_if_ring = {
+    .di_destroy      = ring_di_destroy,
+    .di_empty        = ring_di_empty,
+    .di_frame_done   = ring_di_frame_done,
+    .di_get_frame    = ring_di_get_frame,
+    .di_insert_frame = ring_di_insert_frame,
+    .di_mem_used     = ring_di_mem_used,
+    .di_switch_impl  = ring_di_switch_impl,
+};
+
+static const struct data_in_iface *di_if_ring_ptr = &di_if_ring;
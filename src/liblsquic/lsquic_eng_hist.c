@@ -5,6 +5,7 @@
 #define localtime_r(a,b) localtime_s(b,a)
 #endif
 
+#include "lsquic.h"
 #include "lsquic_eng_hist.h"
 
 #if ENG_HIST_ENABLED
@@ -20,8 +21,7 @@ log_hist_slice (const struct hist_slice *slice, time_t t)
                                   const struct tm *tm);
     if (slice->sl_packets_in == 0 &&
         slice->sl_packets_out == 0 &&
-        slice->sl_del_mini_conns == 0 &&
-        slice->sl_del_full_conns == 0)
+        slice->sl_conns_destroyed == 0)
         return;
     
     struct tm tm;
@@ -30,14 +30,14 @@ log_hist_slice (const struct hist_slice *slice, time_t t)
     localtime_r(&t, &tm);
     strftime(timestr, sizeof(timestr), "%T", &tm);
 
-    LSQ_DEBUG("%s: pi: %u; po: %u; +mc: %u; -mc: %u; +fc: %u; -fc: %u",
+    LSQ_DEBUG("%s: pi: %u; po: %u; drop: %u; dup: %u; +fc: %u; -fc: %u",
         timestr,
         slice->sl_packets_in,
         slice->sl_packets_out,
-        slice->sl_new_mini_conns,
-        slice->sl_del_mini_conns,
-        slice->sl_new_full_conns,
-        slice->sl_del_full_conns);
+        slice->sl_packets_dropped,
+        slice->sl_packets_dup,
+        slice->sl_conns_created,
+        slice->sl_conns_destroyed);
 }
 
 
@@ -3,6 +3,9 @@
  * lsquic_eng_hist.h - Engine history.
  *
  * Keep track of new and destroyed connections, packets in and packets out.
+ * Besides the per-second history, which is logged, running totals are kept
+ * for lsquic_engine_get_stats().  The totals are kept even if history is
+ * disabled.
  */
 
 #ifndef LSQUIC_ENG_HIST
@@ -21,15 +24,22 @@
 #endif
 
 
-/* Keeps history per slice of time -- one second */
+/* Keeps history per slice of time -- one second.  Each member corresponds
+ * to a member of struct lsquic_engine_counters.
+ */
 struct hist_slice
 {
     unsigned    sl_packets_in,
+                sl_bytes_in,
                 sl_packets_out,
-                sl_new_full_conns,
-                sl_new_mini_conns,
-                sl_del_full_conns,
-                sl_del_mini_conns;
+                sl_bytes_out,
+                sl_batches_sent,
+                sl_short_writes,
+                sl_encrypt_failures,
+                sl_packets_dropped,
+                sl_packets_dup,
+                sl_conns_created,
+                sl_conns_destroyed;
 };
 
 
@@ -38,6 +48,8 @@ struct eng_hist
     struct hist_slice   eh_slices[ENG_HIST_NELEMS];
     unsigned            eh_cur_idx,
                         eh_prev_idx;
+    struct lsquic_engine_counters
+                        eh_total;
 };
 
 
@@ -80,15 +92,25 @@ eng_hist_log (const struct eng_hist *);
 /* Increment element `what'.  Slice increment is handled in this macro, too. */
 #define eng_hist_inc(eh, now, what) do {                                    \
     eng_hist_tick(eh, now);                                                 \
-    ++(eh)->eh_slices[(eh)->eh_cur_idx].what;                               \
+    ++(eh)->eh_slices[(eh)->eh_cur_idx].sl_##what;                          \
+    ++(eh)->eh_total.what;                                                  \
+} while (0)
+
+
+/* Add `n' to element `what'. */
+#define eng_hist_add(eh, now, what, n) do {                                 \
+    eng_hist_tick(eh, now);                                                 \
+    (eh)->eh_slices[(eh)->eh_cur_idx].sl_##what += (n);                     \
+    (eh)->eh_total.what += (n);                                             \
 } while (0)
 
 #else /* !ENG_HIST_ENABLED */
 
-#define eng_hist_init(eh)
+#define eng_hist_init(eh) memset(eh, 0, sizeof(*(eh)))
 #define eng_hist_clear_cur(eh)
 #define eng_hist_tick(eh, now)
-#define eng_hist_inc(eh, now, what)
+#define eng_hist_inc(eh, now, what) (++(eh)->eh_total.what)
+#define eng_hist_add(eh, now, what, n) ((eh)->eh_total.what += (n))
 #define eng_hist_log(eh)
 
 #endif  /* ENG_HIST_ENABLED */
@@ -31,8 +31,13 @@
 #include "lsquic_packet_in.h"
 #include "lsquic_packet_out.h"
 #include "lsquic_senhist.h"
+#include "lsquic_sentwin.h"
 #include "lsquic_rtt.h"
 #include "lsquic_cubic.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_prr.h"
 #include "lsquic_pacer.h"
 #include "lsquic_send_ctl.h"
 #include "lsquic_set.h"
@@ -63,6 +68,14 @@
 #define MIN_OUT_BATCH_SIZE 256
 #define INITIAL_OUT_BATCH_SIZE 512
 
+/* Consecutive packets from the same connection are grouped into runs that
+ * can be handed to the kernel as a single UDP GSO super-buffer.  These
+ * limits match those of Linux: UDP_MAX_SEGMENTS and the maximum UDP payload
+ * in an IPv4 datagram.
+ */
+#define MAX_OUT_RUN_SEGS 64
+#define MAX_OUT_RUN_BYTES (0xFFFF - 20 - 8)
+
 struct out_batch
 {
     lsquic_conn_t           *conns  [MAX_OUT_BATCH_SIZE];
@@ -194,6 +207,9 @@ struct lsquic_engine
         }           one;
     }                                  iter_state;
     struct eng_hist                    history;
+    /* Totals as of the previous call to lsquic_engine_get_stats() */
+    struct lsquic_engine_counters      stats_prev;
+    lsquic_time_t                      stats_time;
     unsigned                           batch_size;
     unsigned                           time_until_desired_tick;
     struct attq                       *attq;
@@ -340,6 +356,14 @@ lsquic_engine_init_settings (struct lsquic_engine_settings *settings,
     settings->es_rw_once         = LSQUIC_DF_RW_ONCE;
     settings->es_proc_time_thresh= LSQUIC_DF_PROC_TIME_THRESH;
     settings->es_pace_packets    = LSQUIC_DF_PACE_PACKETS;
+    settings->es_cc_algo         = LSQUIC_DF_CC_ALGO;
+    settings->es_hystart         = LSQUIC_DF_HYSTART;
+    settings->es_prr             = LSQUIC_DF_PRR;
+    settings->es_txtime          = LSQUIC_DF_TXTIME;
+    settings->es_ack_decim       = LSQUIC_DF_ACK_DECIM;
+    settings->es_ack_decim_start = LSQUIC_DF_ACK_DECIM_START;
+    settings->es_fc_mem_budget   = LSQUIC_DF_FC_MEM_BUDGET;
+    settings->es_use_di_ring     = LSQUIC_DF_USE_DI_RING;
 }
 
 
@@ -371,6 +395,14 @@ lsquic_engine_check_settings (const struct lsquic_engine_settings *settings,
                         "one or more unsupported QUIC version is specified");
         return -1;
     }
+    if (settings->es_cc_algo < 1 || settings->es_cc_algo > 2)
+    {
+        if (err_buf)
+            snprintf(err_buf, err_buf_sz, "invalid congestion control "
+                "algorithm %u: must be 1 (Cubic) or 2 (BBR)",
+                settings->es_cc_algo);
+        return -1;
+    }
     return 0;
 }
 
@@ -439,6 +471,14 @@ lsquic_engine_new (unsigned flags,
         return NULL;
     }
     engine->pub.enp_ver_tags_len = tag_buf_len;
+    engine->pub.enp_enc_cache = lsquic_enc_session_gquic_1.esf_cache_new();
+    if (!engine->pub.enp_enc_cache)
+    {
+        LSQ_ERROR("cannot create handshake cache");
+        lsquic_mm_cleanup(&engine->pub.enp_mm);
+        free(engine);
+        return NULL;
+    }
 
     engine->flags           = flags;
     engine->stream_if       = api->ea_stream_if;
@@ -456,11 +496,14 @@ lsquic_engine_new (unsigned flags,
         engine->pub.enp_pmi_ctx  = NULL;
     }
     engine->pub.enp_engine = engine;
+    engine->pub.enp_generate_cid     = api->ea_generate_cid;
+    engine->pub.enp_generate_cid_ctx = api->ea_generate_cid_ctx;
     TAILQ_INIT(&engine->conns_in);
     TAILQ_INIT(&engine->conns_pend_rw);
     conn_hash_init(&engine->full_conns, ~0);
     engine->attq = attq_create();
     eng_hist_init(&engine->history);
+    engine->stats_time = lsquic_time_now();
     engine->batch_size = INITIAL_OUT_BATCH_SIZE;
 
 
@@ -518,6 +561,7 @@ new_full_conn_client (lsquic_engine_t *engine, const char *hostname,
                                  callbacks */
                              )));
     conn->cn_flags |= LSCONN_HASHED;
+    eng_hist_inc(&engine->history, 0, conns_created);
     return conn;
 }
 
@@ -663,6 +707,25 @@ update_pend_rw_progress (lsquic_engine_t *engine, lsquic_conn_t *conn,
 }
 
 
+static void
+deliver_packet_in (lsquic_engine_t *engine, lsquic_conn_t *conn,
+       lsquic_packet_in_t *packet_in, const struct sockaddr *sa_local,
+       const struct sockaddr *sa_peer, void *peer_ctx)
+{
+    if (0 == (conn->cn_flags & LSCONN_HAS_INCOMING)) {
+        TAILQ_INSERT_TAIL(&engine->conns_in, conn, cn_next_in);
+        engine_incref_conn(conn, LSCONN_HAS_INCOMING);
+    }
+    lsquic_conn_record_sockaddr(conn, sa_local, sa_peer);
+    lsquic_packet_in_upref(packet_in);
+    conn->cn_peer_ctx = peer_ctx;
+    conn->cn_if->ci_packet_in(conn, packet_in);
+    if (packet_in->pi_flags & PI_DUP)
+        eng_hist_inc(&engine->history, packet_in->pi_received, packets_dup);
+    lsquic_packet_in_put(&engine->pub.enp_mm, packet_in);
+}
+
+
 /* Return 0 if packet is being processed by a connections, otherwise return 1 */
 static int
 process_packet_in (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
@@ -674,19 +737,13 @@ process_packet_in (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
     conn = find_or_create_conn(engine, packet_in, ppstate, sa_peer, peer_ctx);
     if (!conn)
     {
+        eng_hist_inc(&engine->history, packet_in->pi_received,
+                                                        packets_dropped);
         lsquic_mm_put_packet_in(&engine->pub.enp_mm, packet_in);
         return 1;
     }
 
-    if (0 == (conn->cn_flags & LSCONN_HAS_INCOMING)) {
-        TAILQ_INSERT_TAIL(&engine->conns_in, conn, cn_next_in);
-        engine_incref_conn(conn, LSCONN_HAS_INCOMING);
-    }
-    lsquic_conn_record_sockaddr(conn, sa_local, sa_peer);
-    lsquic_packet_in_upref(packet_in);
-    conn->cn_peer_ctx = peer_ctx;
-    conn->cn_if->ci_packet_in(conn, packet_in);
-    lsquic_packet_in_put(&engine->pub.enp_mm, packet_in);
+    deliver_packet_in(engine, conn, packet_in, sa_local, sa_peer, peer_ctx);
     return 0;
 }
 
@@ -815,6 +872,7 @@ lsquic_engine_destroy (lsquic_engine_t *engine)
 
 
     attq_destroy(engine->attq);
+    lsquic_enc_session_gquic_1.esf_cache_destroy(engine->pub.enp_enc_cache);
 
     assert(0 == engine->conns_out.oh_nelem);
     assert(TAILQ_EMPTY(&engine->conns_pend_rw));
@@ -957,7 +1015,7 @@ engine_decref_conn (lsquic_engine_t *engine, lsquic_conn_t *conn,
                             (refflags2str(conn->cn_flags, str), str));
     if (0 == (conn->cn_flags & CONN_REF_FLAGS))
     {
-            eng_hist_inc(&engine->history, 0, sl_del_full_conns);
+            eng_hist_inc(&engine->history, 0, conns_destroyed);
         destroy_conn(engine, conn);
         return NULL;
     }
@@ -1279,17 +1337,63 @@ coi_reheap (struct conns_out_iter *iter, lsquic_engine_t *engine)
 }
 
 
+/* Walk the batch backwards and set `n_segs' of each element to the number
+ * of packets, starting with this one, that belong to the same run.  All
+ * packets in a run come from the same connection, have the same departure
+ * time and, except for the last one, have the same size.  The last packet
+ * may be smaller.
+ */
+static void
+group_batch_runs (struct out_batch *batch, unsigned n_to_send)
+{
+    struct lsquic_out_spec *out, *head;
+    int i;
+
+    if (0 == n_to_send)
+        return;
+
+    head = &batch->outs[n_to_send - 1];
+    head->n_segs = 1;
+    for (i = (int) n_to_send - 2; i >= 0; --i)
+    {
+        out = &batch->outs[i];
+        if (batch->conns[i] == batch->conns[i + 1]
+            && out->tx_time == head->tx_time
+            && out->sz >= head->sz
+            && (head->n_segs == 1 || out->sz == head->sz)
+            && head->n_segs < MAX_OUT_RUN_SEGS
+            && (head->n_segs + 1) * out->sz <= MAX_OUT_RUN_BYTES)
+            out->n_segs = head->n_segs + 1;
+        else
+            out->n_segs = 1;
+        head = out;
+    }
+}
+
+
 static unsigned
 send_batch (lsquic_engine_t *engine, struct conns_out_iter *conns_iter,
                   struct out_batch *batch, unsigned n_to_send)
 {
     int n_sent, i;
+    size_t bytes_sent;
     lsquic_time_t now;
 
-    /* Set sent time before the write to avoid underestimating RTT */
+    /* Set sent time before the write to avoid underestimating RTT.  If
+     * the packet is to leave later, that is when it is sent.  Departure
+     * times that have passed already are not reported.
+     */
     now = lsquic_time_now();
     for (i = 0; i < (int) n_to_send; ++i)
-        batch->packets[i]->po_sent = now;
+        if (batch->outs[i].tx_time > now)
+            batch->packets[i]->po_sent = batch->outs[i].tx_time;
+        else
+        {
+            batch->outs[i].tx_time = 0;
+            batch->packets[i]->po_sent = now;
+        }
+
+    group_batch_runs(batch, n_to_send);
     n_sent = engine->packets_out(engine->packets_out_ctx, batch->outs,
                                                                 n_to_send);
     if (n_sent >= 0)
@@ -1301,9 +1405,13 @@ send_batch (lsquic_engine_t *engine, struct conns_out_iter *conns_iter,
     }
     if (n_sent > 0)
         engine->last_sent = now + n_sent;
+    eng_hist_inc(&engine->history, now, batches_sent);
+    if (n_sent < (int) n_to_send)
+        eng_hist_inc(&engine->history, now, short_writes);
+    bytes_sent = 0;
     for (i = 0; i < n_sent; ++i)
     {
-        eng_hist_inc(&engine->history, now, sl_packets_out);
+        bytes_sent += batch->outs[i].sz;
         EV_LOG_PACKET_SENT(batch->conns[i]->cn_cid, batch->packets[i]);
         batch->conns[i]->cn_if->ci_packet_sent(batch->conns[i],
                                                     batch->packets[i]);
@@ -1322,6 +1430,8 @@ send_batch (lsquic_engine_t *engine, struct conns_out_iter *conns_iter,
             batch->packets[i]->po_enc_data = NULL;  /* JIC */
         }
     }
+    eng_hist_add(&engine->history, now, packets_out, n_sent);
+    eng_hist_add(&engine->history, now, bytes_out, bytes_sent);
     if (LSQ_LOG_ENABLED_EXT(LSQ_LOG_DEBUG, LSQLM_EVENT))
         for ( ; i < (int) n_to_send; ++i)
             EV_LOG_PACKET_NOT_SENT(batch->conns[i]->cn_cid, batch->packets[i]);
@@ -1360,9 +1470,10 @@ static void
 send_packets_out (struct lsquic_engine *engine,
                   struct closed_conns *closed_conns)
 {
-    unsigned n, w, n_sent, n_batches_sent;
+    unsigned n, w, n_sent, n_batches_sent, run_len;
+    size_t run_sz;
     lsquic_packet_out_t *packet_out;
-    lsquic_conn_t *conn;
+    lsquic_conn_t *conn, *run_conn;
     struct out_batch *const batch = &engine->out_batch;
     struct conns_out_iter conns_iter;
     int shrink, deadline_exceeded;
@@ -1372,14 +1483,21 @@ send_packets_out (struct lsquic_engine *engine,
     n_sent = 0, n = 0;
     shrink = 0;
     deadline_exceeded = 0;
+    run_conn = NULL;
+    run_len = 0;
+    run_sz = 0;
 
-    while ((conn = coi_next(&conns_iter)))
+    /* While packets from a connection are of the same size, keep batching
+     * them back to back so that they form a run (see group_batch_runs()).
+     */
+    while ((conn = run_conn) || (conn = coi_next(&conns_iter)))
     {
         packet_out = conn->cn_if->ci_next_packet_to_send(conn);
         if (!packet_out) {
             LSQ_DEBUG("batched all outgoing packets for conn %"PRIu64,
                                                             conn->cn_cid);
             coi_deactivate(&conns_iter, conn);
+            run_conn = NULL;
             continue;
         }
         if (!(packet_out->po_flags & (PO_ENCRYPTED|PO_NOENCRYPT)))
@@ -1393,6 +1511,7 @@ send_packets_out (struct lsquic_engine *engine,
             case ENCPA_BADCRYPT:
                 /* This is pretty bad: close connection immediately */
                 conn->cn_if->ci_packet_not_sent(conn, packet_out);
+                eng_hist_inc(&engine->history, 0, encrypt_failures);
                 LSQ_INFO("conn %"PRIu64" has unsendable packets", conn->cn_cid);
                 if (!(conn->cn_flags & LSCONN_EVANESCENT))
                 {
@@ -1405,6 +1524,7 @@ send_packets_out (struct lsquic_engine *engine,
                     }
                     coi_remove(&conns_iter, conn);
                 }
+                run_conn = NULL;
                 continue;
             case ENCPA_OK:
                 break;
@@ -1426,12 +1546,24 @@ send_packets_out (struct lsquic_engine *engine,
         batch->outs   [n].peer_ctx = conn->cn_peer_ctx;
         batch->outs   [n].local_sa = (struct sockaddr *) conn->cn_local_addr;
         batch->outs   [n].dest_sa  = (struct sockaddr *) conn->cn_peer_addr;
+        batch->outs   [n].tx_time  = packet_out->po_tx_time;
         batch->conns  [n]          = conn;
         batch->packets[n]          = packet_out;
         ++n;
+        if (conn == run_conn && batch->outs[n - 1].sz == run_sz)
+            ++run_len;
+        else if (conn == run_conn)
+            run_len = MAX_OUT_RUN_SEGS;     /* Run is over: move on */
+        else
+        {
+            run_len = 1;
+            run_sz = batch->outs[n - 1].sz;
+        }
+        run_conn = run_len < MAX_OUT_RUN_SEGS ? conn : NULL;
         if (n == engine->batch_size)
         {
             n = 0;
+            run_conn = NULL;
             w = send_batch(engine, &conns_iter, batch, engine->batch_size);
             ++n_batches_sent;
             n_sent += w;
@@ -1552,16 +1684,13 @@ process_connections (lsquic_engine_t *engine, conn_iter_f next_conn)
 }
 
 
-/* Return 0 if packet is being processed by a real connection, 1 if the
- * packet was processed, but not by a connection, and -1 on error.
+/* Allocate incoming packet and parse the beginning of its header.  On
+ * failure, NULL is returned and errno is set.
  */
-int
-lsquic_engine_packet_in (lsquic_engine_t *engine,
-    const unsigned char *packet_in_data, size_t packet_in_size,
-    const struct sockaddr *sa_local, const struct sockaddr *sa_peer,
-    void *peer_ctx)
+static lsquic_packet_in_t *
+new_packet_in (lsquic_engine_t *engine, const unsigned char *packet_in_data,
+            size_t packet_in_size, struct packin_parse_state *ppstate)
 {
-    struct packin_parse_state ppstate;
     lsquic_packet_in_t *packet_in;
 
     if (packet_in_size > QUIC_MAX_PACKET_SZ)
@@ -1569,12 +1698,12 @@ lsquic_engine_packet_in (lsquic_engine_t *engine,
         LSQ_DEBUG("Cannot handle packet_in_size(%zd) > %d packet incoming "
             "packet's header", packet_in_size, QUIC_MAX_PACKET_SZ);
         errno = E2BIG;
-        return -1;
+        return NULL;
     }
 
     packet_in = lsquic_mm_get_packet_in(&engine->pub.enp_mm);
     if (!packet_in)
-        return -1;
+        return NULL;
 
     /* Library does not modify packet_in_data, it is not referenced after
      * this function returns and subsequent release of pi_data is guarded
@@ -1582,21 +1711,132 @@ lsquic_engine_packet_in (lsquic_engine_t *engine,
      */
     packet_in->pi_data = (unsigned char *) packet_in_data;
     if (0 != parse_packet_in_begin(packet_in, packet_in_size,
-                                        engine->flags & ENG_SERVER, &ppstate))
+                                        engine->flags & ENG_SERVER, ppstate))
     {
         LSQ_DEBUG("Cannot parse incoming packet's header");
         lsquic_mm_put_packet_in(&engine->pub.enp_mm, packet_in);
         errno = EINVAL;
+        return NULL;
+    }
+
+    return packet_in;
+}
+
+
+/* Return 0 if packet is being processed by a real connection, 1 if the
+ * packet was processed, but not by a connection, and -1 on error.
+ */
+int
+lsquic_engine_packet_in (lsquic_engine_t *engine,
+    const unsigned char *packet_in_data, size_t packet_in_size,
+    const struct sockaddr *sa_local, const struct sockaddr *sa_peer,
+    void *peer_ctx)
+{
+    struct packin_parse_state ppstate;
+    lsquic_packet_in_t *packet_in;
+
+    packet_in = new_packet_in(engine, packet_in_data, packet_in_size,
+                                                                &ppstate);
+    if (!packet_in)
+    {
+        eng_hist_inc(&engine->history, 0, packets_dropped);
         return -1;
     }
 
     packet_in->pi_received = lsquic_time_now();
-    eng_hist_inc(&engine->history, packet_in->pi_received, sl_packets_in);
+    eng_hist_inc(&engine->history, packet_in->pi_received, packets_in);
+    eng_hist_add(&engine->history, packet_in->pi_received, bytes_in,
+                                                            packet_in_size);
     return process_packet_in(engine, packet_in, &ppstate, sa_local, sa_peer,
                                                                     peer_ctx);
 }
 
 
+int
+lsquic_cid_from_packet (const unsigned char *packet_in_data,
+                        size_t packet_in_size, lsquic_cid_t *cid)
+{
+    /* All supported GQUIC versions place the connection ID right after the
+     * public flags.
+     */
+    if (packet_in_size < 1 + sizeof(*cid)
+            || !(packet_in_data[0] & PACKET_PUBLIC_FLAGS_8BYTE_CONNECTION_ID))
+        return -1;
+
+    memcpy(cid, packet_in_data + 1, sizeof(*cid));
+    return 0;
+}
+
+
+unsigned
+lsquic_engine_packets_in (lsquic_engine_t *engine,
+        const struct lsquic_in_spec *in_spec, unsigned n_packets_in)
+{
+    const struct lsquic_in_spec *spec;
+    const struct lsquic_in_spec *const end = in_spec + n_packets_in;
+    struct packin_parse_state ppstate;
+    lsquic_packet_in_t *packet_in;
+    lsquic_conn_t *conn, *last_conn;
+    lsquic_time_t now;
+    unsigned n_in, n_proc;
+    size_t bytes_in;
+
+    if (0 == n_packets_in)
+        return 0;
+
+    now = lsquic_time_now();
+    last_conn = NULL;
+    n_in = 0;
+    n_proc = 0;
+    bytes_in = 0;
+
+    for (spec = in_spec; spec < end; ++spec)
+    {
+        packet_in = new_packet_in(engine, spec->buf, spec->sz, &ppstate);
+        if (!packet_in)
+            continue;
+        packet_in->pi_received = now;
+        ++n_in;
+        bytes_in += spec->sz;
+
+        /* Packets usually arrive in runs belonging to the same connection.
+         * The connection cannot go away while it is on the incoming queue,
+         * so it is safe to reuse the result of the previous lookup.
+         */
+        if (last_conn && (packet_in->pi_flags & PI_CONN_ID)
+                && packet_in->pi_conn_id == last_conn->cn_cid
+                && !lsquic_packet_in_is_prst(packet_in))
+        {
+            conn = last_conn;
+            conn->cn_pf->pf_parse_packet_in_finish(packet_in, &ppstate);
+        }
+        else
+        {
+            conn = find_or_create_conn(engine, packet_in, &ppstate,
+                                            spec->peer_sa, spec->peer_ctx);
+            if (!conn)
+            {
+                lsquic_mm_put_packet_in(&engine->pub.enp_mm, packet_in);
+                continue;
+            }
+            last_conn = conn;
+        }
+
+        deliver_packet_in(engine, conn, packet_in, spec->local_sa,
+                                            spec->peer_sa, spec->peer_ctx);
+        ++n_proc;
+    }
+
+    eng_hist_add(&engine->history, now, packets_in, n_in);
+    eng_hist_add(&engine->history, now, bytes_in, bytes_in);
+    eng_hist_add(&engine->history, now, packets_dropped,
+                                                    n_packets_in - n_proc);
+    LSQ_DEBUG("batch of %u incoming packets: %u processed by connections",
+                                                    n_packets_in, n_proc);
+    return n_proc;
+}
+
+
 #if __GNUC__ && !defined(NDEBUG)
 __attribute__((weak))
 #endif
@@ -1636,3 +1876,39 @@ lsquic_engine_count_attq (lsquic_engine_t *engine, int from_now)
 }
 
 
+void
+lsquic_engine_get_stats (lsquic_engine_t *engine,
+                                        struct lsquic_engine_stats *stats)
+{
+    const struct lsquic_engine_counters *const total =
+                                                &engine->history.eh_total;
+    const struct lsquic_engine_counters *const prev = &engine->stats_prev;
+    const lsquic_conn_t *conn;
+    lsquic_time_t now;
+
+    now = lsquic_time_now();
+    stats->total = *total;
+#define INTERVAL(what) stats->interval.what = total->what - prev->what
+    INTERVAL(packets_in);
+    INTERVAL(bytes_in);
+    INTERVAL(packets_out);
+    INTERVAL(bytes_out);
+    INTERVAL(batches_sent);
+    INTERVAL(short_writes);
+    INTERVAL(encrypt_failures);
+    INTERVAL(packets_dropped);
+    INTERVAL(packets_dup);
+    INTERVAL(conns_created);
+    INTERVAL(conns_destroyed);
+#undef INTERVAL
+    stats->interval_usec = now - engine->stats_time;
+    engine->stats_prev = *total;
+    engine->stats_time = now;
+
+    stats->n_conns = conn_hash_count(&engine->full_conns);
+    stats->attq_size = attq_count(engine->attq);
+    stats->pend_rw_count = 0;
+    TAILQ_FOREACH(conn, &engine->conns_pend_rw, cn_next_pend_rw)
+        ++stats->pend_rw_count;
+    stats->fc_windows = engine->pub.enp_fcw_total;
+}
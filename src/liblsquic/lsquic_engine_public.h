@@ -9,6 +9,7 @@
 
 struct lsquic_conn;
 struct lsquic_engine;
+struct enc_sess_cache;
 
 struct lsquic_engine_public {
     struct lsquic_mm                enp_mm;
@@ -17,6 +18,9 @@ struct lsquic_engine_public {
                                    *enp_pmi;
     void                           *enp_pmi_ctx;
     struct lsquic_engine           *enp_engine;
+    lsquic_cid_t                  (*enp_generate_cid)(void *);
+    void                           *enp_generate_cid_ctx;
+    struct enc_sess_cache          *enp_enc_cache;
     enum {
         ENPUB_PROC  = (1 << 0), /* Being processed by one of the user-facing
                                  * functions.
@@ -24,6 +28,11 @@ struct lsquic_engine_public {
     }                               enp_flags;
     unsigned char                   enp_ver_tags_buf[ sizeof(lsquic_ver_tag_t) * N_LSQVER ];
     unsigned                        enp_ver_tags_len;
+    /* Connection flow control windows are charged against es_fc_mem_budget.
+     * These are maintained by the cfcw code.
+     */
+    uint64_t                        enp_fcw_total;
+    unsigned                        enp_n_cfcw;
 };
 
 /* These values are printable ASCII characters for ease of printing the
@@ -0,0 +1,266 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_file_reader.c -- Reader that serves stream data from a file.
+ *
+ * By default, the file is mapped into memory one window at a time and
+ * lsqr_read() copies from the mapping straight into packets: there is no
+ * system call per packet.  The kernel is told that the window is going to
+ * be read sequentially.  If mapping fails -- or if the user asks for it --
+ * the reader uses pread(2) at the current offset instead.
+ *
+ * The size of the file is checked when the reader is created and before
+ * each window is mapped, so that the stream is never longer than the file.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "lsquic.h"
+
+#define LSQUIC_LOGGER_MODULE LSQLM_STREAM
+#include "lsquic_logger.h"
+
+
+/* Size of the mapped window.  Must be a multiple of page size. */
+#define FR_WINDOW_SZ (4 * 1024 * 1024)
+
+
+struct file_reader
+{
+    struct lsquic_reader    fr_reader;      /* Must be first */
+    uint64_t                fr_off;         /* Next offset to read */
+    uint64_t                fr_end;         /* Offset past last byte */
+    unsigned char          *fr_map;         /* NULL if nothing is mapped */
+    uint64_t                fr_map_off;     /* Offset of the mapped window */
+    size_t                  fr_map_sz;
+    uint64_t                fr_page_mask;
+    int                     fr_fd;
+    unsigned                fr_flags;       /* enum lsquic_file_reader_flags */
+};
+
+
+static size_t
+file_reader_size (void *ctx)
+{
+    struct file_reader *const fr = ctx;
+    const uint64_t size = fr->fr_end - fr->fr_off;
+
+    if (size < SIZE_MAX)
+        return size;
+    else
+        return SIZE_MAX;
+}
+
+
+static void
+file_reader_unmap (struct file_reader *fr)
+{
+    if (fr->fr_map)
+    {
+        (void) munmap(fr->fr_map, fr->fr_map_sz);
+        fr->fr_map = NULL;
+    }
+}
+
+
+/* Make sure the reader does not go past the end of file.  Touching a
+ * mapping past it raises SIGBUS.
+ */
+static void
+file_reader_clamp_end (struct file_reader *fr)
+{
+    struct stat st;
+
+    if (0 == fstat(fr->fr_fd, &st) && S_ISREG(st.st_mode)
+                                        && (uint64_t) st.st_size < fr->fr_end)
+    {
+        LSQ_WARN("file ends at offset %"PRIu64" instead of %"PRIu64,
+                                        (uint64_t) st.st_size, fr->fr_end);
+        if ((uint64_t) st.st_size > fr->fr_off)
+            fr->fr_end = st.st_size;
+        else
+            fr->fr_end = fr->fr_off;
+    }
+}
+
+
+/* Map the window that contains current offset.  Returns 0 on success and
+ * -1 on failure, in which case the reader switches to pread(2).  If the
+ * file has been truncated at current offset, nothing is mapped.
+ */
+static int
+file_reader_map (struct file_reader *fr)
+{
+    void *map;
+    uint64_t map_off;
+    size_t map_sz;
+
+    file_reader_unmap(fr);
+
+    file_reader_clamp_end(fr);
+    if (fr->fr_off >= fr->fr_end)
+        return 0;
+
+    map_off = fr->fr_off & ~fr->fr_page_mask;
+    if (fr->fr_end - map_off < FR_WINDOW_SZ)
+        map_sz = fr->fr_end - map_off;
+    else
+        map_sz = FR_WINDOW_SZ;
+
+    map = mmap(NULL, map_sz, PROT_READ, MAP_SHARED, fr->fr_fd,
+                                                            (off_t) map_off);
+    if (map == MAP_FAILED)
+    {
+        LSQ_INFO("cannot map %zu bytes at offset %"PRIu64": %s; will use "
+            "pread()", map_sz, map_off, strerror(errno));
+        fr->fr_flags |= LSQUIC_FR_PREAD;
+        return -1;
+    }
+
+    (void) madvise(map, map_sz, MADV_SEQUENTIAL);
+    (void) madvise(map, map_sz, MADV_WILLNEED);
+    fr->fr_map = map;
+    fr->fr_map_off = map_off;
+    fr->fr_map_sz = map_sz;
+    LSQ_DEBUG("mapped %zu bytes at offset %"PRIu64, map_sz, map_off);
+    return 0;
+}
+
+
+static size_t
+file_reader_read_pread (struct file_reader *fr, unsigned char *buf,
+                                                                size_t count)
+{
+    unsigned char *p = buf;
+    ssize_t nread;
+
+    while (count > 0)
+    {
+        nread = pread(fr->fr_fd, p, count, (off_t) fr->fr_off);
+        if (nread > 0)
+        {
+            p += nread;
+            count -= nread;
+            fr->fr_off += nread;
+        }
+        else if (nread < 0 && errno == EINTR)
+            continue;
+        else
+        {
+            /* Like the error, unexpected end of file is not recoverable:
+             * the stream will be shorter than promised.
+             */
+            if (nread < 0)
+                LSQ_WARN("error reading from file: %s", strerror(errno));
+            else
+                LSQ_WARN("file ends before offset %"PRIu64, fr->fr_end);
+            fr->fr_end = fr->fr_off;
+            break;
+        }
+    }
+
+    return p - buf;
+}
+
+
+static size_t
+file_reader_read (void *ctx, void *buf, size_t count)
+{
+    struct file_reader *const fr = ctx;
+    unsigned char *p = buf, *end;
+    uint64_t map_end;
+    size_t n_tocopy;
+
+    if (count > fr->fr_end - fr->fr_off)
+        count = fr->fr_end - fr->fr_off;
+
+    if (fr->fr_flags & LSQUIC_FR_PREAD)
+        return file_reader_read_pread(fr, buf, count);
+
+    end = p + count;
+    while (p < end)
+    {
+        map_end = fr->fr_map_off + fr->fr_map_sz;
+        if (!fr->fr_map || fr->fr_off >= map_end)
+        {
+            if (0 != file_reader_map(fr))
+                return p - (unsigned char *) buf
+                            + file_reader_read_pread(fr, p, end - p);
+            if (!fr->fr_map)
+                break;
+            map_end = fr->fr_map_off + fr->fr_map_sz;
+        }
+        n_tocopy = end - p;
+        if (n_tocopy > map_end - fr->fr_off)
+            n_tocopy = map_end - fr->fr_off;
+        memcpy(p, fr->fr_map + (fr->fr_off - fr->fr_map_off), n_tocopy);
+        p += n_tocopy;
+        fr->fr_off += n_tocopy;
+    }
+
+    if (fr->fr_off == fr->fr_end)
+        file_reader_unmap(fr);
+
+    return p - (unsigned char *) buf;
+}
+
+
+struct lsquic_reader *
+lsquic_file_reader_new (int fd, uint64_t off, uint64_t size, unsigned flags)
+{
+    struct file_reader *fr;
+    long page_size;
+
+    if (off + size < off)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    fr = calloc(1, sizeof(*fr));
+    if (!fr)
+        return NULL;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0 || FR_WINDOW_SZ % page_size)
+        flags |= LSQUIC_FR_PREAD;
+    else
+        fr->fr_page_mask = page_size - 1;
+
+    fr->fr_reader.lsqr_read = file_reader_read;
+    fr->fr_reader.lsqr_size = file_reader_size;
+    fr->fr_reader.lsqr_ctx  = fr;
+    fr->fr_fd    = fd;
+    fr->fr_off   = off;
+    fr->fr_end   = off + size;
+    fr->fr_flags = flags;
+    file_reader_clamp_end(fr);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (flags & LSQUIC_FR_PREAD)
+        (void) posix_fadvise(fd, (off_t) off, (off_t) size,
+                                                    POSIX_FADV_SEQUENTIAL);
+#endif
+
+    LSQ_DEBUG("created file reader: fd %d, offset %"PRIu64", size %"PRIu64
+        "; use %s", fd, off, size, flags & LSQUIC_FR_PREAD ? "pread" : "mmap");
+    return &fr->fr_reader;
+}
+
+
+void
+lsquic_file_reader_destroy (struct lsquic_reader *reader)
+{
+    struct file_reader *const fr = (struct file_reader *) reader;
+
+    file_reader_unmap(fr);
+    free(fr);
+}
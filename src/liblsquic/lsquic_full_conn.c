@@ -24,13 +24,19 @@
 #include "lsquic_packet_in.h"
 #include "lsquic_packet_out.h"
 #include "lsquic_rechist.h"
+#include "lsquic_ack_decim.h"
 #include "lsquic_util.h"
 #include "lsquic_conn_flow.h"
 #include "lsquic_sfcw.h"
 #include "lsquic_stream.h"
 #include "lsquic_senhist.h"
+#include "lsquic_sentwin.h"
 #include "lsquic_rtt.h"
 #include "lsquic_cubic.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_prr.h"
 #include "lsquic_pacer.h"
 #include "lsquic_send_ctl.h"
 #include "lsquic_set.h"
@@ -148,6 +154,8 @@ struct full_conn
 {
     struct lsquic_conn           fc_conn;
     struct lsquic_rechist        fc_rechist;
+    struct ack_decim             fc_ack_decim;
+    struct ack_gen_cache         fc_ack_cache;
     struct {
         const struct lsquic_stream_if   *stream_if;
         void                            *stream_if_ctx;
@@ -163,6 +171,8 @@ struct full_conn
     lsquic_packno_t              fc_max_ack_packno;
     lsquic_packno_t              fc_max_swf_packno;
     lsquic_time_t                fc_mem_logged_last;
+    lsquic_time_t                fc_created;
+    lsquic_time_t                fc_hsk_done;
     struct {
         unsigned    max_streams_in;
         unsigned    max_streams_out;
@@ -542,6 +552,7 @@ new_conn_common (lsquic_cid_t cid, struct lsquic_engine_public *enpub,
     conn->fc_conn.cn_cid = cid;
     conn->fc_conn.cn_pack_size = max_packet_size;
     conn->fc_flags = flags;
+    conn->fc_created = lsquic_time_now();
     conn->fc_enpub = enpub;
     conn->fc_pub.enpub = enpub;
     conn->fc_pub.mm = &enpub->enp_mm;
@@ -590,6 +601,8 @@ new_conn_common (lsquic_cid_t cid, struct lsquic_engine_public *enpub,
     if (!conn->fc_pub.all_streams)
         goto cleanup_on_error;
     lsquic_rechist_init(&conn->fc_rechist, cid);
+    lsquic_ack_decim_init(&conn->fc_ack_decim, conn->fc_settings->es_ack_decim,
+                                    conn->fc_settings->es_ack_decim_start);
     if (conn->fc_flags & FC_HTTP)
     {
         conn->fc_pub.hs = lsquic_headers_stream_new(
@@ -617,6 +630,7 @@ new_conn_common (lsquic_cid_t cid, struct lsquic_engine_public *enpub,
   cleanup_on_error:
     saved_errno = errno;
 
+    lsquic_cfcw_cleanup(&conn->fc_pub.cfcw);
     if (conn->fc_pub.all_streams)
         lsquic_hash_destroy(conn->fc_pub.all_streams);
     lsquic_rechist_cleanup(&conn->fc_rechist);
@@ -648,14 +662,18 @@ full_conn_client_new (struct lsquic_engine_public *enpub,
 
     version = highest_bit_set(enpub->enp_settings.es_versions);
     esf = select_esf_by_ver(version);
-    cid = esf->esf_generate_cid();
+    if (enpub->enp_generate_cid)
+        cid = enpub->enp_generate_cid(enpub->enp_generate_cid_ctx);
+    else
+        cid = esf->esf_generate_cid();
     conn = new_conn_common(cid, enpub, stream_if, stream_if_ctx, flags,
                                                             max_packet_size);
     if (!conn)
         return NULL;
     conn->fc_conn.cn_esf = esf;
     conn->fc_conn.cn_enc_session =
-        conn->fc_conn.cn_esf->esf_create_client(hostname, cid, conn->fc_enpub);
+        conn->fc_conn.cn_esf->esf_create_client(hostname, cid, conn->fc_enpub,
+                        lsquic_cfcw_get_max_recv_window(&conn->fc_pub.cfcw));
     if (!conn->fc_conn.cn_enc_session)
     {
         LSQ_WARN("could not create enc session: %s", strerror(errno));
@@ -760,6 +778,7 @@ full_conn_ci_destroy (lsquic_conn_t *lconn)
     if (conn->fc_pub.hs)
         lsquic_headers_stream_destroy(conn->fc_pub.hs);
 
+    lsquic_cfcw_cleanup(&conn->fc_pub.cfcw);
     lsquic_send_ctl_cleanup(&conn->fc_send_ctl);
     lsquic_rechist_cleanup(&conn->fc_rechist);
     if (conn->fc_conn.cn_enc_session)
@@ -812,10 +831,11 @@ conn_is_stream_closed (struct full_conn *conn, uint32_t stream_id)
 
 
 static void
-set_ack_timer (struct full_conn *conn, lsquic_time_t now)
+set_ack_timer (struct full_conn *conn, lsquic_time_t now,
+                                                    lsquic_time_t timeout)
 {
-    lsquic_alarmset_set(&conn->fc_alset, AL_ACK, now + ACK_TIMEOUT);
-    LSQ_DEBUG("ACK alarm set to %"PRIu64, now + ACK_TIMEOUT);
+    lsquic_alarmset_set(&conn->fc_alset, AL_ACK, now + timeout);
+    LSQ_DEBUG("ACK alarm set to %"PRIu64, now + timeout);
 }
 
 
@@ -829,13 +849,25 @@ ack_alarm_expired (void *ctx, lsquic_time_t expiry, lsquic_time_t now)
 }
 
 
+/* `was_missing' is true if the packet is not the largest received;
+ * `new_gap' is true if it is, but packets before it are missing.
+ */
 static void
-try_queueing_ack (struct full_conn *conn, int was_missing, lsquic_time_t now)
+try_queueing_ack (struct full_conn *conn, int was_missing, int new_gap,
+                                                            lsquic_time_t now)
 {
-    if (conn->fc_n_slack_akbl >= MAX_RETR_PACKETS_SINCE_LAST_ACK ||
+    enum ack_decim_verdict verdict;
+
+    verdict = lsquic_ack_decim_check(&conn->fc_ack_decim,
+                lsquic_rechist_largest_packno(&conn->fc_rechist),
+                conn->fc_n_slack_akbl, was_missing || new_gap);
+
+    if (verdict == ADV_ACK_NOW ||
+        (verdict == ADV_OFF &&
+            (conn->fc_n_slack_akbl >= MAX_RETR_PACKETS_SINCE_LAST_ACK ||
+            ((conn->fc_flags & FC_ACK_HAD_MISS) && was_missing))) ||
         (conn->fc_conn.cn_version < LSQVER_039 /* Since Q039 do not ack ACKs */
             && conn->fc_n_slack_all >= MAX_ANY_PACKETS_SINCE_LAST_ACK) ||
-        ((conn->fc_flags & FC_ACK_HAD_MISS) && was_missing)      ||
         lsquic_send_ctl_n_stop_waiting(&conn->fc_send_ctl) > 1)
     {
         lsquic_alarmset_unset(&conn->fc_alset, AL_ACK);
@@ -848,7 +880,17 @@ try_queueing_ack (struct full_conn *conn, int was_missing, lsquic_time_t now)
             lsquic_send_ctl_n_stop_waiting(&conn->fc_send_ctl));
     }
     else if (conn->fc_n_slack_akbl > 0)
-        set_ack_timer(conn, now);
+    {
+        if (verdict == ADV_OFF)
+            set_ack_timer(conn, now, ACK_TIMEOUT);
+        /* When decimating, the alarm is not pushed back by each packet:
+         * the first unacknowledged packet waits at most min_rtt / 4.
+         */
+        else if (!lsquic_alarmset_is_set(&conn->fc_alset, AL_ACK))
+            set_ack_timer(conn, now, lsquic_ack_decim_delay(
+                lsquic_rtt_stats_get_min_rtt(&conn->fc_pub.rtt_stats),
+                ACK_TIMEOUT));
+    }
 }
 
 
@@ -880,6 +922,17 @@ new_stream_ext (struct full_conn *conn, uint32_t stream_id, int if_idx,
 }
 
 
+/* Data input used by application streams */
+static enum stream_ctor_flags
+std_stream_di_flags (const struct full_conn *conn)
+{
+    if (conn->fc_enpub->enp_settings.es_use_di_ring)
+        return SCF_USE_DI_RING;
+    else
+        return SCF_DI_AUTOSWITCH;
+}
+
+
 static lsquic_stream_t *
 new_stream (struct full_conn *conn, uint32_t stream_id,
             enum stream_ctor_flags flags)
@@ -900,7 +953,7 @@ new_stream (struct full_conn *conn, uint32_t stream_id,
         break;
     default:
         idx = STREAM_IF_STD;
-        flags |= SCF_DI_AUTOSWITCH;
+        flags |= std_stream_di_flags(conn);
         if (conn->fc_enpub->enp_settings.es_rw_once)
             flags |= SCF_DISP_RW_ONCE;
         break;
@@ -1824,7 +1877,8 @@ process_regular_packet (struct full_conn *conn, lsquic_packet_in_t *packet_in)
 {
     enum received_st st;
     enum quic_ft_bit frame_types;
-    int was_missing;
+    lsquic_packno_t prev_largest;
+    int was_missing, new_gap;
 
     reconstruct_packet_number(conn, packet_in);
     EV_LOG_PACKET_IN(LSQUIC_LOG_CONN_ID, packet_in);
@@ -1833,6 +1887,23 @@ process_regular_packet (struct full_conn *conn, lsquic_packet_in_t *packet_in)
     ++conn->fc_stats.n_all_packets_in;
 #endif
 
+    /* Duplicates are dropped before they are decrypted, as decryption is
+     * the most expensive part of processing a packet.  The packet number
+     * is authenticated during decryption, so a forged number can only
+     * make us drop a packet that we already have.
+     */
+    if (REC_ST_DUP == lsquic_rechist_check(&conn->fc_rechist,
+                                                    packet_in->pi_packno))
+    {
+#if FULL_CONN_STATS
+        ++conn->fc_stats.n_dup_packets;
+#endif
+        LSQ_INFO("packet %"PRIu64" is a duplicate: drop it without "
+                                        "decrypting", packet_in->pi_packno);
+        packet_in->pi_flags |= PI_DUP;
+        return 0;
+    }
+
     /* The packet is decrypted before receive history is updated.  This is
      * done to make sure that a bad packet won't occupy a slot in receive
      * history and subsequent good packet won't be marked as a duplicate.
@@ -1847,6 +1918,7 @@ process_regular_packet (struct full_conn *conn, lsquic_packet_in_t *packet_in)
         return 0;
     }
 
+    prev_largest = lsquic_rechist_largest_packno(&conn->fc_rechist);
     st = lsquic_rechist_received(&conn->fc_rechist, packet_in->pi_packno,
                                                     packet_in->pi_received);
     switch (st) {
@@ -1857,9 +1929,11 @@ process_regular_packet (struct full_conn *conn, lsquic_packet_in_t *packet_in)
             frame_types = packet_in->pi_frame_types;
             was_missing = packet_in->pi_packno !=
                             lsquic_rechist_largest_packno(&conn->fc_rechist);
+            new_gap = prev_largest && packet_in->pi_packno > prev_largest + 1;
             conn->fc_n_slack_all  += 1;
             conn->fc_n_slack_akbl += !!(frame_types & QFRAME_ACKABLE_MASK);
-            try_queueing_ack(conn, was_missing, packet_in->pi_received);
+            try_queueing_ack(conn, was_missing, new_gap,
+                                                    packet_in->pi_received);
         }
         return 0;
     case REC_ST_DUP:
@@ -1867,6 +1941,7 @@ process_regular_packet (struct full_conn *conn, lsquic_packet_in_t *packet_in)
     ++conn->fc_stats.n_dup_packets;
 #endif
         LSQ_INFO("packet %"PRIu64" is a duplicate", packet_in->pi_packno);
+        packet_in->pi_flags |= PI_DUP;
         return 0;
     default:
         assert(0);
@@ -2510,13 +2585,15 @@ generate_ack_frame (struct full_conn *conn)
 
     lsquic_send_ctl_scheduled_one(&conn->fc_send_ctl, packet_out);
     now = lsquic_time_now();
+    conn->fc_ack_cache.agc_version = lsquic_rechist_version(&conn->fc_rechist);
     w = conn->fc_conn.cn_pf->pf_gen_ack_frame(
             packet_out->po_data + packet_out->po_data_sz,
             lsquic_packet_out_avail(packet_out),
             (gaf_rechist_first_f)        lsquic_rechist_first,
             (gaf_rechist_next_f)         lsquic_rechist_next,
             (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-            &conn->fc_rechist, now, &has_missing, &packet_out->po_ack2ed);
+            &conn->fc_rechist, now, &has_missing, &packet_out->po_ack2ed,
+            &conn->fc_ack_cache);
     if (w < 0) {
         ABORT_ERROR("generating ACK frame failed: %d", errno);
         return;
@@ -2994,7 +3071,10 @@ full_conn_ci_handshake_ok (lsquic_conn_t *lconn)
     LSQ_DEBUG("handshake reportedly done");
     lsquic_alarmset_unset(&conn->fc_alset, AL_HANDSHAKE);
     if (0 == apply_peer_settings(conn))
+    {
         lconn->cn_flags |= LSCONN_HANDSHAKE_DONE;
+        conn->fc_hsk_done = lsquic_time_now();
+    }
     else
         conn->fc_flags |= FC_ERROR;
 }
@@ -3243,7 +3323,8 @@ headers_stream_on_push_promise (void *ctx, struct uncompressed_headers *uh)
     }
 
     stream = new_stream_ext(conn, uh->uh_oth_stream_id, STREAM_IF_STD,
-                SCF_DI_AUTOSWITCH|(conn->fc_enpub->enp_settings.es_rw_once ?
+                std_stream_di_flags(conn)|
+                (conn->fc_enpub->enp_settings.es_rw_once ?
                                                         SCF_DISP_RW_ONCE : 0));
     if (!stream)
     {
@@ -3343,6 +3424,31 @@ lsquic_conn_status (lsquic_conn_t *lconn, char *errbuf, size_t bufsz)
 }
 
 
+size_t
+lsquic_conn_get_info (lsquic_conn_t *lconn, struct lsquic_conn_info *info,
+                                                            size_t info_sz)
+{
+    struct full_conn *const conn = (struct full_conn *) lconn;
+    struct lsquic_conn_info full;
+
+    memset(&full, 0, sizeof(full));
+    full.lci_version = LSQUIC_CONN_INFO_VERSION;
+    lsquic_send_ctl_get_info(&conn->fc_send_ctl, &full);
+    full.lci_send_off    = conn->fc_pub.conn_cap.cc_sent;
+    full.lci_send_max    = conn->fc_pub.conn_cap.cc_max;
+    full.lci_recv_off    = conn->fc_pub.cfcw.cf_max_recv_off;
+    full.lci_recv_max    = conn->fc_pub.cfcw.cf_recv_off;
+    full.lci_recv_window = conn->fc_pub.cfcw.cf_max_recv_win;
+    if (lconn->cn_flags & LSCONN_HANDSHAKE_DONE)
+        full.lci_hsk_usec = conn->fc_hsk_done - conn->fc_created;
+
+    if (info_sz > sizeof(full))
+        info_sz = sizeof(full);
+    memcpy(info, &full, info_sz);
+    return info_sz;
+}
+
+
 static const struct headers_stream_callbacks headers_callbacks =
 {
     .hsc_on_headers      = headers_stream_on_incoming_headers,
@@ -1,8 +1,22 @@
 /* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
 /*
  * Global state
+ *
+ * Global state is read-only once initialized.  Initialization is reference-
+ * counted: each call to lsquic_global_init() must be matched by a call to
+ * lsquic_global_cleanup().  Only the first call initializes and only the
+ * last call cleans up.  This way, several threads each running their own
+ * engine can call these functions independently.  A later call that asks
+ * for a mode not yet initialized -- server after client, for example --
+ * initializes the missing part.
  */
 
+#ifndef WIN32
+#include <pthread.h>
+#else
+#include <windows.h>
+#endif
+
 #include "lsquic_int_types.h"
 #include "lsquic_types.h"
 #include "lsquic.h"
@@ -11,16 +25,54 @@
 #include "lsquic_util.h"
 
 
+#ifndef WIN32
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+#define GLOBAL_LOCK()   pthread_mutex_lock(&global_lock)
+#define GLOBAL_UNLOCK() pthread_mutex_unlock(&global_lock)
+#else
+static SRWLOCK global_lock = SRWLOCK_INIT;
+#define GLOBAL_LOCK()   AcquireSRWLockExclusive(&global_lock)
+#define GLOBAL_UNLOCK() ReleaseSRWLockExclusive(&global_lock)
+#endif
+
+static unsigned global_refcnt;
+static int global_flags;       /* LSQUIC_GLOBAL_* flags initialized so far */
+
+
 int
 lsquic_global_init (int flags)
 {
-    lsquic_init_timers();
-    return lsquic_enc_session_gquic_1.esf_global_init(flags);
+    int s;
+
+    GLOBAL_LOCK();
+    if (global_refcnt == 0)
+    {
+        lsquic_init_timers();
+        s = lsquic_enc_session_gquic_1.esf_global_init(flags);
+    }
+    else if (flags & ~global_flags)
+        s = lsquic_enc_session_gquic_1.esf_global_init(flags & ~global_flags);
+    else
+        s = 0;
+    if (0 == s)
+    {
+        global_flags |= flags;
+        ++global_refcnt;
+    }
+    GLOBAL_UNLOCK();
+
+    return s;
 }
 
 
 void
 lsquic_global_cleanup (void)
 {
-    lsquic_enc_session_gquic_1.esf_global_cleanup();
+    GLOBAL_LOCK();
+    if (global_refcnt > 0 && 0 == --global_refcnt)
+    {
+        lsquic_enc_session_gquic_1.esf_global_cleanup();
+        global_flags = 0;
+    }
+    GLOBAL_UNLOCK();
 }
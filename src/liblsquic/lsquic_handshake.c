@@ -139,6 +139,7 @@ struct lsquic_enc_session
     lsquic_session_cache_info_t *info;
     SSL_CTX *  ssl_ctx;
     const struct lsquic_engine_public *enpub;
+    unsigned            cfcw;   /* Connection window advertised in CHLO */
     struct lsquic_str * cert_ptr; /* pointer to the leaf cert of the server, not real copy */
     struct lsquic_str   chlo; /* real copy of CHLO message */
     struct lsquic_str   sstk;
@@ -151,31 +152,38 @@ struct lsquic_enc_session
 };
 
 
-/***
- * client side, it will store the domain/certs as cache cert
+/* Each engine has its own cache.  This way, engines running in different
+ * threads do not share any state.
  */
-static struct lsquic_hash *s_cached_client_certs;
+struct enc_sess_cache
+{
+    /**
+     * client side, it will store the domain/certs as cache cert
+     */
+    struct lsquic_hash *esc_certs;
 
-/**
- * client side will save the session_info for next time 0rtt
- */
-static struct lsquic_hash *s_cached_client_session_infos;
+    /**
+     * client side will save the session_info for next time 0rtt
+     */
+    struct lsquic_hash *esc_session_infos;
+};
 
 /* save to hash table */
-static lsquic_session_cache_info_t *retrieve_session_info_entry(const char *key);
-static void remove_expire_session_info_entry();
-static void remove_session_info_entry(struct lsquic_str *key);
+static lsquic_session_cache_info_t *retrieve_session_info_entry(
+                                struct enc_sess_cache *, const char *key);
+static void remove_expire_session_info_entry(struct enc_sess_cache *);
+static void remove_session_info_entry(struct enc_sess_cache *,
+                                                    struct lsquic_str *key);
 
 static void free_info (lsquic_session_cache_info_t *);
 
 
 /* client */
 static cert_hash_item_t *make_cert_hash_item(struct lsquic_str *domain, struct lsquic_str **certs, int count);
-static int c_insert_certs(cert_hash_item_t *item);
+static int c_insert_certs(struct enc_sess_cache *, cert_hash_item_t *item);
 static void c_free_cert_hash_item (cert_hash_item_t *item);
 
 static int get_tag_val_u32 (unsigned char *v, int len, uint32_t *val);
-static int init_hs_hash_tables(int flags);
 static uint32_t get_tag_value_i32(unsigned char *, int);
 static uint64_t get_tag_value_i64(unsigned char *, int);
 
@@ -201,78 +209,81 @@ static int
 lsquic_handshake_init(int flags)
 {
     crypto_init();
-    return init_hs_hash_tables(flags);
+    return lsquic_crt_init();
 }
 
 
 static void
-cleanup_hs_hash_tables (void)
+lsquic_handshake_cleanup (void)
+{
+    lsquic_crt_cleanup();
+}
+
+
+static void
+destroy_hs_cache (struct enc_sess_cache *cache)
 {
     struct lsquic_hash_elem *el;
 
-    if (s_cached_client_session_infos)
+    if (cache->esc_session_infos)
     {
-        for (el = lsquic_hash_first(s_cached_client_session_infos); el;
-                        el = lsquic_hash_next(s_cached_client_session_infos))
+        for (el = lsquic_hash_first(cache->esc_session_infos); el;
+                        el = lsquic_hash_next(cache->esc_session_infos))
         {
             lsquic_session_cache_info_t *entry = lsquic_hashelem_getdata(el);
             free_info(entry);
         }
-        lsquic_hash_destroy(s_cached_client_session_infos);
-        s_cached_client_session_infos = NULL;
+        lsquic_hash_destroy(cache->esc_session_infos);
     }
 
-    if (s_cached_client_certs)
+    if (cache->esc_certs)
     {
-        for (el = lsquic_hash_first(s_cached_client_certs); el;
-                                el = lsquic_hash_next(s_cached_client_certs))
+        for (el = lsquic_hash_first(cache->esc_certs); el;
+                                el = lsquic_hash_next(cache->esc_certs))
         {
             cert_hash_item_t *item = lsquic_hashelem_getdata(el);
             c_free_cert_hash_item(item);
         }
-        lsquic_hash_destroy(s_cached_client_certs);
-        s_cached_client_certs = NULL;
+        lsquic_hash_destroy(cache->esc_certs);
     }
 
+    free(cache);
 }
 
 
-static void
-lsquic_handshake_cleanup (void)
+/* return NULL on failure */
+static struct enc_sess_cache *
+create_hs_cache (void)
 {
-    cleanup_hs_hash_tables();
-    lsquic_crt_cleanup();
-}
+    struct enc_sess_cache *cache;
 
+    cache = calloc(1, sizeof(*cache));
+    if (!cache)
+        return NULL;
 
-/* return -1 for fail, 0 OK*/
-static int init_hs_hash_tables(int flags)
-{
-    if (flags & LSQUIC_GLOBAL_CLIENT)
-    {
-        s_cached_client_session_infos = lsquic_hash_create();
-        if (!s_cached_client_session_infos)
-            return -1;
+    cache->esc_session_infos = lsquic_hash_create();
+    if (!cache->esc_session_infos)
+        goto err;
 
-        s_cached_client_certs = lsquic_hash_create();
-        if (!s_cached_client_certs)
-            return -1;
-    }
+    cache->esc_certs = lsquic_hash_create();
+    if (!cache->esc_certs)
+        goto err;
 
-    return 0;
+    return cache;
+
+  err:
+    destroy_hs_cache(cache);
+    return NULL;
 }
 
 
 /* client */
-cert_hash_item_t *
-c_find_certs (const lsquic_str_t *domain)
+static cert_hash_item_t *
+c_find_certs (struct enc_sess_cache *cache, const lsquic_str_t *domain)
 {
     struct lsquic_hash_elem *el;
 
-    if (!s_cached_client_certs)
-        return NULL;
-
-    el = lsquic_hash_find(s_cached_client_certs, lsquic_str_cstr(domain),
+    el = lsquic_hash_find(cache->esc_certs, lsquic_str_cstr(domain),
                                                     lsquic_str_len(domain));
     if (el == NULL)
         return NULL;
@@ -323,9 +334,9 @@ c_free_cert_hash_item (cert_hash_item_t *item)
 
 /* client */
 static int
-c_insert_certs (cert_hash_item_t *item)
+c_insert_certs (struct enc_sess_cache *cache, cert_hash_item_t *item)
 {
-    if (lsquic_hash_insert(s_cached_client_certs,
+    if (lsquic_hash_insert(cache->esc_certs,
             lsquic_str_cstr(item->domain),
                 lsquic_str_len(item->domain), item) == NULL)
         return -1;
@@ -334,10 +345,11 @@ c_insert_certs (cert_hash_item_t *item)
 }
 
 
-static int save_session_info_entry(lsquic_str_t *key, lsquic_session_cache_info_t *entry)
+static int save_session_info_entry(struct enc_sess_cache *cache,
+                        lsquic_str_t *key, lsquic_session_cache_info_t *entry)
 {
     lsquic_str_setto(&entry->sni_key, lsquic_str_cstr(key), lsquic_str_len(key));
-    if (lsquic_hash_insert(s_cached_client_session_infos,
+    if (lsquic_hash_insert(cache->esc_session_infos,
             lsquic_str_cstr(&entry->sni_key),
                 lsquic_str_len(&entry->sni_key), entry) == NULL)
     {
@@ -351,35 +363,32 @@ static int save_session_info_entry(lsquic_str_t *key, lsquic_session_cache_info_
 
 /* If entry updated and need to remove cached entry */
 static void
-remove_session_info_entry (lsquic_str_t *key)
+remove_session_info_entry (struct enc_sess_cache *cache, lsquic_str_t *key)
 {
     lsquic_session_cache_info_t *entry;
     struct lsquic_hash_elem *el;
-    el = lsquic_hash_find(s_cached_client_session_infos,
+    el = lsquic_hash_find(cache->esc_session_infos,
                                 lsquic_str_cstr(key), lsquic_str_len(key));
     if (el)
     {
         entry = lsquic_hashelem_getdata(el);
         lsquic_str_d(&entry->sni_key);
-        lsquic_hash_erase(s_cached_client_session_infos, el);
+        lsquic_hash_erase(cache->esc_session_infos, el);
     }
 }
 
 
 /* client */
 static lsquic_session_cache_info_t *
-retrieve_session_info_entry (const char *key)
+retrieve_session_info_entry (struct enc_sess_cache *cache, const char *key)
 {
     lsquic_session_cache_info_t *entry;
     struct lsquic_hash_elem *el;
 
-    if (!s_cached_client_session_infos)
-        return NULL;
-
     if (!key)
         return NULL;
 
-    el = lsquic_hash_find(s_cached_client_session_infos, key, strlen(key));
+    el = lsquic_hash_find(cache->esc_session_infos, key, strlen(key));
     if (el == NULL)
         return NULL;
 
@@ -394,19 +403,19 @@ retrieve_session_info_entry (const char *key)
 __attribute__((unused))
 #endif
 static void
-remove_expire_session_info_entry (void)
+remove_expire_session_info_entry (struct enc_sess_cache *cache)
 {
     time_t tm = time(NULL);
     struct lsquic_hash_elem *el;
 
-    for (el = lsquic_hash_first(s_cached_client_session_infos); el;
-                        el = lsquic_hash_next(s_cached_client_session_infos))
+    for (el = lsquic_hash_first(cache->esc_session_infos); el;
+                        el = lsquic_hash_next(cache->esc_session_infos))
     {
         lsquic_session_cache_info_t *entry = lsquic_hashelem_getdata(el);
         if ((uint64_t)tm > entry->expy)
         {
             free_info(entry);
-            lsquic_hash_erase(s_cached_client_session_infos, el);
+            lsquic_hash_erase(cache->esc_session_infos, el);
         }
     }
 }
@@ -414,7 +423,7 @@ remove_expire_session_info_entry (void)
 
 static lsquic_enc_session_t *
 lsquic_enc_session_create_client (const char *domain, lsquic_cid_t cid,
-                                    const struct lsquic_engine_public *enpub)
+                    const struct lsquic_engine_public *enpub, unsigned cfcw)
 {
     lsquic_session_cache_info_t *info;
     lsquic_enc_session_t *enc_session;
@@ -429,7 +438,7 @@ lsquic_enc_session_create_client (const char *domain, lsquic_cid_t cid,
     if (!enc_session)
         return NULL;
 
-    info = retrieve_session_info_entry(domain);
+    info = retrieve_session_info_entry(enpub->enp_enc_cache, domain);
     if (info)
         memcpy(enc_session->hs_ctx.pubs, info->spubs, 32);
     else
@@ -443,6 +452,7 @@ lsquic_enc_session_create_client (const char *domain, lsquic_cid_t cid,
     }
 
     enc_session->enpub = enpub;
+    enc_session->cfcw  = cfcw;
     enc_session->cid   = cid;
     enc_session->info  = info;
     /* FIXME: allocation may fail */
@@ -654,7 +664,8 @@ static int parse_hs_data (lsquic_enc_session_t *enc_session, uint32_t tag,
 
     case QTAG_STK:
             if (lsquic_str_len(&enc_session->info->sstk) > 0)
-                remove_session_info_entry(&enc_session->info->sstk);
+                remove_session_info_entry(enc_session->enpub->enp_enc_cache,
+                                                    &enc_session->info->sstk);
             lsquic_str_setto(&enc_session->info->sstk, val, len);
         ESHIST_APPEND(enc_session, ESHE_SET_STK);
         break;
@@ -930,8 +941,8 @@ lsquic_enc_session_gen_chlo (lsquic_enc_session_t *enc_session,
     const lsquic_str_t *const ccs = get_common_certs_hash();
     const struct lsquic_engine_settings *const settings =
                                         &enc_session->enpub->enp_settings;
-    cert_hash_item_t *const cached_certs_item =
-                                    c_find_certs(&enc_session->hs_ctx.sni);
+    cert_hash_item_t *const cached_certs_item = c_find_certs(
+                enc_session->enpub->enp_enc_cache, &enc_session->hs_ctx.sni);
     unsigned char pub_key[32];
     size_t ua_len;
     uint32_t opts[1];  /* Only NSTP is supported for now */
@@ -1067,7 +1078,7 @@ lsquic_enc_session_gen_chlo (lsquic_enc_session_t *enc_session,
         MW_WRITE_BUFFER(&mw, QTAG_COPT, opts, n_opts * sizeof(opts[0]));
     if (cached_certs_item)
         MW_WRITE_LS_STR(&mw, QTAG_CCRT, cached_certs_item->hashs);
-    MW_WRITE_UINT32(&mw, QTAG_CFCW, settings->es_cfcw);
+    MW_WRITE_UINT32(&mw, QTAG_CFCW, enc_session->cfcw);
     MW_WRITE_UINT32(&mw, QTAG_SFCW, settings->es_sfcw);
     MW_END(&mw);
     assert(buf + *len >= MW_P(&mw));
@@ -1329,7 +1340,8 @@ lsquic_enc_session_handle_chlo_reply (lsquic_enc_session_t *enc_session,
     int ret;
     lsquic_session_cache_info_t *info = enc_session->info;
     hs_ctx_t * hs_ctx = &enc_session->hs_ctx;
-    cert_hash_item_t *cached_certs_item = c_find_certs(&hs_ctx->sni);
+    cert_hash_item_t *cached_certs_item =
+                c_find_certs(enc_session->enpub->enp_enc_cache, &hs_ctx->sni);
 
     /* FIXME get the number first */
     lsquic_str_t **out_certs = NULL;
@@ -1397,7 +1409,8 @@ lsquic_enc_session_handle_chlo_reply (lsquic_enc_session_t *enc_session,
 
                             cached_certs_item = make_cert_hash_item(&hs_ctx->sni,
                                                                     out_certs, out_certs_count);
-                            c_insert_certs(cached_certs_item);
+                            c_insert_certs(enc_session->enpub->enp_enc_cache,
+                                                            cached_certs_item);
                         }
                         enc_session->cert_ptr = &cached_certs_item->crts[0];
                     }
@@ -1416,7 +1429,8 @@ lsquic_enc_session_handle_chlo_reply (lsquic_enc_session_t *enc_session,
     if (enc_session->hsk_state == HSK_COMPLETED)
     {
         if (!lsquic_str_buf(&info->sni_key))
-            save_session_info_entry(&enc_session->hs_ctx.sni, info);
+            save_session_info_entry(enc_session->enpub->enp_enc_cache,
+                                            &enc_session->hs_ctx.sni, info);
         ret = determine_keys(enc_session
                                            ); /* FIXME: check ret */
         enc_session->have_key = 3;
@@ -1819,6 +1833,8 @@ struct enc_session_funcs lsquic_enc_session_gquic_1 =
 {
     .esf_global_init    = lsquic_handshake_init,
     .esf_global_cleanup = lsquic_handshake_cleanup,
+    .esf_cache_new      = create_hs_cache,
+    .esf_cache_destroy  = destroy_hs_cache,
 #if LSQUIC_KEEP_ENC_SESS_HISTORY
     .esf_get_hist       = lsquic_get_enc_hist,
 #endif
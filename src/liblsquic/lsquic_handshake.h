@@ -4,6 +4,7 @@
 
 struct lsquic_engine_public;
 struct lsquic_enc_session;
+struct enc_sess_cache;
 
 typedef struct lsquic_enc_session lsquic_enc_session_t;
 
@@ -67,12 +68,25 @@ typedef struct lsquic_session_cache_info_st
 
 struct enc_session_funcs
 {
-    /* Global initialization: call once per implementation */
+    /* Global initialization.  Called again, before cleanup, for each newly
+     * requested mode: already-initialized state must be left alone.
+     */
     int (*esf_global_init)(int flags);
 
     /* Global cleanup: call once per implementation */
     void (*esf_global_cleanup) (void);
 
+    /* Create per-engine cache of server certificates and session info.
+     * The cache is only accessed from the thread that runs the engine.
+     */
+    struct enc_sess_cache *
+    (*esf_cache_new) (void);
+
+    /* Destroy per-engine cache.  Called after all sessions that use it
+     * have been destroyed.
+     */
+    void (*esf_cache_destroy) (struct enc_sess_cache *);
+
 #if LSQUIC_KEEP_ENC_SESS_HISTORY
     /* Grab encryption session history */
     void (*esf_get_hist) (const lsquic_enc_session_t *,
@@ -113,10 +127,12 @@ struct enc_session_funcs
     int (*esf_get_peer_option) (const lsquic_enc_session_t *enc_session,
                                                                 uint32_t tag);
 
-    /* Create client session */
+    /* Create client session.  `cfcw' is the connection flow control
+     * window to advertise.
+     */
     lsquic_enc_session_t *
     (*esf_create_client) (const char *domain, lsquic_cid_t cid,
-                                    const struct lsquic_engine_public *);
+                            const struct lsquic_engine_public *, unsigned cfcw);
 
     /* Generate connection ID */
     lsquic_cid_t (*esf_generate_cid) (void);
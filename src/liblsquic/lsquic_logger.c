@@ -13,6 +13,9 @@
 #include <sys/time.h>
 #endif
 #include <time.h>
+#ifndef WIN32
+#include <pthread.h>
+#endif
 
 #define LSQUIC_LOGGER_MODULE LSQLM_LOGGER /* Quis custodiet ipsos custodes? */
 #include "lsquic_logger.h"
@@ -20,6 +23,17 @@
 
 static enum lsquic_logger_timestamp_style g_llts = LLTS_NONE;
 
+/* Messages are formatted outside of the logger lock: read the timestamp
+ * style atomically.
+ */
+#if __GNUC__
+#define get_llts() __atomic_load_n(&g_llts, __ATOMIC_RELAXED)
+#define set_llts(llts) __atomic_store_n(&g_llts, llts, __ATOMIC_RELAXED)
+#else
+#define get_llts() g_llts
+#define set_llts(llts) (g_llts = (llts))
+#endif
+
 static int
 null_vprintf (void *ctx, const char *fmt, va_list ap)
 {
@@ -45,6 +59,21 @@ static const struct lsquic_logger_if null_logger_if = {
 static void *logger_ctx = NULL;
 static const struct lsquic_logger_if *logger_if = &null_logger_if;
 
+/* Engines running in different threads share the logger.  The lock protects
+ * the logger configuration above and keeps each message in one piece.  It
+ * is held only while the user callback is invoked: the callback must not
+ * log through lsquic.
+ */
+#ifndef WIN32
+static pthread_mutex_t logger_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOGGER_LOCK()   pthread_mutex_lock(&logger_lock)
+#define LOGGER_UNLOCK() pthread_mutex_unlock(&logger_lock)
+#else
+static SRWLOCK logger_lock = SRWLOCK_INIT;
+#define LOGGER_LOCK()   AcquireSRWLockExclusive(&logger_lock)
+#define LOGGER_UNLOCK() ReleaseSRWLockExclusive(&logger_lock)
+#endif
+
 enum lsq_log_level lsq_log_levels[N_LSQUIC_LOGGER_MODULES] = {
     [LSQLM_NOMODULE]    = LSQ_LOG_WARN,
     [LSQLM_LOGGER]      = LSQ_LOG_WARN,
@@ -70,6 +99,9 @@ enum lsq_log_level lsq_log_levels[N_LSQUIC_LOGGER_MODULES] = {
     [LSQLM_SPI]         = LSQ_LOG_WARN,
     [LSQLM_DI]          = LSQ_LOG_WARN,
     [LSQLM_PACER]       = LSQ_LOG_WARN,
+    [LSQLM_BBR]         = LSQ_LOG_WARN,
+    [LSQLM_BW_SAMPLER]  = LSQ_LOG_WARN,
+    [LSQLM_PRR]         = LSQ_LOG_WARN,
 };
 
 const char *const lsqlm_to_str[N_LSQUIC_LOGGER_MODULES] = {
@@ -97,6 +129,9 @@ const char *const lsqlm_to_str[N_LSQUIC_LOGGER_MODULES] = {
     [LSQLM_SPI]         = "spi",
     [LSQLM_DI]          = "di",
     [LSQLM_PACER]       = "pacer",
+    [LSQLM_BBR]         = "bbr",
+    [LSQLM_BW_SAMPLER]  = "bw-sampler",
+    [LSQLM_PRR]         = "prr",
 };
 
 const char *const lsq_loglevel2str[N_LSQUIC_LOG_LEVELS] = {
@@ -111,6 +146,47 @@ const char *const lsq_loglevel2str[N_LSQUIC_LOG_LEVELS] = {
 };
 
 
+/* Each message is formatted into a buffer on the stack and handed to the
+ * logger callback in a single call.  Longer messages are truncated.
+ */
+#define LOG_BUF_SZ 0x1000
+
+struct log_buf
+{
+    size_t      lb_off;
+    char        lb_buf[LOG_BUF_SZ];
+};
+
+
+static void
+lb_vprintf (struct log_buf *lb, const char *fmt, va_list ap)
+{
+    int len;
+
+    if (lb->lb_off >= sizeof(lb->lb_buf) - 1)
+        return;
+
+    len = vsnprintf(lb->lb_buf + lb->lb_off, sizeof(lb->lb_buf) - lb->lb_off,
+                                                                    fmt, ap);
+    if (len > 0)
+    {
+        lb->lb_off += (size_t) len;
+        if (lb->lb_off > sizeof(lb->lb_buf) - 1)
+            lb->lb_off = sizeof(lb->lb_buf) - 1;
+    }
+}
+
+
+static void
+lb_printf (struct log_buf *lb, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    lb_vprintf(lb, fmt, ap);
+    va_end(ap);
+}
+
+
 static void
 lsquic_printf (const char *fmt, ...)
 {
@@ -121,6 +197,23 @@ lsquic_printf (const char *fmt, ...)
 }
 
 
+/* Terminate the message with a newline and pass it to the logger.  Only
+ * the callback itself runs under the lock.
+ */
+static void
+lb_emit (struct log_buf *lb)
+{
+    if (lb->lb_off > sizeof(lb->lb_buf) - 2)
+        lb->lb_off = sizeof(lb->lb_buf) - 2;
+    lb->lb_buf[ lb->lb_off++ ] = '\n';
+    lb->lb_buf[ lb->lb_off ] = '\0';
+
+    LOGGER_LOCK();
+    lsquic_printf("%s", lb->lb_buf);
+    LOGGER_UNLOCK();
+}
+
+
 #ifdef WIN32
 #define DELTA_EPOCH_IN_MICROSECS  11644473600000000Ui64
 struct timezone
@@ -170,7 +263,7 @@ gettimeofday (struct timeval *tv, struct timezone *tz)
 
 
 static void
-print_timestamp (void)
+print_timestamp (struct log_buf *lb, enum lsquic_logger_timestamp_style llts)
 {
     struct tm tm;
     struct timeval tv;
@@ -183,22 +276,22 @@ print_timestamp (void)
 #else    
     localtime_r(&tv.tv_sec, &tm);
 #endif    
-    if (g_llts == LLTS_YYYYMMDD_HHMMSSUS)
-        lsquic_printf("%04d-%02d-%02d %02d:%02d:%02d.%06d ",
+    if (llts == LLTS_YYYYMMDD_HHMMSSUS)
+        lb_printf(lb, "%04d-%02d-%02d %02d:%02d:%02d.%06d ",
             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
             tm.tm_hour, tm.tm_min, tm.tm_sec, (int) (tv.tv_usec));
-    else if (g_llts == LLTS_YYYYMMDD_HHMMSSMS)
-        lsquic_printf("%04d-%02d-%02d %02d:%02d:%02d.%03d ",
+    else if (llts == LLTS_YYYYMMDD_HHMMSSMS)
+        lb_printf(lb, "%04d-%02d-%02d %02d:%02d:%02d.%03d ",
             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
             tm.tm_hour, tm.tm_min, tm.tm_sec, (int) (tv.tv_usec / 1000));
-    else if (g_llts == LLTS_HHMMSSMS)
-        lsquic_printf("%02d:%02d:%02d.%03d ", tm.tm_hour, tm.tm_min,
+    else if (llts == LLTS_HHMMSSMS)
+        lb_printf(lb, "%02d:%02d:%02d.%03d ", tm.tm_hour, tm.tm_min,
                                     tm.tm_sec, (int) (tv.tv_usec / 1000));
-    else if (g_llts == LLTS_HHMMSSUS)
-        lsquic_printf("%02d:%02d:%02d.%06d ", tm.tm_hour, tm.tm_min,
+    else if (llts == LLTS_HHMMSSUS)
+        lb_printf(lb, "%02d:%02d:%02d.%06d ", tm.tm_hour, tm.tm_min,
                                     tm.tm_sec, (int) tv.tv_usec);
-    else if (g_llts == LLTS_CHROMELIKE)
-        lsquic_printf("%02d%02d/%02d%02d%02d.%06d ", tm.tm_mon + 1,
+    else if (llts == LLTS_CHROMELIKE)
+        lb_printf(lb, "%02d%02d/%02d%02d%02d.%06d ", tm.tm_mon + 1,
             tm.tm_mday,tm.tm_hour, tm.tm_min, tm.tm_sec, (int) tv.tv_usec);
 }
 
@@ -209,17 +302,20 @@ lsquic_logger_log3 (enum lsq_log_level log_level,
                     uint64_t conn_id, uint32_t stream_id, const char *fmt, ...)
 {
     const int saved_errno = errno;
+    const enum lsquic_logger_timestamp_style llts = get_llts();
+    struct log_buf lb;
+    va_list ap;
 
-    if (g_llts != LLTS_NONE)
-        print_timestamp();
+    lb.lb_off = 0;
+    if (llts != LLTS_NONE)
+        print_timestamp(&lb, llts);
 
-    lsquic_printf("[%s] [QUIC:%"PRIu64"-%"PRIu32"] %s: ",
+    lb_printf(&lb, "[%s] [QUIC:%"PRIu64"-%"PRIu32"] %s: ",
         lsq_loglevel2str[log_level], conn_id, stream_id, lsqlm_to_str[module]);
-    va_list ap;
     va_start(ap, fmt);
-    logger_if->vprintf(logger_ctx, fmt, ap);
+    lb_vprintf(&lb, fmt, ap);
     va_end(ap);
-    lsquic_printf("\n");
+    lb_emit(&lb);
     errno = saved_errno;
 }
 
@@ -230,17 +326,20 @@ lsquic_logger_log2 (enum lsq_log_level log_level,
                     uint64_t conn_id, const char *fmt, ...)
 {
     const int saved_errno = errno;
+    const enum lsquic_logger_timestamp_style llts = get_llts();
+    struct log_buf lb;
+    va_list ap;
 
-    if (g_llts != LLTS_NONE)
-        print_timestamp();
+    lb.lb_off = 0;
+    if (llts != LLTS_NONE)
+        print_timestamp(&lb, llts);
 
-    lsquic_printf("[%s] [QUIC:%"PRIu64"] %s: ",
+    lb_printf(&lb, "[%s] [QUIC:%"PRIu64"] %s: ",
         lsq_loglevel2str[log_level], conn_id, lsqlm_to_str[module]);
-    va_list ap;
     va_start(ap, fmt);
-    logger_if->vprintf(logger_ctx, fmt, ap);
+    lb_vprintf(&lb, fmt, ap);
     va_end(ap);
-    lsquic_printf("\n");
+    lb_emit(&lb);
     errno = saved_errno;
 }
 
@@ -251,17 +350,20 @@ lsquic_logger_log1 (enum lsq_log_level log_level,
                     const char *fmt, ...)
 {
     const int saved_errno = errno;
+    const enum lsquic_logger_timestamp_style llts = get_llts();
+    struct log_buf lb;
+    va_list ap;
 
-    if (g_llts != LLTS_NONE)
-        print_timestamp();
+    lb.lb_off = 0;
+    if (llts != LLTS_NONE)
+        print_timestamp(&lb, llts);
 
-    lsquic_printf("[%s] %s: ", lsq_loglevel2str[log_level],
+    lb_printf(&lb, "[%s] %s: ", lsq_loglevel2str[log_level],
                                                 lsqlm_to_str[module]);
-    va_list ap;
     va_start(ap, fmt);
-    logger_if->vprintf(logger_ctx, fmt, ap);
+    lb_vprintf(&lb, fmt, ap);
     va_end(ap);
-    lsquic_printf("\n");
+    lb_emit(&lb);
     errno = saved_errno;
 }
 
@@ -270,16 +372,19 @@ void
 lsquic_logger_log0 (enum lsq_log_level log_level, const char *fmt, ...)
 {
     const int saved_errno = errno;
+    const enum lsquic_logger_timestamp_style llts = get_llts();
+    struct log_buf lb;
+    va_list ap;
 
-    if (g_llts != LLTS_NONE)
-        print_timestamp();
+    lb.lb_off = 0;
+    if (llts != LLTS_NONE)
+        print_timestamp(&lb, llts);
 
-    lsquic_printf("[%s] ", lsq_loglevel2str[log_level]);
-    va_list ap;
+    lb_printf(&lb, "[%s] ", lsq_loglevel2str[log_level]);
     va_start(ap, fmt);
-    logger_if->vprintf(logger_ctx, fmt, ap);
+    lb_vprintf(&lb, fmt, ap);
     va_end(ap);
-    lsquic_printf("\n");
+    lb_emit(&lb);
     errno = saved_errno;
 }
 
@@ -288,10 +393,12 @@ void
 lsquic_logger_init (const struct lsquic_logger_if *lif, void *lctx,
                     unsigned llts)
 {
+    LOGGER_LOCK();
     logger_if  = lif;
     logger_ctx = lctx;
     if (llts < N_LLTS)
-        g_llts = llts;
+        set_llts(llts);
+    LOGGER_UNLOCK();
     LSQ_DEBUG("%s called", __func__);
 }
 
@@ -361,7 +468,7 @@ lsquic_logger_lopt (const char *optarg_orig)
             fprintf(stderr, "`%s' is not a valid level\n", level_str);
             break;
         }
-        lsq_log_levels[mod] = level;
+        lsq_set_module_log_level(mod, level);
         LSQ_INFO("set %s to %s", mod_str, level_str);
     }
     free(optarg);
@@ -379,7 +486,7 @@ lsquic_set_log_level (const char *level_str)
     if ((int) level >= 0)
     {
         for (i = 0; i < sizeof(lsq_log_levels) / sizeof(lsq_log_levels[0]); ++i)
-            lsq_log_levels[i] = level;
+            lsq_set_module_log_level(i, level);
         return 0;
     }
     else
@@ -70,19 +70,34 @@ enum lsquic_logger_module {
     LSQLM_SPI,
     LSQLM_DI,
     LSQLM_PACER,
+    LSQLM_BBR,
+    LSQLM_BW_SAMPLER,
+    LSQLM_PRR,
     N_LSQUIC_LOGGER_MODULES
 };
 
-/* Each module has its own log level.
+/* Each module has its own log level.  Levels may be changed while engines
+ * run in other threads: access them using the macros below.
  */
 extern enum lsq_log_level lsq_log_levels[N_LSQUIC_LOGGER_MODULES];
 
+#if __GNUC__
+#define lsq_module_log_level(module) \
+    __atomic_load_n(&lsq_log_levels[module], __ATOMIC_RELAXED)
+#define lsq_set_module_log_level(module, level) \
+    __atomic_store_n(&lsq_log_levels[module], level, __ATOMIC_RELAXED)
+#else
+#define lsq_module_log_level(module) lsq_log_levels[module]
+#define lsq_set_module_log_level(module, level) \
+    (lsq_log_levels[module] = (level))
+#endif
+
 extern const char *const lsqlm_to_str[N_LSQUIC_LOGGER_MODULES];
 
 extern const char *const lsq_loglevel2str[N_LSQUIC_LOG_LEVELS];
 
 #define LSQ_LOG_ENABLED_EXT(level, module) (                            \
-    level <= LSQUIC_LOWEST_LOG_LEVEL && level <= lsq_log_levels[module])
+    level <= LSQUIC_LOWEST_LOG_LEVEL && level <= lsq_module_log_level(module))
 
 #define LSQ_LOG_ENABLED(level) LSQ_LOG_ENABLED_EXT(level, LSQUIC_LOGGER_MODULE)
 
@@ -0,0 +1,72 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_minmax.c -- Windowed max filter.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lsquic_minmax.h"
+
+
+uint64_t
+minmax_reset (struct minmax *mm, uint64_t time, uint64_t value)
+{
+    mm->samples[0].time  = time;
+    mm->samples[0].value = value;
+    mm->samples[2] = mm->samples[1] = mm->samples[0];
+    return value;
+}
+
+
+/* The new sample did not displace the best one.  Age the samples: if the
+ * best sample fell out of the window, the second and third best move up.
+ * To keep the three samples spread over the window, the second and third
+ * best are replaced with the new sample when a quarter and a half of the
+ * window have passed, respectively.
+ */
+static uint64_t
+minmax_subwin_update (struct minmax *mm, const struct minmax_sample *sample)
+{
+    const uint64_t dt = sample->time - mm->samples[0].time;
+
+    if (dt > mm->window)
+    {
+        mm->samples[0] = mm->samples[1];
+        mm->samples[1] = mm->samples[2];
+        mm->samples[2] = *sample;
+        if (sample->time - mm->samples[0].time > mm->window)
+        {
+            mm->samples[0] = mm->samples[1];
+            mm->samples[1] = mm->samples[2];
+            mm->samples[2] = *sample;
+        }
+    }
+    else if (mm->samples[1].time == mm->samples[0].time
+                                                && dt > mm->window / 4)
+        mm->samples[2] = mm->samples[1] = *sample;
+    else if (mm->samples[2].time == mm->samples[1].time
+                                                && dt > mm->window / 2)
+        mm->samples[2] = *sample;
+
+    return mm->samples[0].value;
+}
+
+
+uint64_t
+minmax_upmax (struct minmax *mm, uint64_t time, uint64_t value)
+{
+    const struct minmax_sample sample = { time, value, };
+
+    if (value >= mm->samples[0].value
+                    || time - mm->samples[2].time > mm->window)
+        return minmax_reset(mm, time, value);
+
+    if (value >= mm->samples[1].value)
+        mm->samples[2] = mm->samples[1] = sample;
+    else if (value >= mm->samples[2].value)
+        mm->samples[2] = sample;
+
+    return minmax_subwin_update(mm, &sample);
+}
+
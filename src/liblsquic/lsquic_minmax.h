@@ -0,0 +1,40 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_minmax.h -- Windowed max filter.
+ *
+ * The filter keeps the best, second best, and third best values seen
+ * in the window, following Kathleen Nichols' algorithm.  Time is in
+ * arbitrary units: BBR uses round trip counts for its bandwidth filter.
+ */
+
+#ifndef LSQUIC_MINMAX_H
+#define LSQUIC_MINMAX_H 1
+
+struct minmax_sample
+{
+    uint64_t    time;
+    uint64_t    value;
+};
+
+struct minmax
+{
+    uint64_t                window;
+    struct minmax_sample    samples[3];
+};
+
+#define minmax_init(mm, win) do {                                           \
+    memset((mm), 0, sizeof(*(mm)));                                        \
+    (mm)->window = (win);                                                   \
+} while (0)
+
+#define minmax_get(mm) (+(mm)->samples[0].value)
+
+/* Forget all samples and start over with this one. */
+uint64_t
+minmax_reset (struct minmax *, uint64_t time, uint64_t value);
+
+/* Update the max filter and return the new maximum. */
+uint64_t
+minmax_upmax (struct minmax *, uint64_t time, uint64_t value);
+
+#endif
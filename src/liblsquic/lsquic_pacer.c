@@ -53,11 +53,11 @@ pacer_cleanup (struct pacer *pacer)
 }
 
 
-void
+lsquic_time_t
 pacer_packet_scheduled (struct pacer *pacer, unsigned n_in_flight,
                             int in_recovery, tx_time_f tx_time, void *tx_ctx)
 {
-    lsquic_time_t delay, sched_time;
+    lsquic_time_t delay, sched_time, departure;
     int app_limited, making_up;
 
 #ifndef NDEBUG
@@ -77,13 +77,14 @@ pacer_packet_scheduled (struct pacer *pacer, unsigned n_in_flight,
         pacer->pa_next_sched = 0;
         pacer->pa_last_delayed = 0;
         LSQ_DEBUG("%s: tokens: %u", __func__, pacer->pa_burst_tokens);
-        return;
+        return 0;
     }
 
     sched_time = pacer->pa_now;
     delay = tx_time(tx_ctx);
     if (pacer->pa_flags & PA_LAST_SCHED_DELAYED)
     {
+        departure = pacer->pa_next_sched;
         pacer->pa_next_sched += delay;
         app_limited = pacer->pa_last_delayed != 0
             && pacer->pa_last_delayed + delay <= sched_time;
@@ -98,10 +99,13 @@ pacer_packet_scheduled (struct pacer *pacer, unsigned n_in_flight,
         }
     }
     else
-        pacer->pa_next_sched = MAX(pacer->pa_next_sched + delay,
-                                                    sched_time + delay);
+    {
+        departure = MAX(pacer->pa_next_sched, sched_time);
+        pacer->pa_next_sched = departure + delay;
+    }
     LSQ_DEBUG("next_sched is set to %"PRIu64" usec from now",
                                 pacer->pa_next_sched - lsquic_time_now());
+    return departure;
 }
 
 
@@ -116,7 +120,7 @@ pacer_loss_event (struct pacer *pacer)
 static unsigned
 clock_granularity (const struct pacer *pacer)
 {
-    return pacer->pa_intertick_avg;
+    return MAX(pacer->pa_intertick_avg, pacer->pa_horizon);
 }
 
 
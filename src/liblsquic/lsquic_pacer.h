@@ -13,6 +13,12 @@ struct pacer
 
     unsigned        pa_max_intertick;   /* Maximum intertick time */
 
+    /* If set, packets are scheduled at least this far ahead.  This is
+     * used when packets are given departure times and the kernel paces
+     * them.
+     */
+    unsigned        pa_horizon;
+
     /* We keep an average of intertick times, which is our best estimate
      * for the time when the connection ticks next.  This estimate is used
      * to see whether a packet can be scheduled or not.
@@ -50,7 +56,10 @@ pacer_tick (struct pacer *, lsquic_time_t);
 int
 pacer_can_schedule (struct pacer *, unsigned n_in_flight);
 
-void
+/* Returns intended departure time of the packet or zero if the packet
+ * can be sent right away.
+ */
+lsquic_time_t
 pacer_packet_scheduled (struct pacer *pacer, unsigned n_in_flight,
                         int in_recovery, tx_time_f tx_time, void *tx_ctx);
 
@@ -59,4 +68,12 @@ pacer_loss_event (struct pacer *);
 
 #define pacer_next_sched(pacer) (+(pacer)->pa_next_sched)
 
+#define pacer_set_horizon(pacer, usec) do { (pacer)->pa_horizon = (usec); } while (0)
+
+/* When to tick next so that the next packet can be scheduled in time */
+#define pacer_next_tick(pacer) ((pacer)->pa_next_sched - (pacer)->pa_horizon)
+
+/* True if the last scheduling attempt had to be delayed */
+#define pacer_delayed(pacer) ((pacer)->pa_flags & PA_LAST_SCHED_DELAYED)
+
 #endif
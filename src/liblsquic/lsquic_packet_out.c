@@ -279,6 +279,8 @@ lsquic_packet_out_destroy (lsquic_packet_out_t *packet_out,
                                                 packet_out->po_enc_data);
     if (packet_out->po_nonce)
         free(packet_out->po_nonce);
+    if (packet_out->po_bwp_state)
+        lsquic_malo_put(packet_out->po_bwp_state);
     lsquic_mm_put_packet_out(&enpub->enp_mm, packet_out);
 }
 
@@ -57,12 +57,13 @@ TAILQ_HEAD(stream_rec_arr_tailq, stream_rec_arr);
 
 typedef struct lsquic_packet_out
 {
-    /* `po_next' is used for packets_out, unacked_packets and expired_packets
-     * lists.
+    /* `po_next' is used for packets_out and expired_packets lists.  Unacked
+     * packets are kept in a window, see lsquic_sentwin.h.
      */
     TAILQ_ENTRY(lsquic_packet_out)
                        po_next;
     lsquic_time_t      po_sent;       /* Time sent */
+    lsquic_time_t      po_tx_time;    /* Departure time set by pacer, or 0 */
     lsquic_packno_t    po_packno;
 
     enum packet_out_flags {
@@ -117,6 +118,10 @@ typedef struct lsquic_packet_out
 
     lsquic_ver_tag_t   po_ver_tag;      /* Set if PO_VERSION is set */
     unsigned char     *po_nonce;        /* Use to generate header if PO_NONCE is set */
+    /* Delivery rate sampling state.  Only used by congestion controllers
+     * that need it, see lsquic_bw_sampler.h.
+     */
+    struct bwp_state  *po_bwp_state;
 } lsquic_packet_out_t;
 
 /* The size of lsquic_packet_out_t could be further reduced:
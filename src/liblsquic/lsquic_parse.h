@@ -51,6 +51,32 @@ typedef const struct lsquic_packno_range *
 typedef lsquic_time_t
     (*gaf_rechist_largest_recv_f)   (void *rechist);
 
+/* ACK frame always fits into one packet */
+#define ACK_GEN_CACHE_SZ QUIC_MAX_PAYLOAD_SZ
+
+/* ACK blocks that follow the first (largest) range, as they were last
+ * encoded by pf_gen_ack_frame().  When packets arrive in order, only the
+ * first range grows and these blocks are copied instead of being encoded
+ * again.
+ *
+ * Before each call, the caller sets agc_version to a value that changes
+ * whenever anything other than the high end of the first range changes.
+ */
+struct ack_gen_cache
+{
+    unsigned            agc_version;        /* Set by the caller */
+    unsigned            agc_cached_version;
+    unsigned            agc_n_ranges;       /* Including the first range */
+    lsquic_packno_t     agc_maxdiff;        /* Largest range below first */
+    unsigned short      agc_sz;             /* Zero means cache is empty */
+    unsigned char       agc_n_blocks;
+    unsigned char       agc_block_len;
+    unsigned char       agc_blocks[ACK_GEN_CACHE_SZ];
+};
+
+#define ack_gen_cache_valid(cache) ((cache) && (cache)->agc_sz &&        \
+                    (cache)->agc_cached_version == (cache)->agc_version)
+
 /* gsf_: generate stream frame */
 typedef size_t (*gsf_read_f) (void *stream, void *buf, size_t len, int *fin);
 
@@ -97,7 +123,8 @@ struct parse_funcs
     (*pf_gen_ack_frame) (unsigned char *outbuf, size_t outbuf_sz,
                 gaf_rechist_first_f, gaf_rechist_next_f,
                 gaf_rechist_largest_recv_f, void *rechist, lsquic_time_t now,
-                int *has_missing, lsquic_packno_t *largest_received);
+                int *has_missing, lsquic_packno_t *largest_received,
+                struct ack_gen_cache *);
     int
     (*pf_gen_stop_waiting_frame) (unsigned char *buf, size_t buf_len,
                     lsquic_packno_t cur_packno, enum lsquic_packno_bits,
@@ -176,6 +203,12 @@ int
 parse_packet_in_begin (struct lsquic_packet_in *, size_t length,
                                 int is_server, struct packin_parse_state *);
 
+void
+ack_gen_cache_save (struct ack_gen_cache *, unsigned n_ranges,
+                    lsquic_packno_t maxdiff, unsigned block_len,
+                    const unsigned char *blocks, unsigned sz,
+                    unsigned n_blocks);
+
 enum QUIC_FRAME_TYPE
 parse_frame_type_gquic_Q035_thru_Q039 (unsigned char first_byte);
 
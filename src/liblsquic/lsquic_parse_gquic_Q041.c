@@ -362,7 +362,7 @@ gquic_ietf_gen_ack_frame (unsigned char *outbuf, size_t outbuf_sz,
         gaf_rechist_first_f rechist_first, gaf_rechist_next_f rechist_next,
         gaf_rechist_largest_recv_f rechist_largest_recv,
         void *rechist, lsquic_time_t now, int *has_missing,
-        lsquic_packno_t *largest_received)
+        lsquic_packno_t *largest_received, struct ack_gen_cache *cache)
 {
     lsquic_time_t time_diff;
     lsquic_packno_t tmp_packno;
@@ -408,17 +408,34 @@ gquic_ietf_gen_ack_frame (unsigned char *outbuf, size_t outbuf_sz,
     largest_acked_len = twobit_to_1248(bits);
     *type |= bits << 2;
 
-    /* Calculate largest ACK block length and set `MM' bits: */
-    unsigned n_ranges = 0;
-    lsquic_packno_t maxdiff = 0;
+    /* Calculate largest ACK block length and set `MM' bits.  If the
+     * ranges below the first one have not changed, use cached values:
+     */
+    unsigned n_ranges;
+    lsquic_packno_t maxdiff, tail_maxdiff;
     const struct lsquic_packno_range *range;
-    for (range = rechist_first(rechist); range; range = rechist_next(rechist))
+    const int use_cache = ack_gen_cache_valid(cache);
+    if (use_cache)
     {
-        ++n_ranges;
-        const lsquic_packno_t diff = range->high - range->low + 1;
-        if (diff > maxdiff)
-            maxdiff = diff;
+        n_ranges = cache->agc_n_ranges;
+        tail_maxdiff = cache->agc_maxdiff;
+    }
+    else
+    {
+        n_ranges = 1;
+        tail_maxdiff = 0;
+        for (range = rechist_next(rechist); range;
+                                            range = rechist_next(rechist))
+        {
+            ++n_ranges;
+            const lsquic_packno_t diff = range->high - range->low + 1;
+            if (diff > tail_maxdiff)
+                tail_maxdiff = diff;
+        }
     }
+    maxdiff = first_high - first_low + 1;
+    if (tail_maxdiff > maxdiff)
+        maxdiff = tail_maxdiff;
     bits = (maxdiff >= (1ULL <<  8))
          + (maxdiff >= (1ULL << 16))
          + (maxdiff >= (1ULL << 32));
@@ -471,40 +488,56 @@ gquic_ietf_gen_ack_frame (unsigned char *outbuf, size_t outbuf_sz,
          *  2. We run out of room.
          *  3. We run out of highest possible number of ACK blocks (0xFF).
          */
-        range = rechist_first(rechist);
-        lsquic_packno_t gap = 0;
-        n_ranges = 0;
-        do {
-            if (0 == gap)
-            {
-                const lsquic_packno_t prev_low = range->low;
-                range = rechist_next(rechist);
-                if (!range)
-                    break;
-                gap = prev_low - range->high - 1;
-            }
-            if (gap >= 0x100)
-            {
-                *p = 0xFF;
-                gap -= 0xFF;
-                memset(p + 1, 0, ack_block_len);
-            }
-            else
-            {
-                *p = gap;
-                gap = 0;
-                diff = range->high - range->low + 1;
+        if (use_cache && cache->agc_block_len == ack_block_len
+                            && AVAIL() >= (intptr_t) cache->agc_sz + 1)
+        {
+            memcpy(p, cache->agc_blocks, cache->agc_sz);
+            p += cache->agc_sz;
+            *n_ranges_p = cache->agc_n_blocks;
+        }
+        else
+        {
+            unsigned char *const blocks = p;
+            const unsigned n_all_ranges = n_ranges;
+            range = rechist_first(rechist);
+            lsquic_packno_t gap = 0;
+            n_ranges = 0;
+            do {
+                if (0 == gap)
+                {
+                    const lsquic_packno_t prev_low = range->low;
+                    range = rechist_next(rechist);
+                    if (!range)
+                        break;
+                    gap = prev_low - range->high - 1;
+                }
+                if (gap >= 0x100)
+                {
+                    *p = 0xFF;
+                    gap -= 0xFF;
+                    memset(p + 1, 0, ack_block_len);
+                }
+                else
+                {
+                    *p = gap;
+                    gap = 0;
+                    diff = range->high - range->low + 1;
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-                diff = bswap_64(diff);
+                    diff = bswap_64(diff);
 #endif
-                memcpy(p + 1, (unsigned char *) &diff + 8 - ack_block_len,
-                                                                ack_block_len);
-            }
-            p += ack_block_len + 1;
-            ++n_ranges;
-        } while (n_ranges < 0xFF &&
-                 AVAIL() >= (intptr_t) ack_block_len + 1 + 1 /* timestamp byte */);
-        *n_ranges_p = n_ranges;
+                    memcpy(p + 1, (unsigned char *) &diff + 8 - ack_block_len,
+                                                            ack_block_len);
+                }
+                p += ack_block_len + 1;
+                ++n_ranges;
+            } while (n_ranges < 0xFF && AVAIL() >=
+                        (intptr_t) ack_block_len + 1 + 1 /* timestamp byte */);
+            *n_ranges_p = n_ranges;
+            /* Blocks cut short for lack of room are not cached */
+            if (cache && (!range || n_ranges == 0xFF))
+                ack_gen_cache_save(cache, n_all_ranges, tail_maxdiff,
+                        ack_block_len, blocks, p - blocks, n_ranges);
+        }
     }
     else
     {
@@ -655,6 +655,31 @@ static const enum QUIC_FRAME_TYPE byte2frame_type_Q041[0x100] =
 };
 
 
+/* Remember ACK blocks that follow the first range.  `n_ranges' and
+ * `maxdiff' describe the ranges the blocks were encoded from.
+ */
+void
+ack_gen_cache_save (struct ack_gen_cache *cache, unsigned n_ranges,
+                    lsquic_packno_t maxdiff, unsigned block_len,
+                    const unsigned char *blocks, unsigned sz,
+                    unsigned n_blocks)
+{
+    if (sz > sizeof(cache->agc_blocks))
+    {
+        cache->agc_sz = 0;
+        return;
+    }
+
+    memcpy(cache->agc_blocks, blocks, sz);
+    cache->agc_sz             = sz;
+    cache->agc_n_blocks       = n_blocks;
+    cache->agc_block_len      = block_len;
+    cache->agc_n_ranges       = n_ranges;
+    cache->agc_maxdiff        = maxdiff;
+    cache->agc_cached_version = cache->agc_version;
+}
+
+
 enum QUIC_FRAME_TYPE
 parse_frame_type_gquic_Q035_thru_Q039 (unsigned char b)
 {
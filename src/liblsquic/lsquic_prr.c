@@ -0,0 +1,80 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_prr.c -- Proportional Rate Reduction (RFC 6937).
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lsquic_int_types.h"
+#include "lsquic_types.h"
+#include "lsquic_prr.h"
+
+#define LSQUIC_LOGGER_MODULE LSQLM_PRR
+#define LSQUIC_LOG_CONN_ID prr->prr_cid
+#include "lsquic_logger.h"
+
+
+void
+lsquic_prr_init (struct lsquic_prr *prr, lsquic_cid_t cid, unsigned mss,
+                        unsigned long recover_fs, unsigned long ssthresh)
+{
+    memset(prr, 0, sizeof(*prr));
+    prr->prr_cid        = cid;
+    prr->prr_mss        = mss;
+    prr->prr_recover_fs = recover_fs ? recover_fs : 1;
+    prr->prr_ssthresh   = ssthresh;
+    /* Let the first retransmission go out even if no ACK comes */
+    prr->prr_limit      = mss;
+    LSQ_DEBUG("enter recovery: recover_fs: %lu; ssthresh: %lu",
+                                                    recover_fs, ssthresh);
+}
+
+
+void
+lsquic_prr_ack (struct lsquic_prr *prr, unsigned long delivered,
+                                                        unsigned long pipe)
+{
+    uint64_t target, sndcnt, limit;
+
+    prr->prr_delivered += delivered;
+
+    if (pipe > prr->prr_ssthresh)
+    {
+        /* Proportional part: send ssthresh/recover_fs bytes for each byte
+         * delivered.
+         */
+        target = (prr->prr_delivered * prr->prr_ssthresh
+                        + prr->prr_recover_fs - 1) / prr->prr_recover_fs;
+        if (target > prr->prr_out)
+            sndcnt = target - prr->prr_out;
+        else
+            sndcnt = 0;
+    }
+    else
+    {
+        /* Slow start reduction bound: grow back to ssthresh no faster than
+         * slow start would.
+         */
+        if (prr->prr_delivered > prr->prr_out)
+            limit = prr->prr_delivered - prr->prr_out;
+        else
+            limit = 0;
+        if (limit < delivered)
+            limit = delivered;
+        limit += prr->prr_mss;
+        sndcnt = prr->prr_ssthresh - pipe;
+        if (sndcnt > limit)
+            sndcnt = limit;
+    }
+
+    /* Fast retransmit */
+    if (sndcnt == 0 && prr->prr_out == 0)
+        sndcnt = prr->prr_mss;
+
+    prr->prr_limit = prr->prr_out + sndcnt;
+    LSQ_DEBUG("delivered: %lu; pipe: %lu; prr_delivered: %"PRIu64"; "
+        "prr_out: %"PRIu64"; sndcnt: %"PRIu64, delivered, pipe,
+        prr->prr_delivered, prr->prr_out, sndcnt);
+}
@@ -0,0 +1,44 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_prr.h -- Proportional Rate Reduction (RFC 6937).
+ *
+ * During loss recovery, PRR takes the place of the congestion window:
+ * it lets the number of bytes sent track the number of bytes delivered,
+ * so that bytes in flight come down to ssthresh gradually instead of
+ * sending stopping and starting again in a burst.
+ */
+
+#ifndef LSQUIC_PRR_H
+#define LSQUIC_PRR_H 1
+
+struct lsquic_prr
+{
+    lsquic_cid_t    prr_cid;            /* Used for logging */
+    uint64_t        prr_delivered;      /* Bytes delivered during recovery */
+    uint64_t        prr_out;            /* Bytes sent during recovery */
+    uint64_t        prr_limit;          /* prr_out may grow up to this */
+    unsigned long   prr_recover_fs;     /* cwnd when recovery began */
+    unsigned long   prr_ssthresh;       /* cwnd after the cut */
+    unsigned        prr_mss;
+};
+
+/* Called when recovery begins. */
+void
+lsquic_prr_init (struct lsquic_prr *, lsquic_cid_t, unsigned mss,
+                    unsigned long recover_fs, unsigned long ssthresh);
+
+/* Called for each ACK received during recovery, including the one that
+ * started it.  `pipe' is the number of bytes in flight after the ACK has
+ * been processed.
+ */
+void
+lsquic_prr_ack (struct lsquic_prr *, unsigned long delivered,
+                                                    unsigned long pipe);
+
+#define lsquic_prr_sent(prr, bytes) do {                                \
+    (prr)->prr_out += (bytes);                                          \
+} while (0)
+
+#define lsquic_prr_can_send(prr) ((prr)->prr_out < (prr)->prr_limit)
+
+#endif
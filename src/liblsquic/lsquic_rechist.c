@@ -21,13 +21,15 @@
 #include "lsquic_logger.h"
 
 
+#define INITIAL_NALLOC 4
+
+
 void
 lsquic_rechist_init (struct lsquic_rechist *rechist, lsquic_cid_t cid)
 {
     memset(rechist, 0, sizeof(*rechist));
     rechist->rh_cid = cid;
     rechist->rh_cutoff = 1;
-    lsquic_packints_init(&rechist->rh_pints);
     LSQ_DEBUG("instantiated received packet history");
 }
 
@@ -35,19 +37,129 @@ lsquic_rechist_init (struct lsquic_rechist *rechist, lsquic_cid_t cid)
 void
 lsquic_rechist_cleanup (lsquic_rechist_t *rechist)
 {
-    lsquic_packints_cleanup(&rechist->rh_pints);
+    free(rechist->rh_ranges);
     memset(rechist, 0, sizeof(*rechist));
 }
 
 
+#if LSQUIC_RECHIST_SANITY_CHECK
+static void
+rechist_sanity_check (const struct lsquic_rechist *rechist)
+{
+    unsigned i;
+
+    for (i = 0; i < rechist->rh_n_ranges; ++i)
+    {
+        assert(rechist->rh_ranges[i].low <= rechist->rh_ranges[i].high);
+        if (i > 0)
+            assert(rechist->rh_ranges[i - 1].high + 1
+                                            < rechist->rh_ranges[i].low);
+    }
+}
+#else
+#   define rechist_sanity_check(rechist)
+#endif
+
+
+/* Forget the smallest range.  Packets up to its high end are now
+ * considered to be duplicates.
+ */
+static void
+rechist_forget_smallest (struct lsquic_rechist *rechist)
+{
+    struct lsquic_packno_range *const ranges = rechist->rh_ranges;
+
+    assert(rechist->rh_n_ranges > 1);
+    LSQ_DEBUG("too many ranges: forget [%"PRIu64"-%"PRIu64"]",
+                                            ranges[0].high, ranges[0].low);
+    rechist->rh_n_packets -= (unsigned) (ranges[0].high - ranges[0].low + 1);
+    rechist->rh_forgotten = ranges[0].high + 1;
+    --rechist->rh_n_ranges;
+    memmove(ranges, ranges + 1, rechist->rh_n_ranges * sizeof(ranges[0]));
+}
+
+
+/* Insert new range [packno, packno] at position `idx'.  Returns the
+ * position of the new range or -1 if the packet cannot be tracked.
+ */
+static int
+rechist_insert (struct lsquic_rechist *rechist, unsigned idx,
+                                                    lsquic_packno_t packno)
+{
+    struct lsquic_packno_range *ranges;
+    unsigned nalloc;
+
+    if (rechist->rh_n_ranges >= rechist->rh_n_alloc)
+    {
+        if (rechist->rh_n_alloc < LSQUIC_RECHIST_MAX_RANGES)
+        {
+            if (rechist->rh_n_alloc)
+                nalloc = rechist->rh_n_alloc * 2;
+            else
+                nalloc = INITIAL_NALLOC;
+            if (nalloc > LSQUIC_RECHIST_MAX_RANGES)
+                nalloc = LSQUIC_RECHIST_MAX_RANGES;
+            ranges = realloc(rechist->rh_ranges, nalloc * sizeof(ranges[0]));
+            if (!ranges)
+                return -1;
+            rechist->rh_ranges = ranges;
+            rechist->rh_n_alloc = nalloc;
+        }
+        else if (idx == 0)
+        {
+            LSQ_DEBUG("too many ranges: packet %"PRIu64" is too old to "
+                                                        "track", packno);
+            return -1;
+        }
+        else
+        {
+            rechist_forget_smallest(rechist);
+            --idx;
+        }
+    }
+
+    ranges = rechist->rh_ranges;
+    memmove(ranges + idx + 1, ranges + idx,
+                        (rechist->rh_n_ranges - idx) * sizeof(ranges[0]));
+    ranges[idx].low = ranges[idx].high = packno;
+    ++rechist->rh_n_ranges;
+    return (int) idx;
+}
+
+
+/* Returns index of the largest range whose low end is not larger than
+ * `packno' or -1 if there is no such range.
+ */
+static int
+rechist_find (const struct lsquic_rechist *rechist, lsquic_packno_t packno)
+{
+    const struct lsquic_packno_range *const ranges = rechist->rh_ranges;
+    unsigned low, high, mid;
+
+    low = 0, high = rechist->rh_n_ranges;
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (ranges[mid].low <= packno)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return (int) low - 1;
+}
+
+
 enum received_st
 lsquic_rechist_received (lsquic_rechist_t *rechist, lsquic_packno_t packno,
                          lsquic_time_t now)
 {
-    const struct lsquic_packno_range *first_range;
+    struct lsquic_packno_range *ranges;
+    unsigned n;
+    int idx;
 
     LSQ_DEBUG("received %"PRIu64, packno);
-    if (packno < rechist->rh_cutoff)
+    if (packno < rechist->rh_cutoff || packno < rechist->rh_forgotten)
     {
         if (packno)
             return REC_ST_DUP;
@@ -55,28 +167,97 @@ lsquic_rechist_received (lsquic_rechist_t *rechist, lsquic_packno_t packno,
             return REC_ST_ERR;
     }
 
-    first_range = lsquic_packints_first(&rechist->rh_pints);
-    if (!first_range || packno > first_range->high)
+    ranges = rechist->rh_ranges;
+    n = rechist->rh_n_ranges;
+
+    /* Fast path: packets arrive in order */
+    if (n && packno == ranges[n - 1].high + 1)
+    {
+        ranges[n - 1].high = packno;
         rechist->rh_largest_acked_received = now;
+        goto ok;
+    }
 
-    switch (lsquic_packints_add(&rechist->rh_pints, packno))
+    if (0 == n || packno > ranges[n - 1].high)
     {
-    case PACKINTS_OK:
-        ++rechist->rh_n_packets;
-        return REC_ST_OK;
-    case PACKINTS_DUP:
+        if (0 > rechist_insert(rechist, n, packno))
+            return REC_ST_ERR;
+        rechist->rh_largest_acked_received = now;
+        ++rechist->rh_version;
+        goto ok;
+    }
+
+    idx = rechist_find(rechist, packno);
+    if (idx >= 0 && packno <= ranges[idx].high)
         return REC_ST_DUP;
-    default:
-        assert(0);
-    case PACKINTS_ERR:
-        return REC_ST_ERR;
+
+    /* Packet is in the gap between ranges `idx' and `idx + 1'.  There is
+     * always a range above it, as the larger packets are handled above.
+     */
+    if (idx >= 0 && ranges[idx].high + 1 == packno)
+    {
+        if (ranges[idx + 1].low - 1 == packno)
+        {
+            /* Packet closes the gap: merge two ranges */
+            ranges[idx].high = ranges[idx + 1].high;
+            --rechist->rh_n_ranges;
+            memmove(ranges + idx + 1, ranges + idx + 2,
+                    (rechist->rh_n_ranges - idx - 1) * sizeof(ranges[0]));
+        }
+        else
+            ranges[idx].high = packno;
+    }
+    else if (ranges[idx + 1].low - 1 == packno)
+        ranges[idx + 1].low = packno;
+    else if (0 > rechist_insert(rechist, idx + 1, packno))
+    {
+        if (rechist->rh_n_ranges < LSQUIC_RECHIST_MAX_RANGES)
+            return REC_ST_ERR;
+        else
+            return REC_ST_DUP;
+    }
+
+    ++rechist->rh_version;
+
+  ok:
+    ++rechist->rh_n_packets;
+    rechist_sanity_check(rechist);
+    return REC_ST_OK;
+}
+
+
+enum received_st
+lsquic_rechist_check (const lsquic_rechist_t *rechist, lsquic_packno_t packno)
+{
+    const struct lsquic_packno_range *const ranges = rechist->rh_ranges;
+    const unsigned n = rechist->rh_n_ranges;
+    int idx;
+
+    if (packno < rechist->rh_cutoff || packno < rechist->rh_forgotten)
+    {
+        if (packno)
+            return REC_ST_DUP;
+        else
+            return REC_ST_ERR;
     }
+
+    if (0 == n || packno > ranges[n - 1].high)
+        return REC_ST_OK;
+
+    idx = rechist_find(rechist, packno);
+    if (idx >= 0 && packno <= ranges[idx].high)
+        return REC_ST_DUP;
+    else
+        return REC_ST_OK;
 }
 
 
 void
 lsquic_rechist_stop_wait (lsquic_rechist_t *rechist, lsquic_packno_t cutoff)
 {
+    struct lsquic_packno_range *const ranges = rechist->rh_ranges;
+    unsigned n;
+
     LSQ_INFO("stop wait: %"PRIu64, cutoff);
 
     if (rechist->rh_flags & RH_CUTOFF_SET)
@@ -88,36 +269,30 @@ lsquic_rechist_stop_wait (lsquic_rechist_t *rechist, lsquic_packno_t cutoff)
 
     rechist->rh_cutoff = cutoff;
     rechist->rh_flags |= RH_CUTOFF_SET;
-    struct packet_interval *pi, *next;
-    for (pi = TAILQ_FIRST(&rechist->rh_pints.pk_intervals); pi; pi = next)
+    ++rechist->rh_version;
+
+    for (n = 0; n < rechist->rh_n_ranges && ranges[n].high < cutoff; ++n)
+        rechist->rh_n_packets -=
+                            (unsigned) (ranges[n].high - ranges[n].low + 1);
+    if (n)
     {
-        next = TAILQ_NEXT(pi, next_pi);
-        if (pi->range.low < cutoff)
-        {
-            if (pi->range.high < cutoff)
-            {
-                rechist->rh_n_packets -= (unsigned)(pi->range.high - pi->range.low + 1);
-                TAILQ_REMOVE(&rechist->rh_pints.pk_intervals, pi, next_pi);
-                free(pi);
-            }
-            else
-            {
-                rechist->rh_n_packets -= (unsigned)(cutoff - pi->range.low);
-                pi->range.low = cutoff;
-            }
-        }
+        rechist->rh_n_ranges -= n;
+        memmove(ranges, ranges + n, rechist->rh_n_ranges * sizeof(ranges[0]));
     }
-    lsquic_packints_sanity_check(&rechist->rh_pints);
+    if (rechist->rh_n_ranges && ranges[0].low < cutoff)
+    {
+        rechist->rh_n_packets -= (unsigned) (cutoff - ranges[0].low);
+        ranges[0].low = cutoff;
+    }
+    rechist_sanity_check(rechist);
 }
 
 
 lsquic_packno_t
 lsquic_rechist_largest_packno (const lsquic_rechist_t *rechist)
 {
-    const struct packet_interval *pi =
-                                TAILQ_FIRST(&rechist->rh_pints.pk_intervals);
-    if (pi)
-        return pi->range.high;
+    if (rechist->rh_n_ranges)
+        return rechist->rh_ranges[ rechist->rh_n_ranges - 1 ].high;
     else
         return 0;   /* Don't call this function if history is empty */
 }
@@ -140,17 +315,22 @@ lsquic_rechist_largest_recv (const lsquic_rechist_t *rechist)
 }
 
 
+/* Ranges are returned from largest to smallest */
 const struct lsquic_packno_range *
 lsquic_rechist_first (lsquic_rechist_t *rechist)
 {
-    return lsquic_packints_first(&rechist->rh_pints);
+    rechist->rh_iter = rechist->rh_n_ranges;
+    return lsquic_rechist_next(rechist);
 }
 
 
 const struct lsquic_packno_range *
 lsquic_rechist_next (lsquic_rechist_t *rechist)
 {
-    return lsquic_packints_next(&rechist->rh_pints);
+    if (rechist->rh_iter > 0)
+        return &rechist->rh_ranges[ --rechist->rh_iter ];
+    else
+        return NULL;
 }
 
 
@@ -158,6 +338,5 @@ size_t
 lsquic_rechist_mem_used (const struct lsquic_rechist *rechist)
 {
     return sizeof(*rechist)
-         - sizeof(rechist->rh_pints)
-         + lsquic_packints_mem_used(&rechist->rh_pints);
+         + rechist->rh_n_alloc * sizeof(rechist->rh_ranges[0]);
 }
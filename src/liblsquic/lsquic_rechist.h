@@ -3,21 +3,37 @@
  * lsquic_rechist.h -- History of received packets.
  *
  * The purpose of received packet history is to generate ACK frames.
+ *
+ * Received packets are kept as ranges in an array ordered from smallest
+ * to largest, so that a packet received in order extends the last range
+ * in place.  The array never holds more than LSQUIC_RECHIST_MAX_RANGES
+ * ranges -- more than fit into an ACK frame.  When a new range does not
+ * fit, the smallest range is forgotten and packets up to and including
+ * its high end are treated as duplicates.  This is similar to Chromium's
+ * kMaxTrackedPackets limit.
  */
 
 #ifndef LSQUIC_RECHIST_H
 #define LSQUIC_RECHIST_H 1
 
-#include "lsquic_packints.h"
+#define LSQUIC_RECHIST_SANITY_CHECK 0
+
+#define LSQUIC_RECHIST_MAX_RANGES 256
 
 struct lsquic_rechist {
-    struct packints                 rh_pints;
+    struct lsquic_packno_range     *rh_ranges;
+    unsigned                        rh_n_ranges;
+    unsigned                        rh_n_alloc;
+    unsigned                        rh_iter;       /* Used by first/next */
+    /* Incremented on every change except in-order growth of the largest
+     * range.  This is used to cache encoded ACK blocks.
+     */
+    unsigned                        rh_version;
     lsquic_packno_t                 rh_cutoff;
+    /* Packets below this number have been forgotten */
+    lsquic_packno_t                 rh_forgotten;
     lsquic_time_t                   rh_largest_acked_received;
     lsquic_cid_t                    rh_cid;        /* Used for logging */
-    /* Chromium limits the number of tracked packets (see
-     * kMaxTrackedPackets).  We could do this, too.
-     */
     unsigned                        rh_n_packets;
     enum {
         RH_CUTOFF_SET   = (1 << 0),
@@ -42,6 +58,12 @@ enum received_st
 lsquic_rechist_received (lsquic_rechist_t *, lsquic_packno_t,
                          lsquic_time_t now);
 
+/* Check whether packet is a duplicate without recording it.  This is used
+ * to drop duplicates before decrypting them.
+ */
+enum received_st
+lsquic_rechist_check (const lsquic_rechist_t *, lsquic_packno_t);
+
 void
 lsquic_rechist_stop_wait (lsquic_rechist_t *, lsquic_packno_t);
 
@@ -66,6 +88,8 @@ lsquic_rechist_cutoff (const lsquic_rechist_t *);
 lsquic_time_t
 lsquic_rechist_largest_recv (const lsquic_rechist_t *);
 
+#define lsquic_rechist_version(rechist) (+(rechist)->rh_version)
+
 size_t
 lsquic_rechist_mem_used (const struct lsquic_rechist *);
 
@@ -22,6 +22,8 @@ void
 lsquic_rtt_stats_update (struct lsquic_rtt_stats *stats,
                          lsquic_time_t send_delta, lsquic_time_t lack_delta)
 {
+    if (!stats->min_rtt || send_delta < stats->min_rtt)
+        stats->min_rtt = send_delta;
     if (send_delta > lack_delta)
         send_delta -= lack_delta;
     if (stats->srtt) {
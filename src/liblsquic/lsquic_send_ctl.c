@@ -20,8 +20,14 @@
 #include "lsquic_parse.h"
 #include "lsquic_packet_out.h"
 #include "lsquic_senhist.h"
+#include "lsquic_sentwin.h"
 #include "lsquic_rtt.h"
+#include "lsquic_cong_ctl.h"
 #include "lsquic_cubic.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_prr.h"
 #include "lsquic_pacer.h"
 #include "lsquic_send_ctl.h"
 #include "lsquic_util.h"
@@ -44,6 +50,14 @@
 #define MAX_RTO_DELAY           60000000    /* Microseconds */
 #define MIN_RTO_DELAY           1000000      /* Microseconds */
 #define N_NACKS_BEFORE_RETX     3
+#define MAX_REORD_THRESH        32
+#define MAX_REO_WND_MULT        4       /* Times min_rtt / 4 */
+#define REO_WND_PERSIST         16      /* Loss events */
+#define WC_DEL_ACK_TIME         25000   /* Peer's maximum ACK delay, usec */
+#define MAX_LOST_RECS           256
+
+/* Pointer to congestion controller state */
+#define CGP(ctl) ((void *) &(ctl)->sc_cong_u)
 
 
 enum retx_mode {
@@ -81,6 +95,13 @@ send_ctl_detect_losses (lsquic_send_ctl_t *ctl, lsquic_time_t time);
 static unsigned
 send_ctl_retx_bytes_out (const struct lsquic_send_ctl *ctl);
 
+static void
+send_ctl_begin_undo (struct lsquic_send_ctl *, enum send_ctl_flags);
+
+static void
+send_ctl_record_lost (struct lsquic_send_ctl *, struct lsquic_packet_out *,
+                                                                    int fack);
+
 
 #ifdef NDEBUG
 static
@@ -106,12 +127,23 @@ lsquic_send_ctl_guess_packno_bits (lsquic_send_ctl_t *ctl)
 }
 
 
+/* Iterate over unacked packets in the order of increasing packet numbers.
+ * Removing the current packet from the window while iterating is fine.
+ */
+#define FOR_EACH_UNACKED(ctl, packno, slot)                                 \
+    for (packno = (ctl)->sc_unacked.sw_first;                               \
+                                    packno < (ctl)->sc_unacked.sw_end; ++packno) \
+        if ((slot = lsquic_sentwin_slot(&(ctl)->sc_unacked, packno)),       \
+                                                            slot->ss_packet)
+
+
 int
 lsquic_send_ctl_have_unacked_stream_frames (const lsquic_send_ctl_t *ctl)
 {
-    const lsquic_packet_out_t *packet_out;
-    TAILQ_FOREACH(packet_out, &ctl->sc_unacked_packets, po_next)
-        if (packet_out->po_frame_types &
+    const struct sentwin_slot *slot;
+    lsquic_packno_t packno;
+    FOR_EACH_UNACKED(ctl, packno, slot)
+        if (slot->ss_packet->po_frame_types &
                     ((1 << QUIC_FRAME_STREAM) | (1 << QUIC_FRAME_RST_STREAM)))
             return 1;
     return 0;
@@ -121,10 +153,11 @@ lsquic_send_ctl_have_unacked_stream_frames (const lsquic_send_ctl_t *ctl)
 static lsquic_packet_out_t *
 send_ctl_first_unacked_retx_packet (const lsquic_send_ctl_t *ctl)
 {
-    lsquic_packet_out_t *packet_out;
-    TAILQ_FOREACH(packet_out, &ctl->sc_unacked_packets, po_next)
-        if (packet_out->po_frame_types & QFRAME_RETRANSMITTABLE_MASK)
-            return packet_out;
+    const struct sentwin_slot *slot;
+    lsquic_packno_t packno;
+    FOR_EACH_UNACKED(ctl, packno, slot)
+        if (slot->ss_flags & SWS_RETX)
+            return slot->ss_packet;
     return NULL;
 }
 
@@ -132,11 +165,15 @@ send_ctl_first_unacked_retx_packet (const lsquic_send_ctl_t *ctl)
 static lsquic_packet_out_t *
 send_ctl_last_unacked_retx_packet (const lsquic_send_ctl_t *ctl)
 {
-    lsquic_packet_out_t *packet_out;
-    TAILQ_FOREACH_REVERSE(packet_out, &ctl->sc_unacked_packets,
-                                            lsquic_packets_tailq, po_next)
-        if (packet_out->po_frame_types & QFRAME_RETRANSMITTABLE_MASK)
-            return packet_out;
+    const struct sentwin_slot *slot;
+    lsquic_packno_t packno;
+    for (packno = ctl->sc_unacked.sw_end;
+                                packno > ctl->sc_unacked.sw_first; --packno)
+    {
+        slot = lsquic_sentwin_slot(&ctl->sc_unacked, packno - 1);
+        if (slot->ss_packet && (slot->ss_flags & SWS_RETX))
+            return slot->ss_packet;
+    }
     return NULL;
 }
 
@@ -144,9 +181,10 @@ send_ctl_last_unacked_retx_packet (const lsquic_send_ctl_t *ctl)
 static int
 have_unacked_handshake_packets (const lsquic_send_ctl_t *ctl)
 {
-    const lsquic_packet_out_t *packet_out;
-    TAILQ_FOREACH(packet_out, &ctl->sc_unacked_packets, po_next)
-        if (packet_out->po_flags & PO_HELLO)
+    const struct sentwin_slot *slot;
+    lsquic_packno_t packno;
+    FOR_EACH_UNACKED(ctl, packno, slot)
+        if (slot->ss_flags & SWS_HELLO)
             return 1;
     return 0;
 }
@@ -158,7 +196,7 @@ get_retx_mode (lsquic_send_ctl_t *ctl)
     if (!(ctl->sc_conn_pub->lconn->cn_flags & LSCONN_HANDSHAKE_DONE)
                                     && have_unacked_handshake_packets(ctl))
         return RETX_MODE_HANDSHAKE;
-    if (ctl->sc_loss_to)
+    if (ctl->sc_loss_time)
         return RETX_MODE_LOSS;
     if (ctl->sc_n_tlp < 2)
         return RETX_MODE_TLP;
@@ -189,7 +227,7 @@ static void
 retx_alarm_rings (void *ctx, lsquic_time_t expiry, lsquic_time_t now)
 {
     lsquic_send_ctl_t *ctl = ctx;
-    lsquic_packet_out_t *packet_out;
+    lsquic_packet_out_t *packet_out, *lost_tail;
     enum retx_mode rm;
 
     /* This is a callback -- before it is called, the alarm is unset */
@@ -202,10 +240,10 @@ retx_alarm_rings (void *ctx, lsquic_time_t expiry, lsquic_time_t now)
     {
     case RETX_MODE_HANDSHAKE:
         send_ctl_expire(ctl, EXFI_HSK);
-        /* Do not register cubic loss during handshake */
+        /* Do not register congestion loss during handshake */
         break;
     case RETX_MODE_LOSS:
-        send_ctl_detect_losses(ctl, lsquic_time_now());
+        send_ctl_detect_losses(ctl, now);
         break;
     case RETX_MODE_TLP:
         ++ctl->sc_n_tlp;
@@ -215,8 +253,22 @@ retx_alarm_rings (void *ctx, lsquic_time_t expiry, lsquic_time_t now)
         ++ctl->sc_n_consec_rtos;
         ctl->sc_next_limit = 2;
         LSQ_DEBUG("packet RTO is %"PRIu64" usec", expiry);
+        lost_tail = TAILQ_LAST(&ctl->sc_lost_packets, lsquic_packets_tailq);
         send_ctl_expire(ctl, EXFI_ALL);
-        lsquic_cubic_timeout(&ctl->sc_cubic);
+        ctl->sc_ci->cci_timeout(CGP(ctl));
+        /* Only the first timeout in a series can be undone: the congestion
+         * controller does not remember the state before the earlier ones.
+         */
+        if (1 == ctl->sc_n_consec_rtos)
+        {
+            send_ctl_begin_undo(ctl, SC_UNDO_RTO);
+            send_ctl_record_lost(ctl, lost_tail, 0);
+        }
+        else
+        {
+            ctl->sc_flags &= ~(SC_UNDO|SC_UNDO_RTO);
+            ctl->sc_n_lost_recs = 0;
+        }
         break;
     }
 
@@ -235,20 +287,44 @@ lsquic_send_ctl_init (lsquic_send_ctl_t *ctl, struct lsquic_alarmset *alset,
     unsigned i;
     memset(ctl, 0, sizeof(*ctl));
     TAILQ_INIT(&ctl->sc_scheduled_packets);
-    TAILQ_INIT(&ctl->sc_unacked_packets);
+    lsquic_sentwin_init(&ctl->sc_unacked);
     TAILQ_INIT(&ctl->sc_lost_packets);
     ctl->sc_enpub = enpub;
     ctl->sc_alset = alset;
     ctl->sc_ver_neg = ver_neg;
     ctl->sc_pack_size = pack_size;
     ctl->sc_conn_pub = conn_pub;
-    if (enpub->enp_settings.es_pace_packets)
+    ctl->sc_reord_thresh = N_NACKS_BEFORE_RETX;
+    ctl->sc_reo_wnd_mult = 1;
+    switch (enpub->enp_settings.es_cc_algo)
+    {
+    case 2:
+        ctl->sc_ci = &lsquic_cong_bbr_if;
+        break;
+    default:
+        ctl->sc_ci = &lsquic_cong_cubic_if;
+        break;
+    }
+    /* BBR relies on pacing to keep the queue at the bottleneck short */
+    if (enpub->enp_settings.es_pace_packets
+                                    || ctl->sc_ci == &lsquic_cong_bbr_if)
         ctl->sc_flags |= SC_PACE;
     lsquic_alarmset_init_alarm(alset, AL_RETX, retx_alarm_rings, ctl);
     lsquic_senhist_init(&ctl->sc_senhist);
-    lsquic_cubic_init(&ctl->sc_cubic, LSQUIC_LOG_CONN_ID);
+    ctl->sc_ci->cci_init(CGP(ctl), LSQUIC_LOG_CONN_ID, &conn_pub->rtt_stats);
+    /* BBR has its own recovery logic */
+    if (ctl->sc_ci == &lsquic_cong_cubic_if)
+    {
+        if (enpub->enp_settings.es_hystart)
+            ctl->sc_cong_u.cubic.cu_flags |= CU_HYSTART;
+        if (enpub->enp_settings.es_prr)
+            ctl->sc_flags |= SC_PRR;
+    }
     if (ctl->sc_flags & SC_PACE)
+    {
         pacer_init(&ctl->sc_pacer, LSQUIC_LOG_CONN_ID, 100000);
+        pacer_set_horizon(&ctl->sc_pacer, enpub->enp_settings.es_txtime);
+    }
     for (i = 0; i < sizeof(ctl->sc_buffered_packets) /
                                 sizeof(ctl->sc_buffered_packets[0]); ++i)
         TAILQ_INIT(&ctl->sc_buffered_packets[i].bpq_packets);
@@ -272,24 +348,26 @@ calculate_packet_rto (lsquic_send_ctl_t *ctl)
 }
 
 
+/* The probe timeout follows RACK-TLP (RFC 8985, Section 7.2): two RTTs,
+ * plus the time the peer may delay its ACK if there is only one packet
+ * in flight.  It is never longer than RTO.  When the probe is acked,
+ * time-threshold loss detection takes care of the packets before it.
+ */
 static lsquic_time_t
 calculate_tlp_delay (lsquic_send_ctl_t *ctl)
 {
-    lsquic_time_t srtt, delay;
+    lsquic_time_t srtt, delay, rto;
 
     srtt = lsquic_rtt_stats_get_srtt(&ctl->sc_conn_pub->rtt_stats);
-    if (ctl->sc_n_in_flight_all > 1)
-    {
+    delay = 2 * srtt;
+    if (ctl->sc_n_in_flight_all <= 1)
+        delay += WC_DEL_ACK_TIME;
+    if (delay < 10000)
         delay = 10000;  /* 10 ms is the minimum tail loss probe delay */
-        if (delay < 2 * srtt)
-            delay = 2 * srtt;
-    }
-    else
-    {
-        delay = srtt + srtt / 2 + MIN_RTO_DELAY;
-        if (delay < 2 * srtt)
-            delay = 2 * srtt;
-    }
+
+    rto = calculate_packet_rto(ctl);
+    if (delay > rto)
+        delay = rto;
 
     return delay;
 }
@@ -301,7 +379,7 @@ set_retx_alarm (lsquic_send_ctl_t *ctl)
     enum retx_mode rm;
     lsquic_time_t delay, now;
 
-    assert(!TAILQ_EMPTY(&ctl->sc_unacked_packets));
+    assert(!lsquic_sentwin_empty(&ctl->sc_unacked));
 
     now = lsquic_time_now();
 
@@ -328,7 +406,7 @@ set_retx_alarm (lsquic_send_ctl_t *ctl)
         ++ctl->sc_n_hsk;
         break;
     case RETX_MODE_LOSS:
-        delay = ctl->sc_loss_to;
+        delay = ctl->sc_loss_time > now ? ctl->sc_loss_time - now : 0;
         break;
     case RETX_MODE_TLP:
         delay = calculate_tlp_delay(ctl);
@@ -355,7 +433,7 @@ set_retx_alarm (lsquic_send_ctl_t *ctl)
 
 
 static int
-send_ctl_in_recovery (lsquic_send_ctl_t *ctl)
+send_ctl_in_recovery (const struct lsquic_send_ctl *ctl)
 {
     return ctl->sc_largest_acked_packno
         && ctl->sc_largest_acked_packno <= ctl->sc_largest_sent_at_cutback;
@@ -365,7 +443,7 @@ send_ctl_in_recovery (lsquic_send_ctl_t *ctl)
 static int
 send_ctl_in_slow_start (lsquic_send_ctl_t *ctl)
 {
-    return lsquic_cubic_in_slow_start(&ctl->sc_cubic);
+    return ctl->sc_ci->cci_in_slow_start(CGP(ctl));
 }
 
 
@@ -373,35 +451,28 @@ static lsquic_time_t
 send_ctl_transfer_time (void *ctx)
 {
     lsquic_send_ctl_t *const ctl = ctx;
-    uint64_t bandwidth, pacing_rate;
-    lsquic_time_t srtt, tx_time;
-    unsigned long cwnd;
-
-    srtt = lsquic_rtt_stats_get_srtt(&ctl->sc_conn_pub->rtt_stats);
-    if (srtt == 0)
-        srtt = 50000;
-    cwnd = lsquic_cubic_get_cwnd(&ctl->sc_cubic);
-    bandwidth = cwnd * 1000000 / srtt;
-    if (send_ctl_in_slow_start(ctl))
-        pacing_rate = bandwidth * 2;
-    else if (send_ctl_in_recovery(ctl))
-        pacing_rate = bandwidth;
-    else
-        pacing_rate = bandwidth + bandwidth / 4;
-
+    uint64_t pacing_rate;
+    lsquic_time_t tx_time;
+    int in_recovery;
+
+    in_recovery = send_ctl_in_recovery(ctl);
+    pacing_rate = ctl->sc_ci->cci_pacing_rate(CGP(ctl), in_recovery);
+    if (pacing_rate == 0)
+        pacing_rate = 1;
     tx_time = (uint64_t) ctl->sc_pack_size * 1000000 / pacing_rate;
-    LSQ_DEBUG("srtt: %"PRIu64"; ss: %d; rec: %d; cwnd: %lu; bandwidth: "
-        "%"PRIu64"; tx_time: %"PRIu64, srtt, send_ctl_in_slow_start(ctl),
-        send_ctl_in_recovery(ctl), cwnd, bandwidth, tx_time);
+    LSQ_DEBUG("ss: %d; rec: %d; cwnd: %lu; pacing rate: %"PRIu64"; "
+        "tx_time: %"PRIu64, send_ctl_in_slow_start(ctl), in_recovery,
+        ctl->sc_ci->cci_get_cwnd(CGP(ctl)), pacing_rate, tx_time);
     return tx_time;
 }
 
 
-static void
+static int
 send_ctl_unacked_append (struct lsquic_send_ctl *ctl,
                          struct lsquic_packet_out *packet_out)
 {
-    TAILQ_INSERT_TAIL(&ctl->sc_unacked_packets, packet_out, po_next);
+    if (0 != lsquic_sentwin_add(&ctl->sc_unacked, packet_out))
+        return -1;
     ctl->sc_bytes_unacked_all += lsquic_packet_out_total_sz(packet_out);
     ctl->sc_n_in_flight_all  += 1;
     if (packet_out->po_frame_types & QFRAME_RETRANSMITTABLE_MASK)
@@ -409,6 +480,7 @@ send_ctl_unacked_append (struct lsquic_send_ctl *ctl,
         ctl->sc_bytes_unacked_retx += lsquic_packet_out_total_sz(packet_out);
         ++ctl->sc_n_in_flight_retx;
     }
+    return 0;
 }
 
 
@@ -416,7 +488,7 @@ static void
 send_ctl_unacked_remove (struct lsquic_send_ctl *ctl,
                      struct lsquic_packet_out *packet_out, unsigned packet_sz)
 {
-    TAILQ_REMOVE(&ctl->sc_unacked_packets, packet_out, po_next);
+    lsquic_sentwin_remove(&ctl->sc_unacked, packet_out->po_packno);
     assert(ctl->sc_bytes_unacked_all >= packet_sz);
     ctl->sc_bytes_unacked_all -= packet_sz;
     ctl->sc_n_in_flight_all  -= 1;
@@ -435,6 +507,9 @@ send_ctl_sched_Xpend_common (struct lsquic_send_ctl *ctl,
     packet_out->po_flags |= PO_SCHED;
     ++ctl->sc_n_scheduled;
     ctl->sc_bytes_scheduled += lsquic_packet_out_total_sz(packet_out);
+    /* Packet may not be full yet: count it as full-sized */
+    if ((ctl->sc_flags & SC_PRR) && send_ctl_in_recovery(ctl))
+        lsquic_prr_sent(&ctl->sc_prr, ctl->sc_pack_size);
     lsquic_send_ctl_sanity_check(ctl);
 }
 
@@ -481,7 +556,17 @@ lsquic_send_ctl_sent_packet (lsquic_send_ctl_t *ctl,
     if (account)
         ctl->sc_bytes_out -= lsquic_packet_out_total_sz(packet_out);
     lsquic_senhist_add(&ctl->sc_senhist, packet_out->po_packno);
-    send_ctl_unacked_append(ctl, packet_out);
+    if (0 != send_ctl_unacked_append(ctl, packet_out))
+    {
+        LSQ_WARN("cannot add packet %"PRIu64" to unacked window",
+                                                    packet_out->po_packno);
+        lsquic_packet_out_destroy(packet_out, ctl->sc_enpub);
+        return -1;
+    }
+    if (ctl->sc_ci->cci_sent)
+        ctl->sc_ci->cci_sent(CGP(ctl), packet_out, ctl->sc_bytes_unacked_all,
+                                        !!(ctl->sc_flags & SC_APP_LIMITED));
+    ctl->sc_flags &= ~SC_APP_LIMITED;
     if (packet_out->po_frame_types & QFRAME_RETRANSMITTABLE_MASK)
     {
         if (!lsquic_alarmset_is_set(ctl->sc_alset, AL_RETX))
@@ -512,6 +597,8 @@ take_rtt_sample (lsquic_send_ctl_t *ctl,
     {
         ctl->sc_max_rtt_packno = packno;
         lsquic_rtt_stats_update(&ctl->sc_conn_pub->rtt_stats, measured_rtt, lack_delta);
+        if (ctl->sc_ci->cci_rtt_sample)
+            ctl->sc_ci->cci_rtt_sample(CGP(ctl), measured_rtt);
         LSQ_DEBUG("packno %"PRIu64"; rtt: %"PRIu64"; delta: %"PRIu64"; "
             "new srtt: %"PRIu64, packno, measured_rtt, lack_delta,
             lsquic_rtt_stats_get_srtt(&ctl->sc_conn_pub->rtt_stats));
@@ -542,6 +629,11 @@ send_ctl_handle_lost_packet (lsquic_send_ctl_t *ctl,
     assert(ctl->sc_n_in_flight_all);
     packet_sz = lsquic_packet_out_sent_sz(packet_out);
     send_ctl_unacked_remove(ctl, packet_out, packet_sz);
+    if (ctl->sc_ci->cci_lost)
+        ctl->sc_ci->cci_lost(CGP(ctl), packet_out, packet_sz);
+#if LSQUIC_SEND_STATS
+    ++ctl->sc_stats.n_lost;
+#endif
     if (packet_out->po_flags & PO_ENCRYPTED)
         send_ctl_release_enc_data(ctl, packet_out);
     if (packet_out->po_frame_types & (1 << QUIC_FRAME_ACK))
@@ -566,83 +658,108 @@ send_ctl_handle_lost_packet (lsquic_send_ctl_t *ctl,
 }
 
 
-static lsquic_packno_t
-largest_retx_packet_number (const lsquic_send_ctl_t *ctl)
+/* Reordering window: a quarter of the minimum RTT, multiplied by the
+ * number of times spurious losses have been seen lately, but never larger
+ * than the smoothed RTT.
+ */
+static lsquic_time_t
+send_ctl_reo_wnd (const struct lsquic_send_ctl *ctl)
 {
-    const lsquic_packet_out_t *packet_out;
-    TAILQ_FOREACH_REVERSE(packet_out, &ctl->sc_unacked_packets,
-                                                lsquic_packets_tailq, po_next)
-    {
-        if (packet_out->po_frame_types & QFRAME_RETRANSMITTABLE_MASK)
-            return packet_out->po_packno;
-    }
-    return 0;
+    const struct lsquic_rtt_stats *const rtt_stats =
+                                            &ctl->sc_conn_pub->rtt_stats;
+    lsquic_time_t min_rtt, srtt, reo_wnd;
+
+    min_rtt = lsquic_rtt_stats_get_min_rtt(rtt_stats);
+    srtt = lsquic_rtt_stats_get_srtt(rtt_stats);
+    if (!min_rtt)
+        min_rtt = srtt;
+    reo_wnd = ctl->sc_reo_wnd_mult * min_rtt / 4;
+    if (reo_wnd > srtt)
+        reo_wnd = srtt;
+    return reo_wnd;
 }
 
 
+/* Only packets below the largest acked packet are examined.  A packet is
+ * lost if it is sc_reord_thresh packets below the largest acked packet
+ * (FACK) or if it has not been acked for RTT plus reordering window since
+ * it was sent (time threshold, see RFC 8985).  If some packets are not
+ * lost yet but will be once the time threshold passes, sc_loss_time is set
+ * to that time and the retransmission alarm fires in RETX_MODE_LOSS.
+ *
+ * Because the FACK rule catches packets far below the largest acked, at
+ * most sc_reord_thresh packets ever wait for the time threshold.
+ */
 static void
 send_ctl_detect_losses (lsquic_send_ctl_t *ctl, lsquic_time_t time)
 {
-    lsquic_packet_out_t *packet_out, *next;
-    lsquic_packno_t largest_retx_packno, largest_lost_packno;
+    lsquic_packet_out_t *lost_tail;
+    const struct sentwin_slot *slot;
+    lsquic_packno_t packno, largest_lost_packno;
+    lsquic_time_t threshold, loss_time;
+    unsigned long prior_cwnd;
 
-    largest_retx_packno = largest_retx_packet_number(ctl);
     largest_lost_packno = 0;
-    ctl->sc_loss_to = 0;
+    loss_time = 0;
+    lost_tail = TAILQ_LAST(&ctl->sc_lost_packets, lsquic_packets_tailq);
+    threshold = ctl->sc_rack_rtt + send_ctl_reo_wnd(ctl);
 
-    for (packet_out = TAILQ_FIRST(&ctl->sc_unacked_packets);
-            packet_out && packet_out->po_packno <= ctl->sc_largest_acked_packno;
-                packet_out = next)
+    FOR_EACH_UNACKED(ctl, packno, slot)
     {
-        next = TAILQ_NEXT(packet_out, po_next);
+        if (packno >= ctl->sc_largest_acked_packno)
+            break;
 
-        if (packet_out->po_packno + N_NACKS_BEFORE_RETX <
-                                                ctl->sc_largest_acked_packno)
+        if (packno + ctl->sc_reord_thresh < ctl->sc_largest_acked_packno)
         {
-            LSQ_DEBUG("loss by FACK detected, packet %"PRIu64,
-                                                    packet_out->po_packno);
-            largest_lost_packno = packet_out->po_packno;
-            (void) send_ctl_handle_lost_packet(ctl, packet_out);
+            LSQ_DEBUG("loss by FACK detected, packet %"PRIu64, packno);
+            largest_lost_packno = packno;
+            (void) send_ctl_handle_lost_packet(ctl, slot->ss_packet);
             continue;
         }
 
-        if (largest_retx_packno
-            && (packet_out->po_frame_types & QFRAME_RETRANSMITTABLE_MASK)
-            && largest_retx_packno <= ctl->sc_largest_acked_packno)
+        if (slot->ss_sent + threshold <= time)
         {
-            LSQ_DEBUG("loss by early retransmit detected, packet %"PRIu64,
-                                                    packet_out->po_packno);
-            largest_lost_packno = packet_out->po_packno;
-            ctl->sc_loss_to =
-                lsquic_rtt_stats_get_srtt(&ctl->sc_conn_pub->rtt_stats) / 4;
-            LSQ_DEBUG("set sc_loss_to to %"PRIu64", packet %"PRIu64,
-                                    ctl->sc_loss_to, packet_out->po_packno);
-            (void) send_ctl_handle_lost_packet(ctl, packet_out);
-            continue;
-        }
-
-        if (ctl->sc_largest_acked_sent_time > packet_out->po_sent +
-                    lsquic_rtt_stats_get_srtt(&ctl->sc_conn_pub->rtt_stats))
-        {
-            LSQ_DEBUG("loss by sent time detected: packet %"PRIu64,
-                                                    packet_out->po_packno);
-            if (packet_out->po_frame_types & QFRAME_RETRANSMITTABLE_MASK)
-                largest_lost_packno = packet_out->po_packno;
+            LSQ_DEBUG("loss by time threshold detected: packet %"PRIu64,
+                                                                    packno);
+            if (slot->ss_flags & SWS_RETX)
+                largest_lost_packno = packno;
             else { /* don't count it as a loss */; }
-            (void) send_ctl_handle_lost_packet(ctl, packet_out);
+            (void) send_ctl_handle_lost_packet(ctl, slot->ss_packet);
             continue;
         }
+
+        if (!loss_time || slot->ss_sent + threshold < loss_time)
+            loss_time = slot->ss_sent + threshold;
+    }
+
+    if (loss_time != ctl->sc_loss_time)
+    {
+        if (loss_time)
+            LSQ_DEBUG("set loss time to %"PRIu64" (%"PRIu64" usec from "
+                "now)", loss_time, loss_time - time);
+        ctl->sc_loss_time = loss_time;
     }
 
     if (largest_lost_packno > ctl->sc_largest_sent_at_cutback)
     {
         LSQ_DEBUG("detected new loss: packet %"PRIu64"; new lsac: "
             "%"PRIu64, largest_lost_packno, ctl->sc_largest_sent_at_cutback);
-        lsquic_cubic_loss(&ctl->sc_cubic);
+        prior_cwnd = ctl->sc_ci->cci_get_cwnd(CGP(ctl));
+        ctl->sc_ci->cci_loss(CGP(ctl));
         if (ctl->sc_flags & SC_PACE)
             pacer_loss_event(&ctl->sc_pacer);
+        if (ctl->sc_flags & SC_PRR)
+            lsquic_prr_init(&ctl->sc_prr, LSQUIC_LOG_CONN_ID,
+                ctl->sc_pack_size, prior_cwnd,
+                ctl->sc_ci->cci_get_cwnd(CGP(ctl)));
         ctl->sc_largest_sent_at_cutback =
                                 lsquic_senhist_largest(&ctl->sc_senhist);
+        send_ctl_begin_undo(ctl, 0);
+        if (ctl->sc_reo_wnd_persist && 0 == --ctl->sc_reo_wnd_persist)
+        {
+            LSQ_DEBUG("no spurious losses lately: reset reordering window");
+            ctl->sc_reo_wnd_mult = 1;
+        }
     }
     else if (largest_lost_packno)
         /* Lost packets whose numbers are smaller than the largest packet
@@ -651,6 +768,191 @@ send_ctl_detect_losses (lsquic_send_ctl_t *ctl, lsquic_time_t time)
          */
         LSQ_DEBUG("ignore loss of packet %"PRIu64" smaller than lsac "
             "%"PRIu64, largest_lost_packno, ctl->sc_largest_sent_at_cutback);
+
+    if (ctl->sc_flags & SC_UNDO)
+        send_ctl_record_lost(ctl, lost_tail, 1);
+}
+
+
+/* Start a new undo period.  Losses recorded before are forgotten: the
+ * new cutback is applied on top of the previous one, which therefore
+ * cannot be undone anymore.
+ */
+static void
+send_ctl_begin_undo (struct lsquic_send_ctl *ctl, enum send_ctl_flags flags)
+{
+    ctl->sc_flags &= ~SC_UNDO_RTO;
+    ctl->sc_flags |= SC_UNDO | flags;
+    ctl->sc_n_lost_recs = 0;
+    ctl->sc_undo_end = lsquic_senhist_largest(&ctl->sc_senhist);
+}
+
+
+/* Record packets placed onto the lost packets queue after `lost_tail'.
+ * Unretransmittable packets are not recorded: they are not placed onto
+ * the queue.  This is fine, as only retransmittable packets cause the
+ * congestion window to be reduced.
+ */
+static void
+send_ctl_record_lost (struct lsquic_send_ctl *ctl,
+                        struct lsquic_packet_out *lost_tail, int fack)
+{
+    struct lsquic_packet_out *packet_out;
+    struct lost_rec *recs;
+    unsigned cap;
+
+    if (lost_tail)
+        packet_out = TAILQ_NEXT(lost_tail, po_next);
+    else
+        packet_out = TAILQ_FIRST(&ctl->sc_lost_packets);
+
+    for ( ; packet_out; packet_out = TAILQ_NEXT(packet_out, po_next))
+    {
+        if (ctl->sc_n_lost_recs >= ctl->sc_lost_recs_cap)
+        {
+            if (ctl->sc_lost_recs_cap >= MAX_LOST_RECS)
+                goto give_up;
+            cap = ctl->sc_lost_recs_cap ? ctl->sc_lost_recs_cap * 2 : 8;
+            recs = realloc(ctl->sc_lost_recs, cap * sizeof(recs[0]));
+            if (!recs)
+                goto give_up;
+            ctl->sc_lost_recs = recs;
+            ctl->sc_lost_recs_cap = cap;
+        }
+        recs = &ctl->sc_lost_recs[ ctl->sc_n_lost_recs++ ];
+        recs->lr_packno = packet_out->po_packno;
+        if (fack && ctl->sc_largest_acked_packno > packet_out->po_packno)
+            recs->lr_reord = ctl->sc_largest_acked_packno
+                                                    - packet_out->po_packno;
+        else
+            recs->lr_reord = 0;
+    }
+
+    return;
+
+  give_up:
+    LSQ_DEBUG("too many lost packets to track, cutback cannot be undone");
+    ctl->sc_flags &= ~(SC_UNDO|SC_UNDO_RTO);
+    ctl->sc_n_lost_recs = 0;
+}
+
+
+static int
+acki_contains (const struct ack_info *acki, lsquic_packno_t packno)
+{
+    unsigned low, high, mid;
+
+    /* Ranges are ordered from largest to smallest */
+    low = 0, high = acki->n_ranges;
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (packno > acki->ranges[mid].high)
+            high = mid;
+        else if (packno < acki->ranges[mid].low)
+            low = mid + 1;
+        else
+            return 1;
+    }
+
+    return 0;
+}
+
+
+/* The original packet is no longer needed if it has not been retransmitted
+ * yet.  Once retransmitted, it has a new packet number and stays in the
+ * queues.
+ */
+static void
+send_ctl_drop_lost (struct lsquic_send_ctl *ctl, lsquic_packno_t packno)
+{
+    struct lsquic_packet_out *packet_out;
+
+    TAILQ_FOREACH(packet_out, &ctl->sc_lost_packets, po_next)
+        if (packet_out->po_packno == packno)
+        {
+            LSQ_DEBUG("packet %"PRIu64" was not retransmitted yet, drop it",
+                                                                    packno);
+            TAILQ_REMOVE(&ctl->sc_lost_packets, packet_out, po_next);
+            lsquic_packet_out_ack_streams(packet_out);
+            lsquic_packet_out_destroy(packet_out, ctl->sc_enpub);
+            break;
+        }
+}
+
+
+/* Packet numbers are never reused, so an ACK of a packet declared lost
+ * means that the original packet, not the retransmission, has arrived.
+ * If all packets lost during the last loss event arrive, or if any packet
+ * considered lost by RTO arrives, the cutback is undone.  Each spurious
+ * loss also raises the FACK threshold to accommodate this much reordering
+ * and widens the reordering window used by time-threshold loss detection.
+ */
+static void
+send_ctl_detect_spurious (struct lsquic_send_ctl *ctl,
+                                                const struct ack_info *acki)
+{
+    struct lost_rec *rec;
+    unsigned n_spurious;
+
+    n_spurious = 0;
+    rec = ctl->sc_lost_recs;
+    while (rec < ctl->sc_lost_recs + ctl->sc_n_lost_recs)
+        if (acki_contains(acki, rec->lr_packno))
+        {
+            LSQ_DEBUG("packet %"PRIu64" was lost spuriously", rec->lr_packno);
+            ++n_spurious;
+#if LSQUIC_SEND_STATS
+            ++ctl->sc_stats.n_spurious;
+#endif
+            if (rec->lr_reord > ctl->sc_reord_thresh)
+            {
+                if (rec->lr_reord < MAX_REORD_THRESH)
+                    ctl->sc_reord_thresh = rec->lr_reord;
+                else
+                    ctl->sc_reord_thresh = MAX_REORD_THRESH;
+                LSQ_DEBUG("reordering threshold raised to %u",
+                                                    ctl->sc_reord_thresh);
+            }
+            send_ctl_drop_lost(ctl, rec->lr_packno);
+            *rec = ctl->sc_lost_recs[ --ctl->sc_n_lost_recs ];
+        }
+        else
+            ++rec;
+
+    if (n_spurious)
+    {
+        if (ctl->sc_reo_wnd_mult < MAX_REO_WND_MULT)
+        {
+            ++ctl->sc_reo_wnd_mult;
+            LSQ_DEBUG("reordering window multiplier raised to %u",
+                                            (unsigned) ctl->sc_reo_wnd_mult);
+        }
+        ctl->sc_reo_wnd_persist = REO_WND_PERSIST;
+    }
+
+    if (!(ctl->sc_flags & SC_UNDO))
+        return;
+
+    if (n_spurious && ((ctl->sc_flags & SC_UNDO_RTO)
+                                                || 0 == ctl->sc_n_lost_recs))
+    {
+        LSQ_INFO("spurious %s detected: undo cutback",
+                        ctl->sc_flags & SC_UNDO_RTO ? "RTO" : "loss");
+        if (ctl->sc_ci->cci_undo)
+            ctl->sc_ci->cci_undo(CGP(ctl));
+        if (!(ctl->sc_flags & SC_UNDO_RTO))
+            /* Leave recovery */
+            ctl->sc_largest_sent_at_cutback = 0;
+        ctl->sc_flags &= ~(SC_UNDO|SC_UNDO_RTO);
+        ctl->sc_n_lost_recs = 0;
+    }
+    else if (largest_acked(acki) > ctl->sc_undo_end)
+    {
+        LSQ_DEBUG("packet sent after cutback is acked: losses are real");
+        ctl->sc_flags &= ~(SC_UNDO|SC_UNDO_RTO);
+        ctl->sc_n_lost_recs = 0;
+    }
 }
 
 
@@ -659,22 +961,17 @@ lsquic_send_ctl_got_ack (lsquic_send_ctl_t *ctl,
                          const struct ack_info *acki,
                          lsquic_time_t ack_recv_time)
 {
-    struct lsquic_packets_tailq acked_acks =
-                                    TAILQ_HEAD_INITIALIZER(acked_acks);
-    const struct lsquic_packno_range *range =
-                                    &acki->ranges[ acki->n_ranges - 1 ];
-    lsquic_packet_out_t *packet_out, *next;
+    const struct lsquic_packno_range *range;
+    struct lsquic_sentwin *const win = &ctl->sc_unacked;
+    lsquic_packet_out_t *packet_out;
     lsquic_time_t now = 0;
-    lsquic_packno_t smallest_unacked;
+    lsquic_packno_t smallest_unacked, packno, low, high;
     lsquic_packno_t ack2ed[2];
     unsigned packet_sz;
+    unsigned long bytes_acked;
     int app_limited;
-    signed char do_rtt, skip_checks;
+    signed char do_rtt, rack_advanced;
 
-    packet_out = TAILQ_FIRST(&ctl->sc_unacked_packets);
-#if __GNUC__
-    __builtin_prefetch(packet_out);
-#endif
 
 #if __GNUC__
 #   define UNLIKELY(cond) __builtin_expect(cond, 0)
@@ -703,58 +1000,84 @@ lsquic_send_ctl_got_ack (lsquic_send_ctl_t *ctl,
         LSQ_DEBUG("ACK comes after a period of quiescence");
         if (!now)
             now = lsquic_time_now();
-        lsquic_cubic_was_quiet(&ctl->sc_cubic, now);
+        ctl->sc_ci->cci_was_quiet(CGP(ctl), now, ctl->sc_bytes_unacked_all);
     }
 
-    if (UNLIKELY(!packet_out))
+    if (UNLIKELY(ctl->sc_n_lost_recs))
+        send_ctl_detect_spurious(ctl, acki);
+
+    if (UNLIKELY(lsquic_sentwin_empty(win)))
         goto no_unacked_packets;
 
-    smallest_unacked = packet_out->po_packno;
+    if (ctl->sc_ci->cci_begin_ack)
+        ctl->sc_ci->cci_begin_ack(CGP(ctl), ack_recv_time,
+                                                ctl->sc_bytes_unacked_all);
+
+    smallest_unacked = lsquic_sentwin_first(win);
     ack2ed[1] = 0;
+    bytes_acked = 0;
 
-    if (packet_out->po_packno > largest_acked(acki))
+    if (smallest_unacked > largest_acked(acki))
         goto detect_losses;
 
-    do_rtt = 0, skip_checks = 0;
+    do_rtt = 0;
+    rack_advanced = 0;
     app_limited = -1;
-    do
+    /* Go over ranges from the smallest to the largest, so that packets are
+     * acked in order.  Each range is clipped to the window: only the slots
+     * covered by the ACK are visited.
+     */
+    for (range = &acki->ranges[ acki->n_ranges - 1 ];
+                                            range >= acki->ranges; --range)
     {
-        next = TAILQ_NEXT(packet_out, po_next);
+        if (range->high < win->sw_first)
+            continue;
+        if (range->low >= win->sw_end)
+            break;
+        low = range->low > win->sw_first ? range->low : win->sw_first;
+        high = range->high < win->sw_end ? range->high : win->sw_end - 1;
+        for (packno = low; packno <= high; ++packno)
+        {
+            packet_out = lsquic_sentwin_slot(win, packno)->ss_packet;
+            if (!packet_out)
+                continue;
 #if __GNUC__
-        __builtin_prefetch(next);
+            if (packno < high)
+                __builtin_prefetch(
+                            lsquic_sentwin_slot(win, packno + 1)->ss_packet);
 #endif
-        if (skip_checks)
-            goto after_checks;
-        /* This is faster than binary search in the normal case when the number
-         * of ranges is not much larger than the number of unacked packets.
-         */
-        while (UNLIKELY(range->high < packet_out->po_packno))
-            --range;
-        if (range->low <= packet_out->po_packno)
-        {
-            skip_checks = range == acki->ranges;
             if (app_limited < 0)
+            {
                 app_limited = send_ctl_retx_bytes_out(ctl) + 3 * ctl->sc_pack_size /* This
                     is the "maximum burst" parameter */
-                    < lsquic_cubic_get_cwnd(&ctl->sc_cubic);
-            if (!now)
-                now = lsquic_time_now();
-  after_checks:
+                    < ctl->sc_ci->cci_get_cwnd(CGP(ctl));
+                if (!now)
+                    now = lsquic_time_now();
+            }
             packet_sz = lsquic_packet_out_sent_sz(packet_out);
-            ctl->sc_largest_acked_packno    = packet_out->po_packno;
-            ctl->sc_largest_acked_sent_time = packet_out->po_sent;
+            if (packno > ctl->sc_largest_acked_packno)
+            {
+                ctl->sc_largest_acked_packno    = packno;
+                ctl->sc_largest_acked_sent_time = packet_out->po_sent;
+                rack_advanced = 1;
+            }
             send_ctl_unacked_remove(ctl, packet_out, packet_sz);
+            bytes_acked += packet_sz;
             ack2ed[!!(packet_out->po_frame_types & (1 << QUIC_FRAME_ACK))]
                 = packet_out->po_ack2ed;
-            do_rtt |= packet_out->po_packno == largest_acked(acki);
-            lsquic_cubic_ack(&ctl->sc_cubic, now, now - packet_out->po_sent,
-                             app_limited, packet_sz);
+            do_rtt |= packno == largest_acked(acki);
+            ctl->sc_ci->cci_ack(CGP(ctl), packet_out, packet_sz, now,
+                                                                app_limited);
             lsquic_packet_out_ack_streams(packet_out);
             lsquic_packet_out_destroy(packet_out, ctl->sc_enpub);
         }
-        packet_out = next;
     }
-    while (packet_out && packet_out->po_packno <= largest_acked(acki));
+
+    /* RACK RTT is not corrected for ACK delay: the time threshold should
+     * err on the side of being too long.
+     */
+    if (rack_advanced && ack_recv_time > ctl->sc_largest_acked_sent_time)
+        ctl->sc_rack_rtt = ack_recv_time - ctl->sc_largest_acked_sent_time;
 
     if (do_rtt)
     {
@@ -766,6 +1089,11 @@ lsquic_send_ctl_got_ack (lsquic_send_ctl_t *ctl,
 
   detect_losses:
     send_ctl_detect_losses(ctl, ack_recv_time);
+    if (ctl->sc_ci->cci_end_ack)
+        ctl->sc_ci->cci_end_ack(CGP(ctl), ctl->sc_bytes_unacked_all);
+    if ((ctl->sc_flags & SC_PRR) && send_ctl_in_recovery(ctl))
+        lsquic_prr_ack(&ctl->sc_prr, bytes_acked,
+                                            send_ctl_retx_bytes_out(ctl));
     if (send_ctl_first_unacked_retx_packet(ctl))
         set_retx_alarm(ctl);
     else
@@ -803,16 +1131,22 @@ lsquic_send_ctl_got_ack (lsquic_send_ctl_t *ctl,
 lsquic_packno_t
 lsquic_send_ctl_smallest_unacked (lsquic_send_ctl_t *ctl)
 {
-    const lsquic_packet_out_t *packet_out;
+    lsquic_packno_t packno;
+    unsigned n;
 
-    /* Packets are always sent out in order (unless we are reordering them
-     * on purpose).  Thus, the first packet on the unacked packets list has
-     * the smallest packet number of all packets on that list.
-     */
-    if ((packet_out = TAILQ_FIRST(&ctl->sc_unacked_packets)))
-        return packet_out->po_packno;
+    if (!lsquic_sentwin_empty(&ctl->sc_unacked))
+        packno = lsquic_sentwin_first(&ctl->sc_unacked);
     else
-        return lsquic_senhist_largest(&ctl->sc_senhist) + 1;
+        packno = lsquic_senhist_largest(&ctl->sc_senhist) + 1;
+
+    /* Peer should keep acknowledging packets that may have been lost
+     * spuriously.
+     */
+    for (n = 0; n < ctl->sc_n_lost_recs; ++n)
+        if (ctl->sc_lost_recs[n].lr_packno < packno)
+            packno = ctl->sc_lost_recs[n].lr_packno;
+
+    return packno;
 }
 
 
@@ -845,6 +1179,8 @@ void
 lsquic_send_ctl_cleanup (lsquic_send_ctl_t *ctl)
 {
     lsquic_packet_out_t *packet_out;
+    struct sentwin_slot *slot;
+    lsquic_packno_t packno;
     lsquic_senhist_cleanup(&ctl->sc_senhist);
     while ((packet_out = TAILQ_FIRST(&ctl->sc_scheduled_packets)))
     {
@@ -853,14 +1189,16 @@ lsquic_send_ctl_cleanup (lsquic_send_ctl_t *ctl)
     }
     assert(0 == ctl->sc_n_scheduled);
     assert(0 == ctl->sc_bytes_scheduled);
-    while ((packet_out = TAILQ_FIRST(&ctl->sc_unacked_packets)))
+    FOR_EACH_UNACKED(ctl, packno, slot)
     {
-        TAILQ_REMOVE(&ctl->sc_unacked_packets, packet_out, po_next);
+        packet_out = slot->ss_packet;
+        lsquic_sentwin_remove(&ctl->sc_unacked, packno);
         ctl->sc_bytes_unacked_all -= lsquic_packet_out_total_sz(packet_out);
         lsquic_packet_out_destroy(packet_out, ctl->sc_enpub);
         --ctl->sc_n_in_flight_all;
     }
     assert(0 == ctl->sc_n_in_flight_all);
+    lsquic_sentwin_cleanup(&ctl->sc_unacked);
     assert(0 == ctl->sc_bytes_unacked_all);
     while ((packet_out = TAILQ_FIRST(&ctl->sc_lost_packets)))
     {
@@ -868,10 +1206,14 @@ lsquic_send_ctl_cleanup (lsquic_send_ctl_t *ctl)
         lsquic_packet_out_destroy(packet_out, ctl->sc_enpub);
     }
     pacer_cleanup(&ctl->sc_pacer);
+    if (ctl->sc_ci->cci_cleanup)
+        ctl->sc_ci->cci_cleanup(CGP(ctl));
+    free(ctl->sc_lost_recs);
 #if LSQUIC_SEND_STATS
-    LSQ_NOTICE("stats: n_total_sent: %u; n_resent: %u; n_delayed: %u",
-        ctl->sc_stats.n_total_sent, ctl->sc_stats.n_resent,
-        ctl->sc_stats.n_delayed);
+    LSQ_NOTICE("stats: n_total_sent: %u; n_resent: %u; n_lost: %u; "
+        "n_delayed: %u; n_spurious: %u", ctl->sc_stats.n_total_sent,
+        ctl->sc_stats.n_resent, ctl->sc_stats.n_lost, ctl->sc_stats.n_delayed,
+        ctl->sc_stats.n_spurious);
 #endif
 }
 
@@ -894,6 +1236,17 @@ lsquic_send_ctl_pacer_blocked (struct lsquic_send_ctl *ctl)
 }
 
 
+/* In recovery, PRR decides how much can be sent instead of cwnd */
+static int
+send_ctl_cwnd_allows (const struct lsquic_send_ctl *ctl, unsigned n_out)
+{
+    if ((ctl->sc_flags & SC_PRR) && send_ctl_in_recovery(ctl))
+        return lsquic_prr_can_send(&ctl->sc_prr);
+    else
+        return n_out < ctl->sc_ci->cci_get_cwnd(CGP(ctl));
+}
+
+
 #ifndef NDEBUG
 #if __GNUC__
 __attribute__((weak))
@@ -905,10 +1258,10 @@ lsquic_send_ctl_can_send (lsquic_send_ctl_t *ctl)
     const unsigned n_out = send_ctl_retx_bytes_out(ctl);
     LSQ_DEBUG("%s: n_out: %u (unacked_retx: %u, out: %u); cwnd: %lu", __func__,
         n_out, ctl->sc_bytes_unacked_retx, ctl->sc_bytes_out,
-        lsquic_cubic_get_cwnd(&ctl->sc_cubic));
+        ctl->sc_ci->cci_get_cwnd(CGP(ctl)));
     if (ctl->sc_flags & SC_PACE)
     {
-        if (n_out >= lsquic_cubic_get_cwnd(&ctl->sc_cubic))
+        if (!send_ctl_cwnd_allows(ctl, n_out))
             return 0;
         if (pacer_can_schedule(&ctl->sc_pacer,
                                ctl->sc_n_scheduled + ctl->sc_n_in_flight_all))
@@ -917,19 +1270,21 @@ lsquic_send_ctl_can_send (lsquic_send_ctl_t *ctl)
         {
             ctl->sc_flags &= ~SC_SCHED_TICK;
             lsquic_engine_add_conn_to_attq(ctl->sc_enpub,
-                    ctl->sc_conn_pub->lconn, pacer_next_sched(&ctl->sc_pacer));
+                    ctl->sc_conn_pub->lconn, pacer_next_tick(&ctl->sc_pacer));
         }
         return 0;
     }
     else
-        return n_out < lsquic_cubic_get_cwnd(&ctl->sc_cubic);
+        return send_ctl_cwnd_allows(ctl, n_out);
 }
 
 
 static void
 send_ctl_expire (lsquic_send_ctl_t *ctl, enum expire_filter filter)
 {
-    lsquic_packet_out_t *packet_out, *next;
+    lsquic_packet_out_t *packet_out;
+    const struct sentwin_slot *slot;
+    lsquic_packno_t packno;
     int n_resubmitted;
     static const char *const filter_type2str[] = {
         [EXFI_ALL] = "all",
@@ -941,18 +1296,16 @@ send_ctl_expire (lsquic_send_ctl_t *ctl, enum expire_filter filter)
     {
     case EXFI_ALL:
         n_resubmitted = 0;
-        while ((packet_out = TAILQ_FIRST(&ctl->sc_unacked_packets)))
-            n_resubmitted += send_ctl_handle_lost_packet(ctl, packet_out);
+        FOR_EACH_UNACKED(ctl, packno, slot)
+            n_resubmitted += send_ctl_handle_lost_packet(ctl,
+                                                            slot->ss_packet);
         break;
     case EXFI_HSK:
         n_resubmitted = 0;
-        for (packet_out = TAILQ_FIRST(&ctl->sc_unacked_packets); packet_out;
-                                                            packet_out = next)
-        {
-            next = TAILQ_NEXT(packet_out, po_next);
-            if (packet_out->po_flags & PO_HELLO)
-                n_resubmitted += send_ctl_handle_lost_packet(ctl, packet_out);
-        }
+        FOR_EACH_UNACKED(ctl, packno, slot)
+            if (slot->ss_flags & SWS_HELLO)
+                n_resubmitted += send_ctl_handle_lost_packet(ctl,
+                                                            slot->ss_packet);
         break;
     case EXFI_LAST:
         packet_out = send_ctl_last_unacked_retx_packet(ctl);
@@ -981,11 +1334,36 @@ lsquic_send_ctl_expire_all (lsquic_send_ctl_t *ctl)
 }
 
 
+void
+lsquic_send_ctl_get_info (const lsquic_send_ctl_t *ctl,
+                                            struct lsquic_conn_info *info)
+{
+    const struct lsquic_rtt_stats *const rtt_stats =
+                                            &ctl->sc_conn_pub->rtt_stats;
+
+    info->lci_srtt              = lsquic_rtt_stats_get_srtt(rtt_stats);
+    info->lci_rttvar            = lsquic_rtt_stats_get_rttvar(rtt_stats);
+    info->lci_min_rtt           = lsquic_rtt_stats_get_min_rtt(rtt_stats);
+    info->lci_cwnd              = ctl->sc_ci->cci_get_cwnd(CGP(ctl));
+    info->lci_ssthresh          = ctl->sc_ci->cci_get_ssthresh(CGP(ctl));
+    info->lci_bytes_in_flight   = ctl->sc_bytes_unacked_all;
+    info->lci_packets_in_flight = ctl->sc_n_in_flight_all;
+#if LSQUIC_SEND_STATS
+    info->lci_packets_sent      = ctl->sc_stats.n_total_sent;
+    info->lci_packets_lost      = ctl->sc_stats.n_lost;
+    info->lci_packets_resent    = ctl->sc_stats.n_resent;
+    info->lci_packets_spurious  = ctl->sc_stats.n_spurious;
+#endif
+}
+
+
 #if LSQUIC_EXTRA_CHECKS
 void
 lsquic_send_ctl_sanity_check (const lsquic_send_ctl_t *ctl)
 {
     const struct lsquic_packet_out *packet_out;
+    const struct sentwin_slot *slot;
+    lsquic_packno_t packno;
     unsigned count, bytes;
 
     assert(!send_ctl_first_unacked_retx_packet(ctl) ||
@@ -997,12 +1375,14 @@ lsquic_send_ctl_sanity_check (const lsquic_send_ctl_t *ctl)
     }
 
     count = 0, bytes = 0;
-    TAILQ_FOREACH(packet_out, &ctl->sc_unacked_packets, po_next)
+    FOR_EACH_UNACKED(ctl, packno, slot)
     {
-        bytes += lsquic_packet_out_sent_sz(packet_out);
+        assert(slot->ss_packet->po_packno == packno);
+        bytes += lsquic_packet_out_sent_sz(slot->ss_packet);
         ++count;
     }
     assert(count == ctl->sc_n_in_flight_all);
+    assert(count == lsquic_sentwin_count(&ctl->sc_unacked));
     assert(bytes == ctl->sc_bytes_unacked_all);
 
     count = 0, bytes = 0;
@@ -1034,13 +1414,31 @@ lsquic_send_ctl_scheduled_one (lsquic_send_ctl_t *ctl,
     if (ctl->sc_flags & SC_PACE)
     {
         unsigned n_out = ctl->sc_n_in_flight_retx + ctl->sc_n_scheduled;
-        pacer_packet_scheduled(&ctl->sc_pacer, n_out,
-            send_ctl_in_recovery(ctl), send_ctl_transfer_time, ctl);
+        packet_out->po_tx_time = pacer_packet_scheduled(&ctl->sc_pacer,
+            n_out, send_ctl_in_recovery(ctl), send_ctl_transfer_time, ctl);
+        if (!ctl->sc_pacer.pa_horizon)
+            packet_out->po_tx_time = 0;
     }
+    else
+        packet_out->po_tx_time = 0;
     send_ctl_sched_append(ctl, packet_out);
 }
 
 
+/* The connection ran out of packets to send.  If neither the congestion
+ * window nor the pacer were the reason, the sender is application-limited.
+ */
+static void
+send_ctl_maybe_app_limited (struct lsquic_send_ctl *ctl)
+{
+    if (send_ctl_retx_bytes_out(ctl) + ctl->sc_pack_size
+                                    <= ctl->sc_ci->cci_get_cwnd(CGP(ctl))
+        && !((ctl->sc_flags & SC_PACE) && pacer_delayed(&ctl->sc_pacer))
+        && TAILQ_EMPTY(&ctl->sc_lost_packets))
+        ctl->sc_flags |= SC_APP_LIMITED;
+}
+
+
 lsquic_packet_out_t *
 lsquic_send_ctl_next_packet_to_send (lsquic_send_ctl_t *ctl)
 {
@@ -1048,7 +1446,10 @@ lsquic_send_ctl_next_packet_to_send (lsquic_send_ctl_t *ctl)
 
     packet_out = TAILQ_FIRST(&ctl->sc_scheduled_packets);
     if (!packet_out)
+    {
+        send_ctl_maybe_app_limited(ctl);
         return NULL;
+    }
 
     if (ctl->sc_n_consec_rtos &&
                     !(packet_out->po_frame_types & (1 << QUIC_FRAME_ACK)))
@@ -1264,6 +1665,9 @@ lsquic_send_ctl_reschedule_packets (lsquic_send_ctl_t *ctl)
         if (packet_out->po_regen_sz < packet_out->po_data_sz)
         {
             ++n;
+#if LSQUIC_SEND_STATS
+            ++ctl->sc_stats.n_resent;
+#endif
             update_for_resending(ctl, packet_out);
             lsquic_send_ctl_scheduled_one(ctl, packet_out);
         }
@@ -1592,9 +1996,9 @@ send_ctl_max_bpq_count (const lsquic_send_ctl_t *ctl,
     case BPT_HIGHEST_PRIO:
     default: /* clang does not complain about absence of `default'... */
         count = ctl->sc_n_scheduled + ctl->sc_n_in_flight_retx;
-        if (count < lsquic_cubic_get_cwnd(&ctl->sc_cubic) / ctl->sc_pack_size)
+        if (count < ctl->sc_ci->cci_get_cwnd(CGP(ctl)) / ctl->sc_pack_size)
         {
-            count -= lsquic_cubic_get_cwnd(&ctl->sc_cubic) / ctl->sc_pack_size;
+            count -= ctl->sc_ci->cci_get_cwnd(CGP(ctl)) / ctl->sc_pack_size;
             if (count > MAX_BPQ_COUNT)
                 return count;
         }
@@ -1667,7 +2071,7 @@ lsquic_send_ctl_calc_packno_bits (lsquic_send_ctl_t *ctl)
     unsigned n_in_flight;
 
     smallest_unacked = lsquic_send_ctl_smallest_unacked(ctl);
-    n_in_flight = lsquic_cubic_get_cwnd(&ctl->sc_cubic) / ctl->sc_pack_size;
+    n_in_flight = ctl->sc_ci->cci_get_cwnd(CGP(ctl)) / ctl->sc_pack_size;
     return calc_packno_bits(ctl->sc_cur_packno + 1, smallest_unacked,
                                                             n_in_flight);
 }
@@ -1793,17 +2197,23 @@ size_t
 lsquic_send_ctl_mem_used (const struct lsquic_send_ctl *ctl)
 {
     const lsquic_packet_out_t *packet_out;
+    const struct sentwin_slot *slot;
+    lsquic_packno_t packno;
     unsigned n;
     size_t size;
     const struct lsquic_packets_tailq queues[] = {
         ctl->sc_scheduled_packets,
-        ctl->sc_unacked_packets,
         ctl->sc_lost_packets,
         ctl->sc_buffered_packets[0].bpq_packets,
         ctl->sc_buffered_packets[1].bpq_packets,
     };
 
     size = sizeof(*ctl);
+    size += ctl->sc_lost_recs_cap * sizeof(ctl->sc_lost_recs[0]);
+    size += lsquic_sentwin_mem_used(&ctl->sc_unacked);
+
+    FOR_EACH_UNACKED(ctl, packno, slot)
+        size += lsquic_packet_out_mem_used(slot->ss_packet);
 
     for (n = 0; n < sizeof(queues) / sizeof(queues[0]); ++n)
         TAILQ_FOREACH(packet_out, &queues[n], po_next)
@@ -18,6 +18,7 @@ struct lsquic_alarmset;
 struct lsquic_engine_public;
 struct lsquic_conn_public;
 struct ver_neg;
+struct cong_ctl_if;
 
 enum buf_packet_type { BPT_HIGHEST_PRIO, BPT_OTHER_PRIO, };
 
@@ -36,6 +37,20 @@ enum send_ctl_flags {
     SC_SCHED_TICK   = (1 << 4),
     SC_BUFFER_STREAM= (1 << 5),
     SC_WAS_QUIET    = (1 << 6),
+    SC_APP_LIMITED  = (1 << 7),
+    SC_PRR          = (1 << 8),     /* Use PRR in recovery */
+    SC_UNDO         = (1 << 9),     /* Last cutback may still be undone */
+    SC_UNDO_RTO     = (1 << 10),    /* ...and it was caused by RTO */
+};
+
+/* Packet declared lost during the last loss event or RTO.  If it is
+ * acknowledged later, the loss was spurious.
+ */
+struct lost_rec
+{
+    lsquic_packno_t     lr_packno;
+    /* FACK threshold that would have avoided declaring this packet lost */
+    unsigned            lr_reord;
 };
 
 typedef struct lsquic_send_ctl {
@@ -46,14 +61,18 @@ typedef struct lsquic_send_ctl {
     lsquic_senhist_t                sc_senhist;
     enum send_ctl_flags             sc_flags;
     unsigned                        sc_n_stop_waiting;
-    struct lsquic_packets_tailq     sc_unacked_packets;
+    struct lsquic_sentwin           sc_unacked;
     lsquic_packno_t                 sc_largest_acked_packno;
     lsquic_time_t                   sc_largest_acked_sent_time;
     unsigned                        sc_bytes_out;
     unsigned                        sc_bytes_unacked_retx;
     unsigned                        sc_bytes_scheduled;
     unsigned                        sc_pack_size;
-    struct lsquic_cubic             sc_cubic;
+    union {
+        struct lsquic_cubic         cubic;
+        struct lsquic_bbr           bbr;
+    }                               sc_cong_u;
+    const struct cong_ctl_if       *sc_ci;
     struct lsquic_engine_public    *sc_enpub;
     unsigned                        sc_bytes_unacked_all;
     unsigned                        sc_n_in_flight_all;
@@ -70,8 +89,27 @@ typedef struct lsquic_send_ctl {
     const struct ver_neg           *sc_ver_neg;
     struct lsquic_conn_public      *sc_conn_pub;
     struct pacer                    sc_pacer;
+    struct lsquic_prr               sc_prr;
     lsquic_packno_t                 sc_cur_packno;
     lsquic_packno_t                 sc_largest_sent_at_cutback;
+    /* Spurious loss detection: packets declared lost since the last
+     * cutback.  The cutback can be undone until a packet sent after it
+     * is acknowledged.
+     */
+    struct lost_rec                *sc_lost_recs;
+    unsigned                        sc_n_lost_recs,
+                                    sc_lost_recs_cap;
+    lsquic_packno_t                 sc_undo_end;
+    unsigned                        sc_reord_thresh;
+    /* Time-threshold loss detection: a packet sent before the largest
+     * acked packet is lost if it is not acked within RTT plus reordering
+     * window after it was sent.  The window is a multiple of min_rtt / 4;
+     * the multiplier grows when losses turn out to be spurious and is
+     * reset after a number of loss events without spurious losses.
+     */
+    lsquic_time_t                   sc_rack_rtt;
+    unsigned char                   sc_reo_wnd_mult,
+                                    sc_reo_wnd_persist;
     lsquic_packno_t                 sc_max_rtt_packno;
     /* sc_largest_ack2ed is the packet number sent by peer that we acked and
      * we know that our ACK was received by peer.  This is used to determine
@@ -81,7 +119,7 @@ typedef struct lsquic_send_ctl {
      * else and it is not insanely long.)
      */
     lsquic_packno_t                 sc_largest_ack2ed;
-    lsquic_time_t                   sc_loss_to;
+    lsquic_time_t                   sc_loss_time;   /* Absolute, or zero */
     struct
     {
         uint32_t                stream_id;
@@ -93,7 +131,9 @@ typedef struct lsquic_send_ctl {
     struct {
         unsigned            n_total_sent,
                             n_resent,
-                            n_delayed;
+                            n_lost,
+                            n_delayed,
+                            n_spurious;
     }                               sc_stats;
 #endif
 } lsquic_send_ctl_t;
@@ -135,6 +175,12 @@ lsquic_send_ctl_next_packet_to_send (lsquic_send_ctl_t *);
 void
 lsquic_send_ctl_expire_all (lsquic_send_ctl_t *ctl);
 
+struct lsquic_conn_info;
+
+/* Fill in RTT, congestion control, and packet counter members */
+void
+lsquic_send_ctl_get_info (const lsquic_send_ctl_t *, struct lsquic_conn_info *);
+
 #define lsquic_send_ctl_n_in_flight(ctl) (+(ctl)->sc_n_in_flight)
 
 #define lsquic_send_ctl_n_scheduled(ctl) (+(ctl)->sc_n_scheduled)
@@ -0,0 +1,121 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_sentwin.c -- Window of sent, not yet acknowledged packets.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_sentwin.h"
+
+#define INITIAL_NALLOC 16
+
+
+void
+lsquic_sentwin_init (struct lsquic_sentwin *win)
+{
+    memset(win, 0, sizeof(*win));
+}
+
+
+void
+lsquic_sentwin_cleanup (struct lsquic_sentwin *win)
+{
+    free(win->sw_slots);
+    win->sw_slots = NULL;
+    win->sw_nalloc = 0;
+}
+
+
+/* Grow the ring so that it can hold packets [sw_first, packno] */
+static int
+sentwin_grow (struct lsquic_sentwin *win, lsquic_packno_t packno)
+{
+    struct sentwin_slot *slots;
+    lsquic_packno_t n;
+    unsigned nalloc;
+
+    nalloc = win->sw_nalloc ? win->sw_nalloc : INITIAL_NALLOC;
+    while (packno - win->sw_first >= nalloc)
+    {
+        if (nalloc >= 1u << 31)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        nalloc <<= 1;
+    }
+
+    slots = calloc(nalloc, sizeof(slots[0]));
+    if (!slots)
+        return -1;
+
+    for (n = win->sw_first; n < win->sw_end; ++n)
+        slots[ n & (nalloc - 1) ] = *lsquic_sentwin_slot(win, n);
+
+    free(win->sw_slots);
+    win->sw_slots = slots;
+    win->sw_nalloc = nalloc;
+    return 0;
+}
+
+
+int
+lsquic_sentwin_add (struct lsquic_sentwin *win,
+                                        struct lsquic_packet_out *packet_out)
+{
+    const lsquic_packno_t packno = packet_out->po_packno;
+    struct sentwin_slot *slot;
+
+    if (0 == win->sw_count)
+        win->sw_first = win->sw_end = packno;
+    assert(packno >= win->sw_end);
+
+    if (packno - win->sw_first >= win->sw_nalloc
+                                        && 0 != sentwin_grow(win, packno))
+        return -1;
+
+    /* Slots outside of the window are always empty, including those
+     * between sw_end and packno, if there is a gap.
+     */
+    slot = lsquic_sentwin_slot(win, packno);
+    assert(!slot->ss_packet);
+    slot->ss_packet = packet_out;
+    slot->ss_sent   = packet_out->po_sent;
+    slot->ss_flags  = 0;
+    if (packet_out->po_frame_types & QFRAME_RETRANSMITTABLE_MASK)
+        slot->ss_flags |= SWS_RETX;
+    if (packet_out->po_flags & PO_HELLO)
+        slot->ss_flags |= SWS_HELLO;
+
+    win->sw_end = packno + 1;
+    ++win->sw_count;
+    return 0;
+}
+
+
+void
+lsquic_sentwin_remove (struct lsquic_sentwin *win, lsquic_packno_t packno)
+{
+    struct sentwin_slot *slot;
+
+    assert(packno >= win->sw_first && packno < win->sw_end);
+    slot = lsquic_sentwin_slot(win, packno);
+    assert(slot->ss_packet);
+    slot->ss_packet = NULL;
+    --win->sw_count;
+
+    if (0 == win->sw_count)
+        win->sw_first = win->sw_end;
+    else if (packno == win->sw_first)
+        do
+            ++win->sw_first;
+        while (!lsquic_sentwin_slot(win, win->sw_first)->ss_packet);
+}
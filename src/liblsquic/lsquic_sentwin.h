@@ -0,0 +1,77 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_sentwin.h -- Window of sent, not yet acknowledged packets.
+ *
+ * Packet numbers of sent packets follow each other without gaps (see
+ * lsquic_senhist.h), which lets us keep unacknowledged packets in a ring
+ * buffer indexed by packet number.  ACK ranges map directly to slots and
+ * removing a packet from the middle of the window is O(1).
+ *
+ * Each slot contains the information that loss detection looks at, so
+ * that scanning the window does not touch the packets themselves.  The
+ * window spans packet numbers [sw_first, sw_end); slots of packets that
+ * have been acknowledged or declared lost are empty.
+ */
+
+#ifndef LSQUIC_SENTWIN_H
+#define LSQUIC_SENTWIN_H 1
+
+struct lsquic_packet_out;
+
+enum sentwin_slot_flags {
+    SWS_RETX    = (1 << 0),     /* Packet is retransmittable */
+    SWS_HELLO   = (1 << 1),     /* Packet contains handshake data */
+};
+
+struct sentwin_slot
+{
+    struct lsquic_packet_out   *ss_packet;  /* NULL if slot is empty */
+    lsquic_time_t               ss_sent;
+    enum sentwin_slot_flags     ss_flags;
+};
+
+struct lsquic_sentwin
+{
+    struct sentwin_slot        *sw_slots;
+    unsigned                    sw_nalloc;  /* Power of two */
+    unsigned                    sw_count;   /* Number of non-empty slots */
+    lsquic_packno_t             sw_first;   /* Smallest packet in window */
+    lsquic_packno_t             sw_end;     /* One past the largest */
+};
+
+void
+lsquic_sentwin_init (struct lsquic_sentwin *);
+
+void
+lsquic_sentwin_cleanup (struct lsquic_sentwin *);
+
+/* The packet number must be larger than that of any packet added before.
+ * Returns 0 on success or -1 if memory could not be allocated.
+ */
+int
+lsquic_sentwin_add (struct lsquic_sentwin *, struct lsquic_packet_out *);
+
+void
+lsquic_sentwin_remove (struct lsquic_sentwin *, lsquic_packno_t);
+
+#define lsquic_sentwin_slot(win, packno) \
+            (&(win)->sw_slots[ (packno) & ((win)->sw_nalloc - 1) ])
+
+/* Returns NULL if the packet is not in the window */
+#define lsquic_sentwin_get(win, packno) (                                   \
+    (packno) >= (win)->sw_first && (packno) < (win)->sw_end ?               \
+                    lsquic_sentwin_slot(win, packno)->ss_packet : NULL)
+
+#define lsquic_sentwin_count(win) (+(win)->sw_count)
+
+#define lsquic_sentwin_empty(win) (0 == (win)->sw_count)
+
+/* Only valid if the window is not empty */
+#define lsquic_sentwin_first(win) (+(win)->sw_first)
+
+#define lsquic_sentwin_last(win) ((win)->sw_end - 1)
+
+#define lsquic_sentwin_mem_used(win) \
+            ((win)->sw_nalloc * sizeof((win)->sw_slots[0]))
+
+#endif
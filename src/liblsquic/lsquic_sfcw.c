@@ -31,28 +31,44 @@ lsquic_sfcw_init (struct lsquic_sfcw *fc, unsigned max_recv_window,
 {
     memset(fc, 0, sizeof(*fc));
     fc->sf_max_recv_win = max_recv_window;
+    fc->sf_init_recv_win = max_recv_window;
     fc->sf_cfcw = cfcw;
     fc->sf_conn_pub = cpub;
     fc->sf_stream_id = stream_id;
-    (void) lsquic_sfcw_fc_offsets_changed(fc);
+    fc->sf_recv_off = max_recv_window;
+    fc->sf_last_updated = lsquic_time_now();
 }
 
 
 static void
-sfcw_maybe_increase_max_window (struct lsquic_sfcw *fc)
+sfcw_tune_window (struct lsquic_sfcw *fc, lsquic_time_t now)
 {
-    unsigned new_max_window, max_conn_window;
+    unsigned new_max_window, max_window, max_conn_window;
+    lsquic_time_t srtt;
 
-    new_max_window = fc->sf_max_recv_win * 2;
+    srtt = lsquic_rtt_stats_get_srtt(&fc->sf_conn_pub->rtt_stats);
+    if (0 == srtt)
+        return;
+
+    new_max_window = lsquic_fcw_bdp_window(fc->sf_max_recv_win,
+                                fc->sf_read_off - fc->sf_last_read_off,
+                                now - fc->sf_last_updated, srtt);
 
     /* Do not increase past explicitly specified maximum */
-    if (new_max_window > fc->sf_conn_pub->enpub->enp_settings.es_max_sfcw)
-        new_max_window = fc->sf_conn_pub->enpub->enp_settings.es_max_sfcw;
+    max_window = fc->sf_conn_pub->enpub->enp_settings.es_max_sfcw;
+    if (max_window < fc->sf_init_recv_win)
+        max_window = fc->sf_init_recv_win;
+    if (new_max_window > max_window)
+        new_max_window = max_window;
+
+    /* Slow reader alone does not shrink window below initial value */
+    if (new_max_window < fc->sf_init_recv_win)
+        new_max_window = fc->sf_init_recv_win;
 
     if (fc->sf_cfcw)
     {
-        /* Do not increase past the connection's maximum window size.  The
-         * connection's window will be increased separately, if possible.
+        /* Do not go past the connection's maximum window size.  The
+         * connection's window is tuned separately.
          *
          * The reference implementation has the logic backwards:  Imagine
          * several concurrent streams that are not being read from fast
@@ -71,25 +87,25 @@ sfcw_maybe_increase_max_window (struct lsquic_sfcw *fc)
          */
     }
 
-    if (new_max_window > fc->sf_max_recv_win)
+    if (new_max_window < LSQUIC_MIN_FCW)
+        new_max_window = LSQUIC_MIN_FCW;
+
+    if (new_max_window != fc->sf_max_recv_win)
     {
-        LSQ_DEBUG("max window increase %u -> %u",
+        LSQ_DEBUG("max window change %u -> %u",
             fc->sf_max_recv_win, new_max_window);
         EV_LOG_CONN_EVENT(LSQUIC_LOG_CONN_ID,
-            "max SFCW increase %u -> %u", fc->sf_max_recv_win,
+            "max SFCW change %u -> %u", fc->sf_max_recv_win,
                                                             new_max_window);
         fc->sf_max_recv_win = new_max_window;
     }
-    else
-        LSQ_DEBUG("max window could use an increase, but we're stuck "
-            "at %u", fc->sf_max_recv_win);
 }
 
 
 int
 lsquic_sfcw_fc_offsets_changed (struct lsquic_sfcw *fc)
 {
-    lsquic_time_t since_last_update, srtt, now;
+    lsquic_time_t now;
 
     if (fc->sf_recv_off - fc->sf_read_off >= fc->sf_max_recv_win / 2)
     {
@@ -99,12 +115,13 @@ lsquic_sfcw_fc_offsets_changed (struct lsquic_sfcw *fc)
     }
 
     now = lsquic_time_now();
-    since_last_update = now - fc->sf_last_updated;
+    sfcw_tune_window(fc, now);
     fc->sf_last_updated = now;
+    fc->sf_last_read_off = fc->sf_read_off;
 
-    srtt = lsquic_rtt_stats_get_srtt(&fc->sf_conn_pub->rtt_stats);
-    if (since_last_update < srtt * 2)
-        sfcw_maybe_increase_max_window(fc);
+    /* If the window shrank, the offset already advertised still stands */
+    if (fc->sf_read_off + fc->sf_max_recv_win <= fc->sf_recv_off)
+        return 0;
 
     fc->sf_recv_off = fc->sf_read_off + fc->sf_max_recv_win;
     LSQ_DEBUG("recv_off changed: read_off: %"PRIu64"; "
@@ -17,9 +17,11 @@ typedef struct lsquic_sfcw {
     uint64_t            sf_recv_off;        /* Flow control receive offset */
     uint64_t            sf_read_off;        /* Number of bytes consumed */
     lsquic_time_t       sf_last_updated;    /* Last time window was updated */
+    uint64_t            sf_last_read_off;   /* Read offset at last update */
     struct lsquic_conn_public
                        *sf_conn_pub;
     unsigned            sf_max_recv_win;    /* Maximum receive window */
+    unsigned            sf_init_recv_win;   /* Initial receive window */
     unsigned            sf_stream_id;       /* Used for logging */
 } lsquic_sfcw_t;
 
@@ -39,6 +41,8 @@ lsquic_sfcw_fc_offsets_changed (lsquic_sfcw_t *);
 
 #define lsquic_sfcw_get_max_recv_off(fc) ((fc)->sf_max_recv_off)
 
+#define lsquic_sfcw_get_max_recv_window(fc) ((fc)->sf_max_recv_win)
+
 /* Returns false if flow control violation is encountered */
 int
 lsquic_sfcw_set_max_recv_off (lsquic_sfcw_t *, uint64_t);
@@ -47,8 +47,13 @@
 #include "lsquic_packet_out.h"
 #include "lsquic_engine_public.h"
 #include "lsquic_senhist.h"
+#include "lsquic_sentwin.h"
 #include "lsquic_pacer.h"
 #include "lsquic_cubic.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_prr.h"
 #include "lsquic_send_ctl.h"
 #include "lsquic_ev_log.h"
 
@@ -75,7 +80,8 @@ static int
 stream_readable (const lsquic_stream_t *stream);
 
 static ssize_t
-stream_write_to_packets (lsquic_stream_t *, struct lsquic_reader *, size_t);
+stream_write_to_packets (lsquic_stream_t *, struct lsquic_reader *, size_t,
+    ssize_t (*save)(lsquic_stream_t *, struct lsquic_reader *, size_t));
 
 static ssize_t
 save_to_buffer (lsquic_stream_t *, struct lsquic_reader *, size_t len);
@@ -233,6 +239,7 @@ lsquic_stream_new_ext (uint32_t id, struct lsquic_conn_public *conn_pub,
     stream->id        = id;
     stream->conn_pub  = conn_pub;
     stream->sm_onnew_arg = stream_if_ctx;
+    STAILQ_INIT(&stream->sm_refs);
     if (!initial_window)
         initial_window = 16 * 1024;
     if (LSQUIC_STREAM_HANDSHAKE == id ||
@@ -252,6 +259,8 @@ lsquic_stream_new_ext (uint32_t id, struct lsquic_conn_public *conn_pub,
     stream->max_send_off = initial_send_off;
     if (ctor_flags & SCF_USE_DI_HASH)
         stream->data_in = data_in_hash_new(conn_pub, id, 0);
+    else if (ctor_flags & SCF_USE_DI_RING)
+        stream->data_in = data_in_ring_new(conn_pub, id);
     else
         stream->data_in = data_in_nocopy_new(conn_pub, id);
     LSQ_DEBUG("created stream %u @%p", id, stream);
@@ -292,11 +301,26 @@ decr_conn_cap (struct lsquic_stream *stream, size_t incr)
 }
 
 
+static void
+release_ref (struct stream_ref *ref)
+{
+    ref->release(ref->ctx);
+    free(ref);
+}
+
+
 static void
 drop_buffered_data (struct lsquic_stream *stream)
 {
+    struct stream_ref *ref;
+
     decr_conn_cap(stream, stream->sm_n_buffered);
     stream->sm_n_buffered = 0;
+    while ((ref = STAILQ_FIRST(&stream->sm_refs)))
+    {
+        STAILQ_REMOVE_HEAD(&stream->sm_refs, next);
+        release_ref(ref);
+    }
     if (stream->stream_flags & STREAM_WRITE_Q_FLAGS)
         maybe_remove_from_write_q(stream, STREAM_WRITE_Q_FLAGS);
 }
@@ -470,7 +494,7 @@ int
 lsquic_stream_frame_in (lsquic_stream_t *stream, stream_frame_t *frame)
 {
     uint64_t max_off;
-    int got_next_offset;
+    int got_next_offset, fin;
     enum ins_frame ins_frame;
 
     assert(frame->packet_in);
@@ -487,17 +511,24 @@ lsquic_stream_frame_in (lsquic_stream_t *stream, stream_frame_t *frame)
         return -1;
     }
 
+    /* Update maximum offset in the flow controller and check for flow
+     * control violation.  This is done before the frame is inserted, so
+     * that data_in implementations never buffer data past the window.
+     */
+    max_off = frame->data_frame.df_offset + frame->data_frame.df_size;
+    if (0 != lsquic_stream_update_sfcw(stream, max_off))
+    {
+        lsquic_packet_in_put(stream->conn_pub->mm, frame->packet_in);
+        lsquic_malo_put(frame);
+        return -1;
+    }
+
     got_next_offset = frame->data_frame.df_offset == stream->read_offset;
+    fin = frame->data_frame.df_fin;
     ins_frame = stream->data_in->di_if->di_insert_frame(stream->data_in, frame, stream->read_offset);
     if (INS_FRAME_OK == ins_frame)
     {
-        /* Update maximum offset in the flow controller and check for flow
-         * control violation:
-         */
-        max_off = frame->data_frame.df_offset + frame->data_frame.df_size;
-        if (0 != lsquic_stream_update_sfcw(stream, max_off))
-            return -1;
-        if (frame->data_frame.df_fin)
+        if (fin)
         {
             SM_HISTORY_APPEND(stream, SHE_FIN_IN);
             stream->stream_flags |= STREAM_FIN_RECVD;
@@ -659,14 +690,18 @@ lsquic_stream_rst_frame_sent (lsquic_stream_t *stream)
 
 
 static size_t
-read_uh (lsquic_stream_t *stream, unsigned char *dst, size_t len)
+read_uh (lsquic_stream_t *stream,
+        size_t (*readf)(void *, const unsigned char *, size_t, int), void *ctx)
 {
     struct uncompressed_headers *uh = stream->uh;
-    size_t n_avail = uh->uh_size - uh->uh_off;
-    if (n_avail < len)
-        len = n_avail;
-    memcpy(dst, uh->uh_headers + uh->uh_off, len);
-    uh->uh_off += len;
+    const unsigned char *const buf = (void *) (uh->uh_headers + uh->uh_off);
+    const size_t n_avail = uh->uh_size - uh->uh_off;
+    const int fin = !!(stream->stream_flags & STREAM_HEAD_IN_FIN);
+    size_t nread;
+
+    nread = readf(ctx, buf, n_avail, fin);
+    assert(nread <= n_avail);
+    uh->uh_off += nread;
     if (uh->uh_off == uh->uh_size)
     {
         LSQ_DEBUG("read all uncompressed headers for stream %u", stream->id);
@@ -678,37 +713,22 @@ read_uh (lsquic_stream_t *stream, unsigned char *dst, size_t len)
             SM_HISTORY_APPEND(stream, SHE_REACH_FIN);
         }
     }
-    return len;
+    return nread;
 }
 
 
 /* This function returns 0 when EOF is reached.
  */
 ssize_t
-lsquic_stream_readv (lsquic_stream_t *stream, const struct iovec *iov,
-                     int iovcnt)
+lsquic_stream_readf (lsquic_stream_t *stream,
+        size_t (*readf)(void *, const unsigned char *, size_t, int), void *ctx)
 {
-    size_t total_nread, nread;
-    int processed_frames, read_unc_headers, iovidx;
-    unsigned char *p, *end;
+    struct data_frame *data_frame;
+    size_t total_nread, nread, navail;
+    int processed_frames, read_unc_headers, fin;
 
     SM_HISTORY_APPEND(stream, SHE_USER_READ);
 
-#define NEXT_IOV() do {                                             \
-    ++iovidx;                                                       \
-    while (iovidx < iovcnt && 0 == iov[iovidx].iov_len)             \
-        ++iovidx;                                                   \
-    if (iovidx < iovcnt)                                            \
-    {                                                               \
-        p = iov[iovidx].iov_base;                                   \
-        end = p + iov[iovidx].iov_len;                              \
-    }                                                               \
-    else                                                            \
-        p = end = NULL;                                             \
-} while (0)
-
-#define AVAIL() (end - p)
-
     if (stream->stream_flags & STREAM_RST_FLAGS)
     {
         errno = ECONNRESET;
@@ -725,41 +745,33 @@ lsquic_stream_readv (lsquic_stream_t *stream, const struct iovec *iov,
     total_nread = 0;
     processed_frames = 0;
 
-    iovidx = -1;
-    NEXT_IOV();
-
-    if (stream->uh && AVAIL())
+    if (stream->uh)
     {
-        read_unc_headers = 1;
-        do
-        {
-            nread = read_uh(stream, p, AVAIL());
-            p += nread;
-            total_nread += nread;
-            if (p == end)
-                NEXT_IOV();
-        }
-        while (stream->uh && AVAIL());
+        nread = read_uh(stream, readf, ctx);
+        total_nread += nread;
+        read_unc_headers = nread > 0 || !stream->uh;
     }
     else
         read_unc_headers = 0;
 
-    struct data_frame *data_frame;
-    while (AVAIL() && (data_frame = stream->data_in->di_if->di_get_frame(stream->data_in, stream->read_offset)))
-    {
-        ++processed_frames;
-        size_t navail = data_frame->df_size - data_frame->df_read_off;
-        size_t ntowrite = AVAIL();
-        if (navail < ntowrite)
-            ntowrite = navail;
-        memcpy(p, data_frame->df_data + data_frame->df_read_off, ntowrite);
-        p += ntowrite;
-        data_frame->df_read_off += ntowrite;
-        stream->read_offset += ntowrite;
-        total_nread += ntowrite;
+    /* Data frames are passed to the callback in place: only the bytes it
+     * consumes are marked as read.  Once the callback takes less than it
+     * was offered, reading stops.
+     */
+    while (!stream->uh && (data_frame = stream->data_in->di_if->di_get_frame(
+                                        stream->data_in, stream->read_offset)))
+    {
+        navail = data_frame->df_size - data_frame->df_read_off;
+        fin = data_frame->df_fin;
+        nread = readf(ctx, data_frame->df_data + data_frame->df_read_off,
+                                                                navail, fin);
+        assert(nread <= navail);
+        data_frame->df_read_off += nread;
+        stream->read_offset += nread;
+        total_nread += nread;
         if (data_frame->df_read_off == data_frame->df_size)
         {
-            const int fin = data_frame->df_fin;
+            ++processed_frames;
             stream->data_in->di_if->di_frame_done(stream->data_in, data_frame);
             if ((stream->stream_flags & STREAM_AUTOSWITCH) &&
                     (stream->data_in->di_flags & DI_SWITCH_IMPL))
@@ -778,8 +790,11 @@ lsquic_stream_readv (lsquic_stream_t *stream, const struct iovec *iov,
                 break;
             }
         }
-        if (p == end)
-            NEXT_IOV();
+        else
+        {
+            processed_frames += nread > 0;
+            break;
+        }
     }
 
     LSQ_DEBUG("%s: read %zd bytes, read offset %"PRIu64, __func__,
@@ -810,6 +825,57 @@ lsquic_stream_readv (lsquic_stream_t *stream, const struct iovec *iov,
 }
 
 
+struct readv_ctx
+{
+    const struct iovec         *iov;
+    const struct iovec   *const end;
+    unsigned char              *p;
+};
+
+
+static size_t
+readv_f (void *ctx_p, const unsigned char *buf, size_t len, int fin)
+{
+    struct readv_ctx *const ctx = ctx_p;
+    const unsigned char *const end = buf + len;
+    unsigned char *iov_end;
+    size_t ntocopy;
+
+    while (ctx->iov < ctx->end && buf < end)
+    {
+        iov_end = (unsigned char *) ctx->iov->iov_base + ctx->iov->iov_len;
+        ntocopy = iov_end - ctx->p;
+        if (ntocopy > (size_t) (end - buf))
+            ntocopy = end - buf;
+        memcpy(ctx->p, buf, ntocopy);
+        ctx->p += ntocopy;
+        buf += ntocopy;
+        if (ctx->p == iov_end)
+        {
+            ++ctx->iov;
+            if (ctx->iov < ctx->end)
+                ctx->p = ctx->iov->iov_base;
+        }
+    }
+
+    return len - (end - buf);
+}
+
+
+/* This function returns 0 when EOF is reached.
+ */
+ssize_t
+lsquic_stream_readv (lsquic_stream_t *stream, const struct iovec *iov,
+                     int iovcnt)
+{
+    struct readv_ctx ctx = { iov, iov + iovcnt, NULL, };
+
+    if (iovcnt > 0)
+        ctx.p = iov->iov_base;
+    return lsquic_stream_readf(stream, readv_f, &ctx);
+}
+
+
 ssize_t
 lsquic_stream_read (lsquic_stream_t *stream, void *buf, size_t len)
 {
@@ -1282,7 +1348,7 @@ stream_flush (lsquic_stream_t *stream)
     empty_reader.lsqr_size = inner_reader_empty_size;
     empty_reader.lsqr_read = inner_reader_empty_read;
     empty_reader.lsqr_ctx  = NULL;  /* pro forma */
-    nw = stream_write_to_packets(stream, &empty_reader, 0);
+    nw = stream_write_to_packets(stream, &empty_reader, 0, save_to_buffer);
 
     if (nw >= 0)
     {
@@ -1426,6 +1492,43 @@ incr_conn_cap (struct lsquic_stream *stream, size_t incr)
 }
 
 
+/* Copy `len' bytes of buffered data to `dst' and remove them from the
+ * buffer.  User buffers are released once all their data is taken.
+ */
+static void
+take_buffered (lsquic_stream_t *stream, unsigned char *dst, size_t len)
+{
+    struct stream_ref *ref;
+    size_t ntocopy;
+
+    assert(len <= stream->sm_n_buffered);
+    stream->sm_n_buffered -= len;
+
+    if (STAILQ_EMPTY(&stream->sm_refs))
+    {
+        memcpy(dst, stream->sm_buf, len);
+        memmove(stream->sm_buf, stream->sm_buf + len, stream->sm_n_buffered);
+        return;
+    }
+
+    while (len > 0)
+    {
+        ref = STAILQ_FIRST(&stream->sm_refs);
+        ntocopy = ref->len < len ? ref->len : len;
+        memcpy(dst, ref->buf, ntocopy);
+        dst += ntocopy;
+        len -= ntocopy;
+        ref->buf += ntocopy;
+        ref->len -= ntocopy;
+        if (0 == ref->len)
+        {
+            STAILQ_REMOVE_HEAD(&stream->sm_refs, next);
+            release_ref(ref);
+        }
+    }
+}
+
+
 static size_t
 frame_gen_read (void *ctx, void *begin_buf, size_t len, int *fin)
 {
@@ -1439,17 +1542,13 @@ frame_gen_read (void *ctx, void *begin_buf, size_t len, int *fin)
     {
         if (len <= stream->sm_n_buffered)
         {
-            memcpy(p, stream->sm_buf, len);
-            memmove(stream->sm_buf, stream->sm_buf + len,
-                                                stream->sm_n_buffered - len);
-            stream->sm_n_buffered -= len;
+            take_buffered(stream, p, len);
             stream->tosend_off += len;
             *fin = frame_gen_fin(fg_ctx);
             return len;
         }
-        memcpy(p, stream->sm_buf, stream->sm_n_buffered);
         p += stream->sm_n_buffered;
-        stream->sm_n_buffered = 0;
+        take_buffered(stream, begin_buf, stream->sm_n_buffered);
     }
 
     available = stream_write_avail(fg_ctx->fgc_stream);
@@ -1567,7 +1666,8 @@ abort_connection (struct lsquic_stream *stream)
 
 static ssize_t
 stream_write_to_packets (lsquic_stream_t *stream, struct lsquic_reader *reader,
-                         size_t thresh)
+    size_t thresh,
+    ssize_t (*save)(lsquic_stream_t *, struct lsquic_reader *, size_t))
 {
     size_t size;
     ssize_t nw;
@@ -1607,7 +1707,7 @@ stream_write_to_packets (lsquic_stream_t *stream, struct lsquic_reader *reader,
         size -= stream->sm_n_buffered;
         if (size > 0)
         {
-            nw = save_to_buffer(stream, reader, size);
+            nw = save(stream, reader, size);
             if (nw < 0)
                 return -1;
             fg_ctx.fgc_nread_from_reader += nw; /* Make this cleaner? */
@@ -1652,6 +1752,7 @@ save_to_buffer (lsquic_stream_t *stream, struct lsquic_reader *reader,
                                                                 size_t len)
 {
     size_t avail, n_written;
+    unsigned short n_buffered;
 
     assert(stream->sm_n_buffered + len <= SM_BUF_SIZE);
 
@@ -1662,6 +1763,16 @@ save_to_buffer (lsquic_stream_t *stream, struct lsquic_reader *reader,
             return -1;
     }
 
+    /* Data written by reference comes first: copy it so that all buffered
+     * data is in sm_buf.
+     */
+    if (!STAILQ_EMPTY(&stream->sm_refs))
+    {
+        n_buffered = stream->sm_n_buffered;
+        take_buffered(stream, stream->sm_buf, n_buffered);
+        stream->sm_n_buffered = n_buffered;
+    }
+
     avail = stream_write_avail(stream);
     if (avail < len)
         len = avail;
@@ -1678,7 +1789,8 @@ save_to_buffer (lsquic_stream_t *stream, struct lsquic_reader *reader,
 
 
 static ssize_t
-stream_write (lsquic_stream_t *stream, struct lsquic_reader *reader)
+stream_write (lsquic_stream_t *stream, struct lsquic_reader *reader,
+    ssize_t (*save)(lsquic_stream_t *, struct lsquic_reader *, size_t))
 {
     size_t thresh, len;
 
@@ -1686,9 +1798,9 @@ stream_write (lsquic_stream_t *stream, struct lsquic_reader *reader)
     len = reader->lsqr_size(reader->lsqr_ctx);
     if (stream->sm_n_buffered + len <= SM_BUF_SIZE &&
                                     stream->sm_n_buffered + len < thresh)
-        return save_to_buffer(stream, reader, len);
+        return save(stream, reader, len);
     else
-        return stream_write_to_packets(stream, reader, thresh);
+        return stream_write_to_packets(stream, reader, thresh, save);
 }
 
 
@@ -1768,7 +1880,7 @@ lsquic_stream_writev (lsquic_stream_t *stream, const struct iovec *iov,
         .lsqr_ctx  = &iro,
     };
 
-    return stream_write(stream, &reader);
+    return stream_write(stream, &reader, save_to_buffer);
 }
 
 
@@ -1777,7 +1889,109 @@ lsquic_stream_writef (lsquic_stream_t *stream, struct lsquic_reader *reader)
 {
     COMMON_WRITE_CHECKS();
     SM_HISTORY_APPEND(stream, SHE_USER_WRITE_DATA);
-    return stream_write(stream, reader);
+    return stream_write(stream, reader, save_to_buffer);
+}
+
+
+struct inner_reader_ref
+{
+    const unsigned char    *buf;
+    size_t                  len;
+    size_t                  off;
+    /* Set to NULL once the reference is passed to the stream */
+    void                  (*release)(void *);
+    void                   *ctx;
+};
+
+
+static size_t
+inner_reader_ref_read (void *ctx, void *buf, size_t count)
+{
+    struct inner_reader_ref *const irr = ctx;
+
+    if (count > irr->len - irr->off)
+        count = irr->len - irr->off;
+    memcpy(buf, irr->buf + irr->off, count);
+    irr->off += count;
+    return count;
+}
+
+
+static size_t
+inner_reader_ref_size (void *ctx)
+{
+    struct inner_reader_ref *const irr = ctx;
+    return irr->len - irr->off;
+}
+
+
+/* Instead of copying the data that does not fill a packet to sm_buf, keep
+ * a reference to the user buffer.  If sm_buf already has data, the new
+ * data is copied after it.
+ */
+static ssize_t
+save_to_ref (lsquic_stream_t *stream, struct lsquic_reader *reader,
+                                                                size_t len)
+{
+    struct inner_reader_ref *const irr = reader->lsqr_ctx;
+    struct stream_ref *ref;
+    size_t avail;
+
+    if (stream->sm_n_buffered > 0 && STAILQ_EMPTY(&stream->sm_refs))
+        return save_to_buffer(stream, reader, len);
+
+    avail = stream_write_avail(stream);
+    if (avail < len)
+        len = avail;
+    if (0 == len)
+        return 0;
+
+    ref = malloc(sizeof(*ref));
+    if (!ref)
+        return -1;
+    ref->buf     = irr->buf + irr->off;
+    ref->len     = len;
+    ref->release = irr->release;
+    ref->ctx     = irr->ctx;
+    irr->release = NULL;
+    irr->off += len;
+    STAILQ_INSERT_TAIL(&stream->sm_refs, ref, next);
+    stream->sm_n_buffered += len;
+    incr_conn_cap(stream, len);
+    LSQ_DEBUG("buffered %zd bytes by reference; %hu bytes are now buffered",
+              len, stream->sm_n_buffered);
+    maybe_flush_stream(stream);
+    return len;
+}
+
+
+ssize_t
+lsquic_stream_write_nobuf (lsquic_stream_t *stream, const void *buf,
+                size_t len, void (*release)(void *ctx), void *ctx)
+{
+    ssize_t nw;
+
+    COMMON_WRITE_CHECKS();
+    SM_HISTORY_APPEND(stream, SHE_USER_WRITE_DATA);
+
+    struct inner_reader_ref irr = {
+        .buf     = buf,
+        .len     = len,
+        .off     = 0,
+        .release = release,
+        .ctx     = ctx,
+    };
+    struct lsquic_reader reader = {
+        .lsqr_read = inner_reader_ref_read,
+        .lsqr_size = inner_reader_ref_size,
+        .lsqr_ctx  = &irr,
+    };
+
+    nw = stream_write(stream, &reader, save_to_ref);
+    /* If the stream did not keep a reference, the data has been copied */
+    if (nw > 0 && irr.release)
+        release(ctx);
+    return nw;
 }
 
 
@@ -2084,11 +2298,14 @@ lsquic_stream_refuse_push (lsquic_stream_t *stream)
 size_t
 lsquic_stream_mem_used (const struct lsquic_stream *stream)
 {
+    const struct stream_ref *ref;
     size_t size;
 
     size = sizeof(stream);
     if (stream->sm_buf)
         size += SM_BUF_SIZE;
+    STAILQ_FOREACH(ref, &stream->sm_refs, next)
+        size += sizeof(*ref);
     if (stream->data_in)
         size += stream->data_in->di_if->di_mem_used(stream->data_in);
 
@@ -33,6 +33,18 @@ typedef unsigned char sm_hist_idx_t;
 #endif
 
 
+/* Data handed over by the user using lsquic_stream_write_nobuf().  It is
+ * buffered by reference until it is packetized.
+ */
+struct stream_ref
+{
+    STAILQ_ENTRY(stream_ref)        next;
+    const unsigned char            *buf;
+    size_t                          len;
+    void                          (*release)(void *);
+    void                           *ctx;
+};
+
 struct lsquic_stream
 {
     uint32_t                        id;
@@ -116,10 +128,12 @@ struct lsquic_stream
                                    *push_req;
 
     unsigned char                  *sm_buf;
+    /* Buffered data is either in sm_buf or in sm_refs, never in both */
+    STAILQ_HEAD(, stream_ref)       sm_refs;
     void                           *sm_onnew_arg;
 
     unsigned                        n_unacked;
-    unsigned short                  sm_n_buffered;  /* Amount of data in sm_buf */
+    unsigned short                  sm_n_buffered;  /* Amount of buffered data */
 
     unsigned char                   sm_priority;  /* 0: high; 255: low */
 #if LSQUIC_KEEP_STREAM_HISTORY
@@ -144,6 +158,9 @@ enum stream_ctor_flags
                                    * performance.
                                    */
     SCF_DISP_RW_ONCE  = (1 << 3),
+    SCF_USE_DI_RING   = (1 << 4), /* Use ring buffer data input.  It does
+                                   * not switch to other implementations.
+                                   */
 };
 
 
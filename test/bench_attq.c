@@ -0,0 +1,417 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * bench_attq.c -- Benchmark the Advisory Tick Time Queue
+ *
+ * Compares the timing wheel in lsquic_attq.c with the binary heap it
+ * replaced (a copy of which is included below).  The workload models an
+ * engine with many mostly idle connections: on each tick, connections
+ * whose time has come are popped and re-armed with an idle timer, and a
+ * small share of active connections re-register with a short advisory
+ * time.  Prints nanoseconds per queue operation for both implementations.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <unistd.h>
+
+#include "lsquic.h"
+
+#include "../src/liblsquic/lsquic_int_types.h"
+#include "../src/liblsquic/lsquic_attq.h"
+#include "../src/liblsquic/lsquic_conn.h"
+#include "../src/liblsquic/lsquic_malo.h"
+#include "../src/liblsquic/lsquic_util.h"
+
+
+/* The binary heap, as it was before the timing wheel.  Like the original,
+ * it allocates an element each time a connection is added.
+ */
+
+struct heap_elem
+{
+    unsigned            he_conn;
+    lsquic_time_t       he_time;
+    unsigned            he_idx;
+};
+
+struct heap
+{
+    struct heap_elem  **h_elems;
+    unsigned            h_nelem;
+};
+
+/* Stand-in for lsquic_conn, so that looking up the element of a connection
+ * costs the same for both implementations.
+ */
+struct heap_conn
+{
+    struct heap_elem   *hc_elem;
+    char                hc_pad[sizeof(struct lsquic_conn)
+                                                - sizeof(struct heap_elem *)];
+};
+
+#define HE_PARENT(i) ((i - 1) / 2)
+#define HE_LCHILD(i) (2 * i + 1)
+#define HE_RCHILD(i) (2 * i + 2)
+
+
+static void
+heap_swap (struct heap *h, unsigned a, unsigned b)
+{
+    struct heap_elem *el;
+
+    el = h->h_elems[ a ];
+    h->h_elems[ a ] = h->h_elems[ b ];
+    h->h_elems[ b ] = el;
+    h->h_elems[ a ]->he_idx = a;
+    h->h_elems[ b ]->he_idx = b;
+}
+
+
+static void
+heap_add (struct heap *h, struct heap_elem *el, lsquic_time_t time)
+{
+    unsigned i;
+
+    el->he_time = time;
+    el->he_idx = h->h_nelem;
+    h->h_elems[ h->h_nelem++ ] = el;
+
+    i = h->h_nelem - 1;
+    while (i > 0 && h->h_elems[ HE_PARENT(i) ]->he_time >=
+                                        h->h_elems[ i ]->he_time)
+    {
+        heap_swap(h, i, HE_PARENT(i));
+        i = HE_PARENT(i);
+    }
+}
+
+
+static void
+heap_heapify (struct heap *h, unsigned i)
+{
+    unsigned smallest;
+
+    if (HE_LCHILD(i) < h->h_nelem)
+    {
+        if (h->h_elems[ HE_LCHILD(i) ]->he_time <
+                                    h->h_elems[ i ]->he_time)
+            smallest = HE_LCHILD(i);
+        else
+            smallest = i;
+        if (HE_RCHILD(i) < h->h_nelem &&
+            h->h_elems[ HE_RCHILD(i) ]->he_time <
+                                    h->h_elems[ smallest ]->he_time)
+            smallest = HE_RCHILD(i);
+    }
+    else
+        smallest = i;
+
+    if (smallest != i)
+    {
+        heap_swap(h, smallest, i);
+        heap_heapify(h, smallest);
+    }
+}
+
+
+static void
+heap_remove (struct heap *h, struct heap_elem *el)
+{
+    unsigned idx;
+
+    idx = el->he_idx;
+    h->h_elems[ idx ] = h->h_elems[ --h->h_nelem ];
+    h->h_elems[ idx ]->he_idx = idx;
+    if (idx > 0 && h->h_elems[ idx ]->he_time <
+                                h->h_elems[ HE_PARENT(idx) ]->he_time)
+    {
+        do
+        {
+            heap_swap(h, idx, HE_PARENT(idx));
+            idx = HE_PARENT(idx);
+        }
+        while (idx > 0 && h->h_elems[ idx ]->he_time <
+                                h->h_elems[ HE_PARENT(idx) ]->he_time);
+    }
+    else if (h->h_nelem > 1 && idx < h->h_nelem)
+        heap_heapify(h, idx);
+}
+
+
+static struct heap_elem *
+heap_pop (struct heap *h, lsquic_time_t cutoff)
+{
+    struct heap_elem *el;
+
+    if (h->h_nelem == 0)
+        return NULL;
+
+    el = h->h_elems[0];
+    if (el->he_time >= cutoff)
+        return NULL;
+
+    heap_remove(h, el);
+    return el;
+}
+
+
+static const lsquic_time_t *
+heap_next_time (struct heap *h)
+{
+    if (h->h_nelem > 0)
+        return &h->h_elems[0]->he_time;
+    else
+        return NULL;
+}
+
+
+struct workload
+{
+    unsigned        n_conns;
+    unsigned        n_ticks;
+    unsigned        n_active;       /* Re-register on each tick */
+    lsquic_time_t   tick;           /* Time between ticks */
+    lsquic_time_t   idle;           /* Idle timers are up to this long */
+    lsquic_time_t   active;         /* Active timers are up to this long */
+};
+
+
+static uint64_t
+next_rand (uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+
+/* The idle timer depends only on the connection and the time, so that both
+ * implementations produce the same results no matter in which order the
+ * connections with equal times are popped.
+ */
+static lsquic_time_t
+idle_time (const struct workload *w, unsigned idx, lsquic_time_t now)
+{
+    uint64_t x;
+
+    x = ((uint64_t) idx << 32 | idx) ^ now;
+    x *= 0x9E3779B97F4A7C15ull;
+    x ^= x >> 29;
+    return now + 1 + x % w->idle;
+}
+
+
+/* Returns number of operations performed during the ticks; their duration
+ * is returned in `usec'.  Filling the queue is not timed.  `checksum' is
+ * used to compare the results of the two implementations.
+ */
+static unsigned long
+run_heap (const struct workload *w, uint64_t *checksum, lsquic_time_t *usec)
+{
+    struct heap heap;
+    struct malo *malo;
+    struct heap_conn *conns, *conn;
+    struct heap_elem *el;
+    lsquic_time_t now, start;
+    const lsquic_time_t *next;
+    uint64_t rand_state = 1;
+    unsigned long n_ops;
+    unsigned i, tick, idx;
+
+    malo = lsquic_malo_create(sizeof(struct heap_elem));
+    conns = calloc(w->n_conns, sizeof(conns[0]));
+    heap.h_elems = malloc(w->n_conns * sizeof(heap.h_elems[0]));
+    heap.h_nelem = 0;
+    now = 1000000;
+    for (i = 0; i < w->n_conns; ++i)
+    {
+        conns[i].hc_elem = lsquic_malo_get(malo);
+        conns[i].hc_elem->he_conn = i;
+        heap_add(&heap, conns[i].hc_elem, idle_time(w, i, now));
+    }
+    n_ops = 0;
+
+    *checksum = 0;
+    start = lsquic_time_now();
+    for (tick = 0; tick < w->n_ticks; ++tick)
+    {
+        now += w->tick;
+        for (i = 0; i < w->n_active; ++i)
+        {
+            conn = &conns[ next_rand(&rand_state) % w->n_conns ];
+            heap_remove(&heap, conn->hc_elem);
+            lsquic_malo_put(conn->hc_elem);
+            conn->hc_elem = lsquic_malo_get(malo);
+            conn->hc_elem->he_conn = conn - conns;
+            heap_add(&heap, conn->hc_elem,
+                                now + next_rand(&rand_state) % w->active);
+        }
+        n_ops += w->n_active * 2;
+        while ((el = heap_pop(&heap, now)))
+        {
+            idx = el->he_conn;
+            *checksum += idx;
+            lsquic_malo_put(el);
+            conns[idx].hc_elem = lsquic_malo_get(malo);
+            conns[idx].hc_elem->he_conn = idx;
+            heap_add(&heap, conns[idx].hc_elem, idle_time(w, idx, now));
+            n_ops += 2;
+        }
+        next = heap_next_time(&heap);
+        *checksum += *next;
+        n_ops += 2;
+    }
+    *usec = lsquic_time_now() - start;
+
+    lsquic_malo_destroy(malo);
+    free(heap.h_elems);
+    free(conns);
+    return n_ops;
+}
+
+
+static unsigned long
+run_attq (const struct workload *w, uint64_t *checksum, lsquic_time_t *usec)
+{
+    struct attq *attq;
+    struct lsquic_conn *conns, *conn;
+    lsquic_time_t now, start;
+    const lsquic_time_t *next;
+    uint64_t rand_state = 1;
+    unsigned long n_ops;
+    unsigned i, tick;
+
+    conns = calloc(w->n_conns, sizeof(conns[0]));
+    attq = attq_create();
+    now = 1000000;
+    for (i = 0; i < w->n_conns; ++i)
+        attq_add(attq, &conns[i], idle_time(w, i, now));
+    n_ops = 0;
+
+    *checksum = 0;
+    start = lsquic_time_now();
+    for (tick = 0; tick < w->n_ticks; ++tick)
+    {
+        now += w->tick;
+        for (i = 0; i < w->n_active; ++i)
+        {
+            conn = &conns[ next_rand(&rand_state) % w->n_conns ];
+            attq_remove(attq, conn);
+            attq_add(attq, conn, now + next_rand(&rand_state) % w->active);
+        }
+        n_ops += w->n_active * 2;
+        while ((conn = attq_pop(attq, now)))
+        {
+            *checksum += conn - conns;
+            attq_add(attq, conn, idle_time(w, conn - conns, now));
+            n_ops += 2;
+        }
+        next = attq_next_time(attq);
+        *checksum += *next;
+        n_ops += 2;
+    }
+    *usec = lsquic_time_now() - start;
+
+    attq_destroy(attq);
+    free(conns);
+    return n_ops;
+}
+
+
+static void
+usage (const char *argv0)
+{
+    printf(
+"Usage: %s [options]\n"
+"\n"
+"   -n COUNT    Number of connections.  May be specified more than once.\n"
+"                 Defaults to 10000, 100000, and 1000000.\n"
+"   -t TICKS    Number of ticks.  Defaults to 10000.\n"
+"   -a PERCENT  Percentage of connections that re-register on each tick.\n"
+"                 Defaults to 1.\n"
+"   -h          Print this help screen and exit.\n"
+    , argv0);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    static const unsigned default_counts[] = { 10000, 100000, 1000000, };
+    unsigned counts[16], n_counts, i, percent;
+    struct workload w;
+    lsquic_time_t heap_usec, attq_usec;
+    unsigned long heap_ops, attq_ops;
+    uint64_t heap_sum, attq_sum;
+    int opt;
+
+    memset(&w, 0, sizeof(w));
+    w.n_ticks = 10000;
+    w.tick    = 1000;                   /* 1 ms */
+    w.idle    = 30 * 1000000;           /* 30 seconds */
+    w.active  = 100 * 1000;             /* 100 ms */
+    percent   = 1;
+    n_counts  = 0;
+
+    while (-1 != (opt = getopt(argc, argv, "n:t:a:h")))
+    {
+        switch (opt)
+        {
+        case 'n':
+            if (n_counts < sizeof(counts) / sizeof(counts[0]))
+                counts[ n_counts++ ] = atoi(optarg);
+            break;
+        case 't':
+            w.n_ticks = atoi(optarg);
+            break;
+        case 'a':
+            percent = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (n_counts == 0)
+    {
+        memcpy(counts, default_counts, sizeof(default_counts));
+        n_counts = sizeof(default_counts) / sizeof(default_counts[0]);
+    }
+
+    printf("%8s %12s %12s %8s\n", "conns", "heap ns/op", "wheel ns/op",
+                                                                "speedup");
+    for (i = 0; i < n_counts; ++i)
+    {
+        if (counts[i] == 0)
+            continue;
+        w.n_conns = counts[i];
+        w.n_active = w.n_conns * percent / 100;
+
+        heap_ops = run_heap(&w, &heap_sum, &heap_usec);
+        attq_ops = run_attq(&w, &attq_sum, &attq_usec);
+
+        if (heap_sum != attq_sum || heap_ops != attq_ops)
+        {
+            fprintf(stderr, "results differ for %u connections\n",
+                                                                counts[i]);
+            exit(EXIT_FAILURE);
+        }
+
+        printf("%8u %12.1f %12.1f %7.2fx\n", counts[i],
+            (double) heap_usec * 1000 / (double) heap_ops,
+            (double) attq_usec * 1000 / (double) attq_ops,
+            (double) heap_usec / (double) attq_usec);
+    }
+
+    exit(EXIT_SUCCESS);
+}
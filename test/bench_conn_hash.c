@@ -0,0 +1,342 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * bench_conn_hash.c -- Benchmark the connection hash
+ *
+ * Compares the open-addressing table in lsquic_conn_hash.c with the
+ * chained hash it replaced (a copy of which is included below).  Both
+ * hashes are filled with the same connection IDs; then each ID is looked
+ * up in random order, as happens when packets come in, followed by the
+ * same number of lookups of IDs that are not in the hash.  The longest
+ * time a single add took is printed as well: the chained hash doubled its
+ * buckets in one go, while the new table grows incrementally.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lsquic.h"
+
+#include "../src/liblsquic/lsquic_int_types.h"
+#include "../src/liblsquic/lsquic_conn.h"
+#include "../src/liblsquic/lsquic_conn_hash.h"
+#include "../src/liblsquic/lsquic_malo.h"
+#include "../src/liblsquic/lsquic_xxhash.h"
+
+
+/* The chained hash, as it was before the open-addressing table.  Buckets
+ * are linked through the connections.
+ */
+
+#define CHAIN_MAX_PER_BUCKET 2
+
+/* Stand-in for lsquic_conn, so that following the chain costs the same as
+ * it did with real connections.
+ */
+struct chain_conn
+{
+    TAILQ_ENTRY(chain_conn)     cc_next_hash;
+    lsquic_cid_t                cc_cid;
+    unsigned                    cc_hash;
+    char                        cc_pad[sizeof(struct lsquic_conn)
+                                        - sizeof(TAILQ_ENTRY(chain_conn))
+                                        - sizeof(lsquic_cid_t)
+                                        - sizeof(unsigned)];
+};
+
+TAILQ_HEAD(chain_head, chain_conn);
+
+struct chain_hash
+{
+    struct chain_head  *ch_buckets;
+    unsigned            ch_count;
+    unsigned            ch_nbits;
+};
+
+#define chain_mask(h) ((1U << (h)->ch_nbits) - 1)
+
+
+static void
+chain_init (struct chain_hash *h)
+{
+    h->ch_count = 0;
+    h->ch_nbits = 1;
+    h->ch_buckets = malloc(sizeof(h->ch_buckets[0]) << h->ch_nbits);
+    TAILQ_INIT(&h->ch_buckets[0]);
+    TAILQ_INIT(&h->ch_buckets[1]);
+}
+
+
+static struct chain_conn *
+chain_find (struct chain_hash *h, lsquic_cid_t cid)
+{
+    const unsigned hash = XXH32(&cid, sizeof(cid), (uintptr_t) h);
+    struct chain_conn *conn;
+
+    TAILQ_FOREACH(conn, &h->ch_buckets[hash & chain_mask(h)], cc_next_hash)
+        if (conn->cc_cid == cid)
+            return conn;
+    return NULL;
+}
+
+
+static void
+chain_double (struct chain_hash *h)
+{
+    struct chain_head *new_buckets, *new[2];
+    struct chain_conn *conn;
+    unsigned n, old_n;
+
+    old_n = 1U << h->ch_nbits;
+    new_buckets = malloc(sizeof(new_buckets[0]) * old_n * 2);
+    for (n = 0; n < old_n; ++n)
+    {
+        new[0] = &new_buckets[n];
+        new[1] = &new_buckets[n + old_n];
+        TAILQ_INIT(new[0]);
+        TAILQ_INIT(new[1]);
+        while ((conn = TAILQ_FIRST(&h->ch_buckets[n])))
+        {
+            TAILQ_REMOVE(&h->ch_buckets[n], conn, cc_next_hash);
+            TAILQ_INSERT_TAIL(new[(conn->cc_hash >> h->ch_nbits) & 1], conn,
+                                                                cc_next_hash);
+        }
+    }
+    free(h->ch_buckets);
+    h->ch_buckets = new_buckets;
+    ++h->ch_nbits;
+}
+
+
+static void
+chain_add (struct chain_hash *h, struct chain_conn *conn)
+{
+    conn->cc_hash = XXH32(&conn->cc_cid, sizeof(conn->cc_cid), (uintptr_t) h);
+    if (h->ch_count >= (1U << h->ch_nbits) * CHAIN_MAX_PER_BUCKET)
+        chain_double(h);
+    TAILQ_INSERT_TAIL(&h->ch_buckets[conn->cc_hash & chain_mask(h)], conn,
+                                                                cc_next_hash);
+    ++h->ch_count;
+}
+
+
+static uint64_t
+next_rand (uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+
+static uint64_t
+now_nsec (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+struct result
+{
+    double      hit_ns,         /* Per lookup */
+                miss_ns;        /* Per lookup */
+    uint64_t    max_add_ns;
+};
+
+
+static void
+run_chain (unsigned n_conns, const lsquic_cid_t *cids,
+           const lsquic_cid_t *hits, const lsquic_cid_t *misses,
+           struct result *res)
+{
+    struct chain_hash h;
+    struct chain_conn *conns;
+    uint64_t start, elapsed;
+    unsigned n, found;
+
+    conns = calloc(n_conns, sizeof(conns[0]));
+    chain_init(&h);
+
+    res->max_add_ns = 0;
+    for (n = 0; n < n_conns; ++n)
+    {
+        conns[n].cc_cid = cids[n];
+        start = now_nsec();
+        chain_add(&h, &conns[n]);
+        elapsed = now_nsec() - start;
+        if (elapsed > res->max_add_ns)
+            res->max_add_ns = elapsed;
+    }
+
+    found = 0;
+    start = now_nsec();
+    for (n = n_conns; n > 0; --n)
+        found += NULL != chain_find(&h, hits[n - 1]);
+    res->hit_ns = (double) (now_nsec() - start) / n_conns;
+    assert(found == n_conns);
+
+    start = now_nsec();
+    for (n = 0; n < n_conns; ++n)
+        found += NULL != chain_find(&h, misses[n]);
+    res->miss_ns = (double) (now_nsec() - start) / n_conns;
+    assert(found == n_conns);
+
+    free(h.ch_buckets);
+    free(conns);
+}
+
+
+static void
+run_conn_hash (unsigned n_conns, const lsquic_cid_t *cids,
+               const lsquic_cid_t *hits, const lsquic_cid_t *misses,
+           struct result *res)
+{
+    struct conn_hash h;
+    struct malo *malo;
+    struct lsquic_conn *conn;
+    uint64_t start, elapsed;
+    unsigned n, found;
+
+    malo = lsquic_malo_create(sizeof(*conn));
+    if (0 != conn_hash_init(&h, n_conns))
+    {
+        perror("conn_hash_init");
+        exit(EXIT_FAILURE);
+    }
+
+    res->max_add_ns = 0;
+    for (n = 0; n < n_conns; ++n)
+    {
+        conn = lsquic_malo_get(malo);
+        memset(conn, 0, sizeof(*conn));
+        conn->cn_cid = cids[n];
+        start = now_nsec();
+        if (0 != conn_hash_add(&h, conn))
+        {
+            perror("conn_hash_add");
+            exit(EXIT_FAILURE);
+        }
+        elapsed = now_nsec() - start;
+        if (elapsed > res->max_add_ns)
+            res->max_add_ns = elapsed;
+    }
+
+    found = 0;
+    start = now_nsec();
+    for (n = n_conns; n > 0; --n)
+        found += NULL != conn_hash_find(&h, hits[n - 1]);
+    res->hit_ns = (double) (now_nsec() - start) / n_conns;
+    assert(found == n_conns);
+
+    start = now_nsec();
+    for (n = 0; n < n_conns; ++n)
+        found += NULL != conn_hash_find(&h, misses[n]);
+    res->miss_ns = (double) (now_nsec() - start) / n_conns;
+    assert(found == n_conns);
+
+    conn_hash_cleanup(&h);
+    lsquic_malo_destroy(malo);
+}
+
+
+static void
+usage (const char *argv0)
+{
+    printf(
+"Usage: %s [options]\n"
+"\n"
+"Options:\n"
+"   -n COUNT    Number of connections.  May be specified several times.\n"
+"                 The default is 1000000.\n"
+"   -s SEED     Random seed.\n"
+"   -h          Print this help screen and exit.\n"
+    , argv0);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    unsigned counts[16], n_counts, i, n, k;
+    lsquic_cid_t *cids, *hits, *misses, cid;
+    struct result chain, open;
+    uint64_t seed;
+    int opt;
+
+    n_counts = 0;
+    seed = 0x5DEECE66DULL;
+
+    while (-1 != (opt = getopt(argc, argv, "n:s:h")))
+    {
+        switch (opt)
+        {
+        case 'n':
+            if (n_counts < sizeof(counts) / sizeof(counts[0]))
+                counts[ n_counts++ ] = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 10) | 1;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (n_counts == 0)
+        counts[ n_counts++ ] = 1000000;
+
+    printf("%8s %16s %16s %16s\n", "", "hit ns/lookup", "miss ns/lookup",
+                                                            "max add us");
+    printf("%8s %8s %7s %8s %7s %8s %7s\n", "conns", "chained", "open",
+                                "chained", "open", "chained", "open");
+    for (i = 0; i < n_counts; ++i)
+    {
+        if (counts[i] == 0)
+            continue;
+        cids = malloc(sizeof(cids[0]) * counts[i]);
+        hits = malloc(sizeof(hits[0]) * counts[i]);
+        misses = malloc(sizeof(misses[0]) * counts[i]);
+        /* The two sequences do not overlap: xorshift has a period of
+         * 2^64 - 1.
+         */
+        for (n = 0; n < counts[i]; ++n)
+            cids[n] = next_rand(&seed);
+        for (n = 0; n < counts[i]; ++n)
+            misses[n] = next_rand(&seed);
+        /* Look up existing IDs in random order */
+        memcpy(hits, cids, sizeof(cids[0]) * counts[i]);
+        for (n = counts[i] - 1; n > 0; --n)
+        {
+            k = next_rand(&seed) % (n + 1);
+            cid = hits[n];
+            hits[n] = hits[k];
+            hits[k] = cid;
+        }
+
+        run_chain(counts[i], cids, hits, misses, &chain);
+        run_conn_hash(counts[i], cids, hits, misses, &open);
+
+        printf("%8u %8.1f %7.1f %8.1f %7.1f %8.1f %7.1f\n", counts[i],
+            chain.hit_ns, open.hit_ns, chain.miss_ns, open.miss_ns,
+            (double) chain.max_add_ns / 1000, (double) open.max_add_ns / 1000);
+
+        free(cids);
+        free(hits);
+        free(misses);
+    }
+
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,218 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * bench_packets_out.c -- Benchmark the packets_out callback
+ *
+ * Sends batches of packets to a local UDP socket using sport_packets_out()
+ * -- the same callback the sample programs give to the engine -- and
+ * prints the number of packets sent per second and the number of system
+ * calls issued per packet.  Run it with and without -g to compare
+ * sendmsg() and sendmmsg() senders.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <event2/event.h>
+
+#include "lsquic.h"
+#include "test_config.h"
+#include "test_common.h"
+#include "prog.h"
+
+#include "../src/liblsquic/lsquic_int_types.h"
+#include "../src/liblsquic/lsquic_util.h"
+
+
+static void
+usage (const char *argv0)
+{
+    printf(
+"Usage: %s [options]\n"
+"\n"
+"   -n COUNT    Number of packets per batch, up to 1024.  Defaults\n"
+"                 to 512.\n"
+"   -s SIZE     Packet size.  Defaults to 1350.\n"
+"   -t SEC      Run for this many seconds.  Defaults to 3.\n"
+#if HAVE_SENDMMSG
+"   -g          Use sendmmsg().\n"
+#endif
+#if HAVE_UDP_SEGMENT
+"   -G          Use UDP GSO.  Packets are grouped into runs the same way\n"
+"                 the engine does it.\n"
+#endif
+"   -h          Print this help screen and exit.\n"
+    , argv0);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    int opt, rcv_fd, n_sent;
+    unsigned i, batch_size, packet_size, seconds, n_calls, max_segs, n_runs;
+    unsigned long n_packets, n_syscalls;
+    lsquic_time_t start, now, end;
+    struct sockaddr_in sin;
+    socklen_t socklen;
+    struct prog prog;
+    struct service_port *sport;
+    struct event_base *eb;
+    struct lsquic_out_spec *specs;
+    unsigned char *buf;
+    char addr[0x20];
+
+    memset(&prog, 0, sizeof(prog));
+    batch_size = 512;
+    packet_size = 1350;
+    seconds = 3;
+
+    while (-1 != (opt = getopt(argc, argv, "n:s:t:gGh")))
+    {
+        switch (opt)
+        {
+        case 'n':
+            batch_size = atoi(optarg);
+            break;
+        case 's':
+            packet_size = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+#if HAVE_SENDMMSG
+        case 'g':
+            prog.prog_use_sendmmsg = 1;
+            break;
+#endif
+#if HAVE_UDP_SEGMENT
+        case 'G':
+            prog.prog_use_gso = 1;
+            break;
+#endif
+        case 'h':
+            usage(argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (batch_size == 0 || batch_size > 1024 || packet_size == 0)
+    {
+        fprintf(stderr, "invalid batch size or packet size\n");
+        exit(EXIT_FAILURE);
+    }
+
+    lsquic_init_timers();
+
+    /* The receiving socket is never read from: the kernel drops the
+     * packets once its receive buffer is full, which does not affect the
+     * sender.
+     */
+    rcv_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen = sizeof(sin);
+    if (rcv_fd < 0
+            || 0 != bind(rcv_fd, (struct sockaddr *) &sin, sizeof(sin))
+            || 0 != getsockname(rcv_fd, (struct sockaddr *) &sin, &socklen))
+    {
+        perror("cannot set up receiving socket");
+        exit(EXIT_FAILURE);
+    }
+
+    snprintf(addr, sizeof(addr), "127.0.0.1:%hu", ntohs(sin.sin_port));
+    eb = event_base_new();
+    sport = sport_new(addr, &prog);
+    if (!sport)
+    {
+        fprintf(stderr, "cannot create service port\n");
+        exit(EXIT_FAILURE);
+    }
+    sport->sp_flags = 0;
+    if (0 != sport_init_client(sport, NULL, eb))
+    {
+        perror("cannot initialize service port");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Same limits as used by the engine to form runs: */
+    max_segs = (0xFFFF - 20 - 8) / packet_size;
+    if (max_segs > 64)
+        max_segs = 64;
+    if (max_segs == 0)
+        max_segs = 1;
+
+    buf = calloc(1, packet_size);
+    specs = calloc(batch_size, sizeof(specs[0]));
+    n_runs = 0;
+    for (i = 0; i < batch_size; ++i)
+    {
+        specs[i].buf      = buf;
+        specs[i].sz       = packet_size;
+        specs[i].local_sa = NULL;
+        specs[i].dest_sa  = (struct sockaddr *) &sport->sas;
+        specs[i].peer_ctx = sport;
+        if (i % max_segs == 0)
+        {
+            ++n_runs;
+            specs[i].n_segs = batch_size - i < max_segs
+                                            ? batch_size - i : max_segs;
+        }
+        else
+            specs[i].n_segs = specs[i - 1].n_segs - 1;
+    }
+
+    n_packets = 0;
+    n_syscalls = 0;
+    n_calls = 0;
+    start = lsquic_time_now();
+    end = start + (lsquic_time_t) seconds * 1000000;
+    do
+    {
+        n_sent = sport_packets_out(&prog, specs, batch_size);
+        ++n_calls;
+        if (n_sent > 0)
+            n_packets += n_sent;
+        if (prog.prog_use_gso && !(sport->sp_flags & SPORT_NO_GSO))
+            n_syscalls += n_sent == (int) batch_size ? n_runs
+                        : (n_sent > 0 ? n_sent : 0) / max_segs + 1;
+        else if (prog.prog_use_sendmmsg)
+            ++n_syscalls;
+        else
+            n_syscalls += (n_sent > 0 ? n_sent : 0)
+                                    + (n_sent < (int) batch_size);
+        now = lsquic_time_now();
+    }
+    while (now < end);
+
+    printf("sender: %s; batch: %u; packet size: %u\n",
+        prog.prog_use_gso ? (sport->sp_flags & SPORT_NO_GSO ?
+                                    "GSO (not supported: fell back)" : "GSO")
+        : prog.prog_use_sendmmsg ? "sendmmsg" : "sendmsg", batch_size,
+        packet_size);
+    printf("packets: %lu; calls: %u; seconds: %.3f\n", n_packets, n_calls,
+        (double) (now - start) / 1000000);
+    printf("packets/sec: %.0f\n",
+        (double) n_packets * 1000000 / (double) (now - start));
+    printf("syscalls/packet: %.4f\n",
+        n_packets ? (double) n_syscalls / (double) n_packets : 0.);
+
+    free(specs);
+    free(buf);
+    sport_destroy(sport);
+    event_base_free(eb);
+    close(rcv_fd);
+
+    exit(EXIT_SUCCESS);
+}
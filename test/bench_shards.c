@@ -0,0 +1,257 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * bench_shards.c -- Benchmark scaling of the sharded client runtime
+ *
+ * For each number of shards from 1 to N, starts the shards with their
+ * sockets sharing a local port and floods the port from several generator
+ * threads.  The packets carry random connection IDs, so most of them have
+ * to be handed over to the shard that owns the ID.  Prints the number of
+ * packets passed to the engines per second and the speedup relative to a
+ * single shard.
+ */
+
+#define _GNU_SOURCE     /* For sendmmsg() */
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <event2/event.h>
+
+#include "lsquic.h"
+#include "test_config.h"
+#include "test_common.h"
+#include "prog.h"
+#include "shards.h"
+
+#include "../src/liblsquic/lsquic_int_types.h"
+#include "../src/liblsquic/lsquic_util.h"
+
+#define GEN_BATCH 64
+
+struct generator
+{
+    pthread_t               thread;
+    struct sockaddr_in      dest;
+    unsigned                packet_size;
+    unsigned long           n_sent;
+    uint64_t                rand;
+    int                    *stop;
+};
+
+
+static void *
+generator_thread (void *arg)
+{
+    struct generator *const gen = arg;
+    unsigned char bufs[GEN_BATCH][1500];
+    struct iovec iovs[GEN_BATCH];
+#if HAVE_SENDMMSG
+    struct mmsghdr mmsgs[GEN_BATCH];
+#endif
+    unsigned i;
+    int fd, n;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return NULL;
+    }
+
+    memset(bufs, 0, sizeof(bufs));
+    for (i = 0; i < GEN_BATCH; ++i)
+    {
+        bufs[i][0] = 0x08;      /* 8-byte connection ID follows */
+        iovs[i].iov_base = bufs[i];
+        iovs[i].iov_len  = gen->packet_size;
+#if HAVE_SENDMMSG
+        memset(&mmsgs[i], 0, sizeof(mmsgs[i]));
+        mmsgs[i].msg_hdr.msg_name    = &gen->dest;
+        mmsgs[i].msg_hdr.msg_namelen = sizeof(gen->dest);
+        mmsgs[i].msg_hdr.msg_iov     = &iovs[i];
+        mmsgs[i].msg_hdr.msg_iovlen  = 1;
+#endif
+    }
+
+    while (!__atomic_load_n(gen->stop, __ATOMIC_RELAXED))
+    {
+        for (i = 0; i < GEN_BATCH; ++i)
+        {
+            gen->rand ^= gen->rand << 13;
+            gen->rand ^= gen->rand >> 7;
+            gen->rand ^= gen->rand << 17;
+            memcpy(bufs[i] + 1, &gen->rand, sizeof(gen->rand));
+        }
+#if HAVE_SENDMMSG
+        n = sendmmsg(fd, mmsgs, GEN_BATCH, 0);
+#else
+        for (n = 0; n < GEN_BATCH; ++n)
+            if (0 > sendto(fd, bufs[n], gen->packet_size, 0,
+                        (struct sockaddr *) &gen->dest, sizeof(gen->dest)))
+                break;
+#endif
+        if (n > 0)
+            gen->n_sent += n;
+    }
+
+    close(fd);
+    return NULL;
+}
+
+
+static void
+usage (const char *argv0)
+{
+    printf(
+"Usage: %s [options]\n"
+"\n"
+"   -n SHARDS   Maximum number of shards.  Defaults to the number of\n"
+"                 online CPUs.\n"
+"   -g THREADS  Number of generator threads.  Defaults to the maximum\n"
+"                 number of shards.\n"
+"   -s SIZE     Packet size.  Defaults to 1350.\n"
+"   -t SEC      Run each step for this many seconds.  Defaults to 2.\n"
+"   -h          Print this help screen and exit.\n"
+    , argv0);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    int opt;
+    unsigned max_shards, n_shards, n_gens, packet_size, seconds, idx;
+    unsigned long n_packets, n_forwarded, n_sent;
+    double pps, base_pps;
+    lsquic_time_t start, elapsed;
+    int stop;
+    struct shard_stats stats;
+    struct sport_head sports;
+    struct prog prog;
+    struct shards *shards;
+    struct generator *gens;
+
+    max_shards = (unsigned) sysconf(_SC_NPROCESSORS_ONLN);
+    n_gens = 0;
+    packet_size = 1350;
+    seconds = 2;
+
+    while (-1 != (opt = getopt(argc, argv, "n:g:s:t:h")))
+    {
+        switch (opt)
+        {
+        case 'n':
+            max_shards = atoi(optarg);
+            break;
+        case 'g':
+            n_gens = atoi(optarg);
+            break;
+        case 's':
+            packet_size = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (max_shards == 0 || max_shards > SHARDS_MAX
+                            || packet_size < 9 || packet_size > 1500)
+    {
+        fprintf(stderr, "invalid number of shards or packet size\n");
+        exit(EXIT_FAILURE);
+    }
+    if (n_gens == 0)
+        n_gens = max_shards;
+
+    TAILQ_INIT(&sports);
+    prog_init(&prog, 0, &sports, NULL, NULL);
+    /* The peer is never contacted: no connections are created */
+    if (0 != prog_set_opt(&prog, 's', "127.0.0.1:443"))
+    {
+        fprintf(stderr, "cannot set peer address\n");
+        exit(EXIT_FAILURE);
+    }
+
+    gens = calloc(n_gens, sizeof(gens[0]));
+    base_pps = 0;
+    printf("%6s %12s %10s %8s %10s\n", "shards", "packets/sec", "forwarded",
+                                                    "speedup", "sent/sec");
+    for (n_shards = 1; n_shards <= max_shards; ++n_shards)
+    {
+        shards = shards_new(&prog, n_shards, 1);
+        if (!shards || 0 != shards_start(shards))
+        {
+            fprintf(stderr, "cannot start %u shards\n", n_shards);
+            exit(EXIT_FAILURE);
+        }
+
+        stop = 0;
+        start = lsquic_time_now();
+        for (idx = 0; idx < n_gens; ++idx)
+        {
+            gens[idx].dest.sin_family = AF_INET;
+            gens[idx].dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            gens[idx].dest.sin_port = htons(shards_local_port(shards, 0));
+            gens[idx].packet_size = packet_size;
+            gens[idx].n_sent = 0;
+            gens[idx].rand = (uint64_t) (idx + 1) * 0x9E3779B97F4A7C15ull;
+            gens[idx].stop = &stop;
+            if (0 != pthread_create(&gens[idx].thread, NULL, generator_thread,
+                                                                &gens[idx]))
+            {
+                perror("pthread_create");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        sleep(seconds);
+        __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+        n_sent = 0;
+        for (idx = 0; idx < n_gens; ++idx)
+        {
+            pthread_join(gens[idx].thread, NULL);
+            n_sent += gens[idx].n_sent;
+        }
+        shards_stop(shards);
+        elapsed = lsquic_time_now() - start;
+
+        n_packets = 0;
+        n_forwarded = 0;
+        for (idx = 0; idx < n_shards; ++idx)
+        {
+            shards_get_stats(shards, idx, &stats);
+            n_packets += stats.ss_packets_in;
+            n_forwarded += stats.ss_forwarded_in;
+        }
+        shards_destroy(shards);
+
+        pps = (double) n_packets * 1000000 / (double) elapsed;
+        if (n_shards == 1)
+            base_pps = pps;
+        printf("%6u %12.0f %9.1f%% %7.2fx %10.0f\n", n_shards, pps,
+            n_packets ? (double) n_forwarded * 100 / (double) n_packets : 0.,
+            base_pps > 0 ? pps / base_pps : 0.,
+            (double) n_sent * 1000000 / (double) elapsed);
+    }
+
+    free(gens);
+    prog_stop(&prog);
+    lsquic_global_cleanup();
+    exit(EXIT_SUCCESS);
+}
@@ -30,6 +30,7 @@
 #include <fcntl.h>
 
 #include "lsquic.h"
+#include "test_config.h"
 #include "test_common.h"
 #include "prog.h"
 
@@ -96,6 +96,26 @@ prog_print_common_options (const struct prog *prog, FILE *out)
 #if LSQUIC_DONTFRAG_SUPPORTED
 "   -D          Set `do not fragment' flag on outgoing UDP packets\n"
 #endif
+#if HAVE_SENDMMSG
+"   -g          Use sendmmsg() to send packets.  Each batch of packets\n"
+"                 produced by the engine is sent using a single system\n"
+"                 call.\n"
+#endif
+#if HAVE_UDP_SEGMENT
+"   -G          Use UDP GSO: runs of same-size packets from the same\n"
+"                 connection are passed to the kernel as one buffer.\n"
+"                 If the kernel does not support it, packets are sent\n"
+"                 one by one.\n"
+#endif
+#if HAVE_RECVMMSG
+"   -b          Use recvmmsg() to read packets.  Many packets are read\n"
+"                 using a single system call.\n"
+#endif
+#if HAVE_UDP_GRO
+"   -B          Use UDP GRO: the kernel may coalesce packets from the\n"
+"                 same peer into one buffer, which is split into\n"
+"                 individual packets before they are given to the engine.\n"
+#endif
 "   -z BYTES    Maximum size of outgoing UDP packets.  The default is 1370\n"
 "                 bytes for IPv4 socket and 1350 bytes for IPv6 socket\n"
 "   -L LEVEL    Log level for all modules.  Possible values are `debug',\n"
@@ -162,6 +182,26 @@ prog_set_opt (struct prog *prog, int opt, const char *arg)
             sport->sp_flags |= SPORT_DONT_FRAGMENT;
         }
         return 0;
+#endif
+#if HAVE_SENDMMSG
+    case 'g':
+        prog->prog_use_sendmmsg = 1;
+        return 0;
+#endif
+#if HAVE_UDP_SEGMENT
+    case 'G':
+        prog->prog_use_gso = 1;
+        return 0;
+#endif
+#if HAVE_RECVMMSG
+    case 'b':
+        prog->prog_use_recvmmsg = 1;
+        return 0;
+#endif
+#if HAVE_UDP_GRO
+    case 'B':
+        prog->prog_use_gro = 1;
+        return 0;
 #endif
     case 'm':
         prog->prog_packout_max = atoi(arg);
@@ -23,6 +23,10 @@ struct prog
     unsigned                        prog_period_usec;
     unsigned short                  prog_max_packet_size;
     int                             prog_version_cleared;
+    int                             prog_use_sendmmsg;  /* See -g flag */
+    int                             prog_use_gso;       /* See -G flag */
+    int                             prog_use_recvmmsg;  /* See -b flag */
+    int                             prog_use_gro;       /* See -B flag */
     struct event_base              *prog_eb;
     struct event                   *prog_timer,
                                    *prog_onetimer,
@@ -42,13 +46,32 @@ prog_init (struct prog *, unsigned lsquic_engine_flags, struct sport_head *,
 #   define SENDMMSG_FLAG ""
 #endif
 
+#if HAVE_UDP_SEGMENT
+#   define GSO_FLAG "G"
+#else
+#   define GSO_FLAG ""
+#endif
+
+#if HAVE_RECVMMSG
+#   define RECVMMSG_FLAG "b"
+#else
+#   define RECVMMSG_FLAG ""
+#endif
+
+#if HAVE_UDP_GRO
+#   define GRO_FLAG "B"
+#else
+#   define GRO_FLAG ""
+#endif
+
 #if LSQUIC_DONTFRAG_SUPPORTED
 #   define IP_DONTFRAG_FLAG "D"
 #else
 #   define IP_DONTFRAG_FLAG ""
 #endif
 
-#define PROG_OPTS "i:m:c:y:L:l:o:H:s:S:Y:z:" SENDMMSG_FLAG IP_DONTFRAG_FLAG
+#define PROG_OPTS "i:m:c:y:L:l:o:H:s:S:Y:z:" SENDMMSG_FLAG GSO_FLAG \
+                                RECVMMSG_FLAG GRO_FLAG IP_DONTFRAG_FLAG
 
 /* Returns:
  *  0   Applied
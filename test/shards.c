@@ -0,0 +1,717 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * shards.c -- Run several client engines, each in its own thread
+ *
+ * Each shard is a `struct prog' of its own: it has its own engine, event
+ * base, packet buffer allocator, and service port.  The only state shared
+ * between shards is the inbox of each shard, which is protected by a mutex.
+ * Other threads put messages into the inbox and wake up the shard's event
+ * loop by writing to a pipe.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <event2/event.h>
+
+#include "lsquic.h"
+#include "test_config.h"
+#include "test_common.h"
+#include "prog.h"
+#include "shards.h"
+
+#include "../src/liblsquic/lsquic_logger.h"
+
+
+/* The low byte of connection ID is the index of the shard */
+#define SHARD_CID_MASK 0xFF
+
+/* Number of forwarded packets passed to the engine at once */
+#define MAX_INBOX_BATCH 64
+
+
+enum shard_msg_type { SHM_PACKET, SHM_CONNECT, SHM_STOP, };
+
+struct shard_msg
+{
+    STAILQ_ENTRY(shard_msg)     shm_next;
+    enum shard_msg_type         shm_type;
+    /* The rest is only used by SHM_PACKET: */
+    struct sockaddr_storage     shm_local_sa,
+                                shm_peer_sa;
+    size_t                      shm_sz;
+    unsigned char               shm_data[];
+};
+
+STAILQ_HEAD(shard_msgs, shard_msg);
+
+struct shard
+{
+    struct prog                 sh_prog;
+    struct sport_head           sh_sports;
+    struct shards              *sh_shards;
+    unsigned                    sh_idx;
+    /* These flags are only used by the thread that manages the shards: */
+    enum {
+        SH_INITED   = (1 << 0),
+        SH_STARTED  = (1 << 1),
+    }                           sh_flags;
+    int                         sh_stopped; /* Set by shard's own thread */
+    uint64_t                    sh_rand;    /* Connection ID generator */
+    pthread_t                   sh_thread;
+    /* Inbox is written to by other threads: */
+    pthread_mutex_t             sh_inbox_lock;
+    struct shard_msgs           sh_inbox;
+    int                         sh_pipe[2];
+    struct event               *sh_inbox_ev;
+    /* Packets for other shards, indexed by shard.  These are accumulated
+     * while a batch of packets is processed and are then moved to the
+     * other shards' inboxes.
+     */
+    struct shard_msgs          *sh_outbox;
+    struct shard_stats          sh_stats;
+};
+
+struct shards
+{
+    unsigned                    n_shards;
+    unsigned                    next_shard;     /* Round-robin connects */
+    struct shard                shards[];
+};
+
+
+static lsquic_cid_t
+shard_generate_cid (void *ctx)
+{
+    struct shard *const sh = ctx;
+    uint64_t x;
+
+    /* xorshift64* */
+    x = sh->sh_rand;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    sh->sh_rand = x;
+    x *= UINT64_C(0x2545F4914F6CDD1D);
+
+    return (x & ~(lsquic_cid_t) SHARD_CID_MASK) | sh->sh_idx;
+}
+
+
+static void
+shard_seed_rand (struct shard *sh)
+{
+    int fd;
+
+    sh->sh_rand = 0;
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd >= 0)
+    {
+        if (sizeof(sh->sh_rand) != read(fd, &sh->sh_rand,
+                                                    sizeof(sh->sh_rand)))
+            sh->sh_rand = 0;
+        (void) close(fd);
+    }
+    sh->sh_rand ^= (uint64_t) time(NULL) << 8 ^ sh->sh_idx;
+    if (0 == sh->sh_rand)
+        sh->sh_rand = 1;
+}
+
+
+/* Returns index of the shard that owns the connection the packet belongs
+ * to or -1 if the packet does not contain connection ID.
+ */
+static int
+shard_of_packet (const struct shards *shards, const unsigned char *buf,
+                                                                size_t sz)
+{
+    lsquic_cid_t cid;
+
+    if (0 == lsquic_cid_from_packet(buf, sz, &cid))
+        return (cid & SHARD_CID_MASK) % shards->n_shards;
+    else
+        return -1;
+}
+
+
+static void
+shard_wake (struct shard *sh)
+{
+    ssize_t nw;
+
+    nw = write(sh->sh_pipe[1], "", 1);
+    if (nw < 0 && !(EAGAIN == errno || EWOULDBLOCK == errno))
+        LSQ_WARN("shard %u: cannot write to pipe: %s", sh->sh_idx,
+                                                            strerror(errno));
+}
+
+
+/* Move messages in `msgs' to the shard's inbox */
+static void
+shard_post (struct shard *sh, struct shard_msgs *msgs)
+{
+    int was_empty;
+
+    pthread_mutex_lock(&sh->sh_inbox_lock);
+    was_empty = STAILQ_EMPTY(&sh->sh_inbox);
+    STAILQ_CONCAT(&sh->sh_inbox, msgs);
+    pthread_mutex_unlock(&sh->sh_inbox_lock);
+
+    /* The pipe is only written to if the inbox was empty: the shard drains
+     * the pipe before it empties the inbox, so it is guaranteed to see all
+     * messages.
+     */
+    if (was_empty)
+        shard_wake(sh);
+}
+
+
+static int
+shard_post_one (struct shard *sh, enum shard_msg_type type)
+{
+    struct shard_msgs msgs;
+    struct shard_msg *msg;
+
+    msg = malloc(sizeof(*msg));
+    if (!msg)
+        return -1;
+    msg->shm_type = type;
+    STAILQ_INIT(&msgs);
+    STAILQ_INSERT_TAIL(&msgs, msg, shm_next);
+    shard_post(sh, &msgs);
+    return 0;
+}
+
+
+static socklen_t
+sa_len (const struct sockaddr *sa)
+{
+    return AF_INET == sa->sa_family ? sizeof(struct sockaddr_in)
+                                    : sizeof(struct sockaddr_in6);
+}
+
+
+/* This function is called by the service port instead of
+ * lsquic_engine_packets_in().  Packets that belong to connections owned
+ * by other shards are copied and sent to those shards.
+ */
+static unsigned
+shard_packets_in (void *ctx, struct lsquic_in_spec *specs, unsigned count)
+{
+    struct shard *const sh = ctx;
+    struct shards *const shards = sh->sh_shards;
+    struct shard_msg *msg;
+    unsigned n, n_local;
+    int owner;
+
+    n_local = 0;
+    for (n = 0; n < count; ++n)
+    {
+        owner = shard_of_packet(shards, specs[n].buf, specs[n].sz);
+        if (owner < 0 || (unsigned) owner == sh->sh_idx)
+        {
+            specs[n_local++] = specs[n];
+            continue;
+        }
+        msg = malloc(sizeof(*msg) + specs[n].sz);
+        if (!msg)
+        {
+            LSQ_WARN("shard %u: cannot allocate message: drop packet",
+                                                                sh->sh_idx);
+            continue;
+        }
+        msg->shm_type = SHM_PACKET;
+        memcpy(&msg->shm_local_sa, specs[n].local_sa,
+                                                sa_len(specs[n].local_sa));
+        memcpy(&msg->shm_peer_sa, specs[n].peer_sa, sa_len(specs[n].peer_sa));
+        msg->shm_sz = specs[n].sz;
+        memcpy(msg->shm_data, specs[n].buf, specs[n].sz);
+        STAILQ_INSERT_TAIL(&sh->sh_outbox[owner], msg, shm_next);
+        ++sh->sh_stats.ss_forwarded_out;
+    }
+
+    if (n_local < count)
+        for (n = 0; n < shards->n_shards; ++n)
+            if (!STAILQ_EMPTY(&sh->sh_outbox[n]))
+                shard_post(&shards->shards[n], &sh->sh_outbox[n]);
+
+    sh->sh_stats.ss_packets_in += n_local;
+    return lsquic_engine_packets_in(sh->sh_prog.prog_engine, specs, n_local);
+}
+
+
+static void
+drop_event (struct event **ev)
+{
+    if (*ev)
+    {
+        event_del(*ev);
+        event_free(*ev);
+        *ev = NULL;
+    }
+}
+
+
+/* Unlike prog_stop(), this does not stop the other shards */
+static void
+shard_stop (struct shard *sh)
+{
+    struct service_port *sport;
+
+    while ((sport = TAILQ_FIRST(&sh->sh_sports)))
+    {
+        TAILQ_REMOVE(&sh->sh_sports, sport, next_sport);
+        sport_destroy(sport);
+    }
+    drop_event(&sh->sh_inbox_ev);
+    drop_event(&sh->sh_prog.prog_timer);
+    drop_event(&sh->sh_prog.prog_onetimer);
+    sh->sh_stopped = 1;
+}
+
+
+static void
+inbox_handler (int fd, short what, void *arg)
+{
+    struct shard *const sh = arg;
+    struct service_port *const sport = TAILQ_FIRST(&sh->sh_sports);
+    lsquic_engine_t *const engine = sh->sh_prog.prog_engine;
+    struct shard_msgs msgs, held;
+    struct shard_msg *msg;
+    struct lsquic_in_spec specs[MAX_INBOX_BATCH];
+    unsigned n_specs, n_packets;
+    char buf[0x40];
+    int stop;
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+
+    STAILQ_INIT(&msgs);
+    pthread_mutex_lock(&sh->sh_inbox_lock);
+    STAILQ_CONCAT(&msgs, &sh->sh_inbox);
+    pthread_mutex_unlock(&sh->sh_inbox_lock);
+
+    STAILQ_INIT(&held);
+    n_specs = 0;
+    n_packets = 0;
+    stop = 0;
+    while ((msg = STAILQ_FIRST(&msgs)))
+    {
+        STAILQ_REMOVE_HEAD(&msgs, shm_next);
+        if (msg->shm_type == SHM_PACKET && !stop)
+        {
+            specs[n_specs].buf      = msg->shm_data;
+            specs[n_specs].sz       = msg->shm_sz;
+            specs[n_specs].local_sa = (struct sockaddr *) &msg->shm_local_sa;
+            specs[n_specs].peer_sa  = (struct sockaddr *) &msg->shm_peer_sa;
+            specs[n_specs].peer_ctx = sport;
+            STAILQ_INSERT_TAIL(&held, msg, shm_next);
+            if (++n_specs < MAX_INBOX_BATCH)
+                continue;
+        }
+        else if (msg->shm_type == SHM_CONNECT && !stop)
+        {
+            if (0 == prog_connect(&sh->sh_prog))
+                ++sh->sh_stats.ss_conns;
+            else
+                LSQ_WARN("shard %u: cannot create connection", sh->sh_idx);
+            free(msg);
+        }
+        else
+        {
+            stop |= msg->shm_type == SHM_STOP;
+            free(msg);
+        }
+
+        /* Pass packets to the engine before processing next command */
+        if (n_specs)
+        {
+            (void) lsquic_engine_packets_in(engine, specs, n_specs);
+            n_packets += n_specs;
+            n_specs = 0;
+            while ((msg = STAILQ_FIRST(&held)))
+            {
+                STAILQ_REMOVE_HEAD(&held, shm_next);
+                free(msg);
+            }
+        }
+    }
+
+    if (n_specs)
+    {
+        (void) lsquic_engine_packets_in(engine, specs, n_specs);
+        n_packets += n_specs;
+        while ((msg = STAILQ_FIRST(&held)))
+        {
+            STAILQ_REMOVE_HEAD(&held, shm_next);
+            free(msg);
+        }
+    }
+    sh->sh_stats.ss_forwarded_in += n_packets;
+    sh->sh_stats.ss_packets_in += n_packets;
+
+    if (stop)
+    {
+        LSQ_DEBUG("shard %u: stop", sh->sh_idx);
+        shard_stop(sh);
+        event_base_loopbreak(sh->sh_prog.prog_eb);
+        return;
+    }
+
+    if (n_packets)
+        lsquic_engine_process_conns_with_incoming(engine);
+
+    while (lsquic_engine_has_pend_rw(engine))
+        lsquic_engine_process_conns_with_pend_rw(engine);
+
+    prog_maybe_set_onetimer(&sh->sh_prog);
+}
+
+
+static void
+shard_timer_handler (int fd, short what, void *arg)
+{
+    struct shard *const sh = arg;
+    lsquic_engine_proc_all(sh->sh_prog.prog_engine);
+    prog_maybe_set_onetimer(&sh->sh_prog);
+}
+
+
+static void *
+shard_thread (void *arg)
+{
+    struct shard *const sh = arg;
+
+    LSQ_DEBUG("shard %u: thread started", sh->sh_idx);
+    event_base_loop(sh->sh_prog.prog_eb, 0);
+    LSQ_DEBUG("shard %u: thread exiting", sh->sh_idx);
+    return NULL;
+}
+
+
+static int
+set_nonblocking (int fd)
+{
+    int flags;
+
+    flags = fcntl(fd, F_GETFL);
+    if (-1 == flags)
+        return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+
+static int
+shard_init (struct shard *sh, struct shards *shards, unsigned idx,
+            const struct prog *proto, const char *peer,
+            int share_port, unsigned short *local_port)
+{
+    const struct service_port *const proto_sport =
+                                            TAILQ_FIRST(proto->prog_sports);
+    struct service_port *sport;
+    struct prog *const prog = &sh->sh_prog;
+    unsigned n;
+
+    sh->sh_shards = shards;
+    sh->sh_idx = idx;
+    sh->sh_pipe[0] = sh->sh_pipe[1] = -1;
+    STAILQ_INIT(&sh->sh_inbox);
+    TAILQ_INIT(&sh->sh_sports);
+    shard_seed_rand(sh);
+
+    /* Copy settings and options, but not the state: */
+    *prog = *proto;
+    prog->prog_sports = &sh->sh_sports;
+    prog->prog_eb = NULL;
+    prog->prog_engine = NULL;
+    prog->prog_timer = NULL;
+    prog->prog_onetimer = NULL;
+    prog->prog_usr1 = NULL;
+    prog->prog_api.ea_settings = &prog->prog_settings;
+    prog->prog_api.ea_packets_out_ctx = prog;
+    if (proto->prog_api.ea_pmi_ctx == &proto->prog_pba)
+        prog->prog_api.ea_pmi_ctx = &prog->prog_pba;
+    prog->prog_api.ea_generate_cid = shard_generate_cid;
+    prog->prog_api.ea_generate_cid_ctx = sh;
+    pba_init(&prog->prog_pba, prog->prog_packout_max);
+
+    sh->sh_outbox = malloc(shards->n_shards * sizeof(sh->sh_outbox[0]));
+    if (!sh->sh_outbox)
+        return -1;
+    for (n = 0; n < shards->n_shards; ++n)
+        STAILQ_INIT(&sh->sh_outbox[n]);
+
+    if (0 != pthread_mutex_init(&sh->sh_inbox_lock, NULL))
+    {
+        free(sh->sh_outbox);
+        sh->sh_outbox = NULL;
+        return -1;
+    }
+    sh->sh_flags |= SH_INITED;
+
+    prog->prog_eb = event_base_new();
+    if (!prog->prog_eb)
+        return -1;
+
+    prog->prog_engine = lsquic_engine_new(prog->prog_engine_flags,
+                                                            &prog->prog_api);
+    if (!prog->prog_engine)
+        return -1;
+
+    sport = sport_new(peer, prog);
+    if (!sport)
+        return -1;
+    sport->sp_flags = proto_sport->sp_flags;
+    sport->sp_sndbuf = proto_sport->sp_sndbuf;
+    sport->sp_rcvbuf = proto_sport->sp_rcvbuf;
+    sport->sp_packets_in = shard_packets_in;
+    sport->sp_packets_in_ctx = sh;
+    if (share_port)
+    {
+        sport->sp_flags |= SPORT_REUSEPORT;
+        sport->sp_local_port = *local_port;
+    }
+    TAILQ_INSERT_TAIL(&sh->sh_sports, sport, next_sport);
+    if (0 != sport_init_client(sport, prog->prog_engine, prog->prog_eb))
+    {
+        LSQ_ERROR("shard %u: cannot initialize socket: %s", idx,
+                                                            strerror(errno));
+        return -1;
+    }
+    if (share_port)
+        *local_port = sport->sp_local_port;
+
+    if (0 != pipe(sh->sh_pipe)
+            || 0 != set_nonblocking(sh->sh_pipe[0])
+            || 0 != set_nonblocking(sh->sh_pipe[1]))
+        return -1;
+    sh->sh_inbox_ev = event_new(prog->prog_eb, sh->sh_pipe[0],
+                                    EV_READ|EV_PERSIST, inbox_handler, sh);
+    if (!sh->sh_inbox_ev || 0 != event_add(sh->sh_inbox_ev, NULL))
+        return -1;
+
+    return 0;
+}
+
+
+static void
+shard_cleanup (struct shard *sh)
+{
+    struct shard_msg *msg;
+    unsigned n;
+
+    if (!(sh->sh_flags & SH_INITED))
+        return;
+
+    if (!sh->sh_stopped)
+        shard_stop(sh);
+    if (sh->sh_prog.prog_engine)
+        lsquic_engine_destroy(sh->sh_prog.prog_engine);
+    if (sh->sh_prog.prog_eb)
+        event_base_free(sh->sh_prog.prog_eb);
+    pba_cleanup(&sh->sh_prog.prog_pba);
+
+    while ((msg = STAILQ_FIRST(&sh->sh_inbox)))
+    {
+        STAILQ_REMOVE_HEAD(&sh->sh_inbox, shm_next);
+        free(msg);
+    }
+    for (n = 0; n < sh->sh_shards->n_shards; ++n)
+        while ((msg = STAILQ_FIRST(&sh->sh_outbox[n])))
+        {
+            STAILQ_REMOVE_HEAD(&sh->sh_outbox[n], shm_next);
+            free(msg);
+        }
+    free(sh->sh_outbox);
+
+    if (sh->sh_pipe[0] >= 0)
+        (void) close(sh->sh_pipe[0]);
+    if (sh->sh_pipe[1] >= 0)
+        (void) close(sh->sh_pipe[1]);
+    pthread_mutex_destroy(&sh->sh_inbox_lock);
+}
+
+
+struct shards *
+shards_new (struct prog *prog, unsigned n_shards, int share_port)
+{
+    const struct service_port *proto_sport;
+    struct shards *shards;
+    unsigned short local_port;
+    unsigned idx;
+    char peer[sizeof(proto_sport->host) + sizeof(":65535")];
+    char err_buf[100];
+
+    if (0 == n_shards || n_shards > SHARDS_MAX)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (prog->prog_engine_flags & LSENG_SERVER)
+    {
+        LSQ_ERROR("shards only support client mode");
+        errno = EINVAL;
+        return NULL;
+    }
+
+    proto_sport = TAILQ_FIRST(prog->prog_sports);
+    if (!proto_sport)
+    {
+        LSQ_ERROR("peer address is not specified");
+        errno = EINVAL;
+        return NULL;
+    }
+    snprintf(peer, sizeof(peer), "%s:%hu", proto_sport->host,
+        ntohs(AF_INET == proto_sport->sas.ss_family
+                ? ((struct sockaddr_in *) &proto_sport->sas)->sin_port
+                : ((struct sockaddr_in6 *) &proto_sport->sas)->sin6_port));
+
+    if (0 == prog->prog_period_usec)
+        prog->prog_period_usec = PROG_DEFAULT_PERIOD_USEC;
+    if (prog->prog_settings.es_proc_time_thresh == LSQUIC_DF_PROC_TIME_THRESH)
+        prog->prog_settings.es_proc_time_thresh = prog->prog_period_usec;
+
+    if (0 != lsquic_engine_check_settings(&prog->prog_settings,
+                        prog->prog_engine_flags, err_buf, sizeof(err_buf)))
+    {
+        LSQ_ERROR("Error in settings: %s", err_buf);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    shards = calloc(1, sizeof(*shards) + n_shards * sizeof(shards->shards[0]));
+    if (!shards)
+        return NULL;
+    shards->n_shards = n_shards;
+
+    local_port = 0;
+    for (idx = 0; idx < n_shards; ++idx)
+        if (0 != shard_init(&shards->shards[idx], shards, idx, prog, peer,
+                                                    share_port, &local_port))
+        {
+            LSQ_ERROR("cannot initialize shard %u", idx);
+            shards_destroy(shards);
+            return NULL;
+        }
+
+    LSQ_INFO("created %u shard%.*s", n_shards, n_shards != 1, "s");
+    return shards;
+}
+
+
+int
+shards_start (struct shards *shards)
+{
+    struct shard *sh;
+    struct timeval timeout;
+    unsigned idx;
+
+    for (idx = 0; idx < shards->n_shards; ++idx)
+    {
+        sh = &shards->shards[idx];
+        timeout.tv_sec  = 0;
+        timeout.tv_usec = sh->sh_prog.prog_period_usec;
+        sh->sh_prog.prog_timer = event_new(sh->sh_prog.prog_eb, -1,
+                                EV_PERSIST, shard_timer_handler, sh);
+        if (!sh->sh_prog.prog_timer)
+            return -1;
+        event_add(sh->sh_prog.prog_timer, &timeout);
+        if (0 != pthread_create(&sh->sh_thread, NULL, shard_thread, sh))
+        {
+            LSQ_ERROR("cannot start thread for shard %u", idx);
+            return -1;
+        }
+        sh->sh_flags |= SH_STARTED;
+    }
+
+    return 0;
+}
+
+
+int
+shards_connect (struct shards *shards)
+{
+    unsigned idx;
+
+    idx = shards->next_shard++ % shards->n_shards;
+    if (0 == shard_post_one(&shards->shards[idx], SHM_CONNECT))
+        return (int) idx;
+    else
+        return -1;
+}
+
+
+void
+shards_stop (struct shards *shards)
+{
+    struct shard *sh;
+    unsigned idx;
+
+    for (idx = 0; idx < shards->n_shards; ++idx)
+    {
+        sh = &shards->shards[idx];
+        if (sh->sh_flags & SH_STARTED)
+            if (0 != shard_post_one(sh, SHM_STOP))
+                LSQ_ERROR("cannot stop shard %u", idx);
+    }
+
+    for (idx = 0; idx < shards->n_shards; ++idx)
+    {
+        sh = &shards->shards[idx];
+        if (sh->sh_flags & SH_STARTED)
+        {
+            pthread_join(sh->sh_thread, NULL);
+            sh->sh_flags &= ~SH_STARTED;
+        }
+    }
+}
+
+
+void
+shards_destroy (struct shards *shards)
+{
+    unsigned idx;
+
+    shards_stop(shards);
+    for (idx = 0; idx < shards->n_shards; ++idx)
+        shard_cleanup(&shards->shards[idx]);
+    free(shards);
+}
+
+
+unsigned
+shards_count (const struct shards *shards)
+{
+    return shards->n_shards;
+}
+
+
+unsigned short
+shards_local_port (const struct shards *shards, unsigned idx)
+{
+    const struct service_port *sport;
+
+    sport = TAILQ_FIRST(&shards->shards[idx].sh_sports);
+    return sport ? sport->sp_local_port : 0;
+}
+
+
+void
+shards_get_stats (const struct shards *shards, unsigned idx,
+                                                    struct shard_stats *stats)
+{
+    *stats = shards->shards[idx].sh_stats;
+}
@@ -0,0 +1,70 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * shards.h -- Run several client engines, each in its own thread
+ *
+ * The engine is single-threaded.  To use more than one core, the work is
+ * split between shards.  Each shard has its own engine, event loop, and
+ * socket and runs in its own thread.  New connections are assigned to
+ * shards round-robin.
+ *
+ * The index of the shard that owns a connection is encoded in the
+ * connection ID.  If the shards' sockets share a local port (see
+ * SPORT_REUSEPORT), the kernel may deliver a packet to a socket that
+ * belongs to a different shard.  Such packets are handed over to the
+ * owning shard.
+ */
+
+#ifndef SHARDS_H
+#define SHARDS_H 1
+
+struct prog;
+struct shards;
+
+#define SHARDS_MAX 256
+
+struct shard_stats
+{
+    unsigned long   ss_packets_in;      /* Passed to this shard's engine */
+    unsigned long   ss_forwarded_out;   /* Read here, sent to other shard */
+    unsigned long   ss_forwarded_in;    /* Read by other shard */
+    unsigned long   ss_conns;           /* Number of connections created */
+};
+
+/* Create `n_shards' shards based on `prog': settings, stream interface,
+ * options, and the first service port (the peer) are copied.  `prog'
+ * should be initialized and options parsed, but prog_prep() should not be
+ * called.  If `share_port' is true, all shards' sockets are bound to the
+ * same local port using SO_REUSEPORT.
+ */
+struct shards *
+shards_new (struct prog *prog, unsigned n_shards, int share_port);
+
+/* Start shard threads */
+int
+shards_start (struct shards *);
+
+/* Create new connection in the next shard.  The connection is created
+ * asynchronously by the shard's thread.  Returns the shard index or -1
+ * on error.
+ */
+int
+shards_connect (struct shards *);
+
+/* Stop all shards and wait for their threads to exit */
+void
+shards_stop (struct shards *);
+
+void
+shards_destroy (struct shards *);
+
+unsigned
+shards_count (const struct shards *);
+
+unsigned short
+shards_local_port (const struct shards *, unsigned idx);
+
+/* Only call this function after shards_stop() */
+void
+shards_get_stats (const struct shards *, unsigned idx, struct shard_stats *);
+
+#endif
@@ -14,6 +14,11 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <netinet/udp.h>
+#if __linux__
+#include <time.h>
+#include <linux/net_tstamp.h>   /* struct sock_txtime */
+#endif
 #else
 #include <Windows.h>
 #include <WinSock2.h>
@@ -27,8 +32,9 @@
 
 #include <event2/event.h>
 
-#include "test_common.h"
 #include "lsquic.h"
+#include "test_config.h"
+#include "test_common.h"
 #include "prog.h"
 
 #include "../src/liblsquic/lsquic_logger.h"
@@ -50,17 +56,43 @@
 #   define DST_MSG_SZ sizeof(struct sockaddr_in)
 #endif
 
+#if HAVE_UDP_GRO
+#   define GRO_SZ CMSG_SPACE(sizeof(int))   /* UDP_GRO */
+#else
+#   define GRO_SZ 0
+#endif
+
+#if HAVE_SO_TXTIME
+#   define TXTIME_SZ CMSG_SPACE(sizeof(uint64_t))   /* SCM_TXTIME */
+#else
+#   define TXTIME_SZ 0
+#endif
+
 #define MAX_PACKET_SZ 1370
 
-#define CTL_SZ (CMSG_SPACE(MAX(DST_MSG_SZ, \
-                                sizeof(struct in6_pktinfo))) + NDROPPED_SZ)
+/* This matches the maximum batch size used by the engine */
+#define MAX_OUT_BATCH_SIZE 1024
 
-/* There are `n_alloc' elements in `vecs', `local_addresses', and
- * `peer_addresses' arrays.  `ctlmsg_data' is n_alloc * CTL_SZ.  Each packets
- * gets a single `vecs' element that points somewhere into `packet_data'.
+/* With UDP GRO, the kernel may coalesce many datagrams into a single buffer
+ * of up to 64 KB.  Each receive slot must be large enough to hold it.
+ */
+#define GRO_SLOT_SZ 0x10000
+#define GRO_MIN_SLOTS 16
+
+#define CTL_SZ (CMSG_SPACE(MAX(DST_MSG_SZ, \
+                        sizeof(struct in6_pktinfo))) + NDROPPED_SZ + GRO_SZ)
+
+/* There are `n_alloc' elements in `vecs', `local_addresses',
+ * `peer_addresses', and `seg_sizes' arrays.  `ctlmsg_data' is
+ * n_alloc * CTL_SZ.  Each read gets a single `vecs' element that points
+ * somewhere into `packet_data'.  If UDP GRO is on, a single element may
+ * contain several packets, each `seg_sizes' bytes long (the last one may
+ * be shorter); otherwise, `seg_sizes' is zero.
  *
  * `n_alloc' is calculated at run-time based on the socket's receive buffer
- * size.
+ * size.  `slot_sz' is the amount of room given to each read.
+ *
+ * `specs' are filled from `vecs' and passed to lsquic_engine_packets_in().
  */
 struct packets_in
 {
@@ -69,16 +101,23 @@ struct packets_in
     struct iovec            *vecs;
     struct sockaddr_storage *local_addresses,
                             *peer_addresses;
+    unsigned                *seg_sizes;
+    struct lsquic_in_spec   *specs;
+#if HAVE_RECVMMSG
+    struct mmsghdr          *mmsgs;
+#endif
     unsigned                 n_alloc;
+    unsigned                 n_specs;
     unsigned                 data_sz;
+    unsigned                 slot_sz;
 };
 
 
 static struct packets_in *
-allocate_packets_in (int fd)
+allocate_packets_in (int fd, int use_gro)
 {
     struct packets_in *packs_in;
-    unsigned n_alloc;
+    unsigned n_alloc, data_sz, slot_sz;
     socklen_t opt_len;
     int recvsz;
 
@@ -89,18 +128,36 @@ allocate_packets_in (int fd)
         return NULL;
     }
 
-    n_alloc = (unsigned) recvsz / MAX_PACKET_SZ * 2;
+    if (use_gro)
+    {
+        slot_sz = GRO_SLOT_SZ;
+        data_sz = MAX((unsigned) recvsz, GRO_MIN_SLOTS * GRO_SLOT_SZ);
+        n_alloc = data_sz / slot_sz;
+    }
+    else
+    {
+        slot_sz = MAX_PACKET_SZ;
+        data_sz = recvsz;
+        n_alloc = (unsigned) recvsz / MAX_PACKET_SZ * 2;
+    }
     LSQ_INFO("socket buffer size: %d bytes; max # packets is set to %u",
         recvsz, n_alloc);
 
     packs_in = malloc(sizeof(*packs_in));
-    packs_in->data_sz = recvsz;
+    packs_in->data_sz = data_sz;
+    packs_in->slot_sz = slot_sz;
     packs_in->n_alloc = n_alloc;
-    packs_in->packet_data = malloc(recvsz);
+    packs_in->n_specs = n_alloc;
+    packs_in->packet_data = malloc(data_sz);
     packs_in->ctlmsg_data = malloc(n_alloc * CTL_SZ);
     packs_in->vecs = malloc(n_alloc * sizeof(packs_in->vecs[0]));
     packs_in->local_addresses = malloc(n_alloc * sizeof(packs_in->local_addresses[0]));
     packs_in->peer_addresses = malloc(n_alloc * sizeof(packs_in->peer_addresses[0]));
+    packs_in->seg_sizes = malloc(n_alloc * sizeof(packs_in->seg_sizes[0]));
+    packs_in->specs = malloc(packs_in->n_specs * sizeof(packs_in->specs[0]));
+#if HAVE_RECVMMSG
+    packs_in->mmsgs = malloc(n_alloc * sizeof(packs_in->mmsgs[0]));
+#endif
 
     return packs_in;
 }
@@ -109,6 +166,11 @@ allocate_packets_in (int fd)
 static void
 free_packets_in (struct packets_in *packs_in)
 {
+#if HAVE_RECVMMSG
+    free(packs_in->mmsgs);
+#endif
+    free(packs_in->specs);
+    free(packs_in->seg_sizes);
     free(packs_in->peer_addresses);
     free(packs_in->local_addresses);
     free(packs_in->ctlmsg_data);
@@ -145,6 +207,9 @@ sport_new (const char *optarg, struct prog *prog)
     sport->ev = NULL;
     sport->packs_in = NULL;
     sport->fd = -1;
+    sport->sp_local_port = 0;
+    sport->sp_packets_in = NULL;
+    sport->sp_packets_in_ctx = NULL;
     char *const addr = strdup(optarg);
 #if __linux__
     char *if_name;
@@ -197,6 +262,9 @@ static void
 proc_ancillary (struct msghdr *msg, struct sockaddr_storage *storage
 #if __linux__
                 , uint32_t *n_dropped
+#endif
+#if HAVE_UDP_GRO
+                , unsigned *seg_size
 #endif
                 )
 {
@@ -238,6 +306,15 @@ proc_ancillary (struct msghdr *msg, struct sockaddr_storage *storage
         else if (cmsg->cmsg_level == SOL_SOCKET &&
                  cmsg->cmsg_type  == SO_RXQ_OVFL)
             memcpy(n_dropped, CMSG_DATA(cmsg), sizeof(*n_dropped));
+#endif
+#if HAVE_UDP_GRO
+        else if (cmsg->cmsg_level == SOL_UDP &&
+                 cmsg->cmsg_type  == UDP_GRO)
+        {
+            int gso_size;
+            memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+            *seg_size = gso_size;
+        }
 #endif
     }
 }
@@ -253,30 +330,66 @@ struct read_iter
 
 enum rop { ROP_OK, ROP_NOROOM, ROP_ERROR, };
 
+
+/* Fill in local address, segment size, and drop count of the packet (or
+ * packets, if coalesced by GRO) read into element `idx'.
+ */
+static void
+proc_read (struct service_port *sport, unsigned idx, struct msghdr *msg)
+{
+    struct packets_in *const packs_in = sport->packs_in;
+    struct sockaddr_storage *local_addr;
+#if __linux__
+    uint32_t n_dropped;
+#endif
+
+    local_addr = &packs_in->local_addresses[idx];
+    memcpy(local_addr, &sport->sas, sizeof(*local_addr));
+    packs_in->seg_sizes[idx] = 0;
+#if __linux__
+    n_dropped = 0;
+#endif
+    proc_ancillary(msg, local_addr
+#if __linux__
+        , &n_dropped
+#endif
+#if HAVE_UDP_GRO
+        , &packs_in->seg_sizes[idx]
+#endif
+    );
+#if __linux__
+    if (sport->drop_init)
+    {
+        if (sport->n_dropped < n_dropped)
+            LSQ_INFO("dropped %u packets", n_dropped - sport->n_dropped);
+    }
+    else
+        sport->drop_init = 1;
+    sport->n_dropped = n_dropped;
+#endif
+}
+
+
 static enum rop
 read_one_packet (struct read_iter *iter)
 {
     unsigned char *ctl_buf;
     struct packets_in *packs_in;
-#if __linux__
-    uint32_t n_dropped;
-#endif
     ssize_t nread;
-    struct sockaddr_storage *local_addr;
     struct service_port *sport;
 
     sport = iter->ri_sport;
     packs_in = sport->packs_in;
 
     if (iter->ri_idx >= packs_in->n_alloc ||
-        iter->ri_off + MAX_PACKET_SZ > packs_in->data_sz)
+        iter->ri_off + packs_in->slot_sz > packs_in->data_sz)
     {
         LSQ_DEBUG("out of room in packets_in");
         return ROP_NOROOM;
     }
 
     packs_in->vecs[iter->ri_idx].iov_base = packs_in->packet_data + iter->ri_off;
-    packs_in->vecs[iter->ri_idx].iov_len  = MAX_PACKET_SZ;
+    packs_in->vecs[iter->ri_idx].iov_len  = packs_in->slot_sz;
     ctl_buf = packs_in->ctlmsg_data + iter->ri_idx * CTL_SZ;
 
     struct msghdr msg = {
@@ -294,26 +407,7 @@ read_one_packet (struct read_iter *iter)
         return ROP_ERROR;
     }
 
-    local_addr = &packs_in->local_addresses[iter->ri_idx];
-    memcpy(local_addr, &sport->sas, sizeof(*local_addr));
-#if __linux__
-    n_dropped = 0;
-#endif
-    proc_ancillary(&msg, local_addr
-#if __linux__
-        , &n_dropped
-#endif
-    );
-#if __linux__
-    if (sport->drop_init)
-    {
-        if (sport->n_dropped < n_dropped)
-            LSQ_INFO("dropped %u packets", n_dropped - sport->n_dropped);
-    }
-    else
-        sport->drop_init = 1;
-    sport->n_dropped = n_dropped;
-#endif
+    proc_read(sport, iter->ri_idx, &msg);
 
     packs_in->vecs[iter->ri_idx].iov_len = nread;
     iter->ri_off += nread;
@@ -323,16 +417,141 @@ read_one_packet (struct read_iter *iter)
 }
 
 
+#if HAVE_RECVMMSG
+/* Read as many packets as there is room for using a single recvmmsg()
+ * call.  Unlike read_one_packet(), each read gets a whole slot, as the
+ * size of each packet is not known in advance.
+ */
+static enum rop
+read_using_recvmmsg (struct read_iter *iter)
+{
+    struct service_port *const sport = iter->ri_sport;
+    struct packets_in *const packs_in = sport->packs_in;
+    struct mmsghdr *mmsg;
+    unsigned n, count, idx;
+    int nread;
+
+    count = (packs_in->data_sz - iter->ri_off) / packs_in->slot_sz;
+    if (count > packs_in->n_alloc - iter->ri_idx)
+        count = packs_in->n_alloc - iter->ri_idx;
+    if (count == 0)
+    {
+        LSQ_DEBUG("out of room in packets_in");
+        return ROP_NOROOM;
+    }
+
+    for (n = 0; n < count; ++n)
+    {
+        idx = iter->ri_idx + n;
+        packs_in->vecs[idx].iov_base = packs_in->packet_data + iter->ri_off
+                                                    + n * packs_in->slot_sz;
+        packs_in->vecs[idx].iov_len  = packs_in->slot_sz;
+        mmsg = &packs_in->mmsgs[idx];
+        mmsg->msg_hdr = (struct msghdr) {
+            .msg_name       = &packs_in->peer_addresses[idx],
+            .msg_namelen    = sizeof(packs_in->peer_addresses[idx]),
+            .msg_iov        = &packs_in->vecs[idx],
+            .msg_iovlen     = 1,
+            .msg_control    = packs_in->ctlmsg_data + idx * CTL_SZ,
+            .msg_controllen = CTL_SZ,
+        };
+        mmsg->msg_len = 0;
+    }
+
+    nread = recvmmsg(sport->fd, &packs_in->mmsgs[iter->ri_idx], count, 0,
+                                                                    NULL);
+    if (-1 == nread) {
+        if (!(EAGAIN == errno || EWOULDBLOCK == errno))
+            LSQ_ERROR("recvmmsg: %s", strerror(errno));
+        return ROP_ERROR;
+    }
+
+    for (n = 0; n < (unsigned) nread; ++n)
+    {
+        idx = iter->ri_idx + n;
+        mmsg = &packs_in->mmsgs[idx];
+        proc_read(sport, idx, &mmsg->msg_hdr);
+        packs_in->vecs[idx].iov_len = mmsg->msg_len;
+    }
+
+    iter->ri_off += nread * packs_in->slot_sz;
+    iter->ri_idx += nread;
+
+    return ROP_OK;
+}
+#endif
+
+
+static void
+pass_specs (struct service_port *sport, struct lsquic_in_spec *specs,
+                                                                unsigned n)
+{
+    if (sport->sp_packets_in)
+        (void) sport->sp_packets_in(sport->sp_packets_in_ctx, specs, n);
+    else
+        (void) lsquic_engine_packets_in(sport->engine, specs, n);
+}
+
+
+/* Pass packets read into the first `n_read' elements of packs_in to the
+ * engine.  Buffers coalesced by GRO are split into individual packets
+ * without copying.  Returns number of packets passed to the engine.
+ */
+static unsigned
+packets_to_engine (struct service_port *sport, unsigned n_read)
+{
+    struct packets_in *const packs_in = sport->packs_in;
+    struct lsquic_in_spec *spec;
+    const unsigned char *p, *end;
+    unsigned n, n_specs, n_packets, seg_sz;
+
+    n_specs = 0;
+    n_packets = 0;
+    for (n = 0; n < n_read; ++n)
+    {
+        p = packs_in->vecs[n].iov_base;
+        end = p + packs_in->vecs[n].iov_len;
+        seg_sz = packs_in->seg_sizes[n];
+        if (seg_sz == 0)
+            seg_sz = packs_in->vecs[n].iov_len;
+        while (p < end)
+        {
+            if (n_specs >= packs_in->n_specs)
+            {
+                pass_specs(sport, packs_in->specs, n_specs);
+                n_packets += n_specs;
+                n_specs = 0;
+            }
+            spec = &packs_in->specs[n_specs++];
+            spec->buf      = p;
+            spec->sz       = (unsigned) (end - p) < seg_sz ?
+                                            (unsigned) (end - p) : seg_sz;
+            spec->local_sa = (struct sockaddr *) &packs_in->local_addresses[n];
+            spec->peer_sa  = (struct sockaddr *) &packs_in->peer_addresses[n];
+            spec->peer_ctx = sport;
+            p += spec->sz;
+        }
+    }
+
+    if (n_specs)
+    {
+        pass_specs(sport, packs_in->specs, n_specs);
+        n_packets += n_specs;
+    }
+    return n_packets;
+}
+
+
 static void
 read_handler (int fd, short flags, void *ctx)
 {
     struct service_port *sport = ctx;
     lsquic_engine_t *const engine = sport->engine;
-    struct packets_in *packs_in = sport->packs_in;
     struct read_iter iter;
     unsigned n, n_batches;
     enum rop rop;
 
+    n = 0;
     n_batches = 0;
     iter.ri_sport = sport;
 
@@ -341,28 +560,24 @@ read_handler (int fd, short flags, void *ctx)
         iter.ri_off = 0;
         iter.ri_idx = 0;
 
+#if HAVE_RECVMMSG
+        if (sport->sp_prog->prog_use_recvmmsg)
+            do
+                rop = read_using_recvmmsg(&iter);
+            while (ROP_OK == rop);
+        else
+#endif
         do
             rop = read_one_packet(&iter);
         while (ROP_OK == rop);
 
         n_batches += iter.ri_idx > 0;
-
-        for (n = 0; n < iter.ri_idx; ++n)
-            if (0 != lsquic_engine_packet_in(engine,
-                        packs_in->vecs[n].iov_base,
-                        packs_in->vecs[n].iov_len,
-                        (struct sockaddr *) &packs_in->local_addresses[n],
-                        (struct sockaddr *) &packs_in->peer_addresses[n],
-                        sport))
-                break;
+        n += packets_to_engine(sport, iter.ri_idx);
     }
     while (ROP_NOROOM == rop);
 
     if (n_batches)
-    {
-        n += packs_in->n_alloc * (n_batches - 1);
         lsquic_engine_process_conns_with_incoming(engine);
-    }
 
     while (lsquic_engine_has_pend_rw(engine))
         lsquic_engine_process_conns_with_pend_rw(engine);
@@ -374,6 +589,58 @@ read_handler (int fd, short flags, void *ctx)
 }
 
 
+#if HAVE_UDP_GRO
+/* GRO is an optimization: if the kernel does not support it, packets are
+ * simply read one datagram at a time.
+ */
+static void
+maybe_enable_gro (struct service_port *sport, int sockfd)
+{
+    int on;
+
+    if (!sport->sp_prog->prog_use_gro)
+        return;
+
+    on = 1;
+    if (0 == setsockopt(sockfd, SOL_UDP, UDP_GRO, &on, sizeof(on)))
+        sport->sp_flags |= SPORT_GRO;
+    else
+        LSQ_NOTICE("cannot enable UDP GRO: %s", strerror(errno));
+}
+#endif
+
+
+#if HAVE_SO_TXTIME
+/* Let the kernel pace outgoing packets using departure times set by the
+ * engine (see es_txtime).  The departure times are in the library clock,
+ * which is CLOCK_MONOTONIC.  For the pacing to be precise, the fq qdisc
+ * should be used on the outgoing interface:
+ *
+ *      tc qdisc replace dev eth0 root fq
+ *
+ * If SO_TXTIME cannot be set, the packets are sent without departure times
+ * and leave as soon as they are handed to the kernel.
+ */
+static void
+maybe_enable_txtime (struct service_port *sport, int sockfd)
+{
+    struct sock_txtime txtime;
+
+    if (!sport->sp_prog->prog_settings.es_txtime)
+        return;
+
+    memset(&txtime, 0, sizeof(txtime));
+    txtime.clockid = CLOCK_MONOTONIC;
+    if (0 == setsockopt(sockfd, SOL_SOCKET, SO_TXTIME, &txtime,
+                                                            sizeof(txtime)))
+        sport->sp_flags |= SPORT_TXTIME;
+    else
+        LSQ_WARN("cannot enable SO_TXTIME: %s; packets will not be paced "
+            "by the kernel", strerror(errno));
+}
+#endif
+
+
 static int
 add_to_event_loop (struct service_port *sport, struct event_base *eb)
 {
@@ -580,7 +847,15 @@ sport_init_server (struct service_port *sport, struct lsquic_engine *engine,
         return -1;
     }
 
-    sport->packs_in = allocate_packets_in(sockfd);
+#if HAVE_UDP_GRO
+    maybe_enable_gro(sport, sockfd);
+#endif
+#if HAVE_SO_TXTIME
+    maybe_enable_txtime(sport, sockfd);
+#endif
+
+    sport->packs_in = allocate_packets_in(sockfd,
+                                        !!(sport->sp_flags & SPORT_GRO));
     if (!sport->packs_in)
     {
         saved_errno = errno;
@@ -626,12 +901,13 @@ sport_init_client (struct service_port *sport, struct lsquic_engine *engine,
         socklen = sizeof(struct sockaddr_in);
         u.sin.sin_family      = AF_INET;
         u.sin.sin_addr.s_addr = INADDR_ANY;
-        u.sin.sin_port        = 0;
+        u.sin.sin_port        = htons(sport->sp_local_port);
         break;
     case AF_INET6:
         socklen = sizeof(struct sockaddr_in6);
         memset(&u.sin6, 0, sizeof(u.sin6));
         u.sin6.sin6_family = AF_INET6;
+        u.sin6.sin6_port   = htons(sport->sp_local_port);
         break;
     default:
         errno = EINVAL;
@@ -642,6 +918,24 @@ sport_init_client (struct service_port *sport, struct lsquic_engine *engine,
     if (-1 == sockfd)
         return -1;
 
+    if (sport->sp_flags & SPORT_REUSEPORT)
+    {
+#ifdef SO_REUSEPORT
+        int on = 1;
+        s = setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+#else
+        errno = EOPNOTSUPP;
+        s = -1;
+#endif
+        if (0 != s)
+        {
+            saved_errno = errno;
+            close(sockfd);
+            errno = saved_errno;
+            return -1;
+        }
+    }
+
     if (0 != bind(sockfd, sa_local, socklen)) {
         saved_errno = errno;
         close(sockfd);
@@ -723,8 +1017,18 @@ sport_init_client (struct service_port *sport, struct lsquic_engine *engine,
         errno = saved_errno;
         return -1;
     }
+    sport->sp_local_port = ntohs(AF_INET == sa_local->sa_family ?
+                                            u.sin.sin_port : u.sin6.sin6_port);
 
-    sport->packs_in = allocate_packets_in(sockfd);
+#if HAVE_UDP_GRO
+    maybe_enable_gro(sport, sockfd);
+#endif
+#if HAVE_SO_TXTIME
+    maybe_enable_txtime(sport, sockfd);
+#endif
+
+    sport->packs_in = allocate_packets_in(sockfd,
+                                        !!(sport->sp_flags & SPORT_GRO));
     if (!sport->packs_in)
     {
         saved_errno = errno;
@@ -797,6 +1101,38 @@ setup_control_msg (struct msghdr *msg, const struct lsquic_out_spec *spec,
 }
 
 
+#if HAVE_SO_TXTIME
+/* Append SCM_TXTIME control message to the one set up by
+ * setup_control_msg(), if any.  The kernel wants nanoseconds.
+ */
+static void
+add_txtime_control_msg (struct msghdr *msg, unsigned char *buf,
+                                            size_t bufsz, uint64_t tx_time)
+{
+    struct cmsghdr *cmsg;
+    size_t off;
+
+    if (msg->msg_control)
+        off = CMSG_ALIGN(msg->msg_controllen);
+    else
+        off = 0;
+    assert(off + CMSG_SPACE(sizeof(tx_time)) <= bufsz);
+    tx_time *= 1000;
+    msg->msg_control = buf;
+    cmsg = (struct cmsghdr *) (buf + off);
+    cmsg->cmsg_level    = SOL_SOCKET;
+    cmsg->cmsg_type     = SCM_TXTIME;
+    cmsg->cmsg_len      = CMSG_LEN(sizeof(tx_time));
+    memcpy(CMSG_DATA(cmsg), &tx_time, sizeof(tx_time));
+    msg->msg_controllen = off + CMSG_SPACE(sizeof(tx_time));
+}
+
+
+#define NEED_TXTIME(sport, spec) \
+            (((sport)->sp_flags & SPORT_TXTIME) && (spec)->tx_time)
+#endif
+
+
 static int
 send_packets_one_by_one (const struct lsquic_out_spec *specs, unsigned count)
 {
@@ -814,7 +1150,8 @@ send_packets_one_by_one (const struct lsquic_out_spec *specs, unsigned count)
                                       sizeof(struct in_addr)
 #endif
                                         , sizeof(struct in6_pktinfo))
-                                                                )];
+                                                                )
+                         + TXTIME_SZ ];
         struct cmsghdr cmsg;
     } ancil;
     struct iovec iov;
@@ -842,6 +1179,11 @@ send_packets_one_by_one (const struct lsquic_out_spec *specs, unsigned count)
             msg.msg_control = NULL;
             msg.msg_controllen = 0;
         }
+#if HAVE_SO_TXTIME
+        if (NEED_TXTIME(sport, &specs[n]))
+            add_txtime_control_msg(&msg, ancil.buf, sizeof(ancil.buf),
+                                                        specs[n].tx_time);
+#endif
         s = sendmsg(sport->fd, &msg, 0);
         if (s < 0)
         {
@@ -859,10 +1201,268 @@ send_packets_one_by_one (const struct lsquic_out_spec *specs, unsigned count)
 }
 
 
+#if HAVE_SENDMMSG
+/* All packets in the batch must go out through the same socket.  The batch
+ * may contain packets for several service ports (server mode); in that case,
+ * it is split into runs of packets that share the socket and each run is
+ * sent using a single sendmmsg() call.  We stop at the first run that is
+ * not sent out completely, as the engine expects packets to be sent in
+ * order.
+ */
+static int
+send_packets_using_sendmmsg (const struct lsquic_out_spec *specs,
+                                                        unsigned count)
+{
+    const struct service_port *sport;
+    unsigned i, n, run;
+    int s, saved_errno;
+    struct mmsghdr mmsgs[MAX_OUT_BATCH_SIZE];
+    union {
+        /* cmsg(3) recommends union for proper alignment */
+        unsigned char buf[ CMSG_SPACE(
+                                MAX(
+#if __linux__
+                                      sizeof(struct in_pktinfo)
+#else
+                                      sizeof(struct in_addr)
+#endif
+                                        , sizeof(struct in6_pktinfo))
+                                                                )
+                         + TXTIME_SZ ];
+        struct cmsghdr cmsg;
+    } ancil [ MAX_OUT_BATCH_SIZE ];
+    struct iovec iovs[ MAX_OUT_BATCH_SIZE ];
+
+    if (0 == count)
+        return 0;
+
+    n = 0;
+    while (n < count)
+    {
+        sport = specs[n].peer_ctx;
+        for (run = 0; n + run < count && run < MAX_OUT_BATCH_SIZE
+                            && specs[n + run].peer_ctx == sport; ++run)
+        {
+            i = n + run;
+            iovs[run].iov_base = (void *) specs[i].buf;
+            iovs[run].iov_len  = specs[i].sz;
+            mmsgs[run].msg_hdr.msg_name       = (void *) specs[i].dest_sa;
+            mmsgs[run].msg_hdr.msg_namelen    =
+                                (AF_INET == specs[i].dest_sa->sa_family ?
+                                            sizeof(struct sockaddr_in) :
+                                            sizeof(struct sockaddr_in6));
+            mmsgs[run].msg_hdr.msg_iov        = &iovs[run];
+            mmsgs[run].msg_hdr.msg_iovlen     = 1;
+            mmsgs[run].msg_hdr.msg_flags      = 0;
+            if (sport->sp_flags & SPORT_SERVER)
+            {
+                /* Consecutive packets to the same peer usually have the
+                 * same local address: reuse the ancillary message.  It
+                 * cannot be reused if the departure times differ.
+                 */
+                if (run > 0 && specs[i].local_sa == specs[i - 1].local_sa
+                            && specs[i].tx_time == specs[i - 1].tx_time)
+                {
+                    mmsgs[run].msg_hdr.msg_control =
+                                        mmsgs[run - 1].msg_hdr.msg_control;
+                    mmsgs[run].msg_hdr.msg_controllen =
+                                        mmsgs[run - 1].msg_hdr.msg_controllen;
+                }
+                else
+                {
+                    setup_control_msg(&mmsgs[run].msg_hdr, &specs[i],
+                                    ancil[run].buf, sizeof(ancil[run].buf));
+#if HAVE_SO_TXTIME
+                    if (NEED_TXTIME(sport, &specs[i]))
+                        add_txtime_control_msg(&mmsgs[run].msg_hdr,
+                            ancil[run].buf, sizeof(ancil[run].buf),
+                            specs[i].tx_time);
+#endif
+                }
+            }
+            else
+            {
+                mmsgs[run].msg_hdr.msg_control    = NULL;
+                mmsgs[run].msg_hdr.msg_controllen = 0;
+#if HAVE_SO_TXTIME
+                if (NEED_TXTIME(sport, &specs[i]))
+                    add_txtime_control_msg(&mmsgs[run].msg_hdr,
+                        ancil[run].buf, sizeof(ancil[run].buf),
+                        specs[i].tx_time);
+#endif
+            }
+        }
+
+        s = sendmmsg(sport->fd, mmsgs, run, 0);
+        if (s < 0)
+        {
+            saved_errno = errno;
+            LSQ_INFO("sendmmsg failed: %s", strerror(saved_errno));
+            if (n > 0)
+                break;
+            errno = saved_errno;
+            return -1;
+        }
+        n += (unsigned) s;
+        if ((unsigned) s < run)
+        {
+            LSQ_DEBUG("sendmmsg sent %d out of %u packets", s, run);
+            break;
+        }
+    }
+
+    return n;
+}
+#endif
+
+
+#if HAVE_UDP_SEGMENT
+/* Append UDP_SEGMENT control message to the one set up by
+ * setup_control_msg(), if any.
+ */
+static void
+add_segment_control_msg (struct msghdr *msg, unsigned char *buf,
+                                            size_t bufsz, uint16_t seg_sz)
+{
+    struct cmsghdr *cmsg;
+    size_t off;
+
+    if (msg->msg_control)
+        off = CMSG_ALIGN(msg->msg_controllen);
+    else
+        off = 0;
+    assert(off + CMSG_SPACE(sizeof(seg_sz)) <= bufsz);
+    msg->msg_control = buf;
+    cmsg = (struct cmsghdr *) (buf + off);
+    cmsg->cmsg_level    = SOL_UDP;
+    cmsg->cmsg_type     = UDP_SEGMENT;
+    cmsg->cmsg_len      = CMSG_LEN(sizeof(seg_sz));
+    memcpy(CMSG_DATA(cmsg), &seg_sz, sizeof(seg_sz));
+    msg->msg_controllen = off + CMSG_SPACE(sizeof(seg_sz));
+}
+
+
+/* Send each run of packets (see `n_segs' in struct lsquic_out_spec) using
+ * a single sendmsg() call with UDP_SEGMENT set to the size of the first
+ * packet.  The packets are gathered by the kernel from the iovecs, no
+ * copying is done here.  If the kernel does not support GSO on this
+ * socket, the run is sent one packet at a time and GSO is not tried again
+ * on this service port.
+ */
+static int
+send_packets_using_gso (const struct lsquic_out_spec *specs, unsigned count)
+{
+    struct service_port *sport;
+    unsigned n, i, n_segs;
+    int s, saved_errno;
+    struct msghdr msg;
+    union {
+        /* cmsg(3) recommends union for proper alignment */
+        unsigned char buf[ CMSG_SPACE(
+                                MAX(
+                                      sizeof(struct in_pktinfo)
+                                        , sizeof(struct in6_pktinfo))
+                                                                )
+                         + CMSG_SPACE(sizeof(uint16_t)) + TXTIME_SZ ];
+        struct cmsghdr cmsg;
+    } ancil;
+    struct iovec iovs[64];
+
+    n = 0;
+    while (n < count)
+    {
+        sport = specs[n].peer_ctx;
+        n_segs = specs[n].n_segs;
+        if (n_segs == 0)    /* JIC */
+            n_segs = 1;
+        if (n_segs > count - n)
+            n_segs = count - n;
+        if (n_segs > sizeof(iovs) / sizeof(iovs[0]))
+            n_segs = sizeof(iovs) / sizeof(iovs[0]);
+        if (n_segs == 1 || (sport->sp_flags & SPORT_NO_GSO))
+        {
+            s = send_packets_one_by_one(&specs[n], n_segs);
+            if (s < 0)
+                return n > 0 ? (int) n : -1;
+            n += (unsigned) s;
+            if ((unsigned) s < n_segs)
+                break;
+            continue;
+        }
+
+        for (i = 0; i < n_segs; ++i)
+        {
+            iovs[i].iov_base = (void *) specs[n + i].buf;
+            iovs[i].iov_len  = specs[n + i].sz;
+        }
+        msg.msg_name       = (void *) specs[n].dest_sa;
+        msg.msg_namelen    = (AF_INET == specs[n].dest_sa->sa_family ?
+                                            sizeof(struct sockaddr_in) :
+                                            sizeof(struct sockaddr_in6));
+        msg.msg_iov        = iovs;
+        msg.msg_iovlen     = n_segs;
+        msg.msg_flags      = 0;
+        if (sport->sp_flags & SPORT_SERVER)
+            setup_control_msg(&msg, &specs[n], ancil.buf, sizeof(ancil.buf));
+        else
+        {
+            msg.msg_control = NULL;
+            msg.msg_controllen = 0;
+        }
+        add_segment_control_msg(&msg, ancil.buf, sizeof(ancil.buf),
+                                                    (uint16_t) specs[n].sz);
+#if HAVE_SO_TXTIME
+        /* All packets in the run have the same departure time */
+        if (NEED_TXTIME(sport, &specs[n]))
+            add_txtime_control_msg(&msg, ancil.buf, sizeof(ancil.buf),
+                                                        specs[n].tx_time);
+#endif
+        s = sendmsg(sport->fd, &msg, 0);
+        if (s < 0)
+        {
+            saved_errno = errno;
+            if (saved_errno == EIO || saved_errno == EINVAL
+                || saved_errno == EOPNOTSUPP || saved_errno == ENOPROTOOPT)
+            {
+                LSQ_NOTICE("sendmsg with UDP_SEGMENT failed: %s; disable "
+                    "GSO on this port", strerror(saved_errno));
+                sport->sp_flags |= SPORT_NO_GSO;
+                continue;   /* Retry the run without GSO */
+            }
+            LSQ_INFO("sendmsg failed: %s", strerror(saved_errno));
+            if (n > 0)
+                break;
+            errno = saved_errno;
+            return -1;
+        }
+        /* The whole run is sent as a single datagram from the point of view
+         * of the socket: it is either sent or not.
+         */
+        n += n_segs;
+    }
+
+    return n;
+}
+#endif
+
+
 int
 sport_packets_out (void *ctx, const struct lsquic_out_spec *specs,
                    unsigned count)
 {
+#if HAVE_UDP_SEGMENT || HAVE_SENDMMSG
+    const struct prog *prog = ctx;
+#endif
+#if HAVE_UDP_SEGMENT
+    if (prog->prog_use_gso)
+        return send_packets_using_gso(specs, count);
+    else
+#endif
+#if HAVE_SENDMMSG
+    if (prog->prog_use_sendmmsg)
+        return send_packets_using_sendmmsg(specs, count);
+    else
+#endif
         return send_packets_one_by_one(specs, count);
 }
 
@@ -887,6 +1487,13 @@ set_engine_option (struct lsquic_engine_settings *settings,
             return 0;
         }
         break;
+    case 3:
+        if (0 == strncmp(name, "prr", 3))
+        {
+            settings->es_prr = atoi(val);
+            return 0;
+        }
+        break;
     case 4:
         if (0 == strncmp(name, "cfcw", 4))
         {
@@ -904,6 +1511,13 @@ set_engine_option (struct lsquic_engine_settings *settings,
             return 0;
         }
         break;
+    case 6:
+        if (0 == strncmp(name, "txtime", 6))
+        {
+            settings->es_txtime = atoi(val);
+            return 0;
+        }
+        break;
     case 7:
         if (0 == strncmp(name, "version", 7))
         {
@@ -943,6 +1557,16 @@ set_engine_option (struct lsquic_engine_settings *settings,
             settings->es_rw_once = atoi(val);
             return 0;
         }
+        else if (0 == strncmp(name, "cc_algo", 7))
+        {
+            settings->es_cc_algo = atoi(val);
+            return 0;
+        }
+        else if (0 == strncmp(name, "hystart", 7))
+        {
+            settings->es_hystart = atoi(val);
+            return 0;
+        }
         break;
     case 8:
         if (0 == strncmp(name, "max_cfcw", 8))
@@ -956,6 +1580,13 @@ set_engine_option (struct lsquic_engine_settings *settings,
             return 0;
         }
         break;
+    case 9:
+        if (0 == strncmp(name, "ack_decim", 9))
+        {
+            settings->es_ack_decim = atoi(val);
+            return 0;
+        }
+        break;
     case 10:
         if (0 == strncmp(name, "honor_prst", 10))
         {
@@ -963,6 +1594,13 @@ set_engine_option (struct lsquic_engine_settings *settings,
             return 0;
         }
         break;
+    case 11:
+        if (0 == strncmp(name, "use_di_ring", 11))
+        {
+            settings->es_use_di_ring = atoi(val);
+            return 0;
+        }
+        break;
     case 12:
         if (0 == strncmp(name, "idle_conn_to", 12))
         {
@@ -991,6 +1629,11 @@ set_engine_option (struct lsquic_engine_settings *settings,
             settings->es_support_tcid0 = atoi(val);
             return 0;
         }
+        if (0 == strncmp(name, "fc_mem_budget", 13))
+        {
+            settings->es_fc_mem_budget = strtoull(val, NULL, 10);
+            return 0;
+        }
         break;
     case 14:
         if (0 == strncmp(name, "max_streams_in", 14))
@@ -1004,6 +1647,13 @@ set_engine_option (struct lsquic_engine_settings *settings,
             return 0;
         }
         break;
+    case 15:
+        if (0 == strncmp(name, "ack_decim_start", 15))
+        {
+            settings->es_ack_decim_start = atoi(val);
+            return 0;
+        }
+        break;
     case 16:
         if (0 == strncmp(name, "proc_time_thresh", 16))
         {
@@ -1105,9 +1755,8 @@ pba_cleanup (struct packout_buf_allocator *pba)
 
 struct reader_ctx
 {
-    size_t  file_size;
-    size_t  nread;
-    int     fd;
+    struct lsquic_reader   *file_reader;
+    int                     fd;
 };
 
 
@@ -1115,7 +1764,7 @@ size_t
 test_reader_size (void *void_ctx)
 {
     struct reader_ctx *const ctx = void_ctx;
-    return ctx->file_size - ctx->nread;
+    return ctx->file_reader->lsqr_size(ctx->file_reader->lsqr_ctx);
 }
 
 
@@ -1123,23 +1772,7 @@ size_t
 test_reader_read (void *void_ctx, void *buf, size_t count)
 {
     struct reader_ctx *const ctx = void_ctx;
-    ssize_t nread;
-
-    if (count > test_reader_size(ctx))
-        count = test_reader_size(ctx);
-
-    nread = read(ctx->fd, buf, count);
-    if (nread >= 0)
-    {
-        ctx->nread += nread;
-        return nread;
-    }
-    else
-    {
-        LSQ_WARN("%s: error reading from file: %s", __func__, strerror(errno));
-        ctx->nread = ctx->file_size = 0;
-        return 0;
-    }
+    return ctx->file_reader->lsqr_read(ctx->file_reader->lsqr_ctx, buf, count);
 }
 
 
@@ -1163,8 +1796,14 @@ create_lsquic_reader_ctx (const char *filename)
         return NULL;
     }
     struct reader_ctx *ctx = malloc(sizeof(*ctx));
-    ctx->file_size = st.st_size;
-    ctx->nread = 0;
+    ctx->file_reader = lsquic_file_reader_new(fd, 0, st.st_size, 0);
+    if (!ctx->file_reader)
+    {
+        LSQ_ERROR("cannot create file reader: %s", strerror(errno));
+        (void) close(fd);
+        free(ctx);
+        return NULL;
+    }
     ctx->fd = fd;
     return ctx;
 }
@@ -1173,6 +1812,7 @@ create_lsquic_reader_ctx (const char *filename)
 void
 destroy_lsquic_reader_ctx (struct reader_ctx *ctx)
 {
+    lsquic_file_reader_destroy(ctx->file_reader);
     (void) close(ctx->fd);
     free(ctx);
 }
@@ -13,6 +13,7 @@
 struct lsquic_engine;
 struct lsquic_engine_settings;
 struct lsquic_out_spec;
+struct lsquic_in_spec;
 struct event_base;
 struct event;
 struct packets_in;
@@ -28,6 +29,10 @@ enum sport_flags
     SPORT_SET_SNDBUF        = (1 << 1), /* SO_SNDBUF */
     SPORT_SET_RCVBUF        = (1 << 2), /* SO_RCVBUF */
     SPORT_SERVER            = (1 << 3),
+    SPORT_NO_GSO            = (1 << 4), /* Kernel rejected UDP_SEGMENT */
+    SPORT_GRO               = (1 << 5), /* UDP_GRO is on */
+    SPORT_REUSEPORT         = (1 << 6), /* SO_REUSEPORT, see sp_local_port */
+    SPORT_TXTIME            = (1 << 7), /* SO_TXTIME is on */
 };
 
 struct service_port {
@@ -51,7 +56,19 @@ struct service_port {
     enum sport_flags           sp_flags;
     int                        sp_sndbuf;   /* If SPORT_SET_SNDBUF is set */
     int                        sp_rcvbuf;   /* If SPORT_SET_RCVBUF is set */
+    /* Client socket is bound to this port.  Zero means any port.  After the
+     * socket is initialized, this is set to the port that was actually
+     * bound, so that other sockets can share it using SPORT_REUSEPORT.
+     */
+    unsigned short             sp_local_port;
     struct prog               *sp_prog;
+    /* If set, packets read from the socket are passed to this function
+     * instead of lsquic_engine_packets_in().  The function may reorder
+     * or modify elements of `specs'.
+     */
+    unsigned                 (*sp_packets_in)(void *ctx,
+                                    struct lsquic_in_spec *specs, unsigned n);
+    void                      *sp_packets_in_ctx;
 };
 
 TAILQ_HEAD(sport_head, service_port);
@@ -0,0 +1,224 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * This is not a test: this program measures how long it takes the send
+ * controller to process ACK frames when there are many packets in flight.
+ *
+ * A window of packets is sent.  Then ACKs are replayed: each ACK
+ * acknowledges the next few packets and as many new packets are sent, so
+ * that the number of packets in flight stays the same.  With -d, every
+ * Nth packet is never acknowledged and each ACK carries up to -r ranges,
+ * as a peer that sees losses would send.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "lsquic.h"
+
+#include "lsquic_alarmset.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_rtt.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_stream.h"
+#include "lsquic_types.h"
+#include "lsquic_malo.h"
+#include "lsquic_mm.h"
+#include "lsquic_conn_public.h"
+#include "lsquic_logger.h"
+#include "lsquic_parse.h"
+#include "lsquic_conn.h"
+#include "lsquic_engine_public.h"
+#include "lsquic_cubic.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_prr.h"
+#include "lsquic_pacer.h"
+#include "lsquic_senhist.h"
+#include "lsquic_sentwin.h"
+#include "lsquic_send_ctl.h"
+#include "lsquic_ver_neg.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_util.h"
+
+#define MAX_RANGES (sizeof(((struct ack_info *) 0)->ranges) \
+                            / sizeof(((struct ack_info *) 0)->ranges[0]))
+
+static struct lsquic_engine_public eng_pub;
+static struct lsquic_conn        lconn;
+static struct lsquic_conn_public conn_pub;
+static struct lsquic_send_ctl    send_ctl;
+static struct lsquic_alarmset    alset;
+static struct ver_neg            ver_neg;
+
+static unsigned drop_every;     /* Zero means no packets are lost */
+
+
+static void
+init_send_ctl (void)
+{
+    lconn.cn_pf = select_pf_by_ver(LSQVER_037);
+    lconn.cn_pack_size = 1370;
+    lconn.cn_flags = LSCONN_HANDSHAKE_DONE;
+    lsquic_mm_init(&eng_pub.enp_mm);
+    lsquic_alarmset_init(&alset, 0);
+    conn_pub.mm = &eng_pub.enp_mm;
+    conn_pub.lconn = &lconn;
+    conn_pub.enpub = &eng_pub;
+    conn_pub.send_ctl = &send_ctl;
+    conn_pub.packet_out_malo =
+                        lsquic_malo_create(sizeof(struct lsquic_packet_out));
+    lsquic_send_ctl_init(&send_ctl, &alset, &eng_pub, &ver_neg, &conn_pub,
+                                                        lconn.cn_pack_size);
+}
+
+
+static void
+send_packet (lsquic_time_t now)
+{
+    struct lsquic_packet_out *packet_out;
+
+    packet_out = lsquic_send_ctl_new_packet_out(&send_ctl, 0);
+    assert(packet_out);
+    packet_out->po_frame_types |= 1 << QUIC_FRAME_WINDOW_UPDATE;
+    packet_out->po_data_sz = 1000;
+    lsquic_send_ctl_scheduled_one(&send_ctl, packet_out);
+    packet_out = lsquic_send_ctl_next_packet_to_send(&send_ctl);
+    assert(packet_out);
+    packet_out->po_sent = now;
+    lsquic_send_ctl_sent_packet(&send_ctl, packet_out, 1);
+}
+
+
+/* Peer has received all packets up to and including `largest', except
+ * those that are lost.  The ACK contains up to `n_ranges' ranges.
+ */
+static void
+make_ack (struct ack_info *acki, lsquic_packno_t largest, unsigned n_ranges)
+{
+    lsquic_packno_t packno;
+
+    memset(acki, 0, sizeof(*acki));
+    packno = largest;
+    while (acki->n_ranges < n_ranges && packno > 0)
+    {
+        if (drop_every && packno % drop_every == 0)
+        {
+            --packno;
+            continue;
+        }
+        acki->ranges[acki->n_ranges].high = packno;
+        if (drop_every)
+            packno = packno / drop_every * drop_every + 1;
+        else
+            packno = 1;
+        acki->ranges[acki->n_ranges].low = packno;
+        ++acki->n_ranges;
+        --packno;
+    }
+}
+
+
+int
+main (int argc, char **argv)
+{
+    struct ack_info acki;
+    lsquic_time_t now, start, elapsed;
+    lsquic_packno_t largest;
+    unsigned n, n_acks = 100000, n_in_flight = 10000, per_ack = 2,
+             n_ranges = 1;
+    int opt, s;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    while (-1 != (opt = getopt(argc, argv, "a:n:k:r:d:l:")))
+    {
+        switch (opt)
+        {
+        case 'a':
+            n_acks = atoi(optarg);
+            break;
+        case 'n':
+            n_in_flight = atoi(optarg);
+            break;
+        case 'k':
+            per_ack = atoi(optarg);
+            if (per_ack < 1)
+                per_ack = 1;
+            break;
+        case 'r':
+            n_ranges = atoi(optarg);
+            if (n_ranges < 1 || n_ranges > MAX_RANGES)
+                n_ranges = MAX_RANGES;
+            break;
+        case 'd':
+            drop_every = atoi(optarg);
+            if (drop_every == 1)
+                drop_every = 2;
+            break;
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            fprintf(stderr,
+"Usage: %s [options]\n"
+"\n"
+"   -a N        Number of ACKs to replay.  Defaults to 100000.\n"
+"   -n N        Number of packets in flight.  Defaults to 10000.\n"
+"   -k N        Number of new packets acknowledged by each ACK.  Defaults\n"
+"                 to 2.\n"
+"   -r N        Maximum number of ranges in each ACK.  Defaults to 1.\n"
+"   -d N        Drop every Nth packet.  By default, no packets are lost.\n"
+"   -l LEVELS   Log levels.\n"
+            , argv[0]);
+            exit(1);
+        }
+    }
+
+    init_send_ctl();
+
+    now = 1000000;
+    for (n = 0; n < n_in_flight; ++n)
+        send_packet(now);
+    largest = 0;
+
+    /* Only ACK processing is timed */
+    elapsed = 0;
+    for (n = 0; n < n_acks; ++n)
+    {
+        now += 10;
+        largest += per_ack;
+        make_ack(&acki, largest, n_ranges);
+        start = lsquic_time_now();
+        s = lsquic_send_ctl_got_ack(&send_ctl, &acki, now);
+        elapsed += lsquic_time_now() - start;
+        if (s != 0)
+        {
+            fprintf(stderr, "ACK #%u was rejected\n", n);
+            exit(1);
+        }
+        while (send_ctl.sc_n_in_flight_all < n_in_flight)
+            send_packet(now);
+    }
+
+    printf("%u ACKs, %u packets in flight, %u ranges: %"PRIu64" usec, "
+        "%.1f nsec per ACK\n", n_acks, n_in_flight, n_ranges, elapsed,
+        (double) elapsed * 1000 / n_acks);
+
+    lsquic_send_ctl_cleanup(&send_ctl);
+    lsquic_malo_destroy(conn_pub.packet_out_malo);
+    lsquic_mm_cleanup(&eng_pub.enp_mm);
+
+    return 0;
+}
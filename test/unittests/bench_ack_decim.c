@@ -0,0 +1,401 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * This is not a test: this program simulates a bulk transfer over a
+ * bottleneck link and counts the ACK packets the receiver sends, first
+ * with ACK decimation off and then with it on.
+ *
+ * The sender is the send controller with Cubic; the receiver uses the
+ * received packet history and the same ACK rules as full_conn.  Data
+ * packets are serialized at the bottleneck rate and dropped if the
+ * bottleneck queue is longer than -b milliseconds.  ACKs take the other
+ * direction, which is not congested.
+ *
+ * The send controller reads the clock itself, so the simulation runs in
+ * real time: each run takes about as long as the transfer.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "lsquic.h"
+
+#include "lsquic_alarmset.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_rtt.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_stream.h"
+#include "lsquic_types.h"
+#include "lsquic_malo.h"
+#include "lsquic_mm.h"
+#include "lsquic_conn_public.h"
+#include "lsquic_logger.h"
+#include "lsquic_parse.h"
+#include "lsquic_conn.h"
+#include "lsquic_engine_public.h"
+#include "lsquic_cubic.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_prr.h"
+#include "lsquic_pacer.h"
+#include "lsquic_senhist.h"
+#include "lsquic_sentwin.h"
+#include "lsquic_send_ctl.h"
+#include "lsquic_ver_neg.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_rechist.h"
+#include "lsquic_ack_decim.h"
+#include "lsquic_util.h"
+#include "link_sim.h"
+
+#define MS(n) ((n) * 1000)  /* MS: Milliseconds */
+
+#define DATA_SZ     1300
+
+/* Decimation is off by default in the library; Chromium uses 10 */
+#define DEFAULT_ACK_DECIM 10
+
+/* Same values as in full_conn: */
+#define MAX_RETR_PACKETS_SINCE_LAST_ACK 2
+#define ACK_TIMEOUT                     25000
+
+struct data_packet
+{
+    TAILQ_ENTRY(data_packet)    next;
+    lsquic_time_t               arrival;
+    lsquic_packno_t             packno;
+};
+
+struct sim_ack
+{
+    TAILQ_ENTRY(sim_ack)        next;
+    lsquic_time_t               arrival;
+    struct ack_info             acki;
+};
+
+struct sender
+{
+    struct lsquic_engine_public eng_pub;
+    struct lsquic_conn          lconn;
+    struct lsquic_conn_public   conn_pub;
+    struct lsquic_send_ctl      send_ctl;
+    struct lsquic_alarmset      alset;
+    struct ver_neg              ver_neg;
+    unsigned                    n_new;      /* Packets with new data sent */
+    unsigned                    n_sent;     /* Including retransmissions */
+};
+
+struct receiver
+{
+    struct lsquic_rechist       rechist;
+    struct ack_decim            ack_decim;
+    lsquic_time_t               ack_alarm;  /* Zero if not set */
+    unsigned                    n_slack_akbl;
+    unsigned                    n_acks;
+    int                         ack_queued;
+    int                         had_miss;
+};
+
+struct link
+{
+    TAILQ_HEAD(, data_packet)   data;       /* Sender to receiver */
+    TAILQ_HEAD(, sim_ack)       acks;       /* Receiver to sender */
+    struct sim_link             bottleneck;
+};
+
+static uint64_t rate = 100000000 / 8;      /* Bytes per second */
+static lsquic_time_t delay = MS(20);        /* One way */
+static lsquic_time_t buf_time = MS(40);
+static unsigned n_packets = 20000;
+static const struct parse_funcs *pf;
+
+
+static void
+sender_init (struct sender *snd)
+{
+    memset(snd, 0, sizeof(*snd));
+    snd->eng_pub.enp_settings.es_cc_algo = 1;
+    snd->eng_pub.enp_settings.es_hystart = LSQUIC_DF_HYSTART;
+    snd->eng_pub.enp_settings.es_prr = LSQUIC_DF_PRR;
+    snd->lconn.cn_pf = pf;
+    snd->lconn.cn_pack_size = 1370;
+    snd->lconn.cn_flags = LSCONN_HANDSHAKE_DONE;
+    lsquic_mm_init(&snd->eng_pub.enp_mm);
+    lsquic_alarmset_init(&snd->alset, 0);
+    snd->conn_pub.mm = &snd->eng_pub.enp_mm;
+    snd->conn_pub.lconn = &snd->lconn;
+    snd->conn_pub.enpub = &snd->eng_pub;
+    snd->conn_pub.send_ctl = &snd->send_ctl;
+    snd->conn_pub.packet_out_malo =
+                        lsquic_malo_create(sizeof(struct lsquic_packet_out));
+    lsquic_send_ctl_init(&snd->send_ctl, &snd->alset, &snd->eng_pub,
+                &snd->ver_neg, &snd->conn_pub, snd->lconn.cn_pack_size);
+}
+
+
+static void
+sender_cleanup (struct sender *snd)
+{
+    lsquic_send_ctl_cleanup(&snd->send_ctl);
+    lsquic_malo_destroy(snd->conn_pub.packet_out_malo);
+    lsquic_mm_cleanup(&snd->eng_pub.enp_mm);
+}
+
+
+/* Put packet onto the bottleneck link or drop it if the queue is full */
+static void
+link_send (struct link *link, lsquic_packno_t packno, lsquic_time_t now)
+{
+    struct data_packet *packet;
+    lsquic_time_t departure;
+
+    departure = sim_link_send(&link->bottleneck, SIM_PACKET_SZ, now);
+    if (!departure)
+        return;
+
+    packet = malloc(sizeof(*packet));
+    assert(packet);
+    packet->packno = packno;
+    packet->arrival = departure + delay;
+    TAILQ_INSERT_TAIL(&link->data, packet, next);
+}
+
+
+static void
+sender_send (struct sender *snd, struct link *link, lsquic_time_t now)
+{
+    struct lsquic_send_ctl *const ctl = &snd->send_ctl;
+    struct lsquic_packet_out *packet_out;
+
+    /* As in the engine: new packets are created only if the congestion
+     * window allows it, while all scheduled packets are sent.
+     */
+    (void) lsquic_send_ctl_reschedule_packets(ctl);
+    while (snd->n_new < n_packets && lsquic_send_ctl_can_send(ctl))
+    {
+        packet_out = lsquic_send_ctl_new_packet_out(ctl, 0);
+        assert(packet_out);
+        packet_out->po_frame_types |= 1 << QUIC_FRAME_WINDOW_UPDATE;
+        packet_out->po_data_sz = DATA_SZ;
+        lsquic_send_ctl_scheduled_one(ctl, packet_out);
+        ++snd->n_new;
+    }
+    while ((packet_out = lsquic_send_ctl_next_packet_to_send(ctl)))
+    {
+        packet_out->po_sent = now;
+        link_send(link, packet_out->po_packno, now);
+        (void) lsquic_send_ctl_sent_packet(ctl, packet_out, 1);
+        ++snd->n_sent;
+    }
+}
+
+
+/* Same logic as try_queueing_ack() in full_conn */
+static void
+receiver_try_queueing_ack (struct receiver *rcv, int was_missing,
+                                            int new_gap, lsquic_time_t now)
+{
+    enum ack_decim_verdict verdict;
+
+    verdict = lsquic_ack_decim_check(&rcv->ack_decim,
+                lsquic_rechist_largest_packno(&rcv->rechist),
+                rcv->n_slack_akbl, was_missing || new_gap);
+    if (verdict == ADV_ACK_NOW ||
+        (verdict == ADV_OFF &&
+            (rcv->n_slack_akbl >= MAX_RETR_PACKETS_SINCE_LAST_ACK ||
+            (rcv->had_miss && was_missing))))
+    {
+        rcv->ack_queued = 1;
+        rcv->ack_alarm = 0;
+    }
+    else if (verdict == ADV_OFF)
+        rcv->ack_alarm = now + ACK_TIMEOUT;
+    else if (!rcv->ack_alarm)
+        rcv->ack_alarm = now + lsquic_ack_decim_delay(2 * delay,
+                                                                ACK_TIMEOUT);
+}
+
+
+static void
+receiver_recv (struct receiver *rcv, lsquic_packno_t packno,
+                                                        lsquic_time_t now)
+{
+    lsquic_packno_t prev_largest;
+    int was_missing, new_gap;
+
+    prev_largest = lsquic_rechist_largest_packno(&rcv->rechist);
+    if (REC_ST_OK != lsquic_rechist_received(&rcv->rechist, packno, now))
+        return;
+    if (rcv->ack_queued)
+        return;
+    was_missing = packno != lsquic_rechist_largest_packno(&rcv->rechist);
+    new_gap = prev_largest && packno > prev_largest + 1;
+    ++rcv->n_slack_akbl;
+    receiver_try_queueing_ack(rcv, was_missing, new_gap, now);
+}
+
+
+static void
+receiver_send_ack (struct receiver *rcv, struct link *link,
+                                                        lsquic_time_t now)
+{
+    struct sim_ack *ack;
+    lsquic_packno_t largest;
+    unsigned char buf[1370];
+    int has_missing, w, s;
+
+    ack = malloc(sizeof(*ack));
+    assert(ack);
+    w = pf->pf_gen_ack_frame(buf, sizeof(buf),
+                (gaf_rechist_first_f)        lsquic_rechist_first,
+                (gaf_rechist_next_f)         lsquic_rechist_next,
+                (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
+                &rcv->rechist, now, &has_missing, &largest, NULL);
+    assert(w > 0);
+    s = pf->pf_parse_ack_frame(buf, w, &ack->acki);
+    assert(s == w);
+    ack->arrival = now + delay;
+    TAILQ_INSERT_TAIL(&link->acks, ack, next);
+
+    rcv->had_miss = has_missing;
+    rcv->ack_queued = 0;
+    rcv->ack_alarm = 0;
+    rcv->n_slack_akbl = 0;
+    ++rcv->n_acks;
+}
+
+
+static void
+run (unsigned ack_decim)
+{
+    struct sender snd;
+    struct receiver rcv;
+    struct link link;
+    struct data_packet *packet;
+    struct sim_ack *ack;
+    lsquic_time_t start, now;
+    int s;
+
+    sender_init(&snd);
+    memset(&rcv, 0, sizeof(rcv));
+    lsquic_rechist_init(&rcv.rechist, 0);
+    lsquic_ack_decim_init(&rcv.ack_decim, ack_decim,
+                                                LSQUIC_DF_ACK_DECIM_START);
+    memset(&link, 0, sizeof(link));
+    TAILQ_INIT(&link.data);
+    TAILQ_INIT(&link.acks);
+    link.bottleneck.rate = rate;
+    link.bottleneck.buf_max = rate * buf_time / 1000000;
+
+    start = now = lsquic_time_now();
+    while (snd.n_new < n_packets
+            || !lsquic_sentwin_empty(&snd.send_ctl.sc_unacked)
+            || !TAILQ_EMPTY(&snd.send_ctl.sc_lost_packets))
+    {
+        now = lsquic_time_now();
+
+        while ((packet = TAILQ_FIRST(&link.data)) && packet->arrival <= now)
+        {
+            TAILQ_REMOVE(&link.data, packet, next);
+            receiver_recv(&rcv, packet->packno, packet->arrival);
+            free(packet);
+        }
+        if (rcv.ack_alarm && rcv.ack_alarm <= now)
+            rcv.ack_queued = 1;
+        if (rcv.ack_queued)
+            receiver_send_ack(&rcv, &link, now);
+
+        while ((ack = TAILQ_FIRST(&link.acks)) && ack->arrival <= now)
+        {
+            TAILQ_REMOVE(&link.acks, ack, next);
+            s = lsquic_send_ctl_got_ack(&snd.send_ctl, &ack->acki, now);
+            assert(0 == s);
+            free(ack);
+        }
+        lsquic_alarmset_ring_expired(&snd.alset, now);
+        sender_send(&snd, &link, now);
+    }
+
+    printf("ACK decimation %-3s: %.3f sec, %5.1f Mbps; %u data packets "
+        "(%u dropped); %u ACKs, %.2f per data packet\n",
+        ack_decim ? "on" : "off", (double) (now - start) / 1000000,
+        (double) n_packets * DATA_SZ * 8 / (now - start), snd.n_sent,
+        link.bottleneck.n_dropped, rcv.n_acks, (double) rcv.n_acks / snd.n_sent);
+
+    while ((packet = TAILQ_FIRST(&link.data)))
+    {
+        TAILQ_REMOVE(&link.data, packet, next);
+        free(packet);
+    }
+    while ((ack = TAILQ_FIRST(&link.acks)))
+    {
+        TAILQ_REMOVE(&link.acks, ack, next);
+        free(ack);
+    }
+    lsquic_rechist_cleanup(&rcv.rechist);
+    sender_cleanup(&snd);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    unsigned ack_decim = DEFAULT_ACK_DECIM;
+    int opt;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+    pf = select_pf_by_ver(LSQVER_039);
+
+    while (-1 != (opt = getopt(argc, argv, "n:r:d:b:k:l:")))
+    {
+        switch (opt)
+        {
+        case 'n':
+            n_packets = atoi(optarg);
+            break;
+        case 'r':
+            rate = strtoull(optarg, NULL, 10) * 1000000 / 8;
+            break;
+        case 'd':
+            delay = MS(atoi(optarg));
+            break;
+        case 'b':
+            buf_time = MS(atoi(optarg));
+            break;
+        case 'k':
+            ack_decim = atoi(optarg);
+            break;
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            fprintf(stderr,
+"Usage: %s [options]\n"
+"\n"
+"   -n N        Number of data packets to transfer.  Defaults to 20000.\n"
+"   -r MBPS     Bottleneck rate in megabits per second.  Defaults to 100.\n"
+"   -d MS       One-way delay in milliseconds.  Defaults to 20.\n"
+"   -b MS       Bottleneck buffer in milliseconds.  Defaults to 40.\n"
+"   -k N        ACK decimation packets.  Defaults to %u.\n"
+"   -l LEVELS   Log levels.\n"
+            , argv[0], DEFAULT_ACK_DECIM);
+            exit(1);
+        }
+    }
+
+    run(0);
+    run(ack_decim);
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * This is not a test: this program measures how long it takes to generate
+ * an ACK frame when packets arrive in order, with and without the ACK
+ * block cache.
+ *
+ * The history starts with the given number of ranges.  Then, before each
+ * ACK frame is generated, the next packet arrives, growing the first range.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "lsquic.h"
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_rechist.h"
+#include "lsquic_parse.h"
+#include "lsquic_util.h"
+#include "lsquic_logger.h"
+
+
+static const struct parse_funcs *pf;
+static unsigned n_acks = 1000000;
+
+
+/* Returns number of nanoseconds it takes to generate one ACK frame */
+static double
+run (unsigned n_ranges, int use_cache)
+{
+    struct lsquic_rechist rechist;
+    struct ack_gen_cache cache;
+    lsquic_packno_t packno, largest;
+    lsquic_time_t start, elapsed;
+    unsigned char buf[1370];
+    unsigned n;
+    int has_missing, w;
+
+    lsquic_rechist_init(&rechist, 0);
+    memset(&cache, 0, sizeof(cache));
+
+    /* Every third packet is lost */
+    for (packno = 1; packno < 3 * (lsquic_packno_t) n_ranges; ++packno)
+        if (packno % 3)
+            (void) lsquic_rechist_received(&rechist, packno, 0);
+
+    /* Clock resolution is too coarse to time each call: recording the
+     * packet is included.
+     */
+    start = lsquic_time_now();
+    for (n = 0; n < n_acks; ++n)
+    {
+        (void) lsquic_rechist_received(&rechist, packno++, start);
+        cache.agc_version = lsquic_rechist_version(&rechist);
+        w = pf->pf_gen_ack_frame(buf, sizeof(buf),
+                (gaf_rechist_first_f)        lsquic_rechist_first,
+                (gaf_rechist_next_f)         lsquic_rechist_next,
+                (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
+                &rechist, start, &has_missing, &largest,
+                use_cache ? &cache : NULL);
+        if (w < 0)
+        {
+            fprintf(stderr, "cannot generate ACK frame\n");
+            exit(1);
+        }
+    }
+    elapsed = lsquic_time_now() - start;
+
+    lsquic_rechist_cleanup(&rechist);
+    return (double) elapsed * 1000 / n_acks;
+}
+
+
+int
+main (int argc, char **argv)
+{
+    static const unsigned default_n_ranges[] = { 1, 16, 255, };
+    unsigned n_ranges[sizeof(default_n_ranges) / sizeof(default_n_ranges[0])];
+    enum lsquic_version version = LSQVER_039;
+    double without_cache, with_cache;
+    unsigned n, count = 0;
+    int opt;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    while (-1 != (opt = getopt(argc, argv, "n:r:v:l:")))
+    {
+        switch (opt)
+        {
+        case 'n':
+            n_acks = atoi(optarg);
+            break;
+        case 'r':
+            if (count < sizeof(n_ranges) / sizeof(n_ranges[0]))
+                n_ranges[count++] = atoi(optarg);
+            break;
+        case 'v':
+            version = lsquic_str2ver(optarg, strlen(optarg));
+            if ((int) version < 0)
+            {
+                fprintf(stderr, "invalid version `%s'\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            fprintf(stderr,
+"Usage: %s [options]\n"
+"\n"
+"   -n N        Number of ACK frames to generate.  Defaults to 1000000.\n"
+"   -r N        Number of ranges.  May be specified up to three times.\n"
+"                 Defaults to 1, 16, and 255.\n"
+"   -v VERSION  QUIC version.  Defaults to Q039.\n"
+"   -l LEVELS   Log levels.\n"
+            , argv[0]);
+            exit(1);
+        }
+    }
+
+    if (0 == count)
+    {
+        memcpy(n_ranges, default_n_ranges, sizeof(default_n_ranges));
+        count = sizeof(default_n_ranges) / sizeof(default_n_ranges[0]);
+    }
+
+    pf = select_pf_by_ver(version);
+    for (n = 0; n < count; ++n)
+    {
+        without_cache = run(n_ranges[n], 0);
+        with_cache = run(n_ranges[n], 1);
+        printf("%3u ranges: %6.1f nsec per ACK without cache, "
+            "%6.1f nsec with cache\n", n_ranges[n], without_cache,
+            with_cache);
+    }
+
+    return 0;
+}
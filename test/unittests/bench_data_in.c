@@ -0,0 +1,341 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * This is not a test: this program measures how fast the data_in
+ * implementations reassemble a stream whose frames arrive out of order.
+ *
+ * The stream is received one flow control window (-w) at a time.  Frames
+ * of each window arrive in the order given by the pattern (-p):
+ *
+ *  inorder     no reordering;
+ *  loss        the first frame of the window arrives last;
+ *  shuffle     random order;
+ *  reverse     last frame first.
+ *
+ * When the whole window has arrived, it is read out.  Implementations (-m)
+ * are nocopy, hash, ring, and auto.  The last is nocopy that switches to
+ * hash and back the way streams do it.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "lsquic.h"
+#include "lsquic_int_types.h"
+#include "lsquic_types.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_rtt.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_stream.h"
+#include "lsquic_mm.h"
+#include "lsquic_malo.h"
+#include "lsquic_conn.h"
+#include "lsquic_conn_public.h"
+#include "lsquic_data_in_if.h"
+#include "lsquic_logger.h"
+#include "lsquic_util.h"
+
+
+#define FRAME_SZ 1350
+
+
+static const char *const patterns[] = { "inorder", "loss", "shuffle",
+                                                                "reverse", };
+static const char *const impls[] = { "nocopy", "hash", "ring", "auto", };
+
+#define N_ELEMS(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+
+struct receiver
+{
+    struct lsquic_mm            mm;
+    struct lsquic_conn          lconn;
+    struct lsquic_conn_public   conn_pub;
+    struct data_in             *data_in;
+    int                         autoswitch;
+};
+
+
+static struct stream_frame *
+new_frame (struct receiver *rcv, const unsigned char *data, uint64_t off,
+                                                        unsigned sz, int fin)
+{
+    struct lsquic_packet_in *packet_in;
+    struct stream_frame *frame;
+
+    packet_in = lsquic_mm_get_packet_in(&rcv->mm);
+    packet_in->pi_data = (unsigned char *) data + off;
+    packet_in->pi_data_sz = sz;
+    packet_in->pi_refcnt = 1;
+
+    frame = lsquic_malo_get(rcv->mm.malo.stream_frame);
+    memset(frame, 0, sizeof(*frame));
+    frame->packet_in = packet_in;
+    frame->data_frame.df_offset = off;
+    frame->data_frame.df_size   = sz;
+    frame->data_frame.df_data   = packet_in->pi_data;
+    frame->data_frame.df_fin    = fin;
+    return frame;
+}
+
+
+static void
+maybe_switch (struct receiver *rcv, uint64_t read_offset)
+{
+    if (rcv->autoswitch && (rcv->data_in->di_flags & DI_SWITCH_IMPL))
+    {
+        rcv->data_in = rcv->data_in->di_if->di_switch_impl(rcv->data_in,
+                                                                read_offset);
+        assert(rcv->data_in);
+    }
+}
+
+
+/* Read everything that is available into `buf' */
+static uint64_t
+read_all (struct receiver *rcv, unsigned char *buf, uint64_t read_offset)
+{
+    struct data_frame *data_frame;
+    unsigned n;
+    int fin;
+
+    while ((data_frame = rcv->data_in->di_if->di_get_frame(rcv->data_in,
+                                                                read_offset)))
+    {
+        n = data_frame->df_size - data_frame->df_read_off;
+        memcpy(buf + read_offset, data_frame->df_data
+                                        + data_frame->df_read_off, n);
+        data_frame->df_read_off += n;
+        read_offset += n;
+        fin = data_frame->df_fin;
+        rcv->data_in->di_if->di_frame_done(rcv->data_in, data_frame);
+        maybe_switch(rcv, read_offset);
+        if (fin)
+            break;
+    }
+
+    return read_offset;
+}
+
+
+static void
+make_order (unsigned *order, unsigned n_frames, const char *pattern)
+{
+    unsigned i, j, tmp;
+
+    for (i = 0; i < n_frames; ++i)
+        order[i] = i;
+
+    if (0 == strcmp(pattern, "loss"))
+    {
+        for (i = 0; i + 1 < n_frames; ++i)
+            order[i] = i + 1;
+        order[n_frames - 1] = 0;
+    }
+    else if (0 == strcmp(pattern, "shuffle"))
+        for (i = n_frames - 1; i > 0; --i)
+        {
+            j = rand() % (i + 1);
+            tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+        }
+    else if (0 == strcmp(pattern, "reverse"))
+        for (i = 0; i < n_frames; ++i)
+            order[i] = n_frames - 1 - i;
+}
+
+
+/* Returns throughput in megabytes per second; peak memory use is
+ * placed into `mem_used'.
+ */
+static double
+run (const unsigned char *data, unsigned char *buf, uint64_t size,
+        unsigned window, const char *impl, const char *pattern,
+        size_t *mem_used)
+{
+    struct receiver rcv;
+    struct stream_frame *frame;
+    unsigned *order, n_frames, n, sz;
+    uint64_t base, off, read_offset;
+    lsquic_time_t start, elapsed;
+    enum ins_frame ins;
+    size_t used;
+
+    memset(&rcv, 0, sizeof(rcv));
+    lsquic_mm_init(&rcv.mm);
+    rcv.conn_pub.mm = &rcv.mm;
+    rcv.conn_pub.lconn = &rcv.lconn;
+
+    if (0 == strcmp(impl, "hash"))
+        rcv.data_in = data_in_hash_new(&rcv.conn_pub, 5, 0);
+    else if (0 == strcmp(impl, "ring"))
+        rcv.data_in = data_in_ring_new(&rcv.conn_pub, 5);
+    else
+    {
+        rcv.data_in = data_in_nocopy_new(&rcv.conn_pub, 5);
+        rcv.autoswitch = 0 == strcmp(impl, "auto");
+    }
+    assert(rcv.data_in);
+
+    /* Frames do not straddle windows */
+    n_frames = window / FRAME_SZ;
+    window = n_frames * FRAME_SZ;
+    order = malloc(n_frames * sizeof(order[0]));
+    srand(2718);
+
+    *mem_used = 0;
+    elapsed = 0;
+    read_offset = 0;
+    for (base = 0; base < size; base += window)
+    {
+        n_frames = window / FRAME_SZ;
+        if (size - base < window)
+            n_frames = (size - base + FRAME_SZ - 1) / FRAME_SZ;
+        make_order(order, n_frames, pattern);
+
+        start = lsquic_time_now();
+        for (n = 0; n < n_frames; ++n)
+        {
+            off = base + (uint64_t) order[n] * FRAME_SZ;
+            sz = FRAME_SZ;
+            if (sz > size - off)
+                sz = size - off;
+            frame = new_frame(&rcv, data, off, sz, off + sz == size);
+            ins = rcv.data_in->di_if->di_insert_frame(rcv.data_in, frame,
+                                                                read_offset);
+            assert(INS_FRAME_OK == ins);
+            maybe_switch(&rcv, read_offset);
+        }
+        elapsed += lsquic_time_now() - start;
+
+        used = rcv.data_in->di_if->di_mem_used(rcv.data_in);
+        if (used > *mem_used)
+            *mem_used = used;
+
+        start = lsquic_time_now();
+        read_offset = read_all(&rcv, buf, read_offset);
+        elapsed += lsquic_time_now() - start;
+        assert(read_offset == base + window || read_offset == size);
+    }
+
+    assert(read_offset == size);
+    assert(0 == memcmp(data, buf, size));
+
+    rcv.data_in->di_if->di_destroy(rcv.data_in);
+    free(order);
+    lsquic_mm_cleanup(&rcv.mm);
+
+    return (double) size / (elapsed ? elapsed : 1);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    const char *sel_impls[N_ELEMS(impls)], *sel_patterns[N_ELEMS(patterns)];
+    unsigned windows[8], n_impls = 0, n_patterns = 0, n_windows = 0,
+             n_runs = 1, i, p, w, run_no;
+    uint64_t size = 256 * 1024 * 1024, off;
+    unsigned char *data, *buf;
+    size_t mem_used;
+    double speed;
+    int opt;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    while (-1 != (opt = getopt(argc, argv, "m:p:w:s:n:l:")))
+    {
+        switch (opt)
+        {
+        case 'm':
+            if (n_impls < N_ELEMS(sel_impls))
+                sel_impls[n_impls++] = optarg;
+            break;
+        case 'p':
+            if (n_patterns < N_ELEMS(sel_patterns))
+                sel_patterns[n_patterns++] = optarg;
+            break;
+        case 'w':
+            if (n_windows < N_ELEMS(windows))
+                windows[n_windows++] = atoi(optarg) * 1024;
+            break;
+        case 's':
+            size = strtoull(optarg, NULL, 10) * 1024 * 1024;
+            break;
+        case 'n':
+            n_runs = atoi(optarg);
+            break;
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            fprintf(stderr,
+"Usage: %s [options]\n"
+"\n"
+"   -m IMPL     Implementation: nocopy, hash, ring, or auto.  May be\n"
+"                 specified more than once.  Defaults to all four.\n"
+"   -p PATTERN  Arrival pattern: inorder, loss, shuffle, or reverse.  May\n"
+"                 be specified more than once.  Defaults to all four.\n"
+"   -w KB       Window size in kilobytes.  May be specified up to eight\n"
+"                 times.  Defaults to 64, 1024, and 16384.\n"
+"   -s MB       Stream size in megabytes.  Defaults to 256.\n"
+"   -n RUNS     Number of runs for each combination.  Defaults to 1.\n"
+"   -l LEVELS   Log levels.\n"
+            , argv[0]);
+            exit(1);
+        }
+    }
+
+    if (0 == n_impls)
+    {
+        memcpy(sel_impls, impls, sizeof(impls));
+        n_impls = N_ELEMS(impls);
+    }
+    if (0 == n_patterns)
+    {
+        memcpy(sel_patterns, patterns, sizeof(patterns));
+        n_patterns = N_ELEMS(patterns);
+    }
+    if (0 == n_windows)
+    {
+        windows[n_windows++] = 64 * 1024;
+        windows[n_windows++] = 1024 * 1024;
+        windows[n_windows++] = 16 * 1024 * 1024;
+    }
+
+    data = malloc(size);
+    buf = malloc(size);
+    if (!data || !buf)
+    {
+        perror("malloc");
+        exit(1);
+    }
+    for (off = 0; off < size; ++off)
+        data[off] = off * 7 + off / 1000;
+
+    for (w = 0; w < n_windows; ++w)
+        for (p = 0; p < n_patterns; ++p)
+            for (i = 0; i < n_impls; ++i)
+                for (run_no = 0; run_no < n_runs; ++run_no)
+                {
+                    speed = run(data, buf, size, windows[w], sel_impls[i],
+                                            sel_patterns[p], &mem_used);
+                    printf("window %6u KB  %-7s  %-6s: %8.1f MB/s; peak "
+                        "memory %7zu KB\n", windows[w] / 1024,
+                        sel_patterns[p], sel_impls[i], speed,
+                        mem_used / 1024);
+                }
+
+    free(data);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,388 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * This is not a test: this program measures how fast a file is uploaded
+ * using lsquic_stream_writef() with different readers:
+ *
+ *  read    read(2) from the file, as test_common.c used to do;
+ *  pread   file reader using pread(2);
+ *  mmap    file reader using memory mapping.
+ *
+ * Packets are not encrypted or sent anywhere: as soon as the stream fills
+ * them, they are taken from the send controller and acknowledged.  The
+ * file is read once before the runs, so that it is in the page cache.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "lsquic.h"
+
+#include "lsquic_alarmset.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_rtt.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_stream.h"
+#include "lsquic_types.h"
+#include "lsquic_malo.h"
+#include "lsquic_mm.h"
+#include "lsquic_conn_public.h"
+#include "lsquic_logger.h"
+#include "lsquic_parse.h"
+#include "lsquic_conn.h"
+#include "lsquic_engine_public.h"
+#include "lsquic_cubic.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_prr.h"
+#include "lsquic_pacer.h"
+#include "lsquic_senhist.h"
+#include "lsquic_sentwin.h"
+#include "lsquic_send_ctl.h"
+#include "lsquic_ver_neg.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_util.h"
+
+/* Flow control windows are moved this far ahead of the data sent */
+#define WINDOW (16 * 1024 * 1024)
+
+struct sender
+{
+    struct lsquic_engine_public eng_pub;
+    struct lsquic_conn          lconn;
+    struct lsquic_conn_public   conn_pub;
+    struct lsquic_send_ctl      send_ctl;
+    struct lsquic_alarmset      alset;
+    struct ver_neg              ver_neg;
+    struct ack_info             acki;
+};
+
+struct read_reader_ctx
+{
+    uint64_t    size;
+    int         fd;
+};
+
+
+static void
+on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+}
+
+
+static const struct lsquic_stream_if stream_if = {
+    .on_close   = on_close,
+};
+
+
+/* This function is only here to avoid crash in the test: */
+void
+lsquic_engine_add_conn_to_pend_rw (struct lsquic_engine_public *enpub,
+                                lsquic_conn_t *conn, enum rw_reason reason)
+{
+}
+
+
+static void
+sender_init (struct sender *snd)
+{
+    memset(snd, 0, sizeof(*snd));
+    snd->eng_pub.enp_settings.es_cc_algo = 1;
+    snd->lconn.cn_pf = select_pf_by_ver(LSQVER_039);
+    snd->lconn.cn_pack_size = 1370;
+    snd->lconn.cn_flags = LSCONN_HANDSHAKE_DONE;
+    lsquic_mm_init(&snd->eng_pub.enp_mm);
+    TAILQ_INIT(&snd->conn_pub.sending_streams);
+    TAILQ_INIT(&snd->conn_pub.read_streams);
+    TAILQ_INIT(&snd->conn_pub.write_streams);
+    TAILQ_INIT(&snd->conn_pub.service_streams);
+    lsquic_conn_cap_init(&snd->conn_pub.conn_cap, WINDOW);
+    lsquic_alarmset_init(&snd->alset, 0);
+    snd->conn_pub.mm = &snd->eng_pub.enp_mm;
+    snd->conn_pub.lconn = &snd->lconn;
+    snd->conn_pub.enpub = &snd->eng_pub;
+    lsquic_cfcw_init(&snd->conn_pub.cfcw, &snd->conn_pub, WINDOW);
+    snd->conn_pub.send_ctl = &snd->send_ctl;
+    snd->conn_pub.packet_out_malo =
+                        lsquic_malo_create(sizeof(struct lsquic_packet_out));
+    lsquic_send_ctl_init(&snd->send_ctl, &snd->alset, &snd->eng_pub,
+                &snd->ver_neg, &snd->conn_pub, snd->lconn.cn_pack_size);
+}
+
+
+static void
+sender_cleanup (struct sender *snd)
+{
+    lsquic_send_ctl_cleanup(&snd->send_ctl);
+    lsquic_malo_destroy(snd->conn_pub.packet_out_malo);
+    lsquic_mm_cleanup(&snd->eng_pub.enp_mm);
+}
+
+
+/* "Send" scheduled packets and acknowledge them right away */
+static void
+sender_send_and_ack (struct sender *snd, lsquic_time_t now)
+{
+    struct lsquic_send_ctl *const ctl = &snd->send_ctl;
+    struct lsquic_packet_out *packet_out;
+    lsquic_packno_t first = 0, last = 0;
+    int s;
+
+    while ((packet_out = lsquic_send_ctl_next_packet_to_send(ctl)))
+    {
+        if (!first)
+            first = packet_out->po_packno;
+        last = packet_out->po_packno;
+        packet_out->po_sent = now;
+        (void) lsquic_send_ctl_sent_packet(ctl, packet_out, 1);
+    }
+
+    if (first)
+    {
+        snd->acki.n_ranges = 1;
+        snd->acki.ranges[0].low = 1;
+        snd->acki.ranges[0].high = last;
+        snd->acki.lack_delta = 0;
+        s = lsquic_send_ctl_got_ack(ctl, &snd->acki, now);
+        assert(0 == s);
+    }
+}
+
+
+static size_t
+read_reader_size (void *ctx)
+{
+    struct read_reader_ctx *const rr = ctx;
+    return rr->size;
+}
+
+
+static size_t
+read_reader_read (void *ctx, void *buf, size_t count)
+{
+    struct read_reader_ctx *const rr = ctx;
+    ssize_t nread;
+
+    if (count > rr->size)
+        count = rr->size;
+    nread = read(rr->fd, buf, count);
+    if (nread < 0)
+    {
+        perror("read");
+        exit(1);
+    }
+    rr->size -= nread;
+    return nread;
+}
+
+
+/* Returns upload throughput in megabytes per second */
+static double
+run (int fd, uint64_t size, const char *mode)
+{
+    struct sender snd;
+    struct read_reader_ctx rr;
+    struct lsquic_reader read_reader, *reader;
+    struct lsquic_stream *stream;
+    lsquic_time_t start, now;
+    ssize_t nw;
+    uint64_t total;
+    int s;
+
+    sender_init(&snd);
+    stream = lsquic_stream_new_ext(5, &snd.conn_pub, &stream_if, NULL,
+                                                        WINDOW, WINDOW, 0);
+    assert(stream);
+
+    if (0 == strcmp(mode, "read"))
+    {
+        (void) lseek(fd, 0, SEEK_SET);
+        rr.fd = fd;
+        rr.size = size;
+        read_reader.lsqr_read = read_reader_read;
+        read_reader.lsqr_size = read_reader_size;
+        read_reader.lsqr_ctx  = &rr;
+        reader = &read_reader;
+    }
+    else
+    {
+        reader = lsquic_file_reader_new(fd, 0, size,
+                        0 == strcmp(mode, "pread") ? LSQUIC_FR_PREAD : 0);
+        assert(reader);
+    }
+
+    start = lsquic_time_now();
+    total = 0;
+    while (total < size)
+    {
+        nw = lsquic_stream_writef(stream, reader);
+        assert(nw >= 0);
+        total += nw;
+        now = lsquic_time_now();
+        sender_send_and_ack(&snd, now);
+        lsquic_stream_window_update(stream, total + WINDOW);
+        snd.conn_pub.conn_cap.cc_max = snd.conn_pub.conn_cap.cc_sent + WINDOW;
+    }
+    s = lsquic_stream_flush(stream);
+    assert(0 == s);
+    sender_send_and_ack(&snd, lsquic_time_now());
+    now = lsquic_time_now();
+    assert(stream->tosend_off == size);
+
+    if (reader != &read_reader)
+        lsquic_file_reader_destroy(reader);
+    lsquic_stream_destroy(stream);
+    sender_cleanup(&snd);
+
+    return (double) size / (now - start);
+}
+
+
+/* Create file of given size filled with garbage */
+static int
+create_file (const char *filename, uint64_t size)
+{
+    unsigned char buf[0x10000];
+    uint64_t off;
+    size_t n;
+    int fd;
+
+    fd = open(filename, O_RDWR|O_CREAT|O_TRUNC, 0600);
+    if (fd < 0)
+    {
+        perror("open");
+        exit(1);
+    }
+    for (n = 0; n < sizeof(buf); ++n)
+        buf[n] = n * 7;
+    for (off = 0; off < size; off += n)
+    {
+        n = size - off < sizeof(buf) ? size - off : sizeof(buf);
+        if ((ssize_t) n != write(fd, buf, n))
+        {
+            perror("write");
+            exit(1);
+        }
+    }
+
+    return fd;
+}
+
+
+/* Bring the file into the page cache */
+static void
+warm_up (int fd, uint64_t size)
+{
+    unsigned char buf[0x10000];
+    uint64_t off;
+    ssize_t nread;
+
+    for (off = 0; off < size; off += nread)
+    {
+        nread = pread(fd, buf, sizeof(buf), (off_t) off);
+        if (nread <= 0)
+        {
+            fprintf(stderr, "cannot read file\n");
+            exit(1);
+        }
+    }
+}
+
+
+int
+main (int argc, char **argv)
+{
+    static const char *const default_modes[] = { "read", "pread", "mmap", };
+    const char *modes[3], *filename = NULL;
+    uint64_t size = 1024 * 1024 * 1024;
+    unsigned n, count = 0, n_runs = 1, run_no;
+    struct stat st;
+    int opt, fd, remove_file = 1;
+    double speed;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    while (-1 != (opt = getopt(argc, argv, "f:m:n:s:l:")))
+    {
+        switch (opt)
+        {
+        case 'f':
+            filename = optarg;
+            remove_file = 0;
+            break;
+        case 'm':
+            if (count < sizeof(modes) / sizeof(modes[0]))
+                modes[count++] = optarg;
+            break;
+        case 'n':
+            n_runs = atoi(optarg);
+            break;
+        case 's':
+            size = strtoull(optarg, NULL, 10) * 1024 * 1024;
+            break;
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            fprintf(stderr,
+"Usage: %s [options]\n"
+"\n"
+"   -f FILE     Upload this file.  If not specified, a temporary file\n"
+"                 is created.\n"
+"   -s MB       Size of temporary file in megabytes.  Defaults to 1024.\n"
+"   -m MODE     Reader: read, pread, or mmap.  May be specified up to\n"
+"                 three times.  Defaults to all three.\n"
+"   -n RUNS     Number of runs for each reader.  Defaults to 1.\n"
+"   -l LEVELS   Log levels.\n"
+            , argv[0]);
+            exit(1);
+        }
+    }
+
+    if (0 == count)
+    {
+        memcpy(modes, default_modes, sizeof(default_modes));
+        count = sizeof(default_modes) / sizeof(default_modes[0]);
+    }
+
+    if (filename)
+    {
+        fd = open(filename, O_RDONLY);
+        if (fd < 0 || 0 != fstat(fd, &st))
+        {
+            perror(filename);
+            exit(1);
+        }
+        size = st.st_size;
+    }
+    else
+    {
+        filename = "/tmp/bench_file_reader.tmp";
+        fd = create_file(filename, size);
+    }
+    warm_up(fd, size);
+
+    for (n = 0; n < count; ++n)
+        for (run_no = 0; run_no < n_runs; ++run_no)
+        {
+            speed = run(fd, size, modes[n]);
+            printf("%-5s: uploaded %"PRIu64" MB at %7.1f MB/s\n", modes[n],
+                                            size / 1024 / 1024, speed);
+        }
+
+    (void) close(fd);
+    if (remove_file)
+        (void) unlink(filename);
+    return 0;
+}
@@ -0,0 +1,140 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * This is not a test: this program measures how long it takes to record
+ * received packets and to generate ACK frames when packets are reordered
+ * and lost.
+ *
+ * Packets arrive in blocks of -w packets; each block arrives in reverse
+ * order.  Every Nth packet (-d) never arrives.  An ACK frame is generated
+ * after every -k packets.  With -s, the peer's STOP_WAITING keeps the
+ * history to the last N packets; by default, the history is not cut.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "lsquic.h"
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_rechist.h"
+#include "lsquic_parse.h"
+#include "lsquic_util.h"
+#include "lsquic_logger.h"
+
+
+int
+main (int argc, char **argv)
+{
+    const struct parse_funcs *const pf = select_pf_by_ver(LSQVER_039);
+    struct lsquic_rechist rechist;
+    lsquic_packno_t block, packno, largest, ack2ed;
+    lsquic_time_t start, recv_time, gen_time;
+    unsigned n_packets = 1000000, window = 10, drop_every = 10, per_ack = 2,
+             stop_wait = 0, n_recv, n_acks, n;
+    int opt, has_missing, w;
+    unsigned char buf[1370];
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    while (-1 != (opt = getopt(argc, argv, "n:w:d:k:s:l:")))
+    {
+        switch (opt)
+        {
+        case 'n':
+            n_packets = atoi(optarg);
+            break;
+        case 'w':
+            window = atoi(optarg);
+            if (window < 1)
+                window = 1;
+            break;
+        case 'd':
+            drop_every = atoi(optarg);
+            if (drop_every == 1)
+                drop_every = 2;
+            break;
+        case 'k':
+            per_ack = atoi(optarg);
+            if (per_ack < 1)
+                per_ack = 1;
+            break;
+        case 's':
+            stop_wait = atoi(optarg);
+            break;
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            fprintf(stderr,
+"Usage: %s [options]\n"
+"\n"
+"   -n N        Number of packets sent by peer.  Defaults to 1000000.\n"
+"   -w N        Reordering window.  Defaults to 10.\n"
+"   -d N        Drop every Nth packet; zero means no drops.  Defaults to 10.\n"
+"   -k N        Generate ACK after every N packets.  Defaults to 2.\n"
+"   -s N        Cut history to last N packets.  By default, it is not cut.\n"
+"   -l LEVELS   Log levels.\n"
+            , argv[0]);
+            exit(1);
+        }
+    }
+
+    lsquic_rechist_init(&rechist, 0);
+
+    recv_time = 0;
+    gen_time = 0;
+    n_recv = 0;
+    n_acks = 0;
+    largest = 0;
+    for (block = 1; block <= n_packets; block += window)
+    {
+        for (n = window; n > 0; --n)
+        {
+            packno = block + n - 1;
+            if (packno > n_packets
+                        || (drop_every && packno % drop_every == 0))
+                continue;
+            start = lsquic_time_now();
+            (void) lsquic_rechist_received(&rechist, packno, start);
+            recv_time += lsquic_time_now() - start;
+            if (packno > largest)
+                largest = packno;
+            if (++n_recv % per_ack)
+                continue;
+            start = lsquic_time_now();
+            w = pf->pf_gen_ack_frame(buf, sizeof(buf),
+                    (gaf_rechist_first_f)        lsquic_rechist_first,
+                    (gaf_rechist_next_f)         lsquic_rechist_next,
+                    (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
+                    &rechist, start, &has_missing, &ack2ed, NULL);
+            gen_time += lsquic_time_now() - start;
+            if (w < 0)
+            {
+                fprintf(stderr, "cannot generate ACK frame\n");
+                exit(1);
+            }
+            ++n_acks;
+            if (stop_wait && largest > stop_wait
+                        && largest - stop_wait > lsquic_rechist_cutoff(&rechist))
+                lsquic_rechist_stop_wait(&rechist, largest - stop_wait);
+        }
+    }
+
+    printf("%u packets received: %"PRIu64" usec, %.1f nsec per packet; "
+        "%u ACKs: %"PRIu64" usec, %.1f nsec per ACK; memory: %zu bytes\n",
+        n_recv, recv_time, (double) recv_time * 1000 / n_recv,
+        n_acks, gen_time, n_acks ? (double) gen_time * 1000 / n_acks : 0.,
+        lsquic_rechist_mem_used(&rechist));
+
+    lsquic_rechist_cleanup(&rechist);
+
+    return 0;
+}
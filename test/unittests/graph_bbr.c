@@ -0,0 +1,169 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * This is not really a test: this program runs BBR over a simulated
+ * bottleneck link and prints out cwnd histogram for visual inspection.
+ *
+ * Each line shows BBR mode -- Startup, Drain, probe Bandwidth, or probe
+ * RTT -- followed by cwnd, bandwidth estimate, and pacing rate.  With -c,
+ * comma-separated values are printed instead, suitable for gnuplot.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "link_sim.h"
+
+
+#define MS(n) ((n) * 1000)  /* MS: Milliseconds */
+
+static const char modes[] = {
+    [BBR_MODE_STARTUP]      = 'S',
+    [BBR_MODE_DRAIN]        = 'D',
+    [BBR_MODE_PROBE_BW]     = 'B',
+    [BBR_MODE_PROBE_RTT]    = 'R',
+};
+
+
+struct rec
+{
+    char            mode;
+    unsigned long   cwnd;
+    uint64_t        bw;
+    uint64_t        pacing_rate;
+};
+
+
+int
+main (int argc, char **argv)
+{
+    int i, n, opt, csv = 0;
+    unsigned unit = 100;        /* Default to 100 ms */
+    unsigned duration = 10;     /* Default to 10 seconds */
+    unsigned mbps = 10, rtt_ms = 40, buf_bdps = 1, loss_pct = 0;
+    uint64_t seed = 1;
+    struct sim sim;
+    struct lsquic_bbr *const bbr = &sim.cong_u.bbr;
+    struct rec *recs;
+    unsigned long max_cwnd, width;
+    char *line;
+#ifndef WIN32
+    struct winsize winsize;
+#endif
+
+    while (-1 != (opt = getopt(argc, argv, "b:r:q:l:d:u:s:c")))
+    {
+        switch (opt)
+        {
+        case 'b':
+            mbps = atoi(optarg);
+            break;
+        case 'r':
+            rtt_ms = atoi(optarg);
+            break;
+        case 'q':
+            buf_bdps = atoi(optarg);
+            break;
+        case 'l':
+            loss_pct = atoi(optarg);
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'u':
+            unit = atoi(optarg);
+            break;
+        case 's':
+            seed = atoi(optarg);
+            break;
+        case 'c':
+            csv = 1;
+            break;
+        default:
+            fprintf(stderr,
+"Usage: %s [options]\n"
+"\n"
+"   -b MBPS     Bottleneck bandwidth in megabits per second.  Defaults to 10.\n"
+"   -r MS       Round-trip propagation delay.  Defaults to 40 ms.\n"
+"   -q BDPS     Bottleneck buffer size in BDPs.  Defaults to 1.\n"
+"   -l PCT      Random loss percentage.  Defaults to 0.\n"
+"   -d SEC      Duration.  Defaults to 10 seconds.\n"
+"   -u MS       Sampling interval.  Defaults to 100 ms.\n"
+"   -s SEED     Random seed.\n"
+"   -c          Print comma-separated values.\n"
+            , argv[0]);
+            exit(1);
+        }
+    }
+
+    sim_init(&sim, &lsquic_cong_bbr_if, mbps, rtt_ms, buf_bdps, loss_pct);
+    sim.seed = seed;
+
+    n = duration * 1000 / unit;
+    recs = malloc(n * sizeof(recs[0]));
+    max_cwnd = 0;
+    for (i = 0; i < n; ++i)
+    {
+        const lsquic_time_t end = sim.now + MS(unit);
+        while (sim.now < end)
+            sim_step(&sim);
+        recs[i].mode = modes[bbr->bbr_mode];
+        recs[i].cwnd = lsquic_bbr_get_cwnd(bbr);
+        recs[i].bw = lsquic_bbr_get_bw(bbr);
+        recs[i].pacing_rate = lsquic_cong_bbr_if.cci_pacing_rate(bbr, 0);
+        if (max_cwnd < recs[i].cwnd)
+            max_cwnd = recs[i].cwnd;
+    }
+
+    if (csv)
+    {
+        printf("ms,mode,cwnd,bw,pacing_rate\n");
+        for (i = 0; i < n; ++i)
+            printf("%u,%c,%lu,%"PRIu64",%"PRIu64"\n", (i + 1) * unit,
+                recs[i].mode, recs[i].cwnd, recs[i].bw, recs[i].pacing_rate);
+        goto end;
+    }
+
+#ifndef WIN32
+    if (isatty(STDIN_FILENO))
+    {
+        if (0 == ioctl(STDIN_FILENO, TIOCGWINSZ, &winsize))
+            width = winsize.ws_col;
+        else
+        {
+            perror("ioctl");
+            width = 80;
+        }
+    }
+    else
+#endif
+        width = 80;
+
+    width -= 1 /* mode */ + 1 /* space */ + 8 /* cwnd */ + 1 /* space */
+           + 9 /* bw */ + 1 /* space */ + 9 /* pacing rate */ + 1 /* space */
+           + 1 /* newline */;
+    line = malloc(width);
+    memset(line, '+', width);
+
+    for (i = 0; i < n; ++i)
+        printf("%c %8lu %9"PRIu64" %9"PRIu64" %.*s\n", recs[i].mode,
+            recs[i].cwnd, recs[i].bw, recs[i].pacing_rate,
+            (int) ((float) recs[i].cwnd / max_cwnd * width), line);
+
+    free(line);
+
+  end:
+    sim_cleanup(&sim);
+    free(recs);
+
+    return 0;
+}
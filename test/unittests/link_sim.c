@@ -0,0 +1,183 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * link_sim.c -- Simulated bottleneck link for congestion control tests.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "link_sim.h"
+
+
+lsquic_time_t
+sim_link_send (struct sim_link *link, unsigned sz, lsquic_time_t now)
+{
+    unsigned long queued;
+
+    if (link->free_at > now)
+        queued = (link->free_at - now) * link->rate / 1000000;
+    else
+    {
+        queued = 0;
+        link->free_at = now;
+    }
+
+    if (queued + sz > link->buf_max)
+    {
+        ++link->n_dropped;
+        return 0;
+    }
+
+    link->free_at += (lsquic_time_t) sz * 1000000 / link->rate;
+    return link->free_at;
+}
+
+
+void
+sim_init (struct sim *sim, const struct cong_ctl_if *cci, unsigned mbps,
+                    unsigned rtt_ms, unsigned buf_bdps, unsigned loss_pct)
+{
+    memset(sim, 0, sizeof(*sim));
+    TAILQ_INIT(&sim->packets);
+    sim->cci = cci;
+    sim->link.rate = (uint64_t) mbps * 1000000 / 8;
+    sim->rtt = rtt_ms * 1000;
+    sim->link.buf_max = sim->link.rate * sim->rtt / 1000000 * buf_bdps;
+    sim->loss_pct = loss_pct;
+    sim->now = 1000000;
+    sim->seed = 1;
+    cci->cci_init(&sim->cong_u, 0, &sim->rtt_stats);
+}
+
+
+void
+sim_cleanup (struct sim *sim)
+{
+    struct sim_packet *packet;
+
+    while ((packet = TAILQ_FIRST(&sim->packets)))
+    {
+        TAILQ_REMOVE(&sim->packets, packet, sp_next);
+        if (sim->cci->cci_lost)
+            sim->cci->cci_lost(&sim->cong_u, &packet->sp_po, SIM_PACKET_SZ);
+        free(packet);
+    }
+    if (sim->cci->cci_cleanup)
+        sim->cci->cci_cleanup(&sim->cong_u);
+}
+
+
+static unsigned
+sim_rand (struct sim *sim)
+{
+    sim->seed = sim->seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return sim->seed >> 33;
+}
+
+
+static void
+sim_send (struct sim *sim)
+{
+    struct sim_packet *packet;
+    lsquic_time_t departure;
+
+    packet = calloc(1, sizeof(*packet));
+    assert(packet);
+    packet->sp_po.po_packno = ++sim->packno;
+    packet->sp_po.po_sent = sim->now;
+    packet->sp_po.po_sent_sz = SIM_PACKET_SZ;
+    packet->sp_po.po_flags = PO_SENT_SZ;
+
+    departure = sim_link_send(&sim->link, SIM_PACKET_SZ, sim->now);
+    if (departure && sim->loss_pct && sim_rand(sim) % 100 < sim->loss_pct)
+    {
+        ++sim->link.n_dropped;
+        departure = 0;
+    }
+
+    if (departure)
+        packet->sp_ack_time = departure + sim->rtt;
+    else
+    {
+        packet->sp_dropped = 1;
+        packet->sp_ack_time = sim->now + sim->rtt;
+    }
+
+    TAILQ_INSERT_TAIL(&sim->packets, packet, sp_next);
+    sim->in_flight += SIM_PACKET_SZ;
+    if (sim->cci->cci_sent)
+        sim->cci->cci_sent(&sim->cong_u, &packet->sp_po, sim->in_flight, 0);
+}
+
+
+void
+sim_step (struct sim *sim)
+{
+    const struct cong_ctl_if *const cci = sim->cci;
+    struct sim_packet *packet;
+    lsquic_packno_t largest_lost;
+    lsquic_time_t largest_sent;
+    uint64_t pacing_rate;
+    int begun, acked;
+
+    sim->now += SIM_STEP;
+
+    begun = 0;
+    acked = 0;
+    largest_lost = 0;
+    largest_sent = 0;
+    /* As with real ACKs, a dropped packet is only detected once the
+     * packets sent before it have been acknowledged.
+     */
+    while ((packet = TAILQ_FIRST(&sim->packets))
+                                    && packet->sp_ack_time <= sim->now)
+    {
+        if (!begun)
+        {
+            if (cci->cci_begin_ack)
+                cci->cci_begin_ack(&sim->cong_u, sim->now, sim->in_flight);
+            begun = 1;
+        }
+        TAILQ_REMOVE(&sim->packets, packet, sp_next);
+        sim->in_flight -= SIM_PACKET_SZ;
+        if (packet->sp_dropped)
+        {
+            if (cci->cci_lost)
+                cci->cci_lost(&sim->cong_u, &packet->sp_po, SIM_PACKET_SZ);
+            largest_lost = packet->sp_po.po_packno;
+        }
+        else
+        {
+            cci->cci_ack(&sim->cong_u, &packet->sp_po, SIM_PACKET_SZ,
+                                                                sim->now, 0);
+            sim->delivered += SIM_PACKET_SZ;
+            largest_sent = packet->sp_po.po_sent;
+            acked = 1;
+        }
+        free(packet);
+    }
+    if (acked)
+    {
+        lsquic_rtt_stats_update(&sim->rtt_stats, sim->now - largest_sent, 0);
+        if (cci->cci_rtt_sample)
+            cci->cci_rtt_sample(&sim->cong_u, sim->now - largest_sent);
+    }
+    if (largest_lost > sim->cutback_packno)
+    {
+        cci->cci_loss(&sim->cong_u);
+        sim->cutback_packno = sim->packno;
+    }
+    if (begun && cci->cci_end_ack)
+        cci->cci_end_ack(&sim->cong_u, sim->in_flight);
+
+    if (sim->next_send + SIM_STEP < sim->now)
+        sim->next_send = sim->now;
+    while (sim->next_send <= sim->now && sim->in_flight + SIM_PACKET_SZ
+                                        <= cci->cci_get_cwnd(&sim->cong_u))
+    {
+        sim_send(sim);
+        pacing_rate = cci->cci_pacing_rate(&sim->cong_u, 0);
+        sim->next_send += SIM_PACKET_SZ * 1000000 / pacing_rate;
+    }
+}
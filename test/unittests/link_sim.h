@@ -0,0 +1,90 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * link_sim.h -- Simulated bottleneck link for congestion control tests.
+ *
+ * Packets are serialized at the link rate and wait in a drop-tail buffer
+ * if the link is busy.  struct sim runs a congestion controller over such
+ * a link: packets are paced, and each is acknowledged -- or declared lost
+ * if it was dropped -- one propagation RTT after it leaves the link.  One
+ * ACK is processed every SIM_STEP microseconds, covering everything that
+ * arrived in that time.
+ */
+
+#ifndef LINK_SIM_H
+#define LINK_SIM_H 1
+
+#include <stdint.h>
+#include <sys/queue.h>
+
+#include "lsquic_int_types.h"
+#include "lsquic_types.h"
+#include "lsquic_cong_ctl.h"
+#include "lsquic_cubic.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_rtt.h"
+
+#define SIM_PACKET_SZ   1370
+#define SIM_STEP        100     /* Microseconds */
+
+struct sim_link
+{
+    uint64_t                    rate;           /* Bytes per second */
+    unsigned long               buf_max;        /* Bytes */
+    lsquic_time_t               free_at;        /* Link is busy until then */
+    unsigned                    n_dropped;
+};
+
+/* Put packet of `sz' bytes onto the link.  Returns the time the packet
+ * leaves the link or zero if it is dropped.
+ */
+lsquic_time_t
+sim_link_send (struct sim_link *, unsigned sz, lsquic_time_t now);
+
+struct sim_packet
+{
+    struct lsquic_packet_out    sp_po;
+    TAILQ_ENTRY(sim_packet)     sp_next;
+    lsquic_time_t               sp_ack_time;    /* Or loss detection time */
+    int                         sp_dropped;
+};
+
+struct sim
+{
+    const struct cong_ctl_if   *cci;
+    union {
+        struct lsquic_cubic     cubic;
+        struct lsquic_bbr       bbr;
+    }                           cong_u;
+    struct lsquic_rtt_stats     rtt_stats;
+    struct sim_link             link;
+    TAILQ_HEAD(, sim_packet)    packets;
+    lsquic_time_t               rtt;            /* Propagation delay */
+    unsigned                    loss_pct;       /* Random loss */
+    lsquic_time_t               now,
+                                next_send;
+    unsigned long               in_flight;
+    lsquic_packno_t             packno,
+                                cutback_packno;
+    uint64_t                    delivered;
+    uint64_t                    seed;
+};
+
+/* The bottleneck buffer holds `buf_bdps' bandwidth-delay products */
+void
+sim_init (struct sim *, const struct cong_ctl_if *, unsigned mbps,
+                    unsigned rtt_ms, unsigned buf_bdps, unsigned loss_pct);
+
+void
+sim_cleanup (struct sim *);
+
+/* Advance time by SIM_STEP: process ACKs and losses, then send as many
+ * packets as cwnd and pacing allow.
+ */
+void
+sim_step (struct sim *);
+
+#endif
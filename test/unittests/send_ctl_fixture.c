@@ -0,0 +1,81 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * send_ctl_fixture.c -- Send controller test fixture.
+ */
+
+#include <assert.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "send_ctl_fixture.h"
+
+
+void
+init_test_objs (struct test_objs *tobjs)
+{
+    memset(tobjs, 0, sizeof(*tobjs));
+    tobjs->lconn.cn_pf = select_pf_by_ver(LSQVER_037);
+    tobjs->lconn.cn_pack_size = 1370;
+    tobjs->lconn.cn_flags = LSCONN_HANDSHAKE_DONE;
+    lsquic_mm_init(&tobjs->eng_pub.enp_mm);
+    lsquic_alarmset_init(&tobjs->alset, 0);
+    tobjs->conn_pub.mm = &tobjs->eng_pub.enp_mm;
+    tobjs->conn_pub.lconn = &tobjs->lconn;
+    tobjs->conn_pub.enpub = &tobjs->eng_pub;
+    tobjs->conn_pub.send_ctl = &tobjs->send_ctl;
+    tobjs->conn_pub.packet_out_malo =
+                        lsquic_malo_create(sizeof(struct lsquic_packet_out));
+    lsquic_send_ctl_init(&tobjs->send_ctl, &tobjs->alset, &tobjs->eng_pub,
+        &tobjs->ver_neg, &tobjs->conn_pub, tobjs->lconn.cn_pack_size);
+    tobjs->now = lsquic_time_now();
+}
+
+
+void
+deinit_test_objs (struct test_objs *tobjs)
+{
+    lsquic_send_ctl_cleanup(&tobjs->send_ctl);
+    lsquic_malo_destroy(tobjs->conn_pub.packet_out_malo);
+    lsquic_mm_cleanup(&tobjs->eng_pub.enp_mm);
+}
+
+
+void
+send_packets (struct test_objs *tobjs, unsigned count)
+{
+    struct lsquic_packet_out *packet_out;
+
+    while (count-- > 0)
+    {
+        packet_out = lsquic_send_ctl_new_packet_out(&tobjs->send_ctl, 0);
+        assert(packet_out);
+        packet_out->po_frame_types |= 1 << QUIC_FRAME_WINDOW_UPDATE;
+        packet_out->po_data_sz = 100;
+        lsquic_send_ctl_scheduled_one(&tobjs->send_ctl, packet_out);
+        packet_out = lsquic_send_ctl_next_packet_to_send(&tobjs->send_ctl);
+        assert(packet_out);
+        packet_out->po_sent = tobjs->now;
+        lsquic_send_ctl_sent_packet(&tobjs->send_ctl, packet_out, 1);
+    }
+}
+
+
+void
+ack (struct test_objs *tobjs, ...)
+{
+    struct ack_info acki;
+    va_list ap;
+    int s;
+
+    memset(&acki, 0, sizeof(acki));
+    va_start(ap, tobjs);
+    while ((acki.ranges[acki.n_ranges].high = va_arg(ap, lsquic_packno_t)))
+    {
+        acki.ranges[acki.n_ranges].low = va_arg(ap, lsquic_packno_t);
+        ++acki.n_ranges;
+    }
+    va_end(ap);
+
+    s = lsquic_send_ctl_got_ack(&tobjs->send_ctl, &acki, tobjs->now);
+    assert(0 == s);
+}
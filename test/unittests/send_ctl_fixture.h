@@ -0,0 +1,74 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * send_ctl_fixture.h -- Send controller with just enough of a connection
+ * around it to send packets and process ACKs.  Used by send controller
+ * unit tests.
+ */
+
+#ifndef SEND_CTL_FIXTURE_H
+#define SEND_CTL_FIXTURE_H 1
+
+#include <sys/queue.h>
+
+#include "lsquic.h"
+
+#include "lsquic_alarmset.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_rtt.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_stream.h"
+#include "lsquic_types.h"
+#include "lsquic_malo.h"
+#include "lsquic_mm.h"
+#include "lsquic_conn_public.h"
+#include "lsquic_logger.h"
+#include "lsquic_parse.h"
+#include "lsquic_conn.h"
+#include "lsquic_engine_public.h"
+#include "lsquic_cubic.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_prr.h"
+#include "lsquic_pacer.h"
+#include "lsquic_senhist.h"
+#include "lsquic_sentwin.h"
+#include "lsquic_send_ctl.h"
+#include "lsquic_ver_neg.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_util.h"
+
+struct test_objs {
+    struct lsquic_engine_public eng_pub;
+    struct lsquic_conn        lconn;
+    struct lsquic_conn_public conn_pub;
+    struct lsquic_send_ctl    send_ctl;
+    struct lsquic_alarmset    alset;
+    struct ver_neg            ver_neg;
+    lsquic_time_t             now;
+};
+
+void
+init_test_objs (struct test_objs *);
+
+void
+deinit_test_objs (struct test_objs *);
+
+/* Send `count' retransmittable packets at current time */
+void
+send_packets (struct test_objs *, unsigned count);
+
+/* Process ACK at current time.  Ranges are given from largest to smallest
+ * and are terminated by zero: use the ACK() macro.
+ */
+void
+ack (struct test_objs *, ...);
+
+#define ACK(tobjs, ...) ack(tobjs, __VA_ARGS__, (lsquic_packno_t) 0)
+#define P(n) ((lsquic_packno_t) (n))
+
+#define CWND(tobjs) lsquic_cubic_get_cwnd(&(tobjs)->send_ctl.sc_cong_u.cubic)
+
+#endif
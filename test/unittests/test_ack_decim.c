@@ -0,0 +1,42 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_ack_decim.h"
+
+
+int
+main (void)
+{
+    struct ack_decim ad;
+
+    /* Off: */
+    lsquic_ack_decim_init(&ad, 0, 100);
+    assert(ADV_OFF == lsquic_ack_decim_check(&ad, 1000, 1, 0));
+    assert(ADV_OFF == lsquic_ack_decim_check(&ad, 1000, 100, 1));
+
+    lsquic_ack_decim_init(&ad, 10, 100);
+
+    /* Not enough packets received yet: */
+    assert(ADV_OFF == lsquic_ack_decim_check(&ad, 1, 1, 0));
+    assert(ADV_OFF == lsquic_ack_decim_check(&ad, 99, 5, 0));
+
+    assert(ADV_WAIT == lsquic_ack_decim_check(&ad, 100, 1, 0));
+    assert(ADV_WAIT == lsquic_ack_decim_check(&ad, 200, 9, 0));
+    assert(ADV_ACK_NOW == lsquic_ack_decim_check(&ad, 200, 10, 0));
+    assert(ADV_ACK_NOW == lsquic_ack_decim_check(&ad, 200, 11, 0));
+    assert(ADV_ACK_NOW == lsquic_ack_decim_check(&ad, 200, 1, 1));
+    /* Nothing to acknowledge: */
+    assert(ADV_WAIT == lsquic_ack_decim_check(&ad, 200, 0, 1));
+
+    /* Delay is a quarter of min_rtt, capped by max_delay: */
+    assert(10000 == lsquic_ack_decim_delay(40000, 25000));
+    assert(25000 == lsquic_ack_decim_delay(200000, 25000));
+    assert(25000 == lsquic_ack_decim_delay(0, 25000));
+
+    return 0;
+}
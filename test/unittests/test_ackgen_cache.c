@@ -0,0 +1,170 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test that ACK frames generated using the ACK block cache are the same
+ * as those generated without it.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_rechist.h"
+#include "lsquic_parse.h"
+#include "lsquic_util.h"
+#include "lsquic_logger.h"
+#include "lsquic.h"
+
+
+static int
+gen_ack (const struct parse_funcs *pf, struct lsquic_rechist *rechist,
+            unsigned char *buf, size_t bufsz, lsquic_time_t now,
+            int *has_missing, struct ack_gen_cache *cache)
+{
+    lsquic_packno_t largest;
+
+    if (cache)
+        cache->agc_version = lsquic_rechist_version(rechist);
+    return pf->pf_gen_ack_frame(buf, bufsz,
+        (gaf_rechist_first_f)        lsquic_rechist_first,
+        (gaf_rechist_next_f)         lsquic_rechist_next,
+        (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
+        rechist, now, has_missing, &largest, cache);
+}
+
+
+/* Packets mostly arrive in order; some are lost, some are late.  After
+ * each packet, the ACK frame is generated with and without the cache.
+ */
+static void
+test_random (enum lsquic_version version, size_t bufsz, unsigned seed)
+{
+    const struct parse_funcs *const pf = select_pf_by_ver(version);
+    struct lsquic_rechist rechist;
+    struct ack_gen_cache cache;
+    lsquic_time_t now;
+    lsquic_packno_t packno;
+    unsigned char buf[2][1500];
+    int has_missing[2], w[2];
+    unsigned n, n_hits;
+
+    assert(bufsz <= sizeof(buf[0]));
+    srand(seed);
+    lsquic_rechist_init(&rechist, 0);
+    memset(&cache, 0, sizeof(cache));
+    now = 1000000;
+    packno = 0;
+    n_hits = 0;
+
+    for (n = 0; n < 20000; ++n)
+    {
+        switch (rand() % 32)
+        {
+        case 0:     /* Lose a few packets */
+            packno += 1 + rand() % 3;
+            break;
+        case 1:     /* Lose many packets: gap does not fit into one byte */
+            packno += 300 + rand() % 300;
+            break;
+        case 2:     /* Late packet */
+            if (packno > 10)
+                (void) lsquic_rechist_received(&rechist,
+                                        packno - 1 - rand() % 10, now);
+            break;
+        case 3:     /* STOP_WAITING */
+            if (packno > 1000 + lsquic_rechist_cutoff(&rechist)
+                                                        && 0 == rand() % 4)
+                lsquic_rechist_stop_wait(&rechist, packno - 1000);
+            break;
+        }
+        (void) lsquic_rechist_received(&rechist, ++packno, now);
+        now += 10;
+        if (cache.agc_sz && cache.agc_cached_version
+                                    == lsquic_rechist_version(&rechist))
+            ++n_hits;
+        w[0] = gen_ack(pf, &rechist, buf[0], bufsz, now, &has_missing[0],
+                                                                    NULL);
+        w[1] = gen_ack(pf, &rechist, buf[1], bufsz, now, &has_missing[1],
+                                                                    &cache);
+        assert(w[0] > 0);
+        assert(w[0] == w[1]);
+        assert(0 == memcmp(buf[0], buf[1], w[0]));
+        assert(has_missing[0] == has_missing[1]);
+    }
+
+    assert(n_hits > 0);     /* Test the test */
+    lsquic_rechist_cleanup(&rechist);
+}
+
+
+/* Cache is used as long as only the first range grows */
+static void
+test_in_order (enum lsquic_version version)
+{
+    const struct parse_funcs *const pf = select_pf_by_ver(version);
+    struct lsquic_rechist rechist;
+    struct ack_gen_cache cache;
+    lsquic_packno_t packno;
+    unsigned char buf[2][1500];
+    int has_missing[2], w[2];
+    unsigned version_before;
+
+    lsquic_rechist_init(&rechist, 0);
+    memset(&cache, 0, sizeof(cache));
+
+    for (packno = 1; packno < 200; ++packno)
+        if (packno % 10)
+            (void) lsquic_rechist_received(&rechist, packno, 0);
+
+    w[1] = gen_ack(pf, &rechist, buf[1], sizeof(buf[1]), 0, &has_missing[1],
+                                                                    &cache);
+    assert(w[1] > 0);
+    assert(has_missing[1]);
+    assert(cache.agc_sz > 0);
+
+    version_before = lsquic_rechist_version(&rechist);
+    for ( ; packno < 500; ++packno)
+    {
+        (void) lsquic_rechist_received(&rechist, packno, 0);
+        assert(version_before == lsquic_rechist_version(&rechist));
+        cache.agc_version = lsquic_rechist_version(&rechist);
+        assert(cache.agc_cached_version == cache.agc_version);
+        w[0] = gen_ack(pf, &rechist, buf[0], sizeof(buf[0]), 0,
+                                                    &has_missing[0], NULL);
+        w[1] = gen_ack(pf, &rechist, buf[1], sizeof(buf[1]), 0,
+                                                    &has_missing[1], &cache);
+        assert(w[0] == w[1]);
+        assert(0 == memcmp(buf[0], buf[1], w[0]));
+    }
+
+    /* Block length grows from one to two bytes: blocks are encoded again */
+    assert(cache.agc_block_len == 2);
+
+    /* Late packet changes history below the first range */
+    (void) lsquic_rechist_received(&rechist, 10, 0);
+    assert(version_before != lsquic_rechist_version(&rechist));
+
+    lsquic_rechist_cleanup(&rechist);
+}
+
+
+int
+main (void)
+{
+    static const enum lsquic_version versions[] = {
+        LSQVER_035, LSQVER_039, LSQVER_041,
+    };
+    static const size_t bufszs[] = { 1500, 200, 30, };
+    unsigned i, j;
+
+    for (i = 0; i < sizeof(versions) / sizeof(versions[0]); ++i)
+    {
+        test_in_order(versions[i]);
+        for (j = 0; j < sizeof(bufszs) / sizeof(bufszs[0]); ++j)
+            test_random(versions[i], bufszs[j], i * 10 + j);
+    }
+
+    return 0;
+}
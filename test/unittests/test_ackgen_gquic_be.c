@@ -46,7 +46,7 @@ test1 (void) /* Inverse of quic_framer_test.cc -- NewAckFrameOneAckBlock */
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now + 0x7FF8000, &has_missing, &largest);
+        &rechist, now + 0x7FF8000, &has_missing, &largest, NULL);
     assert(("ACK frame generation successful", w > 0));
     assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
     assert(("ACK frame contents are as expected",
@@ -107,7 +107,7 @@ test2 (void) /* Inverse of quic_framer_test.cc -- NewAckFrameOneAckBlock, minus
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now, &has_missing, &largest);
+        &rechist, now, &has_missing, &largest, NULL);
     assert(("ACK frame generation successful", w > 0));
     assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
     assert(("ACK frame contents are as expected",
@@ -152,7 +152,7 @@ test3 (void)
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now, &has_missing, &largest);
+        &rechist, now, &has_missing, &largest, NULL);
     assert(("ACK frame generation successful", w > 0));
     assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
     assert(("ACK frame contents are as expected",
@@ -190,7 +190,7 @@ test4 (void)
             (gaf_rechist_first_f)        lsquic_rechist_first,
             (gaf_rechist_next_f)         lsquic_rechist_next,
             (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-            &rechist, now, &has_missing, &largest);
+            &rechist, now, &has_missing, &largest, NULL);
         assert(("ACK frame generation successful", w > 0));
         assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
         assert(("ACK frame contents are as expected",
@@ -220,7 +220,7 @@ test4 (void)
             (gaf_rechist_first_f)        lsquic_rechist_first,
             (gaf_rechist_next_f)         lsquic_rechist_next,
             (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-            &rechist, now, &has_missing, &largest);
+            &rechist, now, &has_missing, &largest, NULL);
         assert(("ACK frame generation successful", w > 0));
         assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
         assert(("ACK frame contents are as expected",
@@ -238,18 +238,16 @@ test_4byte_packnos (void)
 {
     lsquic_packno_t packno;
     lsquic_rechist_t rechist;
-    struct packet_interval *pint;
     lsquic_time_t now = lsquic_time_now();
 
     lsquic_rechist_init(&rechist, 0);
 
     packno = 0x23456789;
     (void) lsquic_rechist_received(&rechist, packno - 33, now);
-    pint = TAILQ_FIRST(&rechist.rh_pints.pk_intervals);
     (void) lsquic_rechist_received(&rechist, packno, now);
 
     /* Adjust: */
-    pint->range.low = 1;
+    rechist.rh_ranges[0].low = 1;
 
     const unsigned char expected_ack_frame[] = {
         0x60
@@ -272,7 +270,7 @@ test_4byte_packnos (void)
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now, &has_missing, &largest);
+        &rechist, now, &has_missing, &largest, NULL);
     assert(("ACK frame generation successful", w > 0));
     assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
     assert(("ACK frame contents are as expected",
@@ -289,18 +287,16 @@ test_6byte_packnos (void)
 {
     lsquic_packno_t packno;
     lsquic_rechist_t rechist;
-    struct packet_interval *pint;
     lsquic_time_t now = lsquic_time_now();
 
     lsquic_rechist_init(&rechist, 0);
 
     packno = 0xABCD23456789;
     (void) lsquic_rechist_received(&rechist, packno - 33, now);
-    pint = TAILQ_FIRST(&rechist.rh_pints.pk_intervals);
     (void) lsquic_rechist_received(&rechist, packno, now);
 
     /* Adjust: */
-    pint->range.low = 1;
+    rechist.rh_ranges[0].low = 1;
 
     const unsigned char expected_ack_frame[] = {
         0x60
@@ -323,7 +319,7 @@ test_6byte_packnos (void)
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now, &has_missing, &largest);
+        &rechist, now, &has_missing, &largest, NULL);
     assert(("ACK frame generation successful", w > 0));
     assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
     assert(("ACK frame contents are as expected",
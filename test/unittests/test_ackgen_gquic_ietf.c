@@ -47,7 +47,7 @@ test1 (void) /* Inverse of quic_framer_test.cc -- NewAckFrameOneAckBlock */
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now + 0x7FF8000, &has_missing, &largest);
+        &rechist, now + 0x7FF8000, &has_missing, &largest, NULL);
     assert(("ACK frame generation successful", w > 0));
     assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
     assert(("ACK frame contents are as expected",
@@ -109,7 +109,7 @@ test2 (void) /* Inverse of quic_framer_test.cc -- NewAckFrameOneAckBlock, minus
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now, &has_missing, &largest);
+        &rechist, now, &has_missing, &largest, NULL);
     assert(("ACK frame generation successful", w > 0));
     assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
     assert(("ACK frame contents are as expected",
@@ -155,7 +155,7 @@ test3 (void)
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now, &has_missing, &largest);
+        &rechist, now, &has_missing, &largest, NULL);
     assert(("ACK frame generation successful", w > 0));
     assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
     assert(("ACK frame contents are as expected",
@@ -194,7 +194,7 @@ test4 (void)
             (gaf_rechist_first_f)        lsquic_rechist_first,
             (gaf_rechist_next_f)         lsquic_rechist_next,
             (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-            &rechist, now, &has_missing, &largest);
+            &rechist, now, &has_missing, &largest, NULL);
         assert(("ACK frame generation successful", w > 0));
         assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
         assert(("ACK frame contents are as expected",
@@ -225,7 +225,7 @@ test4 (void)
             (gaf_rechist_first_f)        lsquic_rechist_first,
             (gaf_rechist_next_f)         lsquic_rechist_next,
             (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-            &rechist, now, &has_missing, &largest);
+            &rechist, now, &has_missing, &largest, NULL);
         assert(("ACK frame generation successful", w > 0));
         assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
         assert(("ACK frame contents are as expected",
@@ -243,18 +243,16 @@ test_4byte_packnos (void)
 {
     lsquic_packno_t packno;
     lsquic_rechist_t rechist;
-    struct packet_interval *pint;
     lsquic_time_t now = lsquic_time_now();
 
     lsquic_rechist_init(&rechist, 0);
 
     packno = 0x23456789;
     (void) lsquic_rechist_received(&rechist, packno - 33, now);
-    pint = TAILQ_FIRST(&rechist.rh_pints.pk_intervals);
     (void) lsquic_rechist_received(&rechist, packno, now);
 
     /* Adjust: */
-    pint->range.low = 1;
+    rechist.rh_ranges[0].low = 1;
 
     const unsigned char expected_ack_frame[] = {
      /* TYPE   N        LL       MM */
@@ -275,7 +273,7 @@ test_4byte_packnos (void)
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now, &has_missing, &largest);
+        &rechist, now, &has_missing, &largest, NULL);
     assert(("ACK frame generation successful", w > 0));
     assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
     assert(("ACK frame contents are as expected",
@@ -292,18 +290,16 @@ test_8byte_packnos (void)
 {
     lsquic_packno_t packno;
     lsquic_rechist_t rechist;
-    struct packet_interval *pint;
     lsquic_time_t now = lsquic_time_now();
 
     lsquic_rechist_init(&rechist, 0);
 
     packno = 0xABCD23456789;
     (void) lsquic_rechist_received(&rechist, packno - 33, now);
-    pint = TAILQ_FIRST(&rechist.rh_pints.pk_intervals);
     (void) lsquic_rechist_received(&rechist, packno, now);
 
     /* Adjust: */
-    pint->range.low = 1;
+    rechist.rh_ranges[0].low = 1;
 
     const unsigned char expected_ack_frame[] = {
      /* TYPE   N        LL       MM */
@@ -324,7 +320,7 @@ test_8byte_packnos (void)
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now, &has_missing, &largest);
+        &rechist, now, &has_missing, &largest, NULL);
     assert(("ACK frame generation successful", w > 0));
     assert(("ACK frame length is correct", w == sizeof(expected_ack_frame)));
     assert(("ACK frame contents are as expected",
@@ -358,7 +358,7 @@ test_max_ack (void)
         (gaf_rechist_first_f)        lsquic_rechist_first,
         (gaf_rechist_next_f)         lsquic_rechist_next,
         (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-        &rechist, now, &has_missing, &largest);
+        &rechist, now, &has_missing, &largest, NULL);
     assert(sz[0] > 0);
     assert(sz[0] <= (int) sizeof(buf));
     assert(has_missing);
@@ -412,7 +412,7 @@ test_ack_truncation (void)
             (gaf_rechist_first_f)        lsquic_rechist_first,
             (gaf_rechist_next_f)         lsquic_rechist_next,
             (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
-            &rechist, now, &has_missing, &largest);
+            &rechist, now, &has_missing, &largest, NULL);
         assert(sz[0] > 0);
         assert(sz[0] <= (int) bufsz);
         assert(has_missing);
@@ -205,6 +205,115 @@ test_attq_removal_3 (void)
 }
 
 
+/* Advisory times spread over many levels of the wheel.  Pop with
+ * increasing cutoff times and compare with a brute-force count.
+ */
+static void
+test_attq_random (void)
+{
+    struct attq *q;
+    struct lsquic_conn *conns, *conn;
+    lsquic_time_t *times, cutoff, prev;
+    const lsquic_time_t *t;
+    unsigned i, n_in, count, expected;
+    const unsigned n_conns = 2000;
+    int s;
+
+    srand(1);
+    q = attq_create();
+    conns = calloc(n_conns, sizeof(conns[0]));
+    times = calloc(n_conns, sizeof(times[0]));
+
+    for (i = 0; i < n_conns; ++i)
+    {
+        times[i] = 1000000 + ((lsquic_time_t) rand() << (i % 24));
+        s = attq_add(q, &conns[i], times[i]);
+        assert(s == 0);
+    }
+    n_in = n_conns;
+
+    /* Remove every tenth */
+    for (i = 0; i < n_conns; i += 10)
+    {
+        attq_remove(q, &conns[i]);
+        assert(!conns[i].cn_attq_elem);
+        --n_in;
+    }
+
+    prev = 0;
+    for (cutoff = 1000000; n_in > 0; cutoff += cutoff / 2)
+    {
+        expected = 0;
+        for (i = 0; i < n_conns; ++i)
+            expected += conns[i].cn_attq_elem && times[i] < cutoff;
+        count = attq_count_before(q, cutoff);
+        assert(count == expected);
+        while ((conn = attq_pop(q, cutoff)))
+        {
+            i = conn - conns;
+            assert(times[i] < cutoff);
+            assert(times[i] >= prev);
+            prev = times[i];
+            --n_in;
+            --count;
+        }
+        assert(0 == count);
+        assert(0 == attq_count_before(q, cutoff));
+        t = attq_next_time(q);
+        if (n_in)
+            assert(t && *t >= cutoff);
+        else
+            assert(!t);
+    }
+
+    free(times);
+    free(conns);
+    attq_destroy(q);
+}
+
+
+/* Elements added with advisory time earlier than that of the last popped
+ * element are due and come out first.
+ */
+static void
+test_attq_due (void)
+{
+    struct attq *q;
+    struct lsquic_conn *conns, *conn;
+    const lsquic_time_t *t;
+
+    q = attq_create();
+    conns = calloc(4, sizeof(conns[0]));
+
+    attq_add(q, &conns[0], 100000);
+    attq_add(q, &conns[1], 200000);
+    conn = attq_pop(q, 150000);
+    assert(conn == &conns[0]);
+    conn = attq_pop(q, 150000);
+    assert(!conn);
+
+    attq_add(q, &conns[2], 50000);
+    t = attq_next_time(q);
+    assert(t && *t == 50000);
+    attq_add(q, &conns[3], 120000);
+    assert(3 == attq_count_before(q, 1000000));
+    assert(1 == attq_count_before(q, 100000));
+    assert(2 == attq_count_before(q, 150000));
+
+    conn = attq_pop(q, 150000);
+    assert(conn == &conns[2]);
+    conn = attq_pop(q, 150000);
+    assert(conn == &conns[3]);
+    conn = attq_pop(q, 150000);
+    assert(!conn);
+    t = attq_next_time(q);
+    assert(t && *t == 200000);
+
+    free(conns);
+    attq_destroy(q);
+}
+
+
 int
 main (void)
 {
@@ -214,5 +323,7 @@ main (void)
     test_attq_removal_1();
     test_attq_removal_2();
     test_attq_removal_3();
+    test_attq_random();
+    test_attq_due();
     return 0;
 }
@@ -0,0 +1,188 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test BBR using a simulated bottleneck link: see link_sim.h.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lsquic.h"
+#include "lsquic_logger.h"
+#include "link_sim.h"
+
+
+static void
+test_minmax (void)
+{
+    struct minmax mm;
+
+    minmax_init(&mm, 10);
+    assert(0 == minmax_get(&mm));
+    minmax_upmax(&mm, 1, 100);
+    minmax_upmax(&mm, 2, 50);
+    minmax_upmax(&mm, 5, 70);
+    assert(100 == minmax_get(&mm));
+    /* The maximum falls out of the window; next best takes its place */
+    minmax_upmax(&mm, 12, 10);
+    assert(70 == minmax_get(&mm));
+    minmax_upmax(&mm, 13, 200);
+    assert(200 == minmax_get(&mm));
+    /* Nothing in the window: the new sample is the maximum */
+    minmax_upmax(&mm, 100, 1);
+    assert(1 == minmax_get(&mm));
+}
+
+
+/* On a clean path, BBR should find the bottleneck bandwidth and the
+ * propagation delay, leave Startup, and keep the queue short.  Once the
+ * minimum RTT has not been seen for ten seconds, BBR should go through
+ * ProbeRTT and come back.
+ */
+static void
+test_clean_path (void)
+{
+    struct sim sim;
+    struct lsquic_bbr *const bbr = &sim.cong_u.bbr;
+    uint64_t bdp, bw;
+    unsigned long max_in_flight;
+    int seen_probe_rtt;
+    lsquic_time_t start;
+
+    sim_init(&sim, &lsquic_cong_bbr_if, 10, 40, 4, 0);
+    bdp = sim.link.rate * sim.rtt / 1000000;
+    start = sim.now;
+
+    while (sim.now < start + 3000000)
+        sim_step(&sim);
+    assert(BBR_MODE_PROBE_BW == bbr->bbr_mode);
+    bw = lsquic_bbr_get_bw(bbr);
+    assert(bw >= sim.link.rate * 9 / 10 && bw <= sim.link.rate * 11 / 10);
+    assert(bbr->bbr_min_rtt >= sim.rtt);
+    assert(bbr->bbr_min_rtt <= sim.rtt + 5000);
+    assert(0 == sim.link.n_dropped);
+
+    max_in_flight = 0;
+    seen_probe_rtt = 0;
+    while (sim.now < start + 13000000)
+    {
+        sim_step(&sim);
+        seen_probe_rtt |= bbr->bbr_mode == BBR_MODE_PROBE_RTT;
+        if (bbr->bbr_mode == BBR_MODE_PROBE_BW
+                                            && sim.in_flight > max_in_flight)
+            max_in_flight = sim.in_flight;
+    }
+    assert(seen_probe_rtt);
+    assert(BBR_MODE_PROBE_BW == bbr->bbr_mode);
+    /* Gain of 2 plus slack for ACK aggregation */
+    assert(max_in_flight <= bdp * 2 + 4 * SIM_PACKET_SZ);
+
+    sim_cleanup(&sim);
+}
+
+
+/* Random loss does not make BBR back off */
+static void
+test_lossy_path (void)
+{
+    struct sim sim;
+    lsquic_time_t start;
+    uint64_t delivered;
+
+    sim_init(&sim, &lsquic_cong_bbr_if, 10, 100, 1, 1);
+    start = sim.now;
+    while (sim.now < start + 5000000)
+        sim_step(&sim);
+    delivered = sim.delivered;
+    while (sim.now < start + 15000000)
+        sim_step(&sim);
+    assert(sim.link.n_dropped > 0);
+    /* At least 80% of the link rate over the last ten seconds */
+    assert((sim.delivered - delivered) / 10 >= sim.link.rate * 8 / 10);
+
+    sim_cleanup(&sim);
+}
+
+
+/* Packet conservation on entering recovery and cwnd restoration upon
+ * exiting it.
+ */
+static void
+test_recovery (void)
+{
+    struct sim sim;
+    struct lsquic_bbr *const bbr = &sim.cong_u.bbr;
+    struct lsquic_packet_out po;
+    unsigned long cwnd;
+    lsquic_time_t start;
+
+    sim_init(&sim, &lsquic_cong_bbr_if, 10, 40, 4, 0);
+    start = sim.now;
+    while (sim.now < start + 3000000)
+        sim_step(&sim);
+
+    cwnd = lsquic_cong_bbr_if.cci_get_cwnd(bbr);
+    lsquic_cong_bbr_if.cci_loss(bbr);
+    assert(lsquic_cong_bbr_if.cci_get_cwnd(bbr)
+                                            <= sim.in_flight + SIM_PACKET_SZ);
+    assert(bbr->bbr_flags & BBR_IN_RECOVERY);
+
+    /* Acknowledging a packet sent after the loss ends recovery */
+    memset(&po, 0, sizeof(po));
+    po.po_packno = sim.packno + 1;
+    po.po_sent = sim.now;
+    lsquic_cong_bbr_if.cci_begin_ack(bbr, sim.now + sim.rtt,
+                                                            sim.in_flight);
+    lsquic_cong_bbr_if.cci_ack(bbr, &po, SIM_PACKET_SZ, sim.now + sim.rtt,
+                                                                        0);
+    lsquic_cong_bbr_if.cci_end_ack(bbr, sim.in_flight);
+    assert(!(bbr->bbr_flags & BBR_IN_RECOVERY));
+    assert(lsquic_cong_bbr_if.cci_get_cwnd(bbr) >= cwnd);
+
+    sim_cleanup(&sim);
+}
+
+
+/* Spurious loss: cwnd is restored and recovery ends at once */
+static void
+test_undo (void)
+{
+    struct sim sim;
+    struct lsquic_bbr *const bbr = &sim.cong_u.bbr;
+    unsigned long cwnd;
+    lsquic_time_t start;
+
+    sim_init(&sim, &lsquic_cong_bbr_if, 10, 40, 4, 0);
+    start = sim.now;
+    while (sim.now < start + 3000000)
+        sim_step(&sim);
+
+    cwnd = lsquic_cong_bbr_if.cci_get_cwnd(bbr);
+    lsquic_cong_bbr_if.cci_loss(bbr);
+    assert(bbr->bbr_flags & BBR_IN_RECOVERY);
+    lsquic_cong_bbr_if.cci_undo(bbr);
+    assert(!(bbr->bbr_flags & (BBR_IN_RECOVERY|BBR_CONSERVATION)));
+    assert(lsquic_cong_bbr_if.cci_get_cwnd(bbr) >= cwnd);
+
+    sim_cleanup(&sim);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        lsquic_set_log_level(argv[1]);
+        lsquic_logger_lopt("bbr=debug");
+    }
+
+    test_minmax();
+    test_clean_path();
+    test_lossy_path();
+    test_recovery();
+    test_undo();
+
+    return 0;
+}
@@ -30,6 +30,57 @@ get_new_lsquic_conn (struct malo *malo)
 }
 
 
+/* Add and remove connections while the table grows, so that lookups and
+ * removals happen while entries are being moved to the new table.
+ */
+static void
+test_add_remove_while_growing (unsigned nelems)
+{
+    struct malo *malo;
+    struct conn_hash conn_hash;
+    struct lsquic_conn **lconns, *lconn;
+    unsigned n, n_removed;
+    int s;
+
+    malo = lsquic_malo_create(sizeof(*lconn));
+    lconns = calloc(nelems, sizeof(lconns[0]));
+    s = conn_hash_init(&conn_hash, nelems);
+    assert(0 == s);
+
+    n_removed = 0;
+    for (n = 0; n < nelems; ++n)
+    {
+        lconns[n] = get_new_lsquic_conn(malo);
+        s = conn_hash_add(&conn_hash, lconns[n]);
+        assert(0 == s);
+        assert(lconns[n] == conn_hash_find(&conn_hash, lconns[n]->cn_cid));
+        if (n % 3 == 2)
+        {
+            lconn = lconns[n / 2];
+            if (conn_hash_find(&conn_hash, lconn->cn_cid))
+            {
+                conn_hash_remove(&conn_hash, lconn);
+                ++n_removed;
+            }
+            assert(!conn_hash_find(&conn_hash, lconn->cn_cid));
+        }
+    }
+
+    assert(nelems - n_removed == conn_hash_count(&conn_hash));
+    for (n = 0, lconn = conn_hash_first(&conn_hash); lconn;
+                                    lconn = conn_hash_next(&conn_hash))
+    {
+        assert(lconn == conn_hash_find(&conn_hash, lconn->cn_cid));
+        ++n;
+    }
+    assert(n == conn_hash_count(&conn_hash));
+
+    conn_hash_cleanup(&conn_hash);
+    free(lconns);
+    lsquic_malo_destroy(malo);
+}
+
+
 int
 main (int argc, char **argv)
 {
@@ -90,5 +141,7 @@ main (int argc, char **argv)
     conn_hash_cleanup(&conn_hash);
     lsquic_malo_destroy(malo);
 
+    test_add_remove_while_growing(nelems < 100000 ? nelems : 100000);
+
     exit(0);
 }
@@ -0,0 +1,143 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test lsquic_conn_get_info(): values must reflect a client connection
+ * that has sent its first packets, and callers with a smaller structure
+ * must not have their memory overwritten.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#else
+#include <winsock2.h>
+#endif
+
+#include "lsquic.h"
+
+
+static unsigned s_n_packets_out;
+
+
+static int
+packets_out (void *ctx, const struct lsquic_out_spec *specs, unsigned n)
+{
+    s_n_packets_out += n;
+    return n;
+}
+
+
+static lsquic_conn_ctx_t *
+on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    return NULL;
+}
+
+
+static void
+on_conn_closed (lsquic_conn_t *conn)
+{
+}
+
+
+static lsquic_stream_ctx_t *
+on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    return NULL;
+}
+
+
+static void
+on_stream_event (lsquic_stream_t *stream, lsquic_stream_ctx_t *h)
+{
+}
+
+
+static const struct lsquic_stream_if stream_if = {
+    .on_new_conn        = on_new_conn,
+    .on_conn_closed     = on_conn_closed,
+    .on_new_stream      = on_new_stream,
+    .on_read            = on_stream_event,
+    .on_write           = on_stream_event,
+    .on_close           = on_stream_event,
+};
+
+
+int
+main (void)
+{
+    struct lsquic_engine_settings settings;
+    struct lsquic_conn_info info;
+    lsquic_engine_t *engine;
+    lsquic_conn_t *conn;
+    struct sockaddr_in peer;
+    unsigned char *p;
+    size_t sz, off;
+    int s;
+
+    s = lsquic_global_init(LSQUIC_GLOBAL_CLIENT);
+    assert(0 == s);
+
+    lsquic_engine_init_settings(&settings, 0);
+    struct lsquic_engine_api api = {
+        .ea_settings        = &settings,
+        .ea_stream_if       = &stream_if,
+        .ea_packets_out     = packets_out,
+    };
+
+    engine = lsquic_engine_new(0, &api);
+    assert(engine);
+
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    peer.sin_port = htons(443);
+
+    conn = lsquic_engine_connect(engine, (struct sockaddr *) &peer, NULL,
+                                                    NULL, "localhost", 0);
+    assert(conn);
+    assert(s_n_packets_out > 0);
+
+    memset(&info, 0xAB, sizeof(info));
+    sz = lsquic_conn_get_info(conn, &info, sizeof(info));
+    assert(sizeof(info) == sz);
+    assert(LSQUIC_CONN_INFO_VERSION == info.lci_version);
+    assert(info.lci_cwnd > 0);
+    assert(info.lci_ssthresh > 0);
+    assert(info.lci_packets_in_flight > 0);
+    assert(info.lci_bytes_in_flight > 0);
+    /* No ACKs have been received */
+    assert(0 == info.lci_srtt);
+    assert(0 == info.lci_min_rtt);
+    assert(info.lci_send_off <= info.lci_send_max);
+    assert(info.lci_send_max > 0);
+    assert(info.lci_recv_window > 0);
+    assert(info.lci_recv_max >= info.lci_recv_window);
+    assert(0 == info.lci_hsk_usec);
+#if !defined(LSQUIC_SEND_STATS) || LSQUIC_SEND_STATS
+    assert(s_n_packets_out == info.lci_packets_sent);
+    assert(0 == info.lci_packets_lost);
+    assert(0 == info.lci_packets_resent);
+    assert(0 == info.lci_packets_spurious);
+#endif
+
+    /* Caller compiled against a smaller structure */
+    off = offsetof(struct lsquic_conn_info, lci_srtt);
+    memset(&info, 0xAB, sizeof(info));
+    sz = lsquic_conn_get_info(conn, &info, off);
+    assert(off == sz);
+    assert(LSQUIC_CONN_INFO_VERSION == info.lci_version);
+    for (p = (unsigned char *) &info + off;
+                            p < (unsigned char *) &info + sizeof(info); ++p)
+        assert(0xAB == *p);
+
+    lsquic_engine_destroy(engine);
+    lsquic_global_cleanup();
+
+    return 0;
+}
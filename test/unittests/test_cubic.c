@@ -1,5 +1,6 @@
 /* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,9 +11,8 @@
 #endif
 
 #include "lsquic.h"
-#include "lsquic_int_types.h"
-#include "lsquic_cubic.h"
 #include "lsquic_logger.h"
+#include "link_sim.h"
 
 
 static void
@@ -67,6 +67,50 @@ test_post_quiescence_explosion2 (void)
 }
 
 
+/* Run Cubic over a paced path with a drop-tail bottleneck buffer of two
+ * BDPs until `duration' runs out.  Returns number of packets dropped.
+ */
+static unsigned
+simulate_startup (int hystart, lsquic_time_t duration,
+                                                unsigned long *ssthresh)
+{
+    struct sim sim;
+    lsquic_time_t end;
+    unsigned n_dropped;
+
+    sim_init(&sim, &lsquic_cong_cubic_if, 100, 80, 2, 0);
+    if (hystart)
+        sim.cong_u.cubic.cu_flags |= CU_HYSTART;
+    end = sim.now + duration;
+    while (sim.now < end)
+        sim_step(&sim);
+
+    *ssthresh = lsquic_cubic_get_ssthresh(&sim.cong_u.cubic);
+    n_dropped = sim.link.n_dropped;
+    sim_cleanup(&sim);
+    return n_dropped;
+}
+
+
+/* Without HyStart++, slow start keeps doubling cwnd until the buffer
+ * overflows.  With it, cwnd growth slows down once the queue builds up,
+ * so that fewer packets are lost, and slow start still ends at about the
+ * right cwnd.
+ */
+static void
+test_hystart (void)
+{
+    unsigned n_dropped_plain, n_dropped_hystart;
+    unsigned long ssthresh_plain, ssthresh_hystart;
+    const unsigned long bdp = 100000000 / 8 / 1000000 * 80000;
+
+    n_dropped_plain = simulate_startup(0, 3000000, &ssthresh_plain);
+    n_dropped_hystart = simulate_startup(1, 3000000, &ssthresh_hystart);
+    assert(n_dropped_plain > 0);
+    assert(n_dropped_hystart * 3 < n_dropped_plain);
+    assert(ssthresh_hystart >= bdp / 2);
+}
+
 
 int
 main (int argc, char **argv)
@@ -90,6 +134,7 @@ main (int argc, char **argv)
 
     test_post_quiescence_explosion();
     test_post_quiescence_explosion2();
+    test_hystart();
 
     exit(EXIT_SUCCESS);
 }
@@ -16,10 +16,9 @@ main (void)
     lsquic_engine_init_settings(&settings, flags);
 
     struct lsquic_engine_api api = {
-        &settings,
-        NULL, NULL,     /* stream if and ctx */
-        (void *) (uintptr_t) 1, NULL,     /* packets out and ctx */
-        NULL, NULL,     /* packout mem interface and ctx */
+        .ea_settings    = &settings,
+        /* Not called: */
+        .ea_packets_out = (void *) (uintptr_t) 1,
     };
 
     engine = lsquic_engine_new(flags, &api);
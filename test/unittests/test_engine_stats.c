@@ -0,0 +1,200 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test lsquic_engine_get_stats(): counters must match what the engine
+ * reports to the packets_out callback and what it is given, and each call
+ * must start a new interval.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#else
+#include <winsock2.h>
+#endif
+
+#include "lsquic.h"
+
+
+struct packets_out_state
+{
+    unsigned long long  n_calls,
+                        n_packets,
+                        n_bytes;
+    int                 fail;
+};
+
+
+static int
+packets_out (void *ctx, const struct lsquic_out_spec *specs, unsigned n)
+{
+    struct packets_out_state *const state = ctx;
+    unsigned i;
+
+    ++state->n_calls;
+    if (state->fail)
+        return 0;
+
+    for (i = 0; i < n; ++i)
+        state->n_bytes += specs[i].sz;
+    state->n_packets += n;
+    return n;
+}
+
+
+static lsquic_conn_ctx_t *
+on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    return NULL;
+}
+
+
+static void
+on_conn_closed (lsquic_conn_t *conn)
+{
+}
+
+
+static lsquic_stream_ctx_t *
+on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    return NULL;
+}
+
+
+static void
+on_stream_event (lsquic_stream_t *stream, lsquic_stream_ctx_t *h)
+{
+}
+
+
+static const struct lsquic_stream_if stream_if = {
+    .on_new_conn        = on_new_conn,
+    .on_conn_closed     = on_conn_closed,
+    .on_new_stream      = on_new_stream,
+    .on_read            = on_stream_event,
+    .on_write           = on_stream_event,
+    .on_close           = on_stream_event,
+};
+
+
+int
+main (void)
+{
+    struct lsquic_engine_settings settings;
+    struct lsquic_engine_stats stats;
+    struct packets_out_state out;
+    lsquic_engine_t *engine;
+    lsquic_conn_t *conn;
+    struct sockaddr_in local, peer;
+    struct lsquic_in_spec specs[3];
+    unsigned i, n_proc;
+    int s;
+    static const unsigned char bad_flags[] = { 0x80, 0x01, };
+    static const unsigned char no_conn[] = {
+        0x08,                                   /* 8-byte CID, 1-byte PN */
+        0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+        0x01,
+        0x00, 0x00, 0x00, 0x00,
+    };
+    static const unsigned char no_cid[] = { 0x00, 0x01, 0x00, 0x00, };
+
+    s = lsquic_global_init(LSQUIC_GLOBAL_CLIENT);
+    assert(0 == s);
+
+    memset(&out, 0, sizeof(out));
+    lsquic_engine_init_settings(&settings, 0);
+    struct lsquic_engine_api api = {
+        .ea_settings        = &settings,
+        .ea_stream_if       = &stream_if,
+        .ea_packets_out     = packets_out,
+        .ea_packets_out_ctx = &out,
+    };
+
+    engine = lsquic_engine_new(0, &api);
+    assert(engine);
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    local.sin_port = htons(12345);
+    peer = local;
+    peer.sin_port = htons(443);
+
+    lsquic_engine_get_stats(engine, &stats);
+    assert(0 == stats.total.conns_created);
+    assert(0 == stats.total.packets_out);
+    assert(0 == stats.n_conns);
+    assert(0 == stats.attq_size);
+    assert(0 == stats.pend_rw_count);
+
+    /* The first connection cannot send its packets right away */
+    out.fail = 1;
+    conn = lsquic_engine_connect(engine, (struct sockaddr *) &peer, NULL,
+                                                    NULL, "localhost", 0);
+    assert(conn);
+    out.fail = 0;
+    lsquic_engine_send_unsent_packets(engine);
+    conn = lsquic_engine_connect(engine, (struct sockaddr *) &peer, NULL,
+                                                    NULL, "localhost", 0);
+    assert(conn);
+
+    lsquic_engine_get_stats(engine, &stats);
+    assert(2 == stats.total.conns_created);
+    assert(0 == stats.total.conns_destroyed);
+    assert(2 == stats.n_conns);
+    assert(out.n_calls == stats.total.batches_sent);
+    assert(1 == stats.total.short_writes);
+    assert(out.n_packets > 0);
+    assert(out.n_packets == stats.total.packets_out);
+    assert(out.n_bytes == stats.total.bytes_out);
+    assert(0 == stats.total.encrypt_failures);
+    assert(0 == memcmp(&stats.total, &stats.interval, sizeof(stats.total)));
+
+    /* Packets with bad flags cannot be parsed; the other two do not belong
+     * to any connection.
+     */
+    specs[0].buf = bad_flags;
+    specs[0].sz  = sizeof(bad_flags);
+    specs[1].buf = no_conn;
+    specs[1].sz  = sizeof(no_conn);
+    specs[2].buf = no_cid;
+    specs[2].sz  = sizeof(no_cid);
+    for (i = 0; i < sizeof(specs) / sizeof(specs[0]); ++i)
+    {
+        specs[i].local_sa = (struct sockaddr *) &local;
+        specs[i].peer_sa  = (struct sockaddr *) &peer;
+        specs[i].peer_ctx = NULL;
+    }
+    n_proc = lsquic_engine_packets_in(engine, specs,
+                                            sizeof(specs) / sizeof(specs[0]));
+    assert(0 == n_proc);
+    s = lsquic_engine_packet_in(engine, no_conn, sizeof(no_conn),
+                                    specs[1].local_sa, specs[1].peer_sa, NULL);
+    assert(1 == s);
+
+    lsquic_engine_get_stats(engine, &stats);
+    assert(3 == stats.total.packets_in);
+    assert(2 * sizeof(no_conn) + sizeof(no_cid) == stats.total.bytes_in);
+    assert(4 == stats.total.packets_dropped);
+    assert(3 == stats.interval.packets_in);
+    assert(4 == stats.interval.packets_dropped);
+    assert(0 == stats.interval.conns_created);
+    assert(0 == stats.interval.packets_out);
+    assert(2 == stats.total.conns_created);
+
+    /* Nothing happened since the previous call */
+    lsquic_engine_get_stats(engine, &stats);
+    assert(0 == stats.interval.packets_in);
+    assert(0 == stats.interval.packets_dropped);
+    assert(4 == stats.total.packets_dropped);
+
+    lsquic_engine_destroy(engine);
+    lsquic_global_cleanup();
+
+    return 0;
+}
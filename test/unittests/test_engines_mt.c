@@ -0,0 +1,251 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Run several engines in parallel threads.  Each thread initializes the
+ * library, creates engines, connects, feeds packets, and destroys its
+ * engines while another thread keeps changing log levels.  The engines
+ * must not share any unprotected state: run this test under
+ * ThreadSanitizer to check.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "lsquic.h"
+
+#define N_THREADS       4
+#define N_ENGINES       20      /* Per thread, one after another */
+#define N_CONNS         3       /* Per engine */
+#define N_BATCHES       50      /* Per engine */
+
+
+/* Calls to the logger are serialized: each call carries one complete
+ * message and no other thread may enter the callback at the same time.
+ */
+struct logger_state
+{
+    unsigned long   n_messages;
+    unsigned        n_inside;
+};
+
+
+static int
+check_vprintf (void *ctx, const char *fmt, va_list ap)
+{
+    struct logger_state *const state = ctx;
+    const char *msg, *nl;
+
+    assert(0 == state->n_inside);
+    ++state->n_inside;
+    assert(0 == strcmp(fmt, "%s"));
+    msg = va_arg(ap, const char *);
+    nl = strchr(msg, '\n');
+    assert(nl && nl[1] == '\0');
+    ++state->n_messages;
+    --state->n_inside;
+
+    return 0;
+}
+
+
+static const struct lsquic_logger_if logger_if = { check_vprintf, };
+
+
+static lsquic_conn_ctx_t *
+on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    return NULL;
+}
+
+
+static void
+on_conn_closed (lsquic_conn_t *conn)
+{
+}
+
+
+static lsquic_stream_ctx_t *
+on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    return NULL;
+}
+
+
+static void
+on_stream_event (lsquic_stream_t *stream, lsquic_stream_ctx_t *h)
+{
+}
+
+
+static const struct lsquic_stream_if stream_if = {
+    .on_new_conn        = on_new_conn,
+    .on_conn_closed     = on_conn_closed,
+    .on_new_stream      = on_new_stream,
+    .on_read            = on_stream_event,
+    .on_write           = on_stream_event,
+    .on_close           = on_stream_event,
+};
+
+
+static int
+packets_out (void *ctx, const struct lsquic_out_spec *specs, unsigned n)
+{
+    unsigned long *const n_sent = ctx;
+    *n_sent += n;
+    return n;
+}
+
+
+struct engine_thread
+{
+    pthread_t       thread;
+    unsigned        idx;
+    unsigned long   n_sent;
+};
+
+
+static void *
+engine_thread (void *arg)
+{
+    struct engine_thread *const et = arg;
+    struct lsquic_engine_settings settings;
+    lsquic_engine_t *engine;
+    struct sockaddr_in local, peer;
+    struct lsquic_in_spec specs[16];
+    unsigned char packets[16][32];
+    unsigned i, j, n_engines, n_conns, batch;
+    int s;
+
+    s = lsquic_global_init(LSQUIC_GLOBAL_CLIENT);
+    assert(0 == s);
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    local.sin_port = htons(10000 + et->idx);
+    peer = local;
+    peer.sin_port = htons(443);
+
+    /* Packets with unknown connection IDs */
+    memset(packets, 0, sizeof(packets));
+    for (i = 0; i < sizeof(specs) / sizeof(specs[0]); ++i)
+    {
+        packets[i][0] = 0x08;
+        packets[i][1] = et->idx;
+        packets[i][2] = i;
+        specs[i].buf      = packets[i];
+        specs[i].sz       = sizeof(packets[i]);
+        specs[i].local_sa = (struct sockaddr *) &local;
+        specs[i].peer_sa  = (struct sockaddr *) &peer;
+        specs[i].peer_ctx = NULL;
+    }
+
+    lsquic_engine_init_settings(&settings, 0);
+    struct lsquic_engine_api api = {
+        .ea_settings        = &settings,
+        .ea_stream_if       = &stream_if,
+        .ea_packets_out     = packets_out,
+        .ea_packets_out_ctx = &et->n_sent,
+    };
+
+    for (n_engines = 0; n_engines < N_ENGINES; ++n_engines)
+    {
+        engine = lsquic_engine_new(0, &api);
+        assert(engine);
+        for (n_conns = 0; n_conns < N_CONNS; ++n_conns)
+            if (!lsquic_engine_connect(engine, (struct sockaddr *) &peer,
+                                                NULL, NULL, "localhost", 0))
+                break;
+        for (batch = 0; batch < N_BATCHES; ++batch)
+        {
+            for (j = 0; j < sizeof(specs) / sizeof(specs[0]); ++j)
+                packets[j][3] = batch;
+            (void) lsquic_engine_packets_in(engine, specs,
+                                            sizeof(specs) / sizeof(specs[0]));
+            lsquic_engine_process_conns_with_incoming(engine);
+            lsquic_engine_process_conns_to_tick(engine);
+        }
+        lsquic_engine_destroy(engine);
+    }
+
+    lsquic_global_cleanup();
+    return NULL;
+}
+
+
+static void *
+log_level_thread (void *arg)
+{
+    const int *const stop = arg;
+    int s;
+
+    do
+    {
+        s = lsquic_set_log_level("debug");
+        assert(0 == s);
+        s = lsquic_logger_lopt("engine=info,conn=warn");
+        assert(0 == s);
+        s = lsquic_set_log_level("warn");
+        assert(0 == s);
+    }
+    while (!__atomic_load_n(stop, __ATOMIC_RELAXED));
+
+    return NULL;
+}
+
+
+int
+main (void)
+{
+    struct engine_thread threads[N_THREADS];
+    struct logger_state logger_state;
+    pthread_t log_thread;
+    unsigned i;
+    int s, stop;
+
+    memset(&logger_state, 0, sizeof(logger_state));
+    lsquic_logger_init(&logger_if, &logger_state, LLTS_NONE);
+
+    /* The library stays initialized while the threads run */
+    s = lsquic_global_init(LSQUIC_GLOBAL_CLIENT);
+    assert(0 == s);
+
+    stop = 0;
+    s = pthread_create(&log_thread, NULL, log_level_thread, &stop);
+    assert(0 == s);
+
+    memset(threads, 0, sizeof(threads));
+    for (i = 0; i < N_THREADS; ++i)
+    {
+        threads[i].idx = i;
+        s = pthread_create(&threads[i].thread, NULL, engine_thread,
+                                                                &threads[i]);
+        assert(0 == s);
+    }
+
+    for (i = 0; i < N_THREADS; ++i)
+    {
+        s = pthread_join(threads[i].thread, NULL);
+        assert(0 == s);
+    }
+
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    s = pthread_join(log_thread, NULL);
+    assert(0 == s);
+
+    for (i = 0; i < N_THREADS; ++i)
+        assert(threads[i].n_sent > 0);
+
+    lsquic_global_cleanup();
+
+    assert(0 == logger_state.n_inside);
+    assert(logger_state.n_messages > 0);
+
+    return 0;
+}
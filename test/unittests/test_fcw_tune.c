@@ -0,0 +1,504 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test flow control window tuning: windows follow the bandwidth-delay
+ * product and connection windows share the engine's memory budget.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#else
+#include <winsock2.h>
+#endif
+
+#include "lsquic.h"
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_rtt.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_stream.h"
+#include "lsquic_conn_public.h"
+#include "lsquic_mm.h"
+#include "lsquic_engine_public.h"
+#include "lsquic_conn.h"
+#include "lsquic_str.h"
+#include "lsquic_handshake.h"
+#include "lsquic_qtags.h"
+#include "lsquic_util.h"
+
+
+#define KB 1024
+#define SRTT 100000     /* 100 ms */
+
+
+struct test_conn
+{
+    struct lsquic_conn          lconn;
+    struct lsquic_conn_public   conn_pub;
+};
+
+
+static void
+init_test_conn (struct test_conn *tconn, struct lsquic_engine_public *enpub,
+                                        unsigned window, lsquic_time_t srtt)
+{
+    memset(tconn, 0, sizeof(*tconn));
+    tconn->conn_pub.lconn = &tconn->lconn;
+    tconn->conn_pub.enpub = enpub;
+    tconn->conn_pub.rtt_stats.srtt = srtt;
+    lsquic_cfcw_init(&tconn->conn_pub.cfcw, &tconn->conn_pub, window);
+}
+
+
+/* Consume `n_read' bytes over `elapsed' microseconds */
+static int
+cfcw_read (struct lsquic_cfcw *fc, uint64_t n_read, lsquic_time_t elapsed)
+{
+    lsquic_cfcw_incr_read_off(fc, n_read);
+    fc->cf_last_updated = lsquic_time_now() - elapsed;
+    return lsquic_cfcw_fc_offsets_changed(fc);
+}
+
+
+static void
+test_bdp_window (void)
+{
+    /* 64 KB per 10 ms with 100 ms RTT: BDP is 640 KB, limited to 2x */
+    assert(128 * KB == lsquic_fcw_bdp_window(64 * KB, 64 * KB, 10000, SRTT));
+    /* 64 KB per 1 s with 100 ms RTT: 12.8 KB, limited to 1/2 */
+    assert(32 * KB == lsquic_fcw_bdp_window(64 * KB, 64 * KB, 1000000, SRTT));
+    /* 64 KB per 200 ms with 100 ms RTT: exactly twice BDP */
+    assert(64 * KB == lsquic_fcw_bdp_window(64 * KB, 64 * KB, 200000, SRTT));
+    assert(80 * KB == lsquic_fcw_bdp_window(64 * KB, 80 * KB, 200000, SRTT));
+    /* No time has elapsed */
+    assert(128 * KB == lsquic_fcw_bdp_window(64 * KB, 1, 0, SRTT));
+    /* Does not overflow */
+    assert(UINT32_MAX == lsquic_fcw_bdp_window(UINT32_MAX, UINT32_MAX, 1,
+                                                                    SRTT));
+}
+
+
+/* Fast reader grows the window up to es_max_cfcw; slow reader shrinks it,
+ * but not below the initial value.
+ */
+static void
+test_cfcw_grow_and_shrink (void)
+{
+    struct lsquic_engine_public enpub;
+    struct test_conn tconn;
+    struct lsquic_cfcw *const fc = &tconn.conn_pub.cfcw;
+    uint64_t recv_off;
+    int s;
+
+    memset(&enpub, 0, sizeof(enpub));
+    enpub.enp_settings.es_max_cfcw = 1024 * KB;
+    init_test_conn(&tconn, &enpub, 64 * KB, SRTT);
+    assert(64 * KB == lsquic_cfcw_get_fc_recv_off(fc));
+    assert(64 * KB == enpub.enp_fcw_total);
+    assert(1 == enpub.enp_n_cfcw);
+
+    s = cfcw_read(fc, 16 * KB, 10000);
+    assert(("less than half of window read: no update", !s));
+    assert(64 * KB == lsquic_cfcw_get_max_recv_window(fc));
+
+    s = cfcw_read(fc, 32 * KB, 10000);
+    assert(s);
+    assert(128 * KB == lsquic_cfcw_get_max_recv_window(fc));
+    assert(48 * KB + 128 * KB == lsquic_cfcw_get_fc_recv_off(fc));
+    assert(128 * KB == enpub.enp_fcw_total);
+
+    while (lsquic_cfcw_get_max_recv_window(fc) < 1024 * KB)
+    {
+        recv_off = lsquic_cfcw_get_fc_recv_off(fc);
+        s = cfcw_read(fc, lsquic_cfcw_get_max_recv_window(fc), 10000);
+        assert(s);
+        assert(lsquic_cfcw_get_fc_recv_off(fc) > recv_off);
+    }
+    s = cfcw_read(fc, lsquic_cfcw_get_max_recv_window(fc), 10000);
+    assert(("window does not go past es_max_cfcw",
+                        1024 * KB == lsquic_cfcw_get_max_recv_window(fc)));
+    assert(1024 * KB == enpub.enp_fcw_total);
+
+    /* Slow reader: reading 600 KB takes ten seconds */
+    recv_off = lsquic_cfcw_get_fc_recv_off(fc);
+    s = cfcw_read(fc, 600 * KB, 10000000);
+    assert(512 * KB == lsquic_cfcw_get_max_recv_window(fc));
+    assert(("advertised offset never goes back",
+                            lsquic_cfcw_get_fc_recv_off(fc) >= recv_off));
+    assert(512 * KB == enpub.enp_fcw_total);
+
+    while (lsquic_cfcw_get_max_recv_window(fc) > 64 * KB)
+    {
+        recv_off = lsquic_cfcw_get_fc_recv_off(fc);
+        (void) cfcw_read(fc, lsquic_cfcw_get_max_recv_window(fc), 10000000);
+        assert(lsquic_cfcw_get_fc_recv_off(fc) >= recv_off);
+    }
+    (void) cfcw_read(fc, 64 * KB, 10000000);
+    assert(("window does not shrink below initial value",
+                            64 * KB == lsquic_cfcw_get_max_recv_window(fc)));
+
+    lsquic_cfcw_cleanup(fc);
+    assert(0 == enpub.enp_fcw_total);
+    assert(0 == enpub.enp_n_cfcw);
+}
+
+
+/* When es_max_cfcw is not set, the window stays put */
+static void
+test_cfcw_no_max (void)
+{
+    struct lsquic_engine_public enpub;
+    struct test_conn tconn;
+    struct lsquic_cfcw *const fc = &tconn.conn_pub.cfcw;
+    int s;
+
+    memset(&enpub, 0, sizeof(enpub));
+    init_test_conn(&tconn, &enpub, 64 * KB, SRTT);
+    s = cfcw_read(fc, 48 * KB, 10000);
+    assert(s);
+    assert(64 * KB == lsquic_cfcw_get_max_recv_window(fc));
+    assert(112 * KB == lsquic_cfcw_get_fc_recv_off(fc));
+    lsquic_cfcw_cleanup(fc);
+}
+
+
+/* Connections share the budget: a connection may take what is left or its
+ * fair share, whichever is larger.  A connection that is over its share
+ * gives memory back when its window is updated.
+ */
+static void
+test_budget (void)
+{
+    struct lsquic_engine_public enpub;
+    struct test_conn tconns[2];
+    struct lsquic_cfcw *const fc0 = &tconns[0].conn_pub.cfcw,
+                       *const fc1 = &tconns[1].conn_pub.cfcw;
+    uint64_t recv_off;
+
+    memset(&enpub, 0, sizeof(enpub));
+    enpub.enp_settings.es_max_cfcw = 1024 * KB;
+    enpub.enp_settings.es_fc_mem_budget = 256 * KB;
+    init_test_conn(&tconns[0], &enpub, 64 * KB, SRTT);
+    init_test_conn(&tconns[1], &enpub, 64 * KB, SRTT);
+    assert(128 * KB == enpub.enp_fcw_total);
+    assert(2 == enpub.enp_n_cfcw);
+
+    (void) cfcw_read(fc0, 64 * KB, 10000);
+    assert(128 * KB == lsquic_cfcw_get_max_recv_window(fc0));
+    (void) cfcw_read(fc0, 128 * KB, 10000);
+    assert(("first connection takes what is left",
+                        192 * KB == lsquic_cfcw_get_max_recv_window(fc0)));
+    assert(256 * KB == enpub.enp_fcw_total);
+
+    (void) cfcw_read(fc1, 64 * KB, 10000);
+    assert(("second connection gets its fair share",
+                        128 * KB == lsquic_cfcw_get_max_recv_window(fc1)));
+    assert(320 * KB == enpub.enp_fcw_total);
+
+    recv_off = lsquic_cfcw_get_fc_recv_off(fc0);
+    (void) cfcw_read(fc0, 192 * KB, 10000);
+    assert(("first connection shrinks under memory pressure",
+                        128 * KB == lsquic_cfcw_get_max_recv_window(fc0)));
+    assert(lsquic_cfcw_get_fc_recv_off(fc0) >= recv_off);
+    assert(256 * KB == enpub.enp_fcw_total);
+
+    /* Budget cap applies even without RTT measurement */
+    enpub.enp_settings.es_fc_mem_budget = 128 * KB;
+    tconns[1].conn_pub.rtt_stats.srtt = 0;
+    (void) cfcw_read(fc1, 128 * KB, 10000);
+    assert(64 * KB == lsquic_cfcw_get_max_recv_window(fc1));
+    assert(192 * KB == enpub.enp_fcw_total);
+
+    lsquic_cfcw_cleanup(fc0);
+    assert(64 * KB == enpub.enp_fcw_total);
+    lsquic_cfcw_cleanup(fc1);
+    assert(0 == enpub.enp_fcw_total);
+    assert(0 == enpub.enp_n_cfcw);
+}
+
+
+/* More connections are created than the budget allows: new connections
+ * get what is left, but no less than the minimum window.  Once memory is
+ * freed, their windows grow back.
+ */
+static void
+test_budget_at_init (void)
+{
+    struct lsquic_engine_public enpub;
+    struct test_conn tconns[10];
+    struct lsquic_cfcw *fc;
+    unsigned i;
+
+    memset(&enpub, 0, sizeof(enpub));
+    enpub.enp_settings.es_fc_mem_budget = 216 * KB;
+    for (i = 0; i < sizeof(tconns) / sizeof(tconns[0]); ++i)
+        init_test_conn(&tconns[i], &enpub, 64 * KB, SRTT);
+
+    for (i = 0; i < 3; ++i)
+    {
+        fc = &tconns[i].conn_pub.cfcw;
+        assert(64 * KB == lsquic_cfcw_get_max_recv_window(fc));
+    }
+    fc = &tconns[3].conn_pub.cfcw;
+    assert(("fourth connection gets what is left",
+                            24 * KB == lsquic_cfcw_get_max_recv_window(fc)));
+    assert(24 * KB == lsquic_cfcw_get_fc_recv_off(fc));
+    for (i = 4; i < sizeof(tconns) / sizeof(tconns[0]); ++i)
+    {
+        fc = &tconns[i].conn_pub.cfcw;
+        assert(LSQUIC_MIN_FCW == lsquic_cfcw_get_max_recv_window(fc));
+        assert(LSQUIC_MIN_FCW == lsquic_cfcw_get_fc_recv_off(fc));
+    }
+    assert(216 * KB + 6 * LSQUIC_MIN_FCW == enpub.enp_fcw_total);
+    assert(10 == enpub.enp_n_cfcw);
+
+    /* Three connections go away: the last one grows back to initial
+     * window at its next update.
+     */
+    for (i = 0; i < 3; ++i)
+        lsquic_cfcw_cleanup(&tconns[i].conn_pub.cfcw);
+    fc = &tconns[9].conn_pub.cfcw;
+    (void) cfcw_read(fc, LSQUIC_MIN_FCW, 10000000);
+    assert(64 * KB == lsquic_cfcw_get_max_recv_window(fc));
+
+    for (i = 3; i < sizeof(tconns) / sizeof(tconns[0]); ++i)
+        lsquic_cfcw_cleanup(&tconns[i].conn_pub.cfcw);
+    assert(0 == enpub.enp_fcw_total);
+    assert(0 == enpub.enp_n_cfcw);
+}
+
+
+/* Stream window grows up to es_max_sfcw, but not past connection window */
+static void
+test_sfcw (void)
+{
+    struct lsquic_engine_public enpub;
+    struct test_conn tconn;
+    struct lsquic_sfcw sfcw;
+    uint64_t read_off;
+    int s;
+
+    memset(&enpub, 0, sizeof(enpub));
+    enpub.enp_settings.es_max_sfcw = 1024 * KB;
+    init_test_conn(&tconn, &enpub, 128 * KB, SRTT);
+    lsquic_sfcw_init(&sfcw, 32 * KB, &tconn.conn_pub.cfcw, &tconn.conn_pub, 5);
+    assert(32 * KB == lsquic_sfcw_get_fc_recv_off(&sfcw));
+
+    read_off = 24 * KB;
+    lsquic_sfcw_set_read_off(&sfcw, read_off);
+    sfcw.sf_last_updated = lsquic_time_now() - 10000;
+    s = lsquic_sfcw_fc_offsets_changed(&sfcw);
+    assert(s);
+    assert(64 * KB == lsquic_sfcw_get_max_recv_window(&sfcw));
+    assert(read_off + 64 * KB == lsquic_sfcw_get_fc_recv_off(&sfcw));
+
+    read_off += 64 * KB;
+    lsquic_sfcw_set_read_off(&sfcw, read_off);
+    sfcw.sf_last_updated = lsquic_time_now() - 10000;
+    s = lsquic_sfcw_fc_offsets_changed(&sfcw);
+    assert(s);
+    assert(128 * KB == lsquic_sfcw_get_max_recv_window(&sfcw));
+
+    read_off += 128 * KB;
+    lsquic_sfcw_set_read_off(&sfcw, read_off);
+    sfcw.sf_last_updated = lsquic_time_now() - 10000;
+    s = lsquic_sfcw_fc_offsets_changed(&sfcw);
+    assert(s);
+    assert(("stream window is limited by connection window",
+                        128 * KB == lsquic_sfcw_get_max_recv_window(&sfcw)));
+
+    /* Slow reader does not go below initial window */
+    read_off += 128 * KB;
+    lsquic_sfcw_set_read_off(&sfcw, read_off);
+    sfcw.sf_last_updated = lsquic_time_now() - 10000000;
+    (void) lsquic_sfcw_fc_offsets_changed(&sfcw);
+    assert(64 * KB == lsquic_sfcw_get_max_recv_window(&sfcw));
+    read_off += 64 * KB;
+    lsquic_sfcw_set_read_off(&sfcw, read_off);
+    sfcw.sf_last_updated = lsquic_time_now() - 10000000;
+    (void) lsquic_sfcw_fc_offsets_changed(&sfcw);
+    assert(32 * KB == lsquic_sfcw_get_max_recv_window(&sfcw));
+    read_off += 32 * KB;
+    lsquic_sfcw_set_read_off(&sfcw, read_off);
+    sfcw.sf_last_updated = lsquic_time_now() - 10000000;
+    (void) lsquic_sfcw_fc_offsets_changed(&sfcw);
+    assert(32 * KB == lsquic_sfcw_get_max_recv_window(&sfcw));
+
+    lsquic_cfcw_cleanup(&tconn.conn_pub.cfcw);
+}
+
+
+/* The window a client connection advertises in its CHLO is the one it
+ * got from the budget.  The CHLOs are captured by wrapping esf_gen_chlo.
+ */
+
+#define MAX_CHLOS 3
+
+static int (*orig_gen_chlo) (lsquic_enc_session_t *, enum lsquic_version,
+                                                    uint8_t *, size_t *);
+static unsigned chlo_cfcws[MAX_CHLOS];
+static unsigned n_chlos;
+
+
+/* Return value of the CFCW tag in CHLO message */
+static unsigned
+chlo_cfcw (const unsigned char *buf, size_t len)
+{
+    const unsigned char *values;
+    uint32_t tag, off, prev_off, cfcw;
+    uint16_t n_entries;
+    unsigned i;
+
+    assert(len >= 8);
+    memcpy(&tag, buf, 4);
+    assert(QTAG_CHLO == tag);
+    memcpy(&n_entries, buf + 4, 2);
+    values = buf + 8 + n_entries * 8;
+    assert(values <= buf + len);
+
+    prev_off = 0;
+    for (i = 0; i < n_entries; ++i)
+    {
+        memcpy(&tag, buf + 8 + i * 8, 4);
+        memcpy(&off, buf + 8 + i * 8 + 4, 4);
+        if (QTAG_CFCW == tag)
+        {
+            assert(off - prev_off == sizeof(cfcw));
+            assert(values + off <= buf + len);
+            memcpy(&cfcw, values + prev_off, sizeof(cfcw));
+            return cfcw;
+        }
+        prev_off = off;
+    }
+
+    assert(("CFCW tag is present", 0));
+    return 0;
+}
+
+
+static int
+record_chlo_cfcw (lsquic_enc_session_t *enc_session,
+                enum lsquic_version version, uint8_t *buf, size_t *len)
+{
+    int s;
+
+    s = orig_gen_chlo(enc_session, version, buf, len);
+    if (0 == s)
+    {
+        assert(n_chlos < MAX_CHLOS);
+        chlo_cfcws[n_chlos++] = chlo_cfcw(buf, *len);
+    }
+    return s;
+}
+
+
+static int
+packets_out (void *ctx, const struct lsquic_out_spec *specs, unsigned n)
+{
+    return n;
+}
+
+
+static lsquic_conn_ctx_t *
+on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    return NULL;
+}
+
+
+static void
+on_conn_closed (lsquic_conn_t *conn)
+{
+}
+
+
+static lsquic_stream_ctx_t *
+on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    return NULL;
+}
+
+
+static void
+on_stream_event (lsquic_stream_t *stream, lsquic_stream_ctx_t *h)
+{
+}
+
+
+static const struct lsquic_stream_if stream_if = {
+    .on_new_conn        = on_new_conn,
+    .on_conn_closed     = on_conn_closed,
+    .on_new_stream      = on_new_stream,
+    .on_read            = on_stream_event,
+    .on_write           = on_stream_event,
+    .on_close           = on_stream_event,
+};
+
+
+static void
+test_chlo_cfcw (void)
+{
+    struct lsquic_engine_settings settings;
+    lsquic_engine_t *engine;
+    lsquic_conn_t *conn;
+    struct sockaddr_in peer;
+    unsigned i;
+    int s;
+
+    s = lsquic_global_init(LSQUIC_GLOBAL_CLIENT);
+    assert(0 == s);
+    orig_gen_chlo = lsquic_enc_session_gquic_1.esf_gen_chlo;
+    lsquic_enc_session_gquic_1.esf_gen_chlo = record_chlo_cfcw;
+
+    lsquic_engine_init_settings(&settings, 0);
+    settings.es_cfcw = 64 * KB;
+    settings.es_sfcw = LSQUIC_MIN_FCW;
+    settings.es_fc_mem_budget = 88 * KB;
+    struct lsquic_engine_api api = {
+        .ea_settings        = &settings,
+        .ea_stream_if       = &stream_if,
+        .ea_packets_out     = packets_out,
+    };
+    engine = lsquic_engine_new(0, &api);
+    assert(engine);
+
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    peer.sin_port = htons(443);
+    for (i = 0; i < MAX_CHLOS; ++i)
+    {
+        conn = lsquic_engine_connect(engine, (struct sockaddr *) &peer,
+                                                NULL, NULL, "localhost", 0);
+        assert(conn);
+    }
+
+    assert(MAX_CHLOS == n_chlos);
+    assert(64 * KB == chlo_cfcws[0]);
+    assert(("second connection advertises what is left of the budget",
+                                                24 * KB == chlo_cfcws[1]));
+    assert(LSQUIC_MIN_FCW == chlo_cfcws[2]);
+
+    lsquic_engine_destroy(engine);
+    lsquic_enc_session_gquic_1.esf_gen_chlo = orig_gen_chlo;
+    lsquic_global_cleanup();
+}
+
+
+int
+main (void)
+{
+    test_bdp_window();
+    test_cfcw_grow_and_shrink();
+    test_cfcw_no_max();
+    test_budget();
+    test_budget_at_init();
+    test_sfcw();
+    test_chlo_cfcw();
+    return 0;
+}
@@ -0,0 +1,169 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lsquic.h"
+
+
+/* Larger than two mapped windows */
+#define FILE_SZ (9 * 1024 * 1024 + 123)
+
+
+static unsigned char
+file_byte (size_t off)
+{
+    return (unsigned char) (off * 7 + off / 4096);
+}
+
+
+static int
+create_file (void)
+{
+    char filename[] = "/tmp/test_file_reader.XXXXXX";
+    unsigned char buf[0x1000];
+    size_t off, i;
+    int fd;
+
+    fd = mkstemp(filename);
+    assert(fd >= 0);
+    (void) unlink(filename);
+
+    for (off = 0; off < FILE_SZ; off += sizeof(buf))
+    {
+        for (i = 0; i < sizeof(buf); ++i)
+            buf[i] = file_byte(off + i);
+        assert((ssize_t) sizeof(buf) == write(fd, buf, sizeof(buf)));
+    }
+    assert(0 == ftruncate(fd, FILE_SZ));
+
+    return fd;
+}
+
+
+/* Read using varying chunk sizes and check contents */
+static void
+test_read (int fd, uint64_t off, uint64_t size, unsigned flags)
+{
+    static const size_t chunk_sizes[] = { 1, 1370, 77777, 1, 4096, 3, };
+    struct lsquic_reader *reader;
+    unsigned char *buf;
+    size_t nread, chunk_sz, i, n;
+    uint64_t total;
+
+    buf = malloc(77777);
+    reader = lsquic_file_reader_new(fd, off, size, flags);
+    assert(reader);
+
+    total = 0;
+    for (n = 0; total < size; ++n)
+    {
+        assert(size - total == reader->lsqr_size(reader->lsqr_ctx));
+        chunk_sz = chunk_sizes[n % (sizeof(chunk_sizes)
+                                                / sizeof(chunk_sizes[0]))];
+        nread = reader->lsqr_read(reader->lsqr_ctx, buf, chunk_sz);
+        if (chunk_sz < size - total)
+            assert(nread == chunk_sz);
+        else
+            assert(nread == size - total);
+        for (i = 0; i < nread; ++i)
+            assert(buf[i] == file_byte(off + total + i));
+        total += nread;
+    }
+
+    assert(0 == reader->lsqr_size(reader->lsqr_ctx));
+    nread = reader->lsqr_read(reader->lsqr_ctx, buf, 100);
+    assert(0 == nread);
+
+    lsquic_file_reader_destroy(reader);
+    free(buf);
+}
+
+
+/* The stream ends where the file does */
+static void
+test_short_file (int fd, uint64_t size, unsigned flags)
+{
+    struct lsquic_reader *reader;
+    unsigned char buf[1000];
+    size_t nread, i;
+
+    reader = lsquic_file_reader_new(fd, FILE_SZ - 500, size, flags);
+    assert(reader);
+    assert(500 == reader->lsqr_size(reader->lsqr_ctx));
+    nread = reader->lsqr_read(reader->lsqr_ctx, buf, sizeof(buf));
+    assert(500 == nread);
+    for (i = 0; i < nread; ++i)
+        assert(buf[i] == file_byte(FILE_SZ - 500 + i));
+    assert(0 == reader->lsqr_size(reader->lsqr_ctx));
+    nread = reader->lsqr_read(reader->lsqr_ctx, buf, sizeof(buf));
+    assert(0 == nread);
+    lsquic_file_reader_destroy(reader);
+}
+
+
+/* File is truncated after the reader has been created */
+static void
+test_truncated_file (unsigned flags)
+{
+    struct lsquic_reader *reader;
+    unsigned char *buf;
+    size_t nread, total, i;
+    int fd;
+
+    fd = create_file();
+    buf = malloc(FILE_SZ);
+    reader = lsquic_file_reader_new(fd, 0, FILE_SZ, flags);
+    assert(reader);
+
+    /* Read part of the first window, then cut the file in the second.  In
+     * mmap mode, this is safe because the second window is not mapped yet.
+     */
+    nread = reader->lsqr_read(reader->lsqr_ctx, buf, 1000);
+    assert(1000 == nread);
+    assert(0 == ftruncate(fd, 5 * 1024 * 1024 + 77));
+
+    total = nread;
+    while ((nread = reader->lsqr_read(reader->lsqr_ctx, buf + total,
+                                                    FILE_SZ - total)) > 0)
+        total += nread;
+    assert(5 * 1024 * 1024 + 77 == total);
+    for (i = 0; i < total; ++i)
+        assert(buf[i] == file_byte(i));
+    assert(0 == reader->lsqr_size(reader->lsqr_ctx));
+
+    lsquic_file_reader_destroy(reader);
+    free(buf);
+    (void) close(fd);
+}
+
+
+int
+main (void)
+{
+    static const unsigned flags[] = { 0, LSQUIC_FR_PREAD, };
+    unsigned i;
+    int fd;
+
+    fd = create_file();
+
+    for (i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i)
+    {
+        test_read(fd, 0, FILE_SZ, flags[i]);
+        test_read(fd, 4097, 4 * 1024 * 1024 + 10, flags[i]);
+        test_read(fd, FILE_SZ - 1, 1, flags[i]);
+        test_read(fd, 100, 0, flags[i]);
+        test_short_file(fd, 1000, flags[i]);
+        test_short_file(fd, 20000, flags[i]);
+        test_truncated_file(flags[i]);
+    }
+
+    assert(NULL == lsquic_file_reader_new(fd, 2, UINT64_MAX, 0));
+    assert(EINVAL == errno);
+
+    (void) close(fd);
+    return 0;
+}
@@ -0,0 +1,92 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test reference-counted global initialization: a later call that asks
+ * for a mode not initialized yet must initialize it.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lsquic.h"
+#include "lsquic_int_types.h"
+#include "lsquic_types.h"
+#include "lsquic_str.h"
+#include "lsquic_handshake.h"
+
+
+static int (*orig_global_init)(int);
+static void (*orig_global_cleanup)(void);
+static int last_init_flags;
+static unsigned n_inits, n_cleanups;
+
+
+static int
+count_global_init (int flags)
+{
+    ++n_inits;
+    last_init_flags = flags;
+    return orig_global_init(flags);
+}
+
+
+static void
+count_global_cleanup (void)
+{
+    ++n_cleanups;
+    orig_global_cleanup();
+}
+
+
+int
+main (void)
+{
+    int s;
+
+    orig_global_init = lsquic_enc_session_gquic_1.esf_global_init;
+    orig_global_cleanup = lsquic_enc_session_gquic_1.esf_global_cleanup;
+    lsquic_enc_session_gquic_1.esf_global_init = count_global_init;
+    lsquic_enc_session_gquic_1.esf_global_cleanup = count_global_cleanup;
+
+    s = lsquic_global_init(LSQUIC_GLOBAL_CLIENT);
+    assert(0 == s);
+    assert(1 == n_inits);
+    assert(LSQUIC_GLOBAL_CLIENT == last_init_flags);
+
+    /* Nothing new to initialize */
+    s = lsquic_global_init(LSQUIC_GLOBAL_CLIENT);
+    assert(0 == s);
+    assert(1 == n_inits);
+
+    /* Server after client: only the server part is initialized */
+    s = lsquic_global_init(LSQUIC_GLOBAL_SERVER);
+    assert(0 == s);
+    assert(2 == n_inits);
+    assert(LSQUIC_GLOBAL_SERVER == last_init_flags);
+
+    s = lsquic_global_init(LSQUIC_GLOBAL_CLIENT|LSQUIC_GLOBAL_SERVER);
+    assert(0 == s);
+    assert(2 == n_inits);
+
+    lsquic_global_cleanup();
+    lsquic_global_cleanup();
+    lsquic_global_cleanup();
+    assert(0 == n_cleanups);
+    lsquic_global_cleanup();
+    assert(1 == n_cleanups);
+
+    /* Flags are forgotten after the last cleanup */
+    s = lsquic_global_init(LSQUIC_GLOBAL_SERVER);
+    assert(0 == s);
+    assert(3 == n_inits);
+    assert(LSQUIC_GLOBAL_SERVER == last_init_flags);
+    s = lsquic_global_init(LSQUIC_GLOBAL_CLIENT);
+    assert(0 == s);
+    assert(4 == n_inits);
+    assert(LSQUIC_GLOBAL_CLIENT == last_init_flags);
+    lsquic_global_cleanup();
+    lsquic_global_cleanup();
+    assert(2 == n_cleanups);
+
+    return 0;
+}
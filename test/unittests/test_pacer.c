@@ -0,0 +1,140 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test departure times returned by the pacer.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "lsquic.h"
+#include "lsquic_int_types.h"
+#include "lsquic_types.h"
+#include "lsquic_pacer.h"
+#include "lsquic_logger.h"
+
+#define TX_TIME     500     /* Microseconds between packets */
+#define HORIZON     2000
+#define START       1000000
+
+
+static lsquic_time_t
+get_tx_time (void *ctx)
+{
+    return TX_TIME;
+}
+
+
+/* Use up burst tokens.  Packets sent in a burst go out right away. */
+static unsigned
+schedule_burst (struct pacer *pacer)
+{
+    unsigned n_in_flight;
+
+    for (n_in_flight = 0; pacer->pa_burst_tokens > 0; ++n_in_flight)
+    {
+        assert(pacer_can_schedule(pacer, n_in_flight));
+        assert(0 == pacer_packet_scheduled(pacer, n_in_flight, 0,
+                                                        get_tx_time, NULL));
+    }
+
+    return n_in_flight;
+}
+
+
+/* Without a horizon, a single paced packet is scheduled per tick */
+static void
+test_no_horizon (void)
+{
+    struct pacer pacer;
+    unsigned n_in_flight;
+
+    pacer_init(&pacer, 0, 100000);
+    pacer_tick(&pacer, START);
+    n_in_flight = schedule_burst(&pacer);
+
+    assert(pacer_can_schedule(&pacer, n_in_flight));
+    assert(START == pacer_packet_scheduled(&pacer, n_in_flight++, 0,
+                                                        get_tx_time, NULL));
+    assert(!pacer_can_schedule(&pacer, n_in_flight));
+    assert(pacer_next_tick(&pacer) == pacer_next_sched(&pacer));
+
+    pacer_cleanup(&pacer);
+}
+
+
+/* With a horizon, packets are scheduled ahead, each with its own departure
+ * time, and the connection needs to tick only when the horizon has moved.
+ */
+static void
+test_horizon (void)
+{
+    struct pacer pacer;
+    lsquic_time_t departure, prev;
+    unsigned n_in_flight, n_paced;
+
+    pacer_init(&pacer, 0, 100000);
+    pacer_set_horizon(&pacer, HORIZON);
+    pacer_tick(&pacer, START);
+    n_in_flight = schedule_burst(&pacer);
+
+    prev = 0;
+    for (n_paced = 0; pacer_can_schedule(&pacer, n_in_flight); ++n_paced)
+    {
+        departure = pacer_packet_scheduled(&pacer, n_in_flight++, 0,
+                                                        get_tx_time, NULL);
+        assert(departure >= START);
+        assert(departure <= START + HORIZON);
+        if (prev)
+            assert(departure == prev + TX_TIME);
+        prev = departure;
+    }
+    assert(HORIZON / TX_TIME + 1 == n_paced);
+    assert(pacer_next_tick(&pacer) > START);
+    assert(pacer_next_tick(&pacer) + HORIZON == pacer_next_sched(&pacer));
+
+    /* Next tick comes late: packets that should have left already are sent
+     * right away, that is, their departure time is in the past.
+     */
+    pacer_tick(&pacer, pacer_next_tick(&pacer) + HORIZON);
+    assert(pacer_can_schedule(&pacer, n_in_flight));
+    departure = pacer_packet_scheduled(&pacer, n_in_flight++, 0,
+                                                        get_tx_time, NULL);
+    assert(departure == prev + TX_TIME);
+
+    pacer_cleanup(&pacer);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    int opt;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    while (-1 != (opt = getopt(argc, argv, "l:")))
+    {
+        switch (opt)
+        {
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            exit(EXIT_FAILURE);
+            break;
+        }
+    }
+
+    test_no_horizon();
+    test_horizon();
+
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,104 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test lsquic_engine_packets_in(): packets that are not processed by a
+ * connection are skipped, the same way lsquic_engine_packet_in() rejects
+ * them one at a time.  Also test lsquic_cid_from_packet().
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#else
+#include <winsock2.h>
+#endif
+
+#include "lsquic.h"
+#include "lsquic_int_types.h"
+#include "lsquic_packet_common.h"
+
+
+int
+main (void)
+{
+    struct lsquic_engine_settings settings;
+    lsquic_engine_t *engine;
+    struct sockaddr_in local, peer;
+    struct lsquic_in_spec specs[4];
+    lsquic_cid_t cid;
+    unsigned n_proc, i;
+    int s;
+    const unsigned flags = 0;
+    static unsigned char too_big[QUIC_MAX_PACKET_SZ + 1];
+    static const unsigned char bad_flags[] = { 0x80, 0x01, };
+    static const unsigned char no_conn[] = {
+        0x08,                                   /* 8-byte CID, 1-byte PN */
+        0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+        0x01,
+        0x00, 0x00, 0x00, 0x00,
+    };
+    static const unsigned char no_cid[] = { 0x00, 0x01, 0x00, 0x00, };
+    static const struct {
+        const unsigned char *buf;
+        size_t               sz;
+        int                  packet_in_retval;
+    } packets[] = {
+        { too_big,      sizeof(too_big),    -1, },
+        { bad_flags,    sizeof(bad_flags),  -1, },
+        { no_conn,      sizeof(no_conn),     1, },
+        { no_cid,       sizeof(no_cid),      1, },
+    };
+
+    lsquic_engine_init_settings(&settings, flags);
+
+    struct lsquic_engine_api api = {
+        .ea_settings    = &settings,
+        /* Not called: */
+        .ea_packets_out = (void *) (uintptr_t) 1,
+    };
+
+    engine = lsquic_engine_new(flags, &api);
+    assert(engine);
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(12345);
+    peer = local;
+    peer.sin_port = htons(443);
+
+    for (i = 0; i < sizeof(packets) / sizeof(packets[0]); ++i)
+    {
+        specs[i].buf      = packets[i].buf;
+        specs[i].sz       = packets[i].sz;
+        specs[i].local_sa = (struct sockaddr *) &local;
+        specs[i].peer_sa  = (struct sockaddr *) &peer;
+        specs[i].peer_ctx = NULL;
+        s = lsquic_engine_packet_in(engine, specs[i].buf, specs[i].sz,
+                        specs[i].local_sa, specs[i].peer_sa, NULL);
+        assert(s == packets[i].packet_in_retval);
+    }
+
+    s = lsquic_cid_from_packet(no_conn, sizeof(no_conn), &cid);
+    assert(0 == s);
+    assert(0 == memcmp(&cid, no_conn + 1, sizeof(cid)));
+    s = lsquic_cid_from_packet(no_conn, 1 + sizeof(cid) - 1, &cid);
+    assert(-1 == s);
+    s = lsquic_cid_from_packet(no_cid, sizeof(no_cid), &cid);
+    assert(-1 == s);
+
+    n_proc = lsquic_engine_packets_in(engine, specs, 0);
+    assert(0 == n_proc);
+
+    n_proc = lsquic_engine_packets_in(engine, specs,
+                                        sizeof(packets) / sizeof(packets[0]));
+    assert(0 == n_proc);
+    assert(!lsquic_engine_has_unsent_packets(engine));
+
+    lsquic_engine_destroy(engine);
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "lsquic.h"
+#include "lsquic_int_types.h"
+#include "lsquic_types.h"
+#include "lsquic_prr.h"
+#include "lsquic_logger.h"
+
+#define MSS 1000
+
+
+/* Send as much as PRR allows.  Returns number of packets sent. */
+static unsigned
+send_packets (struct lsquic_prr *prr, unsigned long *pipe)
+{
+    unsigned n_sent = 0;
+
+    while (lsquic_prr_can_send(prr))
+    {
+        lsquic_prr_sent(prr, MSS);
+        *pipe += MSS;
+        ++n_sent;
+    }
+
+    return n_sent;
+}
+
+
+/* The example from RFC 6937, Section 4: one packet out of twenty is lost
+ * and ssthresh is half of the flight size.  PRR sends about one packet for
+ * every two packets acknowledged, so that there is no pause in sending
+ * followed by a burst, and bytes in flight arrive at ssthresh when recovery
+ * ends.
+ */
+static void
+test_proportional (void)
+{
+    struct lsquic_prr prr;
+    unsigned long pipe;
+    unsigned i, n_sent, total;
+
+    pipe = 19 * MSS;
+    lsquic_prr_init(&prr, 0, MSS, 20 * MSS, 10 * MSS);
+
+    total = 0;
+    for (i = 0; i < 19; ++i)
+    {
+        pipe -= MSS;
+        lsquic_prr_ack(&prr, MSS, pipe);
+        n_sent = send_packets(&prr, &pipe);
+        assert(n_sent <= 1);
+        assert(pipe + MSS >= 10 * MSS);
+        total += n_sent;
+    }
+
+    assert(10 == total);
+    assert(10 * MSS == pipe);
+}
+
+
+/* When many packets are lost, bytes in flight fall below ssthresh.  PRR
+ * then grows them back no faster than slow start would, that is, by at
+ * most one extra packet per ACK, and never above ssthresh.
+ */
+static void
+test_slow_start_reduction_bound (void)
+{
+    struct lsquic_prr prr;
+    unsigned long pipe;
+    unsigned i, n_sent;
+
+    pipe = 4 * MSS;
+    lsquic_prr_init(&prr, 0, MSS, 20 * MSS, 10 * MSS);
+
+    for (i = 0; i < 10; ++i)
+    {
+        pipe -= MSS;
+        lsquic_prr_ack(&prr, MSS, pipe);
+        n_sent = send_packets(&prr, &pipe);
+        assert(n_sent <= 2);
+        assert(pipe <= 10 * MSS);
+    }
+
+    assert(10 * MSS == pipe);
+}
+
+
+/* The lost packet is retransmitted right away, even if ACK that started
+ * recovery does not allow to send anything yet.
+ */
+static void
+test_fast_retransmit (void)
+{
+    struct lsquic_prr prr;
+    unsigned long pipe;
+
+    pipe = 99 * MSS;
+    lsquic_prr_init(&prr, 0, MSS, 100 * MSS, 50 * MSS);
+    assert(lsquic_prr_can_send(&prr));
+
+    /* Half a packet's worth */
+    pipe -= MSS;
+    lsquic_prr_ack(&prr, MSS / 2, pipe);
+    assert(1 == send_packets(&prr, &pipe));
+
+    /* Not enough has been delivered to send another one */
+    pipe -= MSS;
+    lsquic_prr_ack(&prr, MSS / 2, pipe);
+    assert(0 == send_packets(&prr, &pipe));
+}
+
+
+int
+main (int argc, char **argv)
+{
+    int opt;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    while (-1 != (opt = getopt(argc, argv, "l:")))
+    {
+        switch (opt)
+        {
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            exit(EXIT_FAILURE);
+            break;
+        }
+    }
+
+    test_proportional();
+    test_slow_start_reduction_bound();
+    test_fast_retransmit();
+
+    exit(EXIT_SUCCESS);
+}
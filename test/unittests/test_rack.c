@@ -0,0 +1,154 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test time-threshold loss detection in the send controller: a packet
+ * sent before the largest acked packet is lost once RTT plus reordering
+ * window has passed since it was sent.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "send_ctl_fixture.h"
+
+#define RTT 50000
+
+#define RETX_EXPIRY(tobjs) ((tobjs)->alset.as_expiry[AL_RETX])
+
+
+/* Tail of a short response: packet 3 of 4 is lost.  There are not enough
+ * packets after it for FACK; the loss is detected by the timer a quarter
+ * of min_rtt after the time it should have been acked.
+ */
+static void
+test_tail_loss (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_send_ctl *const ctl = &tobjs.send_ctl;
+    lsquic_time_t sent;
+    unsigned long cwnd;
+
+    init_test_objs(&tobjs);
+
+    sent = tobjs.now;
+    send_packets(&tobjs, 4);
+    cwnd = CWND(&tobjs);
+
+    tobjs.now += RTT;
+    ACK(&tobjs, P(4), P(4), P(2), P(1));
+    assert(RTT == ctl->sc_rack_rtt);
+    assert(TAILQ_EMPTY(&ctl->sc_lost_packets));
+    assert(sent + RTT + RTT / 4 == ctl->sc_loss_time);
+    assert(lsquic_alarmset_is_set(&tobjs.alset, AL_RETX));
+    assert(RETX_EXPIRY(&tobjs) == ctl->sc_loss_time);
+
+    tobjs.now = RETX_EXPIRY(&tobjs) + 1;
+    lsquic_alarmset_ring_expired(&tobjs.alset, tobjs.now);
+    assert(!TAILQ_EMPTY(&ctl->sc_lost_packets));
+    assert(3 == TAILQ_FIRST(&ctl->sc_lost_packets)->po_packno);
+    assert(0 == ctl->sc_loss_time);
+    assert(CWND(&tobjs) < cwnd);
+    assert(lsquic_sentwin_empty(&ctl->sc_unacked));
+
+    deinit_test_objs(&tobjs);
+}
+
+
+/* A packet sent long before the largest acked packet is lost right away,
+ * even though only one packet is acked after it.
+ */
+static void
+test_sent_long_ago (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_send_ctl *const ctl = &tobjs.send_ctl;
+
+    init_test_objs(&tobjs);
+
+    send_packets(&tobjs, 1);
+    tobjs.now += 2 * RTT;
+    send_packets(&tobjs, 1);
+
+    tobjs.now += RTT;
+    ACK(&tobjs, P(2), P(2));
+    assert(RTT == ctl->sc_rack_rtt);
+    assert(!TAILQ_EMPTY(&ctl->sc_lost_packets));
+    assert(1 == TAILQ_FIRST(&ctl->sc_lost_packets)->po_packno);
+    assert(0 == ctl->sc_loss_time);
+
+    deinit_test_objs(&tobjs);
+}
+
+
+/* A spurious loss widens the reordering window */
+static void
+test_reo_wnd (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_send_ctl *const ctl = &tobjs.send_ctl;
+    lsquic_time_t sent;
+
+    init_test_objs(&tobjs);
+
+    send_packets(&tobjs, 4);
+    tobjs.now += RTT;
+    ACK(&tobjs, P(4), P(4), P(2), P(1));
+    tobjs.now = RETX_EXPIRY(&tobjs) + 1;
+    lsquic_alarmset_ring_expired(&tobjs.alset, tobjs.now);
+    assert(ctl->sc_flags & SC_UNDO);
+
+    /* Packet 3 was only delayed */
+    ACK(&tobjs, P(4), P(1));
+    assert(!(ctl->sc_flags & SC_UNDO));
+    assert(TAILQ_EMPTY(&ctl->sc_lost_packets));
+    assert(2 == ctl->sc_reo_wnd_mult);
+
+    sent = tobjs.now;
+    send_packets(&tobjs, 4);
+    tobjs.now += RTT;
+    ACK(&tobjs, P(8), P(8), P(6), P(5));
+    assert(TAILQ_EMPTY(&ctl->sc_lost_packets));
+    assert(sent + RTT + RTT / 2 == ctl->sc_loss_time);
+
+    /* The window is never larger than srtt */
+    ctl->sc_reo_wnd_mult = 100;
+    ACK(&tobjs, P(8), P(5));
+    send_packets(&tobjs, 2);
+    tobjs.now += RTT;
+    ACK(&tobjs, P(10), P(10));
+    assert(tobjs.now - RTT + 2 * RTT == ctl->sc_loss_time);
+
+    deinit_test_objs(&tobjs);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    int opt;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    while (-1 != (opt = getopt(argc, argv, "l:")))
+    {
+        switch (opt)
+        {
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            exit(EXIT_FAILURE);
+            break;
+        }
+    }
+
+    test_tail_loss();
+    test_sent_long_ago();
+    test_reo_wnd();
+
+    exit(EXIT_SUCCESS);
+}
@@ -164,6 +164,132 @@ test5 (void)
 }
 
 
+/* Returns the number of ranges; the smallest range is placed into `low' */
+static unsigned
+count_ranges (lsquic_rechist_t *rechist, struct lsquic_packno_range *low)
+{
+    const struct lsquic_packno_range *range;
+    unsigned count;
+
+    count = 0;
+    for (range = lsquic_rechist_first(rechist); range;
+                                        range = lsquic_rechist_next(rechist))
+    {
+        ++count;
+        *low = *range;
+    }
+
+    return count;
+}
+
+
+/* The number of ranges is bounded: when a new range does not fit, the
+ * smallest range is forgotten.
+ */
+static void
+test_max_ranges (void)
+{
+    lsquic_rechist_t rechist;
+    struct lsquic_packno_range low;
+    enum received_st st;
+    lsquic_packno_t packno;
+
+    lsquic_rechist_init(&rechist, 0);
+
+    /* Every other packet is lost */
+    for (packno = 3; packno <= 2 * LSQUIC_RECHIST_MAX_RANGES + 1; packno += 2)
+    {
+        st = lsquic_rechist_received(&rechist, packno, 0);
+        assert(st == REC_ST_OK);
+    }
+    assert(LSQUIC_RECHIST_MAX_RANGES == count_ranges(&rechist, &low));
+
+    /* A packet that would become the smallest range cannot be tracked */
+    st = lsquic_rechist_received(&rechist, 1, 0);
+    assert(st == REC_ST_DUP);
+    assert(LSQUIC_RECHIST_MAX_RANGES == count_ranges(&rechist, &low));
+    assert(low.low == 3 && low.high == 3);
+
+    /* Filling a gap merges two ranges, making room for one more */
+    st = lsquic_rechist_received(&rechist, 4, 0);
+    assert(st == REC_ST_OK);
+    st = lsquic_rechist_received(&rechist, 2 * LSQUIC_RECHIST_MAX_RANGES + 3,
+                                                                        0);
+    assert(st == REC_ST_OK);
+    assert(LSQUIC_RECHIST_MAX_RANGES == count_ranges(&rechist, &low));
+    assert(low.low == 3 && low.high == 5);
+
+    /* No more room: smallest range is forgotten */
+    st = lsquic_rechist_received(&rechist, 2 * LSQUIC_RECHIST_MAX_RANGES + 5,
+                                                                        0);
+    assert(st == REC_ST_OK);
+    assert(LSQUIC_RECHIST_MAX_RANGES == count_ranges(&rechist, &low));
+    assert(low.low == 7 && low.high == 7);
+    assert(lsquic_rechist_largest_packno(&rechist)
+                                    == 2 * LSQUIC_RECHIST_MAX_RANGES + 5);
+
+    /* Packets in the forgotten range are now treated as duplicates.  This
+     * is not the cutoff set by peer.
+     */
+    st = lsquic_rechist_received(&rechist, 5, 0);
+    assert(st == REC_ST_DUP);
+    assert(0 == lsquic_rechist_cutoff(&rechist));
+    st = lsquic_rechist_received(&rechist, 8, 0);
+    assert(st == REC_ST_OK);
+    assert(LSQUIC_RECHIST_MAX_RANGES - 1 == count_ranges(&rechist, &low));
+    assert(low.low == 7 && low.high == 9);
+
+    lsquic_rechist_stop_wait(&rechist, 100);
+    assert(100 == lsquic_rechist_cutoff(&rechist));
+    (void) count_ranges(&rechist, &low);
+    assert(low.low == 101);
+    assert(lsquic_rechist_mem_used(&rechist) <= sizeof(rechist)
+            + LSQUIC_RECHIST_MAX_RANGES * sizeof(struct lsquic_packno_range));
+
+    lsquic_rechist_cleanup(&rechist);
+}
+
+
+/* lsquic_rechist_check() gives the same answer as lsquic_rechist_received()
+ * without changing the history.
+ */
+static void
+test_check (void)
+{
+    lsquic_rechist_t rechist;
+    struct lsquic_packno_range low;
+    lsquic_packno_t packno;
+    unsigned version;
+
+    lsquic_rechist_init(&rechist, 0);
+
+    assert(REC_ST_ERR == lsquic_rechist_check(&rechist, 0));
+    assert(REC_ST_OK == lsquic_rechist_check(&rechist, 1));
+
+    for (packno = 1; packno <= 100; ++packno)
+        if (packno % 10)
+            (void) lsquic_rechist_received(&rechist, packno, 0);
+
+    version = lsquic_rechist_version(&rechist);
+    for (packno = 1; packno <= 110; ++packno)
+        if (packno % 10 && packno <= 100)
+            assert(REC_ST_DUP == lsquic_rechist_check(&rechist, packno));
+        else
+            assert(REC_ST_OK == lsquic_rechist_check(&rechist, packno));
+    assert(version == lsquic_rechist_version(&rechist));
+    assert(10 == count_ranges(&rechist, &low));
+
+    lsquic_rechist_stop_wait(&rechist, 50);
+    assert(REC_ST_DUP == lsquic_rechist_check(&rechist, 40));
+    assert(REC_ST_DUP == lsquic_rechist_check(&rechist, 49));
+    assert(REC_ST_OK == lsquic_rechist_check(&rechist, 50));
+    assert(REC_ST_DUP == lsquic_rechist_check(&rechist, 51));
+    assert(REC_ST_OK == lsquic_rechist_check(&rechist, 60));
+
+    lsquic_rechist_cleanup(&rechist);
+}
+
+
 int
 main (void)
 {
@@ -251,5 +377,8 @@ main (void)
 
     test5();
 
+    test_max_ranges();
+    test_check();
+
     return 0;
 }
@@ -28,6 +28,12 @@ main (void)
     lsquic_rtt_stats_update(&stats, received - sent, 0);
     assert(("Second RTT checks out",
                             937500 == lsquic_rtt_stats_get_srtt(&stats)));
+    assert(("Minimum RTT checks out",
+                            500000 == lsquic_rtt_stats_get_min_rtt(&stats)));
+    sent = TV(2, 0), received = TV(3, 0);
+    lsquic_rtt_stats_update(&stats, received - sent, 600000);
+    assert(("Minimum RTT is not adjusted for ACK delay",
+                            500000 == lsquic_rtt_stats_get_min_rtt(&stats)));
 
     return 0;
 }
@@ -0,0 +1,144 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_sentwin.h"
+
+#define N_PACKETS 1000
+
+
+static struct lsquic_packet_out packets[N_PACKETS + 1];
+
+
+static void
+add (struct lsquic_sentwin *win, lsquic_packno_t packno)
+{
+    int s;
+
+    assert(packno <= N_PACKETS);
+    packets[packno].po_packno = packno;
+    packets[packno].po_sent = packno * 10;
+    if (packno & 1)
+        packets[packno].po_frame_types = 1 << QUIC_FRAME_STREAM;
+    else
+        packets[packno].po_frame_types = 1 << QUIC_FRAME_ACK;
+    s = lsquic_sentwin_add(win, &packets[packno]);
+    assert(0 == s);
+}
+
+
+/* Remove packets out of order and check that the window shrinks from the
+ * bottom only when the smallest packet is gone.
+ */
+static void
+test_remove (void)
+{
+    struct lsquic_sentwin win;
+    const struct sentwin_slot *slot;
+    lsquic_packno_t packno;
+
+    lsquic_sentwin_init(&win);
+    assert(lsquic_sentwin_empty(&win));
+
+    for (packno = 1; packno <= 10; ++packno)
+        add(&win, packno);
+    assert(10 == lsquic_sentwin_count(&win));
+    assert(1 == lsquic_sentwin_first(&win));
+    assert(10 == lsquic_sentwin_last(&win));
+
+    slot = lsquic_sentwin_slot(&win, 3);
+    assert(slot->ss_packet == &packets[3]);
+    assert(slot->ss_sent == 30);
+    assert(slot->ss_flags & SWS_RETX);
+    assert(!(lsquic_sentwin_slot(&win, 4)->ss_flags & SWS_RETX));
+
+    lsquic_sentwin_remove(&win, 2);
+    lsquic_sentwin_remove(&win, 3);
+    assert(1 == lsquic_sentwin_first(&win));
+    assert(NULL == lsquic_sentwin_get(&win, 2));
+    lsquic_sentwin_remove(&win, 1);
+    assert(4 == lsquic_sentwin_first(&win));
+    assert(7 == lsquic_sentwin_count(&win));
+
+    for (packno = 4; packno <= 10; ++packno)
+        lsquic_sentwin_remove(&win, packno);
+    assert(lsquic_sentwin_empty(&win));
+    assert(NULL == lsquic_sentwin_get(&win, 10));
+
+    /* Gap in packet numbers */
+    add(&win, 15);
+    add(&win, 20);
+    assert(15 == lsquic_sentwin_first(&win));
+    assert(NULL == lsquic_sentwin_get(&win, 17));
+    lsquic_sentwin_remove(&win, 15);
+    assert(20 == lsquic_sentwin_first(&win));
+    assert(&packets[20] == lsquic_sentwin_get(&win, 20));
+
+    lsquic_sentwin_cleanup(&win);
+}
+
+
+/* The window slides and wraps around the ring; when it is too small, it
+ * grows and packets stay where they are expected.
+ */
+static void
+test_grow (void)
+{
+    struct lsquic_sentwin win;
+    lsquic_packno_t packno, next;
+
+    lsquic_sentwin_init(&win);
+
+    /* Keep ten packets in flight: the ring should not grow */
+    for (packno = 1; packno <= 100; ++packno)
+    {
+        add(&win, packno);
+        if (packno > 10)
+            lsquic_sentwin_remove(&win, packno - 10);
+    }
+    assert(10 == lsquic_sentwin_count(&win));
+    assert(91 == lsquic_sentwin_first(&win));
+    assert(win.sw_nalloc < 32);
+
+    /* Now leave the smallest packet unacknowledged */
+    next = 101;
+    for (packno = 92; packno <= 100; ++packno)
+        lsquic_sentwin_remove(&win, packno);
+    while (next <= N_PACKETS)
+    {
+        add(&win, next);
+        if (next - 5 > 100)
+            lsquic_sentwin_remove(&win, next - 5);
+        ++next;
+    }
+    assert(91 == lsquic_sentwin_first(&win));
+    assert(6 == lsquic_sentwin_count(&win));
+    assert(win.sw_nalloc >= N_PACKETS - 91 + 1);
+    assert(&packets[91] == lsquic_sentwin_get(&win, 91));
+    for (packno = N_PACKETS - 4; packno <= N_PACKETS; ++packno)
+        assert(&packets[packno] == lsquic_sentwin_get(&win, packno));
+    for (packno = 92; packno < N_PACKETS - 4; ++packno)
+        assert(NULL == lsquic_sentwin_get(&win, packno));
+
+    lsquic_sentwin_remove(&win, 91);
+    assert(N_PACKETS - 4 == lsquic_sentwin_first(&win));
+
+    lsquic_sentwin_cleanup(&win);
+}
+
+
+int
+main (void)
+{
+    test_remove();
+    test_grow();
+
+    return 0;
+}
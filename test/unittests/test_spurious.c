@@ -0,0 +1,176 @@
+/* Copyright (c) 2017 - 2018 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test spurious loss detection in the send controller: when a packet
+ * declared lost is acknowledged later, the cutback is undone and the
+ * reordering threshold is raised.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "send_ctl_fixture.h"
+
+#define RTT 50000
+
+/* Each ACK arrives one RTT after the previous event */
+#define ACK_LATER(tobjs, ...) ((tobjs)->now += RTT, ACK(tobjs, __VA_ARGS__))
+
+
+/* Packet 2 is declared lost by FACK, but it is only reordered */
+static void
+test_reordering (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_send_ctl *const ctl = &tobjs.send_ctl;
+    unsigned long cwnd;
+
+    init_test_objs(&tobjs);
+
+    send_packets(&tobjs, 10);
+    ACK_LATER(&tobjs, P(1), P(1));
+    cwnd = CWND(&tobjs);
+
+    ACK_LATER(&tobjs, P(10), P(3), P(1), P(1));
+    assert(CWND(&tobjs) < cwnd);
+    assert(ctl->sc_flags & SC_UNDO);
+    assert(1 == ctl->sc_n_lost_recs);
+    assert(!TAILQ_EMPTY(&ctl->sc_lost_packets));
+    /* Peer is asked to keep acknowledging packet 2 */
+    assert(2 == lsquic_send_ctl_smallest_unacked(ctl));
+
+    /* Packet 2 arrives */
+    ACK_LATER(&tobjs, P(10), P(1));
+    assert(CWND(&tobjs) >= cwnd);
+    assert(!(ctl->sc_flags & SC_UNDO));
+    assert(0 == ctl->sc_largest_sent_at_cutback);
+    /* It has not been retransmitted and is no longer needed */
+    assert(TAILQ_EMPTY(&ctl->sc_lost_packets));
+    assert(11 == lsquic_send_ctl_smallest_unacked(ctl));
+#if LSQUIC_SEND_STATS
+    assert(1 == ctl->sc_stats.n_spurious);
+#endif
+    assert(8 == ctl->sc_reord_thresh);
+
+    /* The threshold is raised: the same amount of reordering does not
+     * cause a loss.
+     */
+    send_packets(&tobjs, 10);
+    ACK_LATER(&tobjs, P(19), P(13), P(11), P(11));
+    assert(!(ctl->sc_flags & SC_UNDO));
+    assert(TAILQ_EMPTY(&ctl->sc_lost_packets));
+    ACK_LATER(&tobjs, P(20), P(11));
+    assert(lsquic_sentwin_empty(&ctl->sc_unacked));
+
+    deinit_test_objs(&tobjs);
+}
+
+
+/* Packet lost for real: once a packet sent after the cutback is acked,
+ * the cutback stays.
+ */
+static void
+test_real_loss (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_send_ctl *const ctl = &tobjs.send_ctl;
+    unsigned long cwnd;
+
+    init_test_objs(&tobjs);
+
+    send_packets(&tobjs, 10);
+    ACK_LATER(&tobjs, P(1), P(1));
+    ACK_LATER(&tobjs, P(10), P(3), P(1), P(1));
+    cwnd = CWND(&tobjs);
+    assert(ctl->sc_flags & SC_UNDO);
+
+    send_packets(&tobjs, 1);
+    ACK_LATER(&tobjs, P(11), P(3), P(1), P(1));
+    assert(!(ctl->sc_flags & SC_UNDO));
+    assert(0 == ctl->sc_n_lost_recs);
+    assert(CWND(&tobjs) >= cwnd);
+
+    /* Too late: this does not count */
+    ACK_LATER(&tobjs, P(11), P(1));
+    assert(CWND(&tobjs) < cwnd + 3 * TCP_MSS);
+#if LSQUIC_SEND_STATS
+    assert(0 == ctl->sc_stats.n_spurious);
+#endif
+    assert(3 == ctl->sc_reord_thresh);    /* Not raised */
+
+    deinit_test_objs(&tobjs);
+}
+
+
+/* Retransmission timeout fires, but the original packets arrive */
+static void
+test_spurious_rto (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_send_ctl *const ctl = &tobjs.send_ctl;
+    unsigned long cwnd, ssthresh;
+    unsigned n_rings;
+
+    init_test_objs(&tobjs);
+
+    /* Grow cwnd so that RTO reduces it */
+    send_packets(&tobjs, 10);
+    ACK_LATER(&tobjs, P(10), P(1));
+    cwnd = CWND(&tobjs);
+    ssthresh = lsquic_cubic_get_ssthresh(&ctl->sc_cong_u.cubic);
+
+    send_packets(&tobjs, 10);
+    /* Two tail loss probes, then RTO */
+    for (n_rings = 0; 0 == ctl->sc_n_consec_rtos; ++n_rings)
+    {
+        assert(lsquic_alarmset_is_set(&tobjs.alset, AL_RETX));
+        tobjs.now += 60000000;
+        lsquic_alarmset_ring_expired(&tobjs.alset, tobjs.now);
+    }
+    assert(3 == n_rings);
+    assert(CWND(&tobjs) < cwnd);
+    assert(ctl->sc_flags & SC_UNDO_RTO);
+    assert(lsquic_sentwin_empty(&ctl->sc_unacked));
+
+    ACK_LATER(&tobjs, P(20), P(1));
+    assert(CWND(&tobjs) == cwnd);
+    assert(lsquic_cubic_get_ssthresh(&ctl->sc_cong_u.cubic) == ssthresh);
+    assert(!(ctl->sc_flags & (SC_UNDO|SC_UNDO_RTO)));
+#if LSQUIC_SEND_STATS
+    assert(ctl->sc_stats.n_spurious > 0);
+#endif
+
+    deinit_test_objs(&tobjs);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    int opt;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    while (-1 != (opt = getopt(argc, argv, "l:")))
+    {
+        switch (opt)
+        {
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            exit(EXIT_FAILURE);
+            break;
+        }
+    }
+
+    test_reordering();
+    test_real_loss();
+    test_spurious_rto();
+
+    exit(EXIT_SUCCESS);
+}
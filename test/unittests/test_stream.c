@@ -32,8 +32,13 @@
 #include "lsquic_conn.h"
 #include "lsquic_engine_public.h"
 #include "lsquic_cubic.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_bbr.h"
+#include "lsquic_prr.h"
 #include "lsquic_pacer.h"
 #include "lsquic_senhist.h"
+#include "lsquic_sentwin.h"
 #include "lsquic_send_ctl.h"
 #include "lsquic_ver_neg.h"
 #include "lsquic_packet_out.h"
@@ -172,13 +177,9 @@ static void
 ack_packet (lsquic_send_ctl_t *send_ctl, lsquic_packno_t packno)
 {
     struct lsquic_packet_out *packet_out;
-    TAILQ_FOREACH(packet_out, &send_ctl->sc_unacked_packets, po_next)
-        if (packet_out->po_packno == packno)
-        {
-            lsquic_packet_out_ack_streams(packet_out);
-            return;
-        }
-    assert(0);
+    packet_out = lsquic_sentwin_get(&send_ctl->sc_unacked, packno);
+    assert(packet_out);
+    lsquic_packet_out_ack_streams(packet_out);
 }
 
 
@@ -276,13 +277,13 @@ init_test_objs (struct test_objs *tobjs, unsigned initial_conn_window,
     TAILQ_INIT(&tobjs->conn_pub.read_streams);
     TAILQ_INIT(&tobjs->conn_pub.write_streams);
     TAILQ_INIT(&tobjs->conn_pub.service_streams);
-    lsquic_cfcw_init(&tobjs->conn_pub.cfcw, &tobjs->conn_pub,
-                                                    initial_conn_window);
     lsquic_conn_cap_init(&tobjs->conn_pub.conn_cap, initial_conn_window);
     lsquic_alarmset_init(&tobjs->alset, 0);
     tobjs->conn_pub.mm = &tobjs->eng_pub.enp_mm;
     tobjs->conn_pub.lconn = &tobjs->lconn;
     tobjs->conn_pub.enpub = &tobjs->eng_pub;
+    lsquic_cfcw_init(&tobjs->conn_pub.cfcw, &tobjs->conn_pub,
+                                                    initial_conn_window);
     tobjs->conn_pub.send_ctl = &tobjs->send_ctl;
     tobjs->conn_pub.packet_out_malo =
                         lsquic_malo_create(sizeof(struct lsquic_packet_out));
@@ -1165,6 +1166,99 @@ test_writev (void)
 }
 
 
+static void
+release_buf (void *ctx)
+{
+    ++*(unsigned *) ctx;
+}
+
+
+/* Data written by reference is not copied to the stream buffer */
+static void
+test_write_nobuf (void)
+{
+    struct test_objs tobjs;
+    lsquic_stream_t *stream;
+    unsigned char buf_in[0x4000];
+    unsigned char buf_out[0x4000];
+    unsigned i, n_released;
+    ssize_t n;
+    int fin;
+
+    for (i = 0; i < sizeof(buf_in); ++i)
+        buf_in[i] = i * 7;
+
+    init_test_objs(&tobjs, UINT_MAX, UINT_MAX);
+    stream = new_stream(&tobjs, 12345);
+    n_released = 0;
+
+    /* Small writes are kept by reference */
+    n = lsquic_stream_write_nobuf(stream, buf_in, 100, release_buf, &n_released);
+    assert(100 == n);
+    n = lsquic_stream_write_nobuf(stream, buf_in + 100, 100, release_buf,
+                                                                &n_released);
+    assert(100 == n);
+    assert(0 == n_released);
+    assert(200 == stream->sm_n_buffered);
+    assert(NULL == stream->sm_buf);
+
+    /* Regular write copies referenced data to the buffer first */
+    n = lsquic_stream_write(stream, buf_in + 200, 100);
+    assert(100 == n);
+    assert(2 == n_released);
+    assert(300 == stream->sm_n_buffered);
+    assert(stream->sm_buf);
+
+    /* Data following copied data is copied, too */
+    n = lsquic_stream_write_nobuf(stream, buf_in + 300, 100, release_buf,
+                                                                &n_released);
+    assert(100 == n);
+    assert(3 == n_released);
+    assert(400 == stream->sm_n_buffered);
+
+    lsquic_stream_flush(stream);
+    assert(0 == stream->sm_n_buffered);
+
+    /* Large write packetizes data referenced before it */
+    n = lsquic_stream_write_nobuf(stream, buf_in + 400, 100, release_buf,
+                                                                &n_released);
+    assert(100 == n);
+    assert(3 == n_released);
+    n = lsquic_stream_write_nobuf(stream, buf_in + 500, sizeof(buf_in) - 500,
+                                                release_buf, &n_released);
+    assert(sizeof(buf_in) - 500 == (size_t) n);
+    /* With 1370-byte packets, the tail of the last write does not fill a
+     * packet: it is still buffered and its reference is still held.
+     */
+    assert(4 == n_released);
+    assert(stream->sm_n_buffered > 0);
+    lsquic_stream_flush(stream);
+    assert(5 == n_released);
+
+    n = read_from_scheduled_packets(&tobjs.send_ctl, stream->id, buf_out,
+                                                sizeof(buf_out), 0, &fin, 0);
+    assert(sizeof(buf_in) == (size_t) n);
+    assert(0 == memcmp(buf_out, buf_in, sizeof(buf_in)));
+    assert(!fin);
+
+    /* Stream is flow-control blocked: no reference is taken */
+    n = lsquic_stream_write_nobuf(stream, buf_in, 10, release_buf, &n_released);
+    assert(0 == n);
+    assert(5 == n_released);
+    lsquic_stream_destroy(stream);
+
+    /* References are released when the stream is destroyed */
+    stream = new_stream(&tobjs, 12347);
+    n = lsquic_stream_write_nobuf(stream, buf_in, 10, release_buf, &n_released);
+    assert(10 == n);
+    assert(5 == n_released);
+    lsquic_stream_destroy(stream);
+    assert(6 == n_released);
+
+    deinit_test_objs(&tobjs);
+}
+
+
 static void
 test_prio_conversion (void)
 {
@@ -1238,6 +1332,167 @@ test_read_in_middle (void)
 }
 
 
+struct readf_ctx
+{
+    unsigned char   buf[0x100];
+    size_t          off;
+    size_t          max;    /* Maximum number of bytes to consume per call */
+    unsigned        n_calls;
+    int             fin;
+};
+
+
+static size_t
+readf_cb (void *ctx_p, const unsigned char *buf, size_t len, int fin)
+{
+    struct readf_ctx *const ctx = ctx_p;
+
+    ++ctx->n_calls;
+    if (len > ctx->max)
+        len = ctx->max;
+    else if (fin)
+        ctx->fin = 1;
+    memcpy(ctx->buf + ctx->off, buf, len);
+    ctx->off += len;
+    return len;
+}
+
+
+/* Data is passed to the readf callback straight from the frames; only what
+ * the callback consumes is read.
+ */
+static void
+test_readf (void)
+{
+    int s;
+    ssize_t nr;
+    const char data[] = "AAABBBCCCDDD";
+    struct test_objs tobjs;
+    struct readf_ctx ctx;
+    stream_frame_t *frame;
+
+    init_test_objs(&tobjs, 0x4000, 0x4000);
+    memset(&ctx, 0, sizeof(ctx));
+
+    lsquic_stream_t *stream = new_stream(&tobjs, 123);
+
+    nr = lsquic_stream_readf(stream, readf_cb, &ctx);
+    assert(-1 == nr && EWOULDBLOCK == errno);
+    assert(0 == ctx.n_calls);
+
+    frame = new_frame_in_ext(&tobjs, 0, 6, 0, &data[0]);
+    s = lsquic_stream_frame_in(stream, frame);
+    assert(0 == s);
+    frame = new_frame_in_ext(&tobjs, 6, 6, 1, &data[6]);
+    s = lsquic_stream_frame_in(stream, frame);
+    assert(0 == s);
+
+    /* Callback does not consume anything: nothing is read */
+    ctx.max = 0;
+    nr = lsquic_stream_readf(stream, readf_cb, &ctx);
+    assert(-1 == nr && EWOULDBLOCK == errno);
+    assert(1 == ctx.n_calls);
+    assert(0 == lsquic_stream_read_offset(stream));
+
+    /* Consume part of the first frame */
+    ctx.max = 4;
+    nr = lsquic_stream_readf(stream, readf_cb, &ctx);
+    assert(4 == nr);
+    assert(4 == lsquic_stream_read_offset(stream));
+    assert(4 == tobjs.conn_pub.cfcw.cf_read_off);
+    assert(0 == memcmp(ctx.buf, "AAAB", 4));
+
+    /* The rest, with FIN */
+    ctx.max = sizeof(ctx.buf);
+    nr = lsquic_stream_readf(stream, readf_cb, &ctx);
+    assert(8 == nr);
+    assert(ctx.fin);
+    assert(0 == memcmp(ctx.buf, data, 12));
+    assert(12 == lsquic_stream_read_offset(stream));
+    assert(12 == tobjs.conn_pub.cfcw.cf_read_off);
+
+    nr = lsquic_stream_readf(stream, readf_cb, &ctx);
+    assert(0 == nr);
+
+    lsquic_stream_destroy(stream);
+    deinit_test_objs(&tobjs);
+}
+
+
+/* Frames arrive in random order within groups and some arrive twice.
+ * Every group is read out in one go.
+ */
+static void
+test_reordered_frames (void)
+{
+    struct test_objs tobjs;
+    lsquic_stream_t *stream;
+    stream_frame_t *frame;
+    unsigned char *data, *buf;
+    unsigned offs[32], sizes[32], n_frames, i, j, tmp;
+    size_t off, group_start, read_off;
+    const size_t total = 0x100000 + 123;
+    ssize_t nr;
+    int s;
+
+    init_test_objs(&tobjs, 0x200000, 0x40000);
+    stream = new_stream(&tobjs, 123);
+    data = malloc(total);
+    buf = malloc(total);
+    for (off = 0; off < total; ++off)
+        data[off] = off * 7 + off / 1000;
+    srand(3141);
+
+    read_off = 0;
+    for (off = 0; off < total; )
+    {
+        group_start = off;
+        for (n_frames = 0; n_frames < sizeof(offs) / sizeof(offs[0])
+                                                && off < total; ++n_frames)
+        {
+            offs[n_frames] = off;
+            sizes[n_frames] = 1 + rand() % 1370;
+            if (sizes[n_frames] > total - off)
+                sizes[n_frames] = total - off;
+            off += sizes[n_frames];
+        }
+        for (i = n_frames - 1; i > 0; --i)
+        {
+            j = rand() % (i + 1);
+            tmp = offs[i]; offs[i] = offs[j]; offs[j] = tmp;
+            tmp = sizes[i]; sizes[i] = sizes[j]; sizes[j] = tmp;
+        }
+        for (i = 0; i < n_frames; ++i)
+        {
+            frame = new_frame_in_ext(&tobjs, offs[i], sizes[i],
+                        offs[i] + sizes[i] == total, &data[offs[i]]);
+            s = lsquic_stream_frame_in(stream, frame);
+            assert(("Inserted frame", 0 == s));
+            if (i % 5 == 4)
+            {
+                j = rand() % (i + 1);
+                frame = new_frame_in_ext(&tobjs, offs[j], sizes[j],
+                            offs[j] + sizes[j] == total, &data[offs[j]]);
+                s = lsquic_stream_frame_in(stream, frame);
+                assert(("Duplicate frame", 0 == s));
+            }
+        }
+        nr = lsquic_stream_read(stream, buf + read_off, total - read_off);
+        assert(nr == (ssize_t) (off - group_start));
+        read_off += nr;
+    }
+
+    assert(0 == memcmp(data, buf, total));
+    nr = lsquic_stream_read(stream, buf, total);
+    assert(0 == nr);
+
+    lsquic_stream_destroy(stream);
+    deinit_test_objs(&tobjs);
+    free(data);
+    free(buf);
+}
+
+
 /* Test that connection flow control does not go past the max when both
  * connection limited and unlimited streams are used.
  */
@@ -1313,7 +1568,7 @@ test_reading_from_stream2 (void)
     assert(("Invalid frame: FIN in the middle", -1 == s));
 
     /* Test for overlaps and DUPs: */
-    if (!(stream_ctor_flags & SCF_USE_DI_HASH))
+    if (!(stream_ctor_flags & (SCF_USE_DI_HASH|SCF_USE_DI_RING)))
     {
         int dup;
         unsigned offset, length;
@@ -2204,7 +2459,7 @@ main (int argc, char **argv)
 
     lsquic_global_init(LSQUIC_GLOBAL_SERVER);
 
-    while (-1 != (opt = getopt(argc, argv, "Ahl:")))
+    while (-1 != (opt = getopt(argc, argv, "Ahl:r")))
     {
         switch (opt)
         {
@@ -2217,6 +2472,9 @@ main (int argc, char **argv)
         case 'l':
             lsquic_logger_lopt(optarg);
             break;
+        case 'r':
+            stream_ctor_flags |= SCF_USE_DI_RING;
+            break;
         default:
             exit(1);
         }
@@ -2241,10 +2499,16 @@ main (int argc, char **argv)
 
     test_writev();
 
+    test_write_nobuf();
+
     test_prio_conversion();
 
     test_read_in_middle();
 
+    test_readf();
+
+    test_reordered_frames();
+
     test_conn_unlimited();
 
     test_flushing();
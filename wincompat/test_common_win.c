@@ -726,6 +726,13 @@ set_engine_option (struct lsquic_engine_settings *settings,
             return 0;
         }
         break;
+    case 3:
+        if (0 == strncmp(name, "prr", 3))
+        {
+            settings->es_prr = atoi(val);
+            return 0;
+        }
+        break;
     case 4:
         if (0 == strncmp(name, "cfcw", 4))
         {
@@ -743,6 +750,13 @@ set_engine_option (struct lsquic_engine_settings *settings,
             return 0;
         }
         break;
+    case 6:
+        if (0 == strncmp(name, "txtime", 6))
+        {
+            settings->es_txtime = atoi(val);
+            return 0;
+        }
+        break;
     case 7:
         if (0 == strncmp(name, "version", 7))
         {
@@ -782,6 +796,16 @@ set_engine_option (struct lsquic_engine_settings *settings,
             settings->es_rw_once = atoi(val);
             return 0;
         }
+        else if (0 == strncmp(name, "cc_algo", 7))
+        {
+            settings->es_cc_algo = atoi(val);
+            return 0;
+        }
+        else if (0 == strncmp(name, "hystart", 7))
+        {
+            settings->es_hystart = atoi(val);
+            return 0;
+        }
         break;
     case 8:
         if (0 == strncmp(name, "max_cfcw", 8))
@@ -795,6 +819,13 @@ set_engine_option (struct lsquic_engine_settings *settings,
             return 0;
         }
         break;
+    case 9:
+        if (0 == strncmp(name, "ack_decim", 9))
+        {
+            settings->es_ack_decim = atoi(val);
+            return 0;
+        }
+        break;
     case 10:
         if (0 == strncmp(name, "honor_prst", 10))
         {
@@ -802,6 +833,13 @@ set_engine_option (struct lsquic_engine_settings *settings,
             return 0;
         }
         break;
+    case 11:
+        if (0 == strncmp(name, "use_di_ring", 11))
+        {
+            settings->es_use_di_ring = atoi(val);
+            return 0;
+        }
+        break;
     case 12:
         if (0 == strncmp(name, "idle_conn_to", 12))
         {
@@ -830,6 +868,11 @@ set_engine_option (struct lsquic_engine_settings *settings,
             settings->es_support_tcid0 = atoi(val);
             return 0;
         }
+        if (0 == strncmp(name, "fc_mem_budget", 13))
+        {
+            settings->es_fc_mem_budget = strtoull(val, NULL, 10);
+            return 0;
+        }
         break;
     case 14:
         if (0 == strncmp(name, "max_streams_in", 14))
@@ -843,6 +886,13 @@ set_engine_option (struct lsquic_engine_settings *settings,
             return 0;
         }
         break;
+    case 15:
+        if (0 == strncmp(name, "ack_decim_start", 15))
+        {
+            settings->es_ack_decim_start = atoi(val);
+            return 0;
+        }
+        break;
     case 16:
         if (0 == strncmp(name, "proc_time_thresh", 16))
         {